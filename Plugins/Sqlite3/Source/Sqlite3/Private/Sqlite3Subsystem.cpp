@@ -1,10 +1,16 @@
 // (c)2024+ Laurent Menten
 
 #include "Sqlite3Subsystem.h"
-#include "platform/Sqlite3Platform.h"
+#include "platform/SQLite3Platform.h"
+#include "platform/pcache.h"
+#include "platform/malloc.h"
+#include "platform/file.h"
 
 #include "CoreMinimal.h"
 #include "Kismet/GameplayStatics.h"
+#include "Misc/CoreDelegates.h"
+#include "UObject/UObjectGlobals.h"
+#include "ProfilingDebugging/CsvProfiler.h"
 
 #include "Misc/MessageDialog.h"
 
@@ -46,6 +52,8 @@
 
 static const FText MessageBoxTitle = FText::FromString( "Sqlite subsystem" );
 
+CSV_DEFINE_CATEGORY( Sqlite, true );
+
 // ============================================================================
 // 
 // ============================================================================
@@ -132,6 +140,30 @@ void USqlite3Subsystem::Initialize( FSubsystemCollectionBase& Collection )
 		UE_LOG( LogSqlite, Log, TEXT("Library successfully initialized") );
 	}
 
+	// ---------------------------------------------------------------------------
+	// Memory budget & trimming
+	// ---------------------------------------------------------------------------
+
+	SetSoftHeapLimit( SoftHeapLimit );
+	SetHardHeapLimit( HardHeapLimit );
+
+	if( bTrimOnMemoryWarning )
+	{
+		MemoryTrimDelegateHandle = FCoreDelegates::GetMemoryTrimDelegate().AddUObject( this, &USqlite3Subsystem::OnMemoryTrim );
+		LowMemoryDelegateHandle = FCoreDelegates::ApplicationShouldUnloadResourcesDelegate.AddUObject( this, &USqlite3Subsystem::OnMemoryTrim );
+	}
+
+	if( bTrimOnLevelTransition )
+	{
+		PostLoadMapDelegateHandle = FCoreUObjectDelegates::PostLoadMapWithWorld.AddUObject( this, &USqlite3Subsystem::OnPostLoadMap );
+	}
+
+	// ---------------------------------------------------------------------------
+	// Write queues and file I/O profiling
+	// ---------------------------------------------------------------------------
+
+	EndFrameDelegateHandle = FCoreDelegates::OnEndFrame.AddUObject( this, &USqlite3Subsystem::OnEndFrame );
+
 	UE_LOG(LogSqlite, Log, TEXT("-- -- -- -- -- -- -- -- -- -- -- -- -- -- -- --"));
 }
 
@@ -141,7 +173,28 @@ bool USqlite3Subsystem::InitializeSqlite()
 	{
 #if SQLITE_OS_OTHER
 
-		SqliteInitializationStatus = sqlite3_ue_config();
+		FSQLitePlatformConfig PlatformConfig;
+		PlatformConfig.bUseSlabAllocator = bUseSlabAllocator;
+		PlatformConfig.SlabAllocatorRegionSize = SlabAllocatorRegionSize;
+		PlatformConfig.bMemStatus = bSqliteMemStatus;
+		PlatformConfig.bUseAdaptiveMutex = bUseAdaptiveMutex;
+		PlatformConfig.bUseCustomPageCache = bUseCustomPageCache;
+		PlatformConfig.PageCacheBudget = PageCacheBudget;
+		PlatformConfig.PageCacheReserve = PageCacheReserve;
+		PlatformConfig.PageCacheSlabSize = PageCacheSlabSize;
+		PlatformConfig.bUseNamedSharedMemory = bUseNamedSharedMemory;
+		PlatformConfig.ReadAheadMaxSize = ReadAheadMaxSize;
+		PlatformConfig.bUseWriteCoalescing = bUseWriteCoalescing;
+		PlatformConfig.WriteCoalescingMaxSize = WriteCoalescingMaxSize;
+		PlatformConfig.bRelaxedDurability = bRelaxedDurability;
+		PlatformConfig.SyncFlushWindowMs = SyncFlushWindowMs;
+		PlatformConfig.bUseMemoryTempFiles = bUseMemoryTempFiles;
+		PlatformConfig.MemoryTempFileSpillSize = MemoryTempFileSpillSize;
+		PlatformConfig.PakBlockSize = PakBlockSize;
+		PlatformConfig.PakBlockCacheSize = PakBlockCacheSize;
+		PlatformConfig.IoUringQueueDepth = IoUringQueueDepth;
+
+		SqliteInitializationStatus = sqlite3_ue_config( PlatformConfig );
 		if( SqliteInitializationStatus != SQLITE_OK )
 		{
 			LOG_SQLITE_ERROR( SqliteInitializationStatus, "Sqlite Platform specific initialization failed." );
@@ -151,7 +204,11 @@ bool USqlite3Subsystem::InitializeSqlite()
 
 #endif
 
+#if SQLITE_OS_OTHER
+		SqliteInitializationStatus = sqlite3_ue_initialize();
+#else
 		SqliteInitializationStatus = sqlite3_initialize();
+#endif
 		if( SqliteInitializationStatus != SQLITE_OK )
 		{
 			LOG_SQLITE_ERROR( SqliteInitializationStatus, "Sqlite initialization failed." );
@@ -175,6 +232,11 @@ void USqlite3Subsystem::Deinitialize()
 	UE_LOG( LogSqlite, Log, TEXT( "--     Sqlite subsystem deinitialization     --" ) );
 	UE_LOG( LogSqlite, Log, TEXT( "-- -- -- -- -- -- -- -- -- -- -- -- -- -- -- --" ) );
 
+	FCoreDelegates::GetMemoryTrimDelegate().Remove( MemoryTrimDelegateHandle );
+	FCoreDelegates::ApplicationShouldUnloadResourcesDelegate.Remove( LowMemoryDelegateHandle );
+	FCoreUObjectDelegates::PostLoadMapWithWorld.Remove( PostLoadMapDelegateHandle );
+	FCoreDelegates::OnEndFrame.Remove( EndFrameDelegateHandle );
+
 	// ---------------------------------------------------------------------------
 	// Handle database finalization
 	// ---------------------------------------------------------------------------
@@ -204,7 +266,11 @@ void USqlite3Subsystem::DeinitializeSqlite()
 {
 	if( bIsSqliteInitialized )
 	{
+#if SQLITE_OS_OTHER
+		sqlite3_ue_shutdown();
+#else
 		sqlite3_shutdown();
+#endif
 	}
 }
 
@@ -238,4 +304,304 @@ void USqlite3Subsystem::RegisterDatabase( USqliteDatabase* Database )
 	Databases.Add( Database );
 }
 
+// ============================================================================
+// = Memory
+// ============================================================================
+
+FSqliteMemoryStatus USqlite3Subsystem::GetMemoryStatus( const bool bResetHighWater )
+{
+	FSqliteMemoryStatus Status;
+
+	sqlite3_status64( SQLITE_STATUS_PAGECACHE_OVERFLOW, &Status.PageCacheOverflow, &Status.PageCacheOverflowHighWater, bResetHighWater );
+
+#if SQLITE_OS_OTHER
+	if( FSQLiteMallocFuncs::IsCountingAllocations() )
+	{
+		FSQLiteMemoryStats MemoryStats;
+		FSQLiteMallocFuncs::GetMemoryStats( MemoryStats, bResetHighWater );
+
+		Status.MemoryUsed = MemoryStats.MemoryUsed;
+		Status.MemoryUsedHighWater = MemoryStats.MemoryUsedHighWater;
+		Status.AllocationCount = MemoryStats.AllocationCount;
+		Status.AllocationCountHighWater = MemoryStats.AllocationCountHighWater;
+		Status.LargestAllocation = MemoryStats.LargestAllocation;
+
+		return Status;
+	}
+#endif
+
+	sqlite3_status64( SQLITE_STATUS_MEMORY_USED, &Status.MemoryUsed, &Status.MemoryUsedHighWater, bResetHighWater );
+	sqlite3_status64( SQLITE_STATUS_MALLOC_COUNT, &Status.AllocationCount, &Status.AllocationCountHighWater, bResetHighWater );
+
+	// For MALLOC_SIZE only the high-water mark is meaningful
+	sqlite3_int64 Unused;
+	sqlite3_status64( SQLITE_STATUS_MALLOC_SIZE, &Unused, &Status.LargestAllocation, bResetHighWater );
+
+	return Status;
+}
+
+int64 USqlite3Subsystem::GetMemoryUsed() const
+{
+#if SQLITE_OS_OTHER
+	if( FSQLiteMallocFuncs::IsCountingAllocations() )
+	{
+		FSQLiteMemoryStats MemoryStats;
+		FSQLiteMallocFuncs::GetMemoryStats( MemoryStats, false );
+
+		return MemoryStats.MemoryUsed;
+	}
+#endif
+
+	return sqlite3_memory_used();
+}
+
+void USqlite3Subsystem::SetSoftHeapLimit( const int64 LimitBytes )
+{
+	SoftHeapLimit = FMath::Max<int64>( LimitBytes, 0 );
+	sqlite3_soft_heap_limit64( SoftHeapLimit );
+
+	UE_LOG( LogSqlite, Log, TEXT("Soft heap limit set to %lld bytes."), SoftHeapLimit );
+
+#if SQLITE_OS_OTHER
+	if( SoftHeapLimit > 0 && !bSqliteMemStatus )
+	{
+		UE_LOG( LogSqlite, Warning, TEXT("Soft heap limit is not enforced while SQLite memory statistics are off (bSqliteMemStatus).") );
+	}
+#endif
+}
+
+void USqlite3Subsystem::SetHardHeapLimit( const int64 LimitBytes )
+{
+	HardHeapLimit = FMath::Max<int64>( LimitBytes, 0 );
+	sqlite3_hard_heap_limit64( HardHeapLimit );
+
+	UE_LOG( LogSqlite, Log, TEXT("Hard heap limit set to %lld bytes."), HardHeapLimit );
+
+#if SQLITE_OS_OTHER
+	if( HardHeapLimit > 0 && !bSqliteMemStatus )
+	{
+		UE_LOG( LogSqlite, Warning, TEXT("Hard heap limit is not enforced while SQLite memory statistics are off (bSqliteMemStatus).") );
+	}
+#endif
+}
+
+int64 USqlite3Subsystem::TrimMemory()
+{
+	const int64 MemoryUsedBefore = GetMemoryUsed();
+
+	for( const auto& db : Databases )
+	{
+		db->ReleaseMemory();
+	}
+
+	// Only does something when built with SQLITE_ENABLE_MEMORY_MANAGEMENT
+	sqlite3_release_memory( MAX_int32 );
+
+	int64 ReclaimedBytes = FMath::Max<int64>( MemoryUsedBefore - GetMemoryUsed(), 0 );
+
+#if SQLITE_OS_OTHER
+	// Page cache slabs are not allocated through SQLite and are not part of sqlite3_memory_used
+	ReclaimedBytes += FSQLitePageCacheFuncs::ReleaseMemory();
+#endif
+
+	MemoryTrimStats.TrimCount++;
+	MemoryTrimStats.LastReclaimedBytes = ReclaimedBytes;
+	MemoryTrimStats.TotalReclaimedBytes += ReclaimedBytes;
+
+	UE_LOG( LogSqlite, Log, TEXT("Memory trim reclaimed %lld bytes."), ReclaimedBytes );
+
+	return ReclaimedBytes;
+}
+
+FSqliteMemoryTrimStats USqlite3Subsystem::GetMemoryTrimStats() const
+{
+	return MemoryTrimStats;
+}
+
+FSqlitePageCacheStats USqlite3Subsystem::GetPageCacheStats() const
+{
+	FSqlitePageCacheStats Stats;
+
+#if SQLITE_OS_OTHER
+	FSQLitePageCacheStats PageCacheStats;
+	FSQLitePageCacheFuncs::GetStats( PageCacheStats );
+
+	Stats.Hits = PageCacheStats.Hits;
+	Stats.Misses = PageCacheStats.Misses;
+	Stats.HitRatio = ( PageCacheStats.Hits + PageCacheStats.Misses ) > 0
+		? (float)( (double)PageCacheStats.Hits / (double)( PageCacheStats.Hits + PageCacheStats.Misses ) )
+		: 0.0f;
+	Stats.Evictions = PageCacheStats.Evictions;
+	Stats.Recycles = PageCacheStats.Recycles;
+	Stats.Overflows = PageCacheStats.Overflows;
+	Stats.PageCount = PageCacheStats.PageCount;
+	Stats.CacheCount = PageCacheStats.CacheCount;
+	Stats.BytesInUse = PageCacheStats.BytesInUse;
+	Stats.BytesReserved = PageCacheStats.BytesReserved;
+	Stats.Budget = PageCacheStats.Budget;
+#endif
+
+	return Stats;
+}
+
+// ============================================================================
+// === Files ==================================================================
+// ============================================================================
+
+#if SQLITE_OS_OTHER
+
+static FSqliteIoOpStats ToIoOpStats( const FSQLiteIoStatsSnapshot::FOp& InOp )
+{
+	FSqliteIoOpStats Stats;
+
+	Stats.Count = InOp.Count;
+	Stats.Bytes = InOp.Bytes;
+	Stats.TotalLatencyUs = InOp.TotalMicroseconds;
+	Stats.AverageLatencyUs = InOp.Count > 0 ? (float)( (double)InOp.TotalMicroseconds / (double)InOp.Count ) : 0.0f;
+	Stats.LatencyHistogram.Append( InOp.LatencyHistogram, SQLiteIoLatencyBucketCount );
+
+	// Upper bound of the bucket holding the 99th percentile
+	int64 Remaining = InOp.Count - ( InOp.Count * 99 ) / 100;
+	for( int32 Bucket = SQLiteIoLatencyBucketCount - 1; Bucket >= 0 && InOp.Count > 0; Bucket-- )
+	{
+		Remaining -= InOp.LatencyHistogram[Bucket];
+		if( Remaining < 0 || Bucket == 0 )
+		{
+			Stats.P99LatencyUs = 1ll << Bucket;
+			break;
+		}
+	}
+
+	return Stats;
+}
+
+static FSqliteFileIoStats ToFileIoStats( const FSQLiteIoStatsSnapshot& InSnapshot )
+{
+	FSqliteFileIoStats Stats;
+
+	Stats.Filename = InSnapshot.Filename;
+	Stats.FileType = (ESqliteFileType)InSnapshot.FileType;
+	Stats.Reads = ToIoOpStats( InSnapshot.Ops[(int32)ESQLiteIoOp::Read] );
+	Stats.Writes = ToIoOpStats( InSnapshot.Ops[(int32)ESQLiteIoOp::Write] );
+	Stats.Syncs = ToIoOpStats( InSnapshot.Ops[(int32)ESQLiteIoOp::Sync] );
+	Stats.Truncates = ToIoOpStats( InSnapshot.Ops[(int32)ESQLiteIoOp::Truncate] );
+
+	return Stats;
+}
+
+#endif
+
+TArray<FSqliteFileIoStats> USqlite3Subsystem::GetFileTypeIoStats() const
+{
+	TArray<FSqliteFileIoStats> Stats;
+
+#if SQLITE_OS_OTHER
+	TArray<FSQLiteIoStatsSnapshot> Snapshots;
+	FSQLiteFileFuncs::GetFileTypeIoStats( Snapshots );
+
+	for( const FSQLiteIoStatsSnapshot& Snapshot : Snapshots )
+	{
+		Stats.Add( ToFileIoStats( Snapshot ) );
+	}
+#endif
+
+	return Stats;
+}
+
+TArray<FSqliteFileIoStats> USqlite3Subsystem::GetOpenFileIoStats() const
+{
+	TArray<FSqliteFileIoStats> Stats;
+
+#if SQLITE_OS_OTHER
+	TArray<FSQLiteIoStatsSnapshot> Snapshots;
+	FSQLiteFileFuncs::GetOpenFileIoStats( Snapshots );
+
+	for( const FSQLiteIoStatsSnapshot& Snapshot : Snapshots )
+	{
+		Stats.Add( ToFileIoStats( Snapshot ) );
+	}
+#endif
+
+	return Stats;
+}
+
+void USqlite3Subsystem::OnEndFrame()
+{
+	for( const auto& db : Databases )
+	{
+		db->TickWriteQueue();
+	}
+
+#if CSV_PROFILER && SQLITE_OS_OTHER
+	if( !FCsvProfiler::Get()->IsCapturing() )
+	{
+		return;
+	}
+
+	// One set of stats per kind of file and operation: count, KiB and milliseconds spent during the frame
+	static const TCHAR* FileTypeNames[] = { TEXT( "MainDb" ), TEXT( "Journal" ), TEXT( "Wal" ), TEXT( "Temp" ), TEXT( "Other" ) };
+	static const TCHAR* OpNames[] = { TEXT( "Read" ), TEXT( "Write" ), TEXT( "Sync" ), TEXT( "Truncate" ) };
+	static_assert( UE_ARRAY_COUNT( FileTypeNames ) == (int32)ESQLiteFileType::Count, "Missing file type name" );
+	static_assert( UE_ARRAY_COUNT( OpNames ) == (int32)ESQLiteIoOp::Count, "Missing operation name" );
+
+	struct FCsvStatNames
+	{
+		FName Count;
+		FName KiB;
+		FName Ms;
+	};
+
+	static TArray<FCsvStatNames> StatNames;
+	if( StatNames.IsEmpty() )
+	{
+		for( const TCHAR* FileTypeName : FileTypeNames )
+		{
+			for( const TCHAR* OpName : OpNames )
+			{
+				StatNames.Add( {
+					FName( FString::Printf( TEXT( "%s%ss" ), FileTypeName, OpName ) ),
+					FName( FString::Printf( TEXT( "%s%sKiB" ), FileTypeName, OpName ) ),
+					FName( FString::Printf( TEXT( "%s%sMs" ), FileTypeName, OpName ) ) } );
+			}
+		}
+	}
+
+	TArray<FSQLiteIoStatsSnapshot> Snapshots;
+	FSQLiteFileFuncs::GetFileTypeIoStats( Snapshots );
+
+	static TArray<FSQLiteIoStatsSnapshot> PreviousSnapshots;
+	if( PreviousSnapshots.Num() != Snapshots.Num() )
+	{
+		PreviousSnapshots = Snapshots;
+		return;
+	}
+
+	for( int32 FileType = 0; FileType < (int32)ESQLiteFileType::Count; FileType++ )
+	{
+		for( int32 Op = 0; Op < (int32)ESQLiteIoOp::Count; Op++ )
+		{
+			const FSQLiteIoStatsSnapshot::FOp& Current = Snapshots[FileType].Ops[Op];
+			const FSQLiteIoStatsSnapshot::FOp& Previous = PreviousSnapshots[FileType].Ops[Op];
+			const FCsvStatNames& Names = StatNames[FileType * (int32)ESQLiteIoOp::Count + Op];
+
+			FCsvProfiler::RecordCustomStat( Names.Count, CSV_CATEGORY_INDEX( Sqlite ), (float)( Current.Count - Previous.Count ), ECsvCustomStatOp::Set );
+			FCsvProfiler::RecordCustomStat( Names.KiB, CSV_CATEGORY_INDEX( Sqlite ), (float)( Current.Bytes - Previous.Bytes ) / 1024.0f, ECsvCustomStatOp::Set );
+			FCsvProfiler::RecordCustomStat( Names.Ms, CSV_CATEGORY_INDEX( Sqlite ), (float)( Current.TotalMicroseconds - Previous.TotalMicroseconds ) / 1000.0f, ECsvCustomStatOp::Set );
+		}
+	}
+
+	PreviousSnapshots = MoveTemp( Snapshots );
+#endif
+}
+
+void USqlite3Subsystem::OnMemoryTrim()
+{
+	TrimMemory();
+}
+
+void USqlite3Subsystem::OnPostLoadMap( UWorld* LoadedWorld )
+{
+	TrimMemory();
+}
+
 #undef LOCTEXT_NAMESPACE
\ No newline at end of file
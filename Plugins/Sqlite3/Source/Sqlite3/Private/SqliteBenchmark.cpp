@@ -0,0 +1,707 @@
+// (c)2024+ Laurent Menten
+
+#include "CoreMinimal.h"
+#include "HAL/IConsoleManager.h"
+#include "Async/Async.h"
+#include "HAL/FileManager.h"
+#include "Misc/Paths.h"
+#include "Math/RandomStream.h"
+#include "Sqlite3Log.h"
+#include "sqlite/Sqlite3Include.h"
+#include "platform/SQLite3Platform.h"
+#include "platform/malloc.h"
+#include "platform/mutex.h"
+#include "platform/file.h"
+
+#include <atomic>
+
+// Benchmarks of the SQLite platform layer, run from the console of a game in
+// which the Sqlite3 subsystem initialized the library with the settings to
+// compare (one run per setting):
+//
+//	sqlite.Bench <Name> [Key=Value ...]
+
+#if !UE_BUILD_SHIPPING
+
+namespace SqliteBenchmark
+{
+	/**
+	 * Run a body on that many threads started together, returns the wall time in seconds.
+	 */
+	static double RunOnThreads( const int32 ThreadCount, TFunctionRef<void( int32 )> Body )
+	{
+		std::atomic<int32> ReadyCount = 0;
+		std::atomic<bool> bGo = false;
+
+		TArray<TFuture<void>> Threads;
+		for( int32 ThreadIndex = 0; ThreadIndex < ThreadCount; ThreadIndex++ )
+		{
+			Threads.Add( Async( EAsyncExecution::Thread, [&, ThreadIndex]()
+			{
+				ReadyCount++;
+				while( !bGo )
+				{
+					FPlatformProcess::YieldThread();
+				}
+
+				Body( ThreadIndex );
+			} ) );
+		}
+
+		while( ReadyCount < ThreadCount )
+		{
+			FPlatformProcess::YieldThread();
+		}
+
+		const double StartTime = FPlatformTime::Seconds();
+		bGo = true;
+
+		for( TFuture<void>& Thread : Threads )
+		{
+			Thread.Wait();
+		}
+
+		return FPlatformTime::Seconds() - StartTime;
+	}
+
+	/** Path of a scratch database of the benchmarks, in Saved/Sqlite/Benchmark */
+	static FString GetScratchFilename( const FString& Name )
+	{
+		return FPaths::ConvertRelativePathToFull( FPaths::ProjectSavedDir() / TEXT( "Sqlite/Benchmark" ) / Name + TEXT( ".db" ) );
+	}
+
+	/**
+	 * Open a scratch database, a fresh one unless bFresh is false, with a file
+	 * system (empty for the default one), a journal mode and a synchronous level.
+	 */
+	static sqlite3* OpenScratchDatabase( const FString& Name, const FString& VfsName, const FString& JournalMode, const FString& Synchronous, const bool bFresh = true )
+	{
+		const FString Filename = GetScratchFilename( Name );
+		IFileManager::Get().MakeDirectory( *FPaths::GetPath( Filename ), true );
+
+		if( bFresh )
+		{
+			for( const TCHAR* Suffix : { TEXT( "" ), TEXT( "-journal" ), TEXT( "-wal" ), TEXT( "-shm" ) } )
+			{
+				IFileManager::Get().Delete( *( Filename + Suffix ), false, true, true );
+			}
+		}
+
+		sqlite3* Db = nullptr;
+		const int rc = sqlite3_open_v2( TCHAR_TO_UTF8( *Filename ), &Db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, VfsName.IsEmpty() ? nullptr : TCHAR_TO_UTF8( *VfsName ) );
+		if( rc != SQLITE_OK )
+		{
+			UE_LOG( LogSqlite, Error, TEXT( "Cannot open the benchmark database [%s] with file system '%s': %hs" ), *Filename, *VfsName, sqlite3_errstr( rc ) );
+			sqlite3_close_v2( Db );
+			return nullptr;
+		}
+
+		const FString Pragmas = FString::Printf( TEXT( "PRAGMA journal_mode=%s; PRAGMA synchronous=%s;" ), *JournalMode, *Synchronous );
+		sqlite3_exec( Db, TCHAR_TO_UTF8( *Pragmas ), nullptr, nullptr, nullptr );
+
+		return Db;
+	}
+
+	/** Value of a percentile of sorted samples */
+	static double Percentile( const TArray<double>& SortedSamples, const double Fraction )
+	{
+		if( SortedSamples.IsEmpty() )
+		{
+			return 0.0;
+		}
+
+		return SortedSamples[FMath::Min( (int32)( Fraction * SortedSamples.Num() ), SortedSamples.Num() - 1 )];
+	}
+
+	// ============================================================================
+	// === Alloc ==================================================================
+	// ============================================================================
+
+	/** Allocation functions timed by Alloc */
+	struct FAllocatorFuncs
+	{
+		const TCHAR* Name;
+		void* ( *Malloc )( int );
+		void* ( *Realloc )( void*, int );
+		void ( *Free )( void* );
+	};
+
+	/**
+	 * Malloc, realloc (to twice the size) and free of the sizes SQLite uses
+	 * most, by batches (so that the thread caches of the slab allocator are
+	 * refilled and drained), on one or more threads. Each allocator of the
+	 * malloc shim is called directly, whichever Register chose, next to
+	 * sqlite3_malloc which goes through the registered one and the SQLite
+	 * memory statistics.
+	 */
+	static void Alloc( const int32 ThreadCount, const int32 Iterations )
+	{
+		static const int32 Sizes[] = { 16, 64, 256, 1024, 4096, 65536 };
+		static const int32 BatchSize = 64;
+
+		const int32 BatchCount = FMath::Max( Iterations / BatchSize, 1 );
+
+		TArray<FAllocatorFuncs> Allocators;
+		Allocators.Add( { TEXT( "sqlite3_malloc (registered)" ),
+			[]( int Size ) { return sqlite3_malloc( Size ); },
+			[]( void* Ptr, int Size ) { return sqlite3_realloc( Ptr, Size ); },
+			[]( void* Ptr ) { sqlite3_free( Ptr ); } } );
+
+#if SQLITE_OS_OTHER
+		TArray<FSQLiteAllocator> ShimAllocators;
+		FSQLiteMallocFuncs::GetAllocators( ShimAllocators );
+		for( const FSQLiteAllocator& ShimAllocator : ShimAllocators )
+		{
+			Allocators.Add( { ShimAllocator.Name, ShimAllocator.Funcs->xMalloc, ShimAllocator.Funcs->xRealloc, ShimAllocator.Funcs->xFree } );
+		}
+#endif
+
+		for( const FAllocatorFuncs& Allocator : Allocators )
+		{
+			for( const int32 Size : Sizes )
+			{
+				std::atomic<uint64> MallocCycles = 0;
+				std::atomic<uint64> ReallocCycles = 0;
+				std::atomic<uint64> FreeCycles = 0;
+
+				RunOnThreads( ThreadCount, [&]( int32 )
+				{
+					void* Blocks[BatchSize];
+					uint64 ThreadCycles[3] = { 0, 0, 0 };
+
+					for( int32 Batch = 0; Batch < BatchCount; Batch++ )
+					{
+						uint64 StartCycles = FPlatformTime::Cycles64();
+						for( int32 Block = 0; Block < BatchSize; Block++ )
+						{
+							Blocks[Block] = Allocator.Malloc( Size );
+						}
+
+						uint64 EndCycles = FPlatformTime::Cycles64();
+						ThreadCycles[0] += EndCycles - StartCycles;
+						StartCycles = EndCycles;
+
+						for( int32 Block = 0; Block < BatchSize; Block++ )
+						{
+							void* Grown = Allocator.Realloc( Blocks[Block], Size * 2 );
+							Blocks[Block] = Grown ? Grown : Blocks[Block];
+						}
+
+						EndCycles = FPlatformTime::Cycles64();
+						ThreadCycles[1] += EndCycles - StartCycles;
+						StartCycles = EndCycles;
+
+						for( int32 Block = 0; Block < BatchSize; Block++ )
+						{
+							Allocator.Free( Blocks[Block] );
+						}
+
+						ThreadCycles[2] += FPlatformTime::Cycles64() - StartCycles;
+					}
+
+					MallocCycles += ThreadCycles[0];
+					ReallocCycles += ThreadCycles[1];
+					FreeCycles += ThreadCycles[2];
+				} );
+
+				// Per call and thread
+				const double Calls = (double)BatchCount * BatchSize * ThreadCount;
+
+				UE_LOG( LogSqlite, Display, TEXT( "Alloc %-28s %6d bytes: malloc %7.1f ns, realloc %7.1f ns, free %7.1f ns (%d thread(s))" ),
+					Allocator.Name,
+					Size,
+					FPlatformTime::ToSeconds64( MallocCycles ) * 1000000000.0 / Calls,
+					FPlatformTime::ToSeconds64( ReallocCycles ) * 1000000000.0 / Calls,
+					FPlatformTime::ToSeconds64( FreeCycles ) * 1000000000.0 / Calls,
+					ThreadCount );
+			}
+		}
+	}
+
+	// ============================================================================
+	// === MemStatus ==============================================================
+	// ============================================================================
+
+	/**
+	 * Allocation throughput on one thread then on ThreadCount threads, while
+	 * the memory statistics are read as the subsystem does. With SQLite
+	 * memstatus on every allocation takes SQLITE_MUTEX_STATIC_MEM, with it off
+	 * (bSqliteMemStatus) the malloc shim counts them per thread: compare the
+	 * scaling of a run with each setting.
+	 */
+	static void MemStatus( const int32 ThreadCount, const int32 Iterations )
+	{
+		static const int32 Sizes[] = { 24, 64, 120, 512, 1032, 4104 };
+
+#if SQLITE_OS_OTHER
+		const bool bCountingAllocations = FSQLiteMallocFuncs::IsCountingAllocations();
+#else
+		const bool bCountingAllocations = false;
+#endif
+
+		double PairsPerSecond[2];
+		double ReadNs = 0.0;
+
+		for( int32 Run = 0; Run < 2; Run++ )
+		{
+			const int32 RunThreadCount = Run == 0 ? 1 : ThreadCount;
+
+			std::atomic<int32> RunningCount = RunThreadCount;
+			int32 ReadCount = 0;
+			double ReadSeconds = 0.0;
+
+			// The statistics reader competes with the allocating threads
+			TFuture<void> Reader = Async( EAsyncExecution::Thread, [&]()
+			{
+				while( RunningCount > 0 )
+				{
+					const double StartTime = FPlatformTime::Seconds();
+					sqlite3_int64 Current, HighWater;
+#if SQLITE_OS_OTHER
+					if( bCountingAllocations )
+					{
+						FSQLiteMemoryStats MemoryStats;
+						FSQLiteMallocFuncs::GetMemoryStats( MemoryStats, false );
+					}
+					else
+#endif
+					{
+						sqlite3_status64( SQLITE_STATUS_MEMORY_USED, &Current, &HighWater, 0 );
+						sqlite3_status64( SQLITE_STATUS_MALLOC_COUNT, &Current, &HighWater, 0 );
+					}
+					ReadSeconds += FPlatformTime::Seconds() - StartTime;
+					ReadCount++;
+
+					FPlatformProcess::Sleep( 0.001f );
+				}
+			} );
+
+			const double Seconds = RunOnThreads( RunThreadCount, [&]( int32 ThreadIndex )
+			{
+				for( int32 Iteration = 0; Iteration < Iterations; Iteration++ )
+				{
+					void* Block = sqlite3_malloc( Sizes[( Iteration + ThreadIndex ) % UE_ARRAY_COUNT( Sizes )] );
+					sqlite3_free( Block );
+				}
+
+				RunningCount--;
+			} );
+
+			Reader.Wait();
+
+			PairsPerSecond[Run] = (double)Iterations * RunThreadCount / Seconds;
+			ReadNs = ReadCount > 0 ? ReadSeconds * 1000000000.0 / ReadCount : 0.0;
+		}
+
+		UE_LOG( LogSqlite, Display, TEXT( "MemStatus (%s): %7.2f M pairs/s on 1 thread, %7.2f M pairs/s on %d threads (x%.2f), %.0f ns per statistics read" ),
+			bCountingAllocations ? TEXT( "counted by the malloc shim" ) : TEXT( "SQLite memstatus" ),
+			PairsPerSecond[0] / 1000000.0,
+			PairsPerSecond[1] / 1000000.0,
+			ThreadCount,
+			PairsPerSecond[1] / PairsPerSecond[0],
+			ReadNs );
+	}
+
+	// ============================================================================
+	// === Mutex ==================================================================
+	// ============================================================================
+
+	/**
+	 * Contention on SQLite mutexes: ThreadCount threads taking one FAST mutex
+	 * for a tiny critical section, then stepping statements on one shared
+	 * connection opened with SQLITE_OPEN_FULLMUTEX. Compare a run with and
+	 * without bUseAdaptiveMutex.
+	 */
+	static void Mutex( const int32 ThreadCount, const int32 Iterations )
+	{
+#if SQLITE_OS_OTHER
+		const TCHAR* MutexKind = FSQLiteMutexFuncs::IsUsingAdaptiveMutex() ? TEXT( "adaptive lock" ) : TEXT( "FCriticalSection" );
+#else
+		const TCHAR* MutexKind = TEXT( "SQLite mutexes" );
+#endif
+
+		sqlite3_mutex* FastMutex = sqlite3_mutex_alloc( SQLITE_MUTEX_FAST );
+		if( FastMutex == nullptr )
+		{
+			UE_LOG( LogSqlite, Error, TEXT( "Mutex: SQLite is not initialized." ) );
+			return;
+		}
+
+		int64 SharedCounter = 0;
+
+		const double FastSeconds = RunOnThreads( ThreadCount, [&]( int32 )
+		{
+			for( int32 Iteration = 0; Iteration < Iterations; Iteration++ )
+			{
+				sqlite3_mutex_enter( FastMutex );
+				SharedCounter++;
+				sqlite3_mutex_leave( FastMutex );
+			}
+		} );
+
+		sqlite3_mutex_free( FastMutex );
+
+		UE_LOG( LogSqlite, Display, TEXT( "Mutex (%s): FAST mutex, %7.1f ns per enter/leave, %7.2f M/s on %d thread(s)" ),
+			MutexKind,
+			FastSeconds * 1000000000.0 / Iterations,
+			(double)Iterations * ThreadCount / FastSeconds / 1000000.0,
+			ThreadCount );
+
+		sqlite3* Db = nullptr;
+		int rc = sqlite3_open_v2( ":memory:", &Db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX, nullptr );
+		if( rc != SQLITE_OK )
+		{
+			LOG_SQLITE_ERROR( rc, "Mutex: failed to open the shared connection." );
+			sqlite3_close_v2( Db );
+			return;
+		}
+
+		// Statements are short so that the connection mutex dominates
+		const int32 StatementIterations = FMath::Max( Iterations / 10, 1 );
+
+		const double SharedSeconds = RunOnThreads( ThreadCount, [&]( int32 ThreadIndex )
+		{
+			sqlite3_stmt* Statement = nullptr;
+			if( sqlite3_prepare_v2( Db, "SELECT ?1 + 1;", -1, &Statement, nullptr ) != SQLITE_OK )
+			{
+				return;
+			}
+
+			for( int32 Iteration = 0; Iteration < StatementIterations; Iteration++ )
+			{
+				sqlite3_bind_int( Statement, 1, ThreadIndex );
+				sqlite3_step( Statement );
+				sqlite3_reset( Statement );
+			}
+
+			sqlite3_finalize( Statement );
+		} );
+
+		sqlite3_close_v2( Db );
+
+		UE_LOG( LogSqlite, Display, TEXT( "Mutex (%s): shared FULLMUTEX connection, %7.2f K statements/s on %d thread(s)" ),
+			MutexKind,
+			(double)StatementIterations * ThreadCount / SharedSeconds / 1000.0,
+			ThreadCount );
+	}
+
+	// ============================================================================
+	// === Commit =================================================================
+	// ============================================================================
+
+	/**
+	 * Latency of small write transactions (one row each), as a game saving its
+	 * state. Compare runs with and without write coalescing, relaxed durability
+	 * or group durability, and across file systems and journal modes.
+	 */
+	static void Commit( const FString& VfsName, const FString& JournalMode, const FString& Synchronous, const int32 CommitCount )
+	{
+		sqlite3* Db = OpenScratchDatabase( TEXT( "Commit" ), VfsName, JournalMode, Synchronous );
+		if( Db == nullptr )
+		{
+			return;
+		}
+
+		sqlite3_exec( Db, "CREATE TABLE Bench( Id INTEGER PRIMARY KEY, Payload BLOB );", nullptr, nullptr, nullptr );
+
+		sqlite3_stmt* Insert = nullptr;
+		sqlite3_prepare_v2( Db, "INSERT INTO Bench( Payload ) VALUES( randomblob( 200 ) );", -1, &Insert, nullptr );
+
+		TArray<double> Latencies;
+		Latencies.Reserve( CommitCount );
+
+		const double StartTime = FPlatformTime::Seconds();
+
+		for( int32 CommitIndex = 0; CommitIndex < CommitCount; CommitIndex++ )
+		{
+			const double CommitStartTime = FPlatformTime::Seconds();
+
+			sqlite3_exec( Db, "BEGIN;", nullptr, nullptr, nullptr );
+			sqlite3_step( Insert );
+			sqlite3_reset( Insert );
+			sqlite3_exec( Db, "COMMIT;", nullptr, nullptr, nullptr );
+
+			Latencies.Add( ( FPlatformTime::Seconds() - CommitStartTime ) * 1000000.0 );
+		}
+
+		const double Seconds = FPlatformTime::Seconds() - StartTime;
+
+		sqlite3_finalize( Insert );
+		sqlite3_close_v2( Db );
+
+		Latencies.Sort();
+
+		UE_LOG( LogSqlite, Display, TEXT( "Commit (%s, journal %s, synchronous %s): p50 %.0f us, p99 %.0f us, max %.0f us, %.0f commits/s" ),
+			VfsName.IsEmpty() ? TEXT( "default file system" ) : *VfsName,
+			*JournalMode,
+			*Synchronous,
+			Percentile( Latencies, 0.50 ),
+			Percentile( Latencies, 0.99 ),
+			Latencies.Last(),
+			CommitCount / Seconds );
+	}
+
+	// ============================================================================
+	// === Journal ================================================================
+	// ============================================================================
+
+	/**
+	 * Journal and WAL bytes written (and syncs) per commit of one updated row,
+	 * in each journal mode, with the sector size and device characteristics
+	 * detected for the file system, then with the worst-case ones SQLite was
+	 * given before (4 KiB sectors, SQLITE_IOCAP_UNDELETABLE_WHEN_OPEN only).
+	 * Counted by the Unreal file system, so only on the unreal-* ones.
+	 */
+	static void Journal( const FString& VfsName, const FString& Synchronous, const int32 CommitCount )
+	{
+#if SQLITE_OS_OTHER
+		static const TCHAR* JournalModes[] = { TEXT( "DELETE" ), TEXT( "TRUNCATE" ), TEXT( "PERSIST" ), TEXT( "WAL" ) };
+
+		for( const bool bDetected : { true, false } )
+		{
+			for( const TCHAR* JournalMode : JournalModes )
+			{
+				FSQLiteFileOptions FileOptions;
+				if( !bDetected )
+				{
+					FileOptions.SectorSize = 4096;
+					FileOptions.DeviceCharacteristics = SQLITE_IOCAP_UNDELETABLE_WHEN_OPEN;
+				}
+				sqlite3_ue_set_file_options( GetScratchFilename( TEXT( "Journal" ) ), FileOptions );
+
+				sqlite3* Db = OpenScratchDatabase( TEXT( "Journal" ), VfsName, JournalMode, Synchronous );
+				if( Db == nullptr )
+				{
+					return;
+				}
+
+				// Enough rows for the updates to touch pages all over the file
+				sqlite3_exec( Db, "CREATE TABLE Bench( Id INTEGER PRIMARY KEY, Payload BLOB );"
+					"WITH RECURSIVE Ids( Id ) AS ( SELECT 1 UNION ALL SELECT Id + 1 FROM Ids WHERE Id < 10000 )"
+					"INSERT INTO Bench SELECT Id, randomblob( 200 ) FROM Ids;", nullptr, nullptr, nullptr );
+
+				sqlite3_stmt* Update = nullptr;
+				sqlite3_prepare_v2( Db, "UPDATE Bench SET Payload = randomblob( 200 ) WHERE Id = ?1;", -1, &Update, nullptr );
+
+				TArray<FSQLiteIoStatsSnapshot> StatsBefore;
+				FSQLiteFileFuncs::GetFileTypeIoStats( StatsBefore );
+
+				for( int32 CommitIndex = 0; CommitIndex < CommitCount; CommitIndex++ )
+				{
+					sqlite3_bind_int( Update, 1, 1 + ( CommitIndex * 7919 ) % 10000 );
+					sqlite3_step( Update );
+					sqlite3_reset( Update );
+				}
+
+				TArray<FSQLiteIoStatsSnapshot> StatsAfter;
+				FSQLiteFileFuncs::GetFileTypeIoStats( StatsAfter );
+
+				sqlite3_finalize( Update );
+				sqlite3_close_v2( Db );
+
+				auto PerCommit = [&]( const ESQLiteFileType FileType, const ESQLiteIoOp Op, const bool bBytes )
+				{
+					const FSQLiteIoStatsSnapshot::FOp& Before = StatsBefore[(int32)FileType].Ops[(int32)Op];
+					const FSQLiteIoStatsSnapshot::FOp& After = StatsAfter[(int32)FileType].Ops[(int32)Op];
+					return (double)( bBytes ? After.Bytes - Before.Bytes : After.Count - Before.Count ) / CommitCount;
+				};
+
+				UE_LOG( LogSqlite, Display, TEXT( "Journal (%s, %-8s): %7.0f journal + %7.0f WAL + %7.0f database bytes, %.2f syncs per commit" ),
+					bDetected ? TEXT( "detected  " ) : TEXT( "worst case" ),
+					JournalMode,
+					PerCommit( ESQLiteFileType::Journal, ESQLiteIoOp::Write, true ),
+					PerCommit( ESQLiteFileType::Wal, ESQLiteIoOp::Write, true ),
+					PerCommit( ESQLiteFileType::MainDatabase, ESQLiteIoOp::Write, true ),
+					PerCommit( ESQLiteFileType::Journal, ESQLiteIoOp::Sync, false ) + PerCommit( ESQLiteFileType::Wal, ESQLiteIoOp::Sync, false ) + PerCommit( ESQLiteFileType::MainDatabase, ESQLiteIoOp::Sync, false ) );
+			}
+		}
+
+		// Forget the overrides
+		sqlite3_ue_set_file_options( GetScratchFilename( TEXT( "Journal" ) ), FSQLiteFileOptions() );
+#else
+		UE_LOG( LogSqlite, Error, TEXT( "Journal: the I/O statistics are kept by the Unreal file system (bCompileCustomSQLitePlatform)." ) );
+#endif
+	}
+
+	// ============================================================================
+	// === FileSystems ============================================================
+	// ============================================================================
+
+	/**
+	 * Bulk insert of RowCount rows in one transaction, then a full scan of them
+	 * and random point reads on a new connection (the page cache of SQLite is
+	 * cold, that of the OS is not).
+	 */
+	static void Scan( const FString& VfsName, const FString& JournalMode, const FString& Synchronous, const int32 RowCount )
+	{
+		static const int32 PayloadSize = 400;
+
+		sqlite3* Db = OpenScratchDatabase( TEXT( "Scan" ), VfsName, JournalMode, Synchronous );
+		if( Db == nullptr )
+		{
+			return;
+		}
+
+		sqlite3_exec( Db, "CREATE TABLE Bench( Id INTEGER PRIMARY KEY, Payload BLOB );", nullptr, nullptr, nullptr );
+
+		sqlite3_stmt* Insert = nullptr;
+		sqlite3_prepare_v2( Db, "INSERT INTO Bench( Payload ) VALUES( randomblob( ?1 ) );", -1, &Insert, nullptr );
+		sqlite3_bind_int( Insert, 1, PayloadSize );
+
+		const double InsertStartTime = FPlatformTime::Seconds();
+
+		sqlite3_exec( Db, "BEGIN;", nullptr, nullptr, nullptr );
+		for( int32 Row = 0; Row < RowCount; Row++ )
+		{
+			sqlite3_step( Insert );
+			sqlite3_reset( Insert );
+		}
+		sqlite3_exec( Db, "COMMIT;", nullptr, nullptr, nullptr );
+
+		const double InsertSeconds = FPlatformTime::Seconds() - InsertStartTime;
+
+		sqlite3_finalize( Insert );
+		sqlite3_close_v2( Db );
+
+		Db = OpenScratchDatabase( TEXT( "Scan" ), VfsName, JournalMode, Synchronous, false );
+		if( Db == nullptr )
+		{
+			return;
+		}
+
+		sqlite3_stmt* Select = nullptr;
+		sqlite3_prepare_v2( Db, "SELECT Id, Payload FROM Bench;", -1, &Select, nullptr );
+
+		const double ScanStartTime = FPlatformTime::Seconds();
+
+		int64 ScannedBytes = 0;
+		while( sqlite3_step( Select ) == SQLITE_ROW )
+		{
+			ScannedBytes += sqlite3_column_bytes( Select, 1 );
+		}
+
+		const double ScanSeconds = FPlatformTime::Seconds() - ScanStartTime;
+
+		sqlite3_finalize( Select );
+
+		// Point reads all over the file, which read-ahead and prefetching do not help
+		const int32 LookupCount = FMath::Max( RowCount / 10, 1 );
+
+		sqlite3_stmt* Lookup = nullptr;
+		sqlite3_prepare_v2( Db, "SELECT Payload FROM Bench WHERE Id = ?1;", -1, &Lookup, nullptr );
+
+		FRandomStream Random( 0x5117e );
+		const double LookupStartTime = FPlatformTime::Seconds();
+
+		for( int32 LookupIndex = 0; LookupIndex < LookupCount; LookupIndex++ )
+		{
+			sqlite3_bind_int( Lookup, 1, Random.RandRange( 1, RowCount ) );
+			sqlite3_step( Lookup );
+			sqlite3_reset( Lookup );
+		}
+
+		const double LookupSeconds = FPlatformTime::Seconds() - LookupStartTime;
+
+		sqlite3_finalize( Lookup );
+		sqlite3_close_v2( Db );
+
+		UE_LOG( LogSqlite, Display, TEXT( "Scan (%s, journal %s): insert %.0f rows/s (%.1f MiB/s), scan %.0f rows/s (%.1f MiB/s), %.0f point reads/s" ),
+			VfsName.IsEmpty() ? TEXT( "default file system" ) : *VfsName,
+			*JournalMode,
+			RowCount / InsertSeconds,
+			(double)RowCount * PayloadSize / InsertSeconds / ( 1024.0 * 1024.0 ),
+			RowCount / ScanSeconds,
+			ScannedBytes / ScanSeconds / ( 1024.0 * 1024.0 ),
+			LookupCount / LookupSeconds );
+	}
+
+	/**
+	 * Same workload (commit latency, bulk insert, scan and point reads) on each
+	 * file system, those that are not registered in this build are skipped.
+	 * "unreal-uring" falls back to positional I/O where the kernel has no
+	 * io_uring, the run then measures the same path as "unreal-fs".
+	 */
+	static void FileSystems( const TArray<FString>& VfsNames, const FString& JournalMode, const FString& Synchronous, const int32 CommitCount, const int32 RowCount )
+	{
+		for( const FString& VfsName : VfsNames )
+		{
+			if( sqlite3_vfs_find( TCHAR_TO_UTF8( *VfsName ) ) == nullptr )
+			{
+				UE_LOG( LogSqlite, Display, TEXT( "FileSystems: '%s' is not registered, skipped." ), *VfsName );
+				continue;
+			}
+
+			Commit( VfsName, JournalMode, Synchronous, CommitCount );
+			Scan( VfsName, JournalMode, Synchronous, RowCount );
+		}
+	}
+}
+
+static FAutoConsoleCommand SqliteBenchCommand(
+	TEXT( "sqlite.Bench" ),
+	TEXT( "Run a benchmark of the SQLite platform layer: sqlite.Bench <Alloc|MemStatus|Mutex|Commit|Journal|FileSystems> [Threads=N] [Iterations=N] [Commits=N] [Rows=N] [Vfs=Name[,Name...]] [JournalMode=Mode] [Synchronous=Level]" ),
+	FConsoleCommandWithArgsDelegate::CreateLambda( []( const TArray<FString>& Args )
+	{
+		if( Args.IsEmpty() )
+		{
+			UE_LOG( LogSqlite, Error, TEXT( "Usage: sqlite.Bench <Name> [Key=Value ...]" ) );
+			return;
+		}
+
+		const FString Params = FString::Join( Args, TEXT( " " ) );
+
+		int32 ThreadCount = 1;
+		int32 Iterations = 1000000;
+		int32 CommitCount = 1000;
+		int32 RowCount = 50000;
+		const bool bThreadCountGiven = FParse::Value( *Params, TEXT( "Threads=" ), ThreadCount );
+		FParse::Value( *Params, TEXT( "Iterations=" ), Iterations );
+		FParse::Value( *Params, TEXT( "Commits=" ), CommitCount );
+		FParse::Value( *Params, TEXT( "Rows=" ), RowCount );
+
+		FString VfsName;
+		FString JournalMode = TEXT( "WAL" );
+		FString Synchronous = TEXT( "NORMAL" );
+		FParse::Value( *Params, TEXT( "Vfs=" ), VfsName );
+		FParse::Value( *Params, TEXT( "JournalMode=" ), JournalMode );
+		FParse::Value( *Params, TEXT( "Synchronous=" ), Synchronous );
+
+		ThreadCount = FMath::Max( ThreadCount, 1 );
+		Iterations = FMath::Max( Iterations, 1 );
+		CommitCount = FMath::Max( CommitCount, 1 );
+		RowCount = FMath::Max( RowCount, 1 );
+
+		if( Args[0] == TEXT( "Alloc" ) )
+		{
+			SqliteBenchmark::Alloc( ThreadCount, Iterations );
+		}
+		else if( Args[0] == TEXT( "MemStatus" ) )
+		{
+			SqliteBenchmark::MemStatus( bThreadCountGiven ? ThreadCount : FPlatformMisc::NumberOfCores(), Iterations );
+		}
+		else if( Args[0] == TEXT( "Mutex" ) )
+		{
+			SqliteBenchmark::Mutex( bThreadCountGiven ? ThreadCount : FPlatformMisc::NumberOfCores(), Iterations );
+		}
+		else if( Args[0] == TEXT( "Commit" ) )
+		{
+			SqliteBenchmark::Commit( VfsName, JournalMode, Synchronous, CommitCount );
+		}
+		else if( Args[0] == TEXT( "Journal" ) )
+		{
+			SqliteBenchmark::Journal( VfsName, Synchronous, CommitCount );
+		}
+		else if( Args[0] == TEXT( "FileSystems" ) )
+		{
+			TArray<FString> VfsNames;
+			( VfsName.IsEmpty() ? FString( TEXT( "unreal-fs,unreal-uring,unix" ) ) : VfsName ).ParseIntoArray( VfsNames, TEXT( "," ) );
+
+			SqliteBenchmark::FileSystems( VfsNames, JournalMode, Synchronous, CommitCount, RowCount );
+		}
+		else
+		{
+			UE_LOG( LogSqlite, Error, TEXT( "Unknown benchmark '%s'." ), *Args[0] );
+		}
+	} ) );
+
+#endif
@@ -4,6 +4,10 @@
 #include "SqliteStatics.h"
 #include "Sqlite3Log.h"
 #include "Sqlite3Subsystem.h"
+#include "SqliteDatabaseWorker.h"
+#include "platform/SQLite3Platform.h"
+#include "Async/Fundamental/Scheduler.h"
+#include "Math/RandomStream.h"
 
 #include <shlobj.h>
 
@@ -92,6 +96,8 @@ void USqliteDatabase::Initialize( const USqliteDatabaseInfo* DatabaseInfo )
 
 	DatabaseInfoAsset = const_cast<USqliteDatabaseInfo*>(DatabaseInfo);
 
+	LLMTag = FName( *FString::Printf( TEXT( "Sqlite/%s" ), *DatabaseInfo->GetName() ) );
+
 	// ---------------------------------------------------------------------------
 	// - Compute open flags ------------------------------------------------------
 	// ---------------------------------------------------------------------------
@@ -113,6 +119,11 @@ void USqliteDatabase::Initialize( const USqliteDatabaseInfo* DatabaseInfo )
 			break;
 	}
 
+	if( DatabaseInfoAsset->FileSystem == ESqliteDatabaseFileSystem::PACKAGED )
+	{
+		OpenFlags = SQLITE_OPEN_READONLY;
+	}
+
 	if( DatabaseInfoAsset->bOpenAsURI )
 	{
 		OpenFlags |= SQLITE_OPEN_URI;
@@ -123,7 +134,12 @@ void USqliteDatabase::Initialize( const USqliteDatabaseInfo* DatabaseInfo )
 		OpenFlags |= SQLITE_OPEN_MEMORY;
 	}
 
-	if( DatabaseInfoAsset->ThreadingMode != ESqliteDatabaseThreadingMode::UNSET )
+	if( DatabaseInfoAsset->bUseWorkerThread )
+	{
+		// Only the worker thread uses the connection
+		OpenFlags |= SQLITE_OPEN_NOMUTEX;
+	}
+	else if( DatabaseInfoAsset->ThreadingMode != ESqliteDatabaseThreadingMode::UNSET )
 	{
 		switch( DatabaseInfoAsset->ThreadingMode )
 		{
@@ -217,6 +233,8 @@ void USqliteDatabase::Initialize( const USqliteDatabaseInfo* DatabaseInfo )
 
 ESqliteDatabaseOpenExecutionPins USqliteDatabase::DoOpenSqliteDatabase()
 {
+	SQLITE_DATABASE_SCOPE( this );
+
 	// ---------------------------------------------------------------------------
 	// - Silently ignore re-opening ----------------------------------------------
 	// ---------------------------------------------------------------------------
@@ -241,7 +259,20 @@ ESqliteDatabaseOpenExecutionPins USqliteDatabase::DoOpenSqliteDatabase()
 	// - Open database -----------------------------------------------------------
 	// ---------------------------------------------------------------------------
 
-	LastSqliteReturnCode = sqlite3_open_v2( TCHAR_TO_ANSI(*DatabaseFilePath), &DatabaseConnectionHandler, OpenFlags, "unreal-fs" );
+	if( DatabaseInfoAsset->bUseWorkerThread && Worker == nullptr && FPlatformProcess::SupportsMultithreading() )
+	{
+		Worker = new FSqliteDatabaseWorker(
+			FString::Printf( TEXT( "SqliteWorker %s" ), *DatabaseInfoAsset->GetName() ),
+			PriorityCounters,
+			DatabaseInfoAsset->PriorityAgingMs / 1000.0 );
+	}
+
+	RegisterFileOptions();
+
+	LastSqliteReturnCode = RunOnWorker( [this]()
+	{
+		return sqlite3_open_v2( TCHAR_TO_ANSI(*DatabaseFilePath), &DatabaseConnectionHandler, OpenFlags, GetVfsName() );
+	} );
 	if( LastSqliteReturnCode != SQLITE_OK )
 	{
 		LOG_SQLITE_ERROR( GetErrorCode(), "Open failed." );
@@ -253,60 +284,80 @@ ESqliteDatabaseOpenExecutionPins USqliteDatabase::DoOpenSqliteDatabase()
 	// - Attach extra databases
 	// ---------------------------------------------------------------------------
 
-	sqlite3_stmt* stmt;
-
-	LastSqliteReturnCode = sqlite3_prepare_v2( this->DatabaseConnectionHandler, TCHAR_TO_ANSI( *Sql_AttachDatabase ), -1, &stmt, 0 );
-	if( LastSqliteReturnCode != SQLITE_OK )
-	{
-		LOG_SQLITE_ERROR( GetErrorCode(), "Failed to prepare 'AttachDatabase' statement." );
-
-		return ESqliteDatabaseOpenExecutionPins::OnFail;
-	}
-
-	DatabaseInfoAsset->DatabaseOpenCount++;
-	
-	for( const auto& Attachment : Attachments )
+	const bool bAttachPrepared = RunOnWorker( [this]()
 	{
-		UE_LOG( LogSqlite, Log, TEXT( "Attaching '%s' as '%s'" ),
-			*Attachment.Value,
-			*Attachment.Key );
+		sqlite3_stmt* stmt;
 
-		LastSqliteReturnCode = sqlite3_bind_text( stmt, 1, TCHAR_TO_ANSI( *Attachment.Value ), -1, nullptr );
+		LastSqliteReturnCode = sqlite3_prepare_v2( this->DatabaseConnectionHandler, TCHAR_TO_ANSI( *Sql_AttachDatabase ), -1, &stmt, 0 );
 		if( LastSqliteReturnCode != SQLITE_OK )
 		{
-			break;
+			LOG_SQLITE_ERROR( GetErrorCode(), "Failed to prepare 'AttachDatabase' statement." );
+
+			return false;
 		}
 
-		LastSqliteReturnCode = sqlite3_bind_text( stmt, 2, TCHAR_TO_ANSI( *Attachment.Key ), -1, nullptr );
-		if( LastSqliteReturnCode != SQLITE_OK )
 		{
-			break;
+			FScopeLock Lock( &StatementsCriticalSection );
+			DatabaseInfoAsset->DatabaseOpenCount++;
+		}
+	
+		for( const auto& Attachment : Attachments )
+		{
+			UE_LOG( LogSqlite, Log, TEXT( "Attaching '%s' as '%s'" ),
+				*Attachment.Value,
+				*Attachment.Key );
+
+			LastSqliteReturnCode = sqlite3_bind_text( stmt, 1, TCHAR_TO_ANSI( *Attachment.Value ), -1, nullptr );
+			if( LastSqliteReturnCode != SQLITE_OK )
+			{
+				break;
+			}
+
+			LastSqliteReturnCode = sqlite3_bind_text( stmt, 2, TCHAR_TO_ANSI( *Attachment.Key ), -1, nullptr );
+			if( LastSqliteReturnCode != SQLITE_OK )
+			{
+				break;
+			}
+
+			LastSqliteReturnCode = sqlite3_step( stmt );
+			if( LastSqliteReturnCode != SQLITE_DONE )
+			{
+				break;
+			}
+
+			sqlite3_reset( stmt );
+			sqlite3_clear_bindings( stmt );
 		}
 
-		LastSqliteReturnCode = sqlite3_step( stmt );
-		if( LastSqliteReturnCode != SQLITE_DONE )
+		if( (LastSqliteReturnCode != SQLITE_OK) && (LastSqliteReturnCode != SQLITE_DONE) )
 		{
-			break;
+			LOG_SQLITE_ERROR( GetErrorCode(), "Failed to bind or execute 'attach' statement." );
 		}
 
-		sqlite3_reset( stmt );
-		sqlite3_clear_bindings( stmt );
-	}
+		sqlite3_finalize( stmt );
+		stmt = nullptr;
 
-	if( (LastSqliteReturnCode != SQLITE_OK) && (LastSqliteReturnCode != SQLITE_DONE) )
+		return true;
+	} );
+
+	if( !bAttachPrepared )
 	{
-		LOG_SQLITE_ERROR( GetErrorCode(), "Failed to bind or execute 'attach' statement." );
+		return ESqliteDatabaseOpenExecutionPins::OnFail;
 	}
 
-	sqlite3_finalize( stmt );
-	stmt = nullptr;
-
 	if( (LastSqliteReturnCode != SQLITE_OK) && (LastSqliteReturnCode != SQLITE_DONE) )
 	{
 		Close();
 		return ESqliteDatabaseOpenExecutionPins::OnFail;
 	}
 
+	RunOnWorker( [this]()
+	{
+		ApplyMemoryBudget();
+		ApplyFileOptions();
+		ApplyBusyPolicy();
+	} );
+
 	// ---------------------------------------------------------------------------
 	// - Check database for create/update ----------------------------------------
 	// ---------------------------------------------------------------------------
@@ -507,6 +558,8 @@ bool USqliteDatabase::IsOpen() const
 
 void USqliteDatabase::EnableAutovacuumCallback( bool enabled )
 {
+	SQLITE_DATABASE_ON_WORKER( this, EnableAutovacuumCallback( enabled ) );
+
 	if( enabled )
 	{
 		sqlite3_autovacuum_pages( DatabaseConnectionHandler, USqliteDatabase::AutovacuumCallbackGlue, this, nullptr );
@@ -534,6 +587,8 @@ unsigned int USqliteDatabase::AutovacuumCallback( const FName& Schema, unsigned
 
 void USqliteDatabase::EnablePreupdateHook( bool enabled )
 {
+	SQLITE_DATABASE_ON_WORKER( this, EnablePreupdateHook( enabled ) );
+
 	if( enabled )
 	{
 		sqlite3_preupdate_hook( DatabaseConnectionHandler, USqliteDatabase::PreupdateHookGlue, this );
@@ -560,6 +615,8 @@ void USqliteDatabase::PreupdateHook( int Operation, const FString& DatabaseName,
 
 void USqliteDatabase::EnableUpdateHook( bool enabled )
 {
+	SQLITE_DATABASE_ON_WORKER( this, EnableUpdateHook( enabled ) );
+
 	if( enabled )
 	{
 		sqlite3_update_hook( DatabaseConnectionHandler, USqliteDatabase::UpdateHookGlue, this );
@@ -586,6 +643,8 @@ void USqliteDatabase::UpdateHook( int Operation, const FString& DatabaseName, co
 
 void USqliteDatabase::EnableCommitHook( bool enabled )
 {
+	SQLITE_DATABASE_ON_WORKER( this, EnableCommitHook( enabled ) );
+
 	if( enabled )
 	{
 		sqlite3_commit_hook( DatabaseConnectionHandler, USqliteDatabase::CommitHookGlue, this );
@@ -613,6 +672,8 @@ int USqliteDatabase::CommitHook()
 
 void USqliteDatabase::EnableRollbackHook( bool enabled )
 {
+	SQLITE_DATABASE_ON_WORKER( this, EnableRollbackHook( enabled ) );
+
 	if( enabled )
 	{
 		sqlite3_rollback_hook( DatabaseConnectionHandler, USqliteDatabase::RollbackHookGlue, this );
@@ -728,29 +789,48 @@ void USqliteDatabase::Finalize()
 	{
 		UE_LOG( LogSqlite, Log, TEXT( "Database '%s' already closed." ), *DatabaseFilePath );
 	}
+
+	// Left by a failed open
+	StopWorker();
 }
 
 void USqliteDatabase::Close( const bool bForceClose )
 {
+	SQLITE_DATABASE_SCOPE( this );
+
 	UE_LOG( LogSqlite, Log, TEXT("Closing database '%s'"), *DatabaseFilePath );
 
-	if( !bForceClose && DatabaseInfoAsset->DatabaseOpenCount > 1 )
 	{
-		DatabaseInfoAsset->DatabaseOpenCount--;
+		FScopeLock Lock( &StatementsCriticalSection );
 
-		return;
+		if( !bForceClose && DatabaseInfoAsset->DatabaseOpenCount > 1 )
+		{
+			DatabaseInfoAsset->DatabaseOpenCount--;
+
+			return;
+		}
+	}
+
+	// Writes still queued would be lost
+	DrainWriteQueue();
+
+	// Finalized outside of the lock, Finalize takes it to forget the statement
+	TArray<USqliteStatement*> ActiveStatementsCachedList;
+	{
+		FScopeLock Lock( &StatementsCriticalSection );
+		ActiveStatementsCachedList = ActiveStatements;
 	}
 
-	if( ! ActiveStatements.IsEmpty() )
+	if( ! ActiveStatementsCachedList.IsEmpty() )
 	{
-		UE_LOG( LogSqlite, Warning, TEXT("Finalizing %d leftover statement(s) before closing."), ActiveStatements.Num() );
+		UE_LOG( LogSqlite, Warning, TEXT("Finalizing %d leftover statement(s) before closing."), ActiveStatementsCachedList.Num() );
 
-		TArray<USqliteStatement*> ActiveStatementsCachedList( ActiveStatements );
 		for( const auto& Statement : ActiveStatementsCachedList )
 		{
 			Statement->Finalize();
 		}
 
+		FScopeLock Lock( &StatementsCriticalSection );
 		if( ! ActiveStatements.IsEmpty() )
 		{
 			UE_LOG( LogSqlite, Error, TEXT("Still %d leftover statement(s) before closing, database will no be properly closed."), ActiveStatements.Num() );
@@ -759,17 +839,275 @@ void USqliteDatabase::Close( const bool bForceClose )
 
 	// TODO: close BLOB handlers and finish backup objects
 		
-	if( sqlite3_close_v2( DatabaseConnectionHandler ) != SQLITE_OK )
+	// The connection is forgotten on the worker thread, so that a flush queued there at a lower priority finds it closed
+	RunOnWorker( [this]()
+	{
+		if( sqlite3_close_v2( DatabaseConnectionHandler ) != SQLITE_OK )
+		{
+			UE_LOG( LogSqlite, Error, TEXT("Close() failed: (%d) %s"),
+				GetErrorCode(),
+				*GetErrorMessage() );
+		}
+
+		bIsOpen = false;
+		DatabaseConnectionHandler = nullptr;
+	} );
+
+	{
+		FScopeLock Lock( &StatementsCriticalSection );
+		DatabaseInfoAsset->DatabaseOpenCount = 0;
+	}
+
+	StopWorker();
+}
+
+// ============================================================================
+// === Memory =================================================================
+// ============================================================================
+
+void USqliteDatabase::ApplyMemoryBudget()
+{
+	if( DatabaseInfoAsset->CacheSizeKiB > 0 )
+	{
+		const FString SqlRequest = FString::Printf( TEXT( "PRAGMA cache_size = -%d" ), DatabaseInfoAsset->CacheSizeKiB );
+
+		int ErrorCode = sqlite3_exec( DatabaseConnectionHandler, TCHAR_TO_ANSI( *SqlRequest ), nullptr, nullptr, nullptr );
+		if( ErrorCode != SQLITE_OK )
+		{
+			LOG_SQLITE_WARNING( ErrorCode, TCHAR_TO_ANSI( *SqlRequest ) );
+		}
+	}
+
+	if( DatabaseInfoAsset->MmapSizeMiB > 0 )
+	{
+		const FString SqlRequest = FString::Printf( TEXT( "PRAGMA mmap_size = %lld" ), (int64)DatabaseInfoAsset->MmapSizeMiB * 1024 * 1024 );
+
+		int ErrorCode = sqlite3_exec( DatabaseConnectionHandler, TCHAR_TO_ANSI( *SqlRequest ), nullptr, nullptr, nullptr );
+		if( ErrorCode != SQLITE_OK )
+		{
+			LOG_SQLITE_WARNING( ErrorCode, TCHAR_TO_ANSI( *SqlRequest ) );
+		}
+	}
+}
+
+// ============================================================================
+// === Files ==================================================================
+// ============================================================================
+
+void USqliteDatabase::RegisterFileOptions()
+{
+#if SQLITE_OS_OTHER
+	if( DatabaseInfoAsset->bInMemory || DatabaseInfoAsset->bOpenAsURI )
+	{
+		return;
+	}
+
+	FSQLiteFileOptions FileOptions;
+
+	if( DatabaseInfoAsset->SectorSize > 0 )
+	{
+		FileOptions.SectorSize = FMath::Clamp( (int32)FMath::RoundUpToPowerOfTwo( (uint32)DatabaseInfoAsset->SectorSize ), 512, 65536 );
+	}
+
+	if( DatabaseInfoAsset->bOverrideDeviceCharacteristics )
+	{
+		const ESqliteDeviceCharacteristics Flags = (ESqliteDeviceCharacteristics)DatabaseInfoAsset->DeviceCharacteristics;
+
+		FileOptions.DeviceCharacteristics = 0;
+
+		if( EnumHasAnyFlags( Flags, ESqliteDeviceCharacteristics::POWERSAFE_OVERWRITE ) )
+		{
+			FileOptions.DeviceCharacteristics |= SQLITE_IOCAP_POWERSAFE_OVERWRITE;
+		}
+		if( EnumHasAnyFlags( Flags, ESqliteDeviceCharacteristics::SAFE_APPEND ) )
+		{
+			FileOptions.DeviceCharacteristics |= SQLITE_IOCAP_SAFE_APPEND;
+		}
+		if( EnumHasAnyFlags( Flags, ESqliteDeviceCharacteristics::SEQUENTIAL ) )
+		{
+			FileOptions.DeviceCharacteristics |= SQLITE_IOCAP_SEQUENTIAL;
+		}
+		if( EnumHasAnyFlags( Flags, ESqliteDeviceCharacteristics::ATOMIC4K ) )
+		{
+			FileOptions.DeviceCharacteristics |= SQLITE_IOCAP_ATOMIC4K;
+		}
+	}
+
+	if( DatabaseInfoAsset->bGroupDurability )
+	{
+		FileOptions.GroupSyncIntervalMs = FMath::Max( DatabaseInfoAsset->GroupSyncIntervalMs, 1 );
+		FileOptions.GroupSyncBytes = (int64)FMath::Max( DatabaseInfoAsset->GroupSyncKiB, 0 ) * 1024;
+	}
+
+	// Also called without overrides, so that those of a previous open are forgotten
+	sqlite3_ue_set_file_options( DatabaseFilePath, FileOptions );
+#endif
+}
+
+const char* USqliteDatabase::GetVfsName() const
+{
+#if SQLITE_OS_OTHER
+	switch( DatabaseInfoAsset->FileSystem )
+	{
+		case ESqliteDatabaseFileSystem::PACKAGED:
+			return "unreal-pak";
+
+		case ESqliteDatabaseFileSystem::NATIVE:
+			if( sqlite3_vfs_find( "unix" ) )
+			{
+				return "unix";
+			}
+
+			UE_LOG( LogSqlite, Warning, TEXT( "The native VFS is not available on this platform, using the default one." ) );
+			break;
+
+		case ESqliteDatabaseFileSystem::IO_URING:
+			if( sqlite3_vfs_find( "unreal-uring" ) )
+			{
+				return "unreal-uring";
+			}
+
+			UE_LOG( LogSqlite, Warning, TEXT( "The io_uring VFS is not available on this platform, using the default one." ) );
+			break;
+
+		default:
+			break;
+	}
+
+	return "unreal-fs";
+#else
+	return nullptr;
+#endif
+}
+
+void USqliteDatabase::ApplyFileOptions()
+{
+	if( DatabaseInfoAsset->ChunkSizeKiB > 0 )
+	{
+		int ChunkSize = DatabaseInfoAsset->ChunkSizeKiB * 1024;
+
+		int ErrorCode = sqlite3_file_control( DatabaseConnectionHandler, "main", SQLITE_FCNTL_CHUNK_SIZE, &ChunkSize );
+		if( ErrorCode != SQLITE_OK )
+		{
+			LOG_SQLITE_WARNING( ErrorCode, "SQLITE_FCNTL_CHUNK_SIZE failed." );
+		}
+	}
+}
+
+void USqliteDatabase::ReleaseMemory()
+{
+	SQLITE_DATABASE_ON_WORKER( this, ReleaseMemory() );
+
+	if( !IsOpen() )
+	{
+		return;
+	}
+
+	SQLITE_DATABASE_SCOPE( this );
+
+	// Dirty pages can not be released, write them out first. This fails with
+	// SQLITE_BUSY if another connection holds a lock, which is not an error here.
+	const int FlushErrorCode = sqlite3_db_cacheflush( DatabaseConnectionHandler );
+	if( FlushErrorCode != SQLITE_OK && FlushErrorCode != SQLITE_BUSY )
+	{
+		LOG_SQLITE_WARNING( FlushErrorCode, "sqlite3_db_cacheflush failed." );
+	}
+
+	sqlite3_db_release_memory( DatabaseConnectionHandler );
+}
+
+int64 USqliteDatabase::GetCacheMemoryUsed() const
+{
+	SQLITE_DATABASE_ON_WORKER( this, GetCacheMemoryUsed() );
+
+	int Current = 0;
+	int HighWater = 0;
+
+	if( IsOpen() )
+	{
+		sqlite3_db_status( DatabaseConnectionHandler, SQLITE_DBSTATUS_CACHE_USED, &Current, &HighWater, 0 );
+	}
+
+	return Current;
+}
+
+// ============================================================================
+// === Busy ===================================================================
+// ============================================================================
+
+void USqliteDatabase::ApplyBusyPolicy()
+{
+	if( DatabaseInfoAsset->BusyTimeoutMs <= 0 )
+	{
+		return;
+	}
+
+	const int ErrorCode = sqlite3_busy_handler( DatabaseConnectionHandler, USqliteDatabase::BusyHandlerGlue, this );
+	if( ErrorCode != SQLITE_OK )
+	{
+		LOG_SQLITE_WARNING( ErrorCode, "sqlite3_busy_handler failed." );
+	}
+}
+
+int USqliteDatabase::BusyHandlerGlue( void* DatabaseRawPtr, int RetryCount )
+{
+	USqliteDatabase* Database = (USqliteDatabase*)DatabaseRawPtr;
+
+	return Database->BusyHandler( RetryCount );
+}
+
+int USqliteDatabase::BusyHandler( const int RetryCount )
+{
+	const double Now = FPlatformTime::Seconds();
+
+	if( RetryCount == 0 )
+	{
+		BusyEvents++;
+		BusyStartTime = Now;
+	}
+
+	const double Deadline = BusyStartTime + DatabaseInfoAsset->BusyTimeoutMs / 1000.0;
+
+	if( ( DatabaseInfoAsset->BusyMaxRetries > 0 && RetryCount >= DatabaseInfoAsset->BusyMaxRetries ) || Now >= Deadline )
+	{
+		BusyGaveUp++;
+		return 0;
+	}
+
+	// Exponential backoff, part of it drawn at random, never past the timeout
+	const double MaxBackoffMs = FMath::Max( DatabaseInfoAsset->BusyMaxBackoffMs, 1 );
+	const double BackoffMs = FMath::Min( DatabaseInfoAsset->BusyInitialBackoffMs * FMath::Pow( 2.0, (double)FMath::Min( RetryCount, 30 ) ), MaxBackoffMs );
+	const double Jitter = FMath::Clamp( (double)DatabaseInfoAsset->BusyBackoffJitter, 0.0, 1.0 );
+	FRandomStream JitterStream( (int32)( FPlatformTime::Cycles() ^ (uint32)RetryCount ) );
+	const double WaitSeconds = FMath::Min( BackoffMs * ( 1.0 - Jitter * JitterStream.FRand() ) / 1000.0, Deadline - Now );
+
+	if( DatabaseInfoAsset->bBusyYield && LowLevelTasks::FScheduler::Get().IsWorkerThread() )
+	{
+		// A task worker runs the pending tasks of the scheduler until the backoff is over instead of blocking them behind the lock
+		const double EndTime = Now + WaitSeconds;
+		LowLevelTasks::BusyWaitUntil( [EndTime]() { return FPlatformTime::Seconds() >= EndTime; } );
+	}
+	else
 	{
-		UE_LOG( LogSqlite, Error, TEXT("Close() failed: (%d) %s"),
-			GetErrorCode(),
-			*GetErrorMessage() );
+		sqlite3_sleep( (int)FMath::CeilToDouble( WaitSeconds * 1000.0 ) );
 	}
 
-	bIsOpen = false;
-	DatabaseConnectionHandler = nullptr;
+	BusyRetries++;
+	BusyWaitUs += (int64)( ( FPlatformTime::Seconds() - Now ) * 1000000.0 );
+
+	return 1;
+}
+
+FSqliteBusyStats USqliteDatabase::GetBusyStats() const
+{
+	FSqliteBusyStats Stats;
+
+	Stats.BusyEvents = BusyEvents;
+	Stats.Retries = BusyRetries;
+	Stats.GaveUp = BusyGaveUp;
+	Stats.TotalWaitMs = (float)( BusyWaitUs / 1000.0 );
 
-	DatabaseInfoAsset->DatabaseOpenCount = 0;
+	return Stats;
 }
 
 // ============================================================================
@@ -785,6 +1123,10 @@ void USqliteDatabase::GetApplicationId( ESqliteDatabaseSimpleExecutionPins& Bran
 
 bool USqliteDatabase::GetApplicationId( int& OutApplicationId ) const
 {
+	SQLITE_DATABASE_ON_WORKER( this, GetApplicationId( OutApplicationId ) );
+
+	SQLITE_DATABASE_SCOPE( this );
+
 	const FString SqlRequest( "PRAGMA application_id");
 	bool bReturnValue;
 
@@ -817,6 +1159,10 @@ bool USqliteDatabase::GetApplicationId( int& OutApplicationId ) const
 
 bool USqliteDatabase::UpdateApplicationId( const FString SchemaName )
 {
+	SQLITE_DATABASE_ON_WORKER( this, UpdateApplicationId( SchemaName ) );
+
+	SQLITE_DATABASE_SCOPE( this );
+
 	const FString SqlRequest = FString::Format( TEXT( "PRAGMA \"{0}\".application_id = {1}" ), { *SchemaName, DatabaseInfoAsset->ApplicationId } );
 	char* ErrorMessage;
 
@@ -849,6 +1195,10 @@ void USqliteDatabase::GetUserVersion( ESqliteDatabaseSimpleExecutionPins& Branch
 
 bool USqliteDatabase::GetUserVersion( int& OutUserVersion ) const
 {
+	SQLITE_DATABASE_ON_WORKER( this, GetUserVersion( OutUserVersion ) );
+
+	SQLITE_DATABASE_SCOPE( this );
+
 	const FString SqlRequest( "PRAGMA user_version");
 	bool bReturnValue;
 
@@ -881,6 +1231,10 @@ bool USqliteDatabase::GetUserVersion( int& OutUserVersion ) const
 
 bool USqliteDatabase::UpdateUserVersion( const FString Schema )
 {
+	SQLITE_DATABASE_ON_WORKER( this, UpdateUserVersion( Schema ) );
+
+	SQLITE_DATABASE_SCOPE( this );
+
 	const FString SqlRequest = FString::Format( TEXT( "PRAGMA \"{0}\".user_version = {1}" ), { *Schema, DatabaseInfoAsset->UserVersion } );
 	char* ErrorMessage;
 
@@ -908,6 +1262,10 @@ bool USqliteDatabase::UpdateUserVersion( const FString Schema )
 
 int USqliteDatabase::BeginTransaction( const FString& Hint )
 {
+	SQLITE_DATABASE_ON_WORKER( this, BeginTransaction( Hint ) );
+
+	SQLITE_DATABASE_SCOPE( this );
+
 	char* ErrorMessage = nullptr;
 
 	int ErrorCode = sqlite3_exec( DatabaseConnectionHandler, TCHAR_TO_ANSI( *Sql_BeginTransaction ), nullptr, nullptr, &ErrorMessage );
@@ -933,6 +1291,10 @@ int USqliteDatabase::BeginTransaction( const FString& Hint )
 
 int USqliteDatabase::Commit( const FString& Hint )
 {
+	SQLITE_DATABASE_ON_WORKER( this, Commit( Hint ) );
+
+	SQLITE_DATABASE_SCOPE( this );
+
 	char* ErrorMessage = nullptr;
 
 	int ErrorCode = sqlite3_exec( DatabaseConnectionHandler, TCHAR_TO_ANSI( *Sql_Commit ), nullptr, nullptr, &ErrorMessage );
@@ -958,6 +1320,10 @@ int USqliteDatabase::Commit( const FString& Hint )
 
 int USqliteDatabase::Rollback( const FString& Hint )
 {
+	SQLITE_DATABASE_ON_WORKER( this, Rollback( Hint ) );
+
+	SQLITE_DATABASE_SCOPE( this );
+
 	char* ErrorMessage = nullptr;
 
 	int ErrorCode = sqlite3_exec( DatabaseConnectionHandler, TCHAR_TO_ANSI( *Sql_Rollback ), nullptr, nullptr, &ErrorMessage );
@@ -982,53 +1348,596 @@ int USqliteDatabase::Rollback( const FString& Hint )
 }
 
 // ============================================================================
-// === Errors =================================================================
+// === Durability =============================================================
 // ============================================================================
 
-int USqliteDatabase::GetErrorCode()
+bool USqliteDatabase::FlushDurable()
 {
-	if( DatabaseInfoAsset->ThreadingMode == ESqliteDatabaseThreadingMode::FULL_MUTEX )
+#if SQLITE_OS_OTHER
+	if( !IsOpen() )
 	{
-		sqlite3_mutex_enter( sqlite3_db_mutex( DatabaseConnectionHandler ) );
+		return false;
 	}
 
-	int rc = sqlite3_errcode( DatabaseConnectionHandler );
-
-	if( DatabaseInfoAsset->ThreadingMode == ESqliteDatabaseThreadingMode::FULL_MUTEX )
+	const int ErrorCode = sqlite3_ue_flush_durable( DatabaseFilePath );
+	if( ErrorCode != SQLITE_OK )
 	{
-		sqlite3_mutex_leave( sqlite3_db_mutex( DatabaseConnectionHandler ) );
+		LOG_SQLITE_ERROR( ErrorCode, "Durability barrier failed." );
+		return false;
 	}
+#endif
 
-	return rc;
+	// Without postponed syncs every commit already is on disk
+	return true;
 }
 
-int USqliteDatabase::GetExtentedErrorCode()
+FSqliteDurabilityStats USqliteDatabase::GetDurabilityStats() const
 {
-	if( DatabaseInfoAsset->ThreadingMode == ESqliteDatabaseThreadingMode::FULL_MUTEX )
+	FSqliteDurabilityStats Stats;
+
+#if SQLITE_OS_OTHER
+	if( IsOpen() )
 	{
-		sqlite3_mutex_enter( sqlite3_db_mutex( DatabaseConnectionHandler ) );
+		FSQLiteDurabilityWindow Window;
+		sqlite3_ue_get_durability_window( DatabaseFilePath, Window );
+
+		Stats.PendingCommits = Window.Commits;
+		Stats.PendingBytes = Window.Bytes;
+		Stats.PendingWindowMs = (float)Window.AgeMs;
 	}
+#endif
 
-	int rc = sqlite3_extended_errcode( DatabaseConnectionHandler );
+	return Stats;
+}
 
-	if( DatabaseInfoAsset->ThreadingMode == ESqliteDatabaseThreadingMode::FULL_MUTEX )
-	{
-		sqlite3_mutex_leave( sqlite3_db_mutex( DatabaseConnectionHandler ) );
-	}
+// ============================================================================
+// === Write queue ============================================================
+// ============================================================================
 
-	return rc;
+void USqliteDatabase::EnqueueWrite( const FString& Sql, TArray<FSqliteWriteValue> Bindings, const ESqliteWorkPriority Priority )
+{
+	FSqliteQueuedWrite Write;
+	Write.Sql = Sql;
+	Write.Bindings = MoveTemp( Bindings );
+	Write.Priority = Priority;
+	Write.EnqueueTime = FPlatformTime::Seconds();
+
+	// Counted first, the flush may dequeue it right away
+	QueuedWriteCount++;
+	PriorityCounters[(int32)Priority].Queued++;
+	WriteQueues[(int32)Priority].Enqueue( MoveTemp( Write ) );
 }
 
-FString USqliteDatabase::GetErrorMessage()
+TFuture<int> USqliteDatabase::EnqueueWriteWithResult( const FString& Sql, TArray<FSqliteWriteValue> Bindings, const ESqliteWorkPriority Priority )
 {
-	if( DatabaseInfoAsset->ThreadingMode == ESqliteDatabaseThreadingMode::FULL_MUTEX )
-	{
-		sqlite3_mutex_enter( sqlite3_db_mutex( DatabaseConnectionHandler ) );
-	}
+	FSqliteQueuedWrite Write;
+	Write.Sql = Sql;
+	Write.Bindings = MoveTemp( Bindings );
+	Write.Priority = Priority;
+	Write.EnqueueTime = FPlatformTime::Seconds();
+	Write.Promise = MakeUnique<TPromise<int>>();
 
-	FString rs = FString( sqlite3_errmsg( DatabaseConnectionHandler ) );
+	TFuture<int> Future = Write.Promise->GetFuture();
 
-	if( DatabaseInfoAsset->ThreadingMode == ESqliteDatabaseThreadingMode::FULL_MUTEX )
+	QueuedWriteCount++;
+	PriorityCounters[(int32)Priority].Queued++;
+	WriteQueues[(int32)Priority].Enqueue( MoveTemp( Write ) );
+
+	return Future;
+}
+
+int USqliteDatabase::FlushWriteQueue()
+{
+	SQLITE_DATABASE_ON_WORKER( this, FlushWriteQueue() );
+
+	return ExecuteWriteQueueBatch( true );
+}
+
+int USqliteDatabase::DrainWriteQueue()
+{
+	SQLITE_DATABASE_ON_WORKER( this, DrainWriteQueue() );
+
+	int ErrorCode = SQLITE_OK;
+
+	// Writes may still be queued by other threads while draining
+	while( !IsWriteQueueEmpty() )
+	{
+		ErrorCode = ExecuteWriteQueueBatch( false );
+		if( ErrorCode != SQLITE_OK && !IsWriteQueueEmpty() )
+		{
+			// No transaction can be started for them (the busy policy already waited), they are not silently dropped
+			FailQueuedWrites( ErrorCode );
+			break;
+		}
+	}
+
+	return ErrorCode;
+}
+
+void USqliteDatabase::FailQueuedWrites( const int ErrorCode )
+{
+	FSqliteQueuedWrite Write;
+	while( DequeueNextWrite( Write, nullptr ) )
+	{
+		WriteQueueStats.Writes++;
+		WriteQueueStats.FailedWrites++;
+
+		if( Write.Promise )
+		{
+			Write.Promise->SetValue( ErrorCode );
+		}
+	}
+}
+
+int USqliteDatabase::ExecuteWriteQueueBatch( const bool bWithinBudgets )
+{
+	if( IsWriteQueueEmpty() )
+	{
+		return SQLITE_OK;
+	}
+
+	// Nothing will ever execute them
+	if( !IsOpen() || DatabaseConnectionHandler == nullptr )
+	{
+		FailQueuedWrites( SQLITE_MISUSE );
+
+		return SQLITE_MISUSE;
+	}
+
+	FSqliteQueuedWrite Write;
+
+	SQLITE_DATABASE_SCOPE( this );
+
+	LastWriteQueueFlushTime = FPlatformTime::Seconds();
+
+	int ErrorCode = BeginWriteQueueTransaction();
+	if( ErrorCode != SQLITE_OK )
+	{
+		return ErrorCode;
+	}
+
+	// Writes of the current transaction, completed with their own result once it commits
+	struct FExecutedWrite
+	{
+		FSqliteQueuedWrite Write;
+		int ErrorCode;
+	};
+	TArray<FExecutedWrite> ExecutedWrites;
+
+	auto CompleteWrite = []( FSqliteQueuedWrite& InWrite, int InErrorCode )
+	{
+		if( InWrite.Promise )
+		{
+			InWrite.Promise->SetValue( InErrorCode );
+		}
+	};
+
+	// The same statements usually come back many times in a flush
+	TMap<FString, sqlite3_stmt*> Statements;
+
+	const int32 MaxBatchSize = ( bWithinBudgets && DatabaseInfoAsset->WriteQueueMaxBatchSize > 0 ) ? DatabaseInfoAsset->WriteQueueMaxBatchSize : MAX_int32;
+	int32 BatchSize = 0;
+
+	// Writes each priority class may still have in the transaction
+	int32 ClassBudgets[(int32)ESqliteWorkPriority::Count];
+	for( int32 Class = 0; Class < (int32)ESqliteWorkPriority::Count; Class++ )
+	{
+		const int32* MaxInFlight = DatabaseInfoAsset->MaxInFlightStatements.Find( (ESqliteWorkPriority)Class );
+		ClassBudgets[Class] = ( MaxInFlight && *MaxInFlight > 0 ) ? *MaxInFlight : MAX_int32;
+	}
+
+	while( BatchSize < MaxBatchSize && DequeueNextWrite( Write, bWithinBudgets ? ClassBudgets : nullptr ) )
+	{
+		BatchSize++;
+
+		const int WriteErrorCode = ExecuteQueuedWrite( Write, Statements );
+
+		WriteQueueStats.Writes++;
+		if( WriteErrorCode != SQLITE_OK )
+		{
+			WriteQueueStats.FailedWrites++;
+		}
+
+		// A failed statement is undone on its own, except for the errors that roll the whole transaction back (SQLITE_FULL, SQLITE_IOERR, ...)
+		if( sqlite3_get_autocommit( DatabaseConnectionHandler ) )
+		{
+			for( FExecutedWrite& Executed : ExecutedWrites )
+			{
+				CompleteWrite( Executed.Write, WriteErrorCode );
+			}
+			ExecutedWrites.Reset();
+
+			CompleteWrite( Write, WriteErrorCode );
+
+			ErrorCode = BeginWriteQueueTransaction();
+			if( ErrorCode != SQLITE_OK )
+			{
+				break;
+			}
+			continue;
+		}
+
+		ExecutedWrites.Add( { MoveTemp( Write ), WriteErrorCode } );
+	}
+
+	for( const TPair<FString, sqlite3_stmt*>& Statement : Statements )
+	{
+		sqlite3_finalize( Statement.Value );
+	}
+
+	if( ErrorCode == SQLITE_OK )
+	{
+		ErrorCode = Commit( "Write queue" );
+		if( ErrorCode == SQLITE_OK )
+		{
+			WriteQueueStats.Transactions++;
+		}
+		else
+		{
+			Rollback( "Write queue" );
+		}
+	}
+
+	for( FExecutedWrite& Executed : ExecutedWrites )
+	{
+		CompleteWrite( Executed.Write, ErrorCode == SQLITE_OK ? Executed.ErrorCode : ErrorCode );
+	}
+
+	return ErrorCode;
+}
+
+int USqliteDatabase::BeginWriteQueueTransaction()
+{
+	char* ErrorMessage = nullptr;
+
+	const int ErrorCode = sqlite3_exec( DatabaseConnectionHandler, TCHAR_TO_ANSI( *Sql_BeginImmediateTransaction ), nullptr, nullptr, &ErrorMessage );
+	if( ErrorCode == SQLITE_BUSY )
+	{
+		LOG_SQLITE_WARNING_TAG( ErrorCode, "Write queue", "Database is locked, the writes stay queued." );
+	}
+	else if( ErrorCode != SQLITE_OK )
+	{
+		LOG_SQLITE_ERROR_TAG( ErrorCode, "Write queue", ErrorMessage );
+	}
+
+	if( ErrorMessage != nullptr )
+	{
+		sqlite3_free( ErrorMessage );
+	}
+
+	return ErrorCode;
+}
+
+FSqliteWriteQueueStats USqliteDatabase::GetWriteQueueStats() const
+{
+	FSqliteWriteQueueStats Stats = WriteQueueStats;
+	Stats.QueuedWrites = FMath::Max( QueuedWriteCount.load(), 0 );
+
+	return Stats;
+}
+
+bool USqliteDatabase::IsWriteQueueEmpty() const
+{
+	for( const TQueue<FSqliteQueuedWrite, EQueueMode::Mpsc>& Queue : WriteQueues )
+	{
+		if( !Queue.IsEmpty() )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool USqliteDatabase::DequeueNextWrite( FSqliteQueuedWrite& OutWrite, int32* ClassBudgets )
+{
+	const double Now = FPlatformTime::Seconds();
+
+	double HeadWaitSeconds[(int32)ESqliteWorkPriority::Count];
+	for( int32 Class = 0; Class < (int32)ESqliteWorkPriority::Count; Class++ )
+	{
+		const FSqliteQueuedWrite* Head = WriteQueues[Class].Peek();
+		HeadWaitSeconds[Class] = ( Head && ( ClassBudgets == nullptr || ClassBudgets[Class] > 0 ) ) ? Now - Head->EnqueueTime : -1.0;
+	}
+
+	const int32 Class = FSqliteDatabaseWorker::PickPriorityClass( HeadWaitSeconds, DatabaseInfoAsset->PriorityAgingMs / 1000.0 );
+	if( Class == INDEX_NONE || !WriteQueues[Class].Dequeue( OutWrite ) )
+	{
+		return false;
+	}
+
+	if( ClassBudgets != nullptr )
+	{
+		ClassBudgets[Class]--;
+	}
+
+	QueuedWriteCount--;
+	PriorityCounters[Class].Dequeued( Now - OutWrite.EnqueueTime );
+
+	return true;
+}
+
+void USqliteDatabase::TickWriteQueue()
+{
+	if( !IsOpen() || IsWriteQueueEmpty() )
+	{
+		return;
+	}
+
+	const int32 FlushIntervalMs = DatabaseInfoAsset->WriteQueueFlushIntervalMs;
+	if( FlushIntervalMs > 0 && ( FPlatformTime::Seconds() - LastWriteQueueFlushTime ) * 1000.0 < FlushIntervalMs )
+	{
+		return;
+	}
+
+	if( Worker != nullptr )
+	{
+		// The worker flushes while the frame goes on, one flush at a time
+		if( !bWriteQueueFlushPending.exchange( true ) )
+		{
+			LastWriteQueueFlushTime = FPlatformTime::Seconds();
+
+			// As urgent as the most urgent write it carries
+			ESqliteWorkPriority Priority = ESqliteWorkPriority::Maintenance;
+			for( int32 Class = (int32)ESqliteWorkPriority::Count - 1; Class >= 0; Class-- )
+			{
+				if( !WriteQueues[Class].IsEmpty() )
+				{
+					Priority = (ESqliteWorkPriority)Class;
+				}
+			}
+
+			Worker->Enqueue( [this]()
+			{
+				// Dropped if the database was closed meanwhile, Close drained the queue
+				if( IsOpen() )
+				{
+					FlushWriteQueue();
+				}
+				bWriteQueueFlushPending = false;
+			}, Priority );
+		}
+
+		return;
+	}
+
+	FlushWriteQueue();
+}
+
+int USqliteDatabase::ExecuteQueuedWrite( const FSqliteQueuedWrite& Write, TMap<FString, sqlite3_stmt*>& Statements )
+{
+	sqlite3_stmt* Statement = nullptr;
+
+	if( sqlite3_stmt** CachedStatement = Statements.Find( Write.Sql ) )
+	{
+		Statement = *CachedStatement;
+		sqlite3_clear_bindings( Statement );
+	}
+	else
+	{
+		const int ErrorCode = sqlite3_prepare_v2( DatabaseConnectionHandler, TCHAR_TO_UTF8( *Write.Sql ), -1, &Statement, nullptr );
+		if( ErrorCode != SQLITE_OK )
+		{
+			LOG_SQLITE_ERROR( ErrorCode, "Failed to prepare a queued write." );
+			return ErrorCode;
+		}
+
+		Statements.Add( Write.Sql, Statement );
+	}
+
+	for( int32 Index = 0; Index < Write.Bindings.Num(); Index++ )
+	{
+		const FSqliteWriteValue& Value = Write.Bindings[Index];
+		const int ParameterIndex = Index + 1;
+
+		int ErrorCode;
+		if( const int64* Integer = Value.TryGet<int64>() )
+		{
+			ErrorCode = sqlite3_bind_int64( Statement, ParameterIndex, *Integer );
+		}
+		else if( const double* Float = Value.TryGet<double>() )
+		{
+			ErrorCode = sqlite3_bind_double( Statement, ParameterIndex, *Float );
+		}
+		else if( const FString* Text = Value.TryGet<FString>() )
+		{
+			const FTCHARToUTF8 Utf8Text( **Text );
+			ErrorCode = sqlite3_bind_text( Statement, ParameterIndex, Utf8Text.Get(), Utf8Text.Length(), SQLITE_TRANSIENT );
+		}
+		else if( const TArray<uint8>* Blob = Value.TryGet<TArray<uint8>>() )
+		{
+			ErrorCode = Blob->IsEmpty()
+				? sqlite3_bind_zeroblob( Statement, ParameterIndex, 0 )
+				: sqlite3_bind_blob64( Statement, ParameterIndex, Blob->GetData(), Blob->Num(), SQLITE_TRANSIENT );
+		}
+		else
+		{
+			ErrorCode = sqlite3_bind_null( Statement, ParameterIndex );
+		}
+
+		if( ErrorCode != SQLITE_OK )
+		{
+			LOG_SQLITE_ERROR( ErrorCode, "Failed to bind a value of a queued write." );
+			return ErrorCode;
+		}
+	}
+
+	int ErrorCode = sqlite3_step( Statement );
+
+	// Reset right away, a statement left running would keep the transaction from committing
+	sqlite3_reset( Statement );
+
+	if( ErrorCode == SQLITE_DONE || ErrorCode == SQLITE_ROW )
+	{
+		return SQLITE_OK;
+	}
+
+	LOG_SQLITE_ERROR( ErrorCode, "Queued write failed." );
+	return ErrorCode;
+}
+
+// ============================================================================
+// === Worker thread ==========================================================
+// ============================================================================
+
+/** Priority class set by FSqliteWorkPriorityScope on the thread, 0xFF without scope */
+static thread_local uint8 ThreadWorkPriority = 0xFF;
+
+FSqliteWorkPriorityScope::FSqliteWorkPriorityScope( const ESqliteWorkPriority InPriority )
+	: SavedPriority( ThreadWorkPriority )
+{
+	ThreadWorkPriority = (uint8)InPriority;
+}
+
+FSqliteWorkPriorityScope::~FSqliteWorkPriorityScope()
+{
+	ThreadWorkPriority = SavedPriority;
+}
+
+ESqliteWorkPriority FSqliteWorkPriorityScope::GetCurrent()
+{
+	if( ThreadWorkPriority != 0xFF )
+	{
+		return (ESqliteWorkPriority)ThreadWorkPriority;
+	}
+
+	return IsInGameThread() ? ESqliteWorkPriority::Gameplay : ESqliteWorkPriority::Background;
+}
+
+TFuture<int> USqliteDatabase::RunOnWorkerAsync( TUniqueFunction<int()> Function, const ESqliteWorkPriority Priority ) const
+{
+	TPromise<int> Promise;
+	TFuture<int> Future = Promise.GetFuture();
+
+	if( Worker == nullptr )
+	{
+		Promise.SetValue( Function() );
+		return Future;
+	}
+
+	Worker->Enqueue( [this, Promise = MoveTemp( Promise ), Function = MoveTemp( Function )]() mutable
+	{
+		SQLITE_DATABASE_SCOPE( this );
+
+		Promise.SetValue( Function() );
+	}, Priority );
+
+	return Future;
+}
+
+bool USqliteDatabase::HasWorkerThread() const
+{
+	return Worker != nullptr;
+}
+
+FSqlitePriorityStats USqliteDatabase::GetPriorityStats( const ESqliteWorkPriority Priority ) const
+{
+	FSqlitePriorityStats Stats;
+
+	if( Priority >= ESqliteWorkPriority::Count )
+	{
+		return Stats;
+	}
+
+	const FSqlitePriorityCounters& Counters = PriorityCounters[(int32)Priority];
+
+	Stats.QueueDepth = FMath::Max( Counters.Queued.load(), 0 );
+	Stats.Executed = Counters.Executed;
+	Stats.AverageWaitMs = Stats.Executed > 0 ? (float)( Counters.TotalWaitUs / (double)Stats.Executed / 1000.0 ) : 0.0f;
+	Stats.MaxWaitMs = (float)( Counters.MaxWaitUs / 1000.0 );
+
+	return Stats;
+}
+
+bool USqliteDatabase::IsWorkerDispatchNeeded() const
+{
+	return Worker != nullptr && !Worker->IsWorkerThread();
+}
+
+void USqliteDatabase::ExecuteOnWorker( TFunctionRef<void()> Command, const ESqliteWorkPriority Priority ) const
+{
+	if( Worker == nullptr )
+	{
+		Command();
+		return;
+	}
+
+	// The allocations of the worker are charged to the database as those of the caller would be
+	Worker->ExecuteAndWait( [this, &Command]()
+	{
+		SQLITE_DATABASE_SCOPE( this );
+
+		Command();
+	}, Priority );
+}
+
+void USqliteDatabase::StopWorker()
+{
+	if( Worker == nullptr )
+	{
+		return;
+	}
+
+	check( !Worker->IsWorkerThread() );
+
+	delete Worker;
+	Worker = nullptr;
+}
+
+// ============================================================================
+// === Errors =================================================================
+// ============================================================================
+
+int USqliteDatabase::GetErrorCode()
+{
+	SQLITE_DATABASE_ON_WORKER( this, GetErrorCode() );
+
+	if( DatabaseInfoAsset->ThreadingMode == ESqliteDatabaseThreadingMode::FULL_MUTEX )
+	{
+		sqlite3_mutex_enter( sqlite3_db_mutex( DatabaseConnectionHandler ) );
+	}
+
+	int rc = sqlite3_errcode( DatabaseConnectionHandler );
+
+	if( DatabaseInfoAsset->ThreadingMode == ESqliteDatabaseThreadingMode::FULL_MUTEX )
+	{
+		sqlite3_mutex_leave( sqlite3_db_mutex( DatabaseConnectionHandler ) );
+	}
+
+	return rc;
+}
+
+int USqliteDatabase::GetExtentedErrorCode()
+{
+	SQLITE_DATABASE_ON_WORKER( this, GetExtentedErrorCode() );
+
+	if( DatabaseInfoAsset->ThreadingMode == ESqliteDatabaseThreadingMode::FULL_MUTEX )
+	{
+		sqlite3_mutex_enter( sqlite3_db_mutex( DatabaseConnectionHandler ) );
+	}
+
+	int rc = sqlite3_extended_errcode( DatabaseConnectionHandler );
+
+	if( DatabaseInfoAsset->ThreadingMode == ESqliteDatabaseThreadingMode::FULL_MUTEX )
+	{
+		sqlite3_mutex_leave( sqlite3_db_mutex( DatabaseConnectionHandler ) );
+	}
+
+	return rc;
+}
+
+FString USqliteDatabase::GetErrorMessage()
+{
+	SQLITE_DATABASE_ON_WORKER( this, GetErrorMessage() );
+
+	if( DatabaseInfoAsset->ThreadingMode == ESqliteDatabaseThreadingMode::FULL_MUTEX )
+	{
+		sqlite3_mutex_enter( sqlite3_db_mutex( DatabaseConnectionHandler ) );
+	}
+
+	FString rs = FString( sqlite3_errmsg( DatabaseConnectionHandler ) );
+
+	if( DatabaseInfoAsset->ThreadingMode == ESqliteDatabaseThreadingMode::FULL_MUTEX )
 	{
 		sqlite3_mutex_leave( sqlite3_db_mutex( DatabaseConnectionHandler ) );
 	}
@@ -1038,6 +1947,8 @@ FString USqliteDatabase::GetErrorMessage()
 
 int USqliteDatabase::GetErrorOffset()
 {
+	SQLITE_DATABASE_ON_WORKER( this, GetErrorOffset() );
+
 	if( DatabaseInfoAsset->ThreadingMode == ESqliteDatabaseThreadingMode::FULL_MUTEX )
 	{
 		sqlite3_mutex_enter( sqlite3_db_mutex( DatabaseConnectionHandler ) );
@@ -1070,14 +1981,27 @@ int USqliteDatabase::GetLastErrorCodeCxx() const
 
 USqliteStatement* USqliteDatabase::Prepare( FString sql )
 {
-	sqlite3_stmt* stmt;
-	LastSqliteReturnCode = sqlite3_prepare_v2( DatabaseConnectionHandler, TCHAR_TO_ANSI( *sql ), -1, &stmt, NULL );
-	if( LastSqliteReturnCode != SQLITE_OK )
+	// Only the statement is prepared on the worker thread, the UObject is created and tracked on the calling thread
+	sqlite3_stmt* stmt = RunOnWorker( [this, &sql]() -> sqlite3_stmt*
 	{
-		UE_LOG( LogSqlite, Error, TEXT("Prepare statement failed: (%d) %s"),
-			GetErrorCode(),
-			*GetErrorMessage() );
+		SQLITE_DATABASE_SCOPE( this );
+
+		sqlite3_stmt* PreparedStatement = nullptr;
+		LastSqliteReturnCode = sqlite3_prepare_v2( DatabaseConnectionHandler, TCHAR_TO_ANSI( *sql ), -1, &PreparedStatement, NULL );
+		if( LastSqliteReturnCode != SQLITE_OK )
+		{
+			UE_LOG( LogSqlite, Error, TEXT("Prepare statement failed: (%d) %s"),
+				GetErrorCode(),
+				*GetErrorMessage() );
+
+			return nullptr;
+		}
 
+		return PreparedStatement;
+	} );
+
+	if( stmt == nullptr )
+	{
 		return nullptr;
 	}
 
@@ -1085,16 +2009,31 @@ USqliteStatement* USqliteDatabase::Prepare( FString sql )
 	Statement->Database = this;
 	Statement->StatementHandler = stmt;
 
-	ActiveStatements.Add( Statement );
+	{
+		FScopeLock Lock( &StatementsCriticalSection );
+		ActiveStatements.Add( Statement );
+	}
 	
 	return Statement;
 }
 
 void USqliteDatabase::StatementFinalized( USqliteStatement* Statement )
 {
+	FScopeLock Lock( &StatementsCriticalSection );
 	ActiveStatements.Remove( Statement );
 }
 
+void USqliteDatabase::AddReferencedObjects( UObject* InThis, FReferenceCollector& Collector )
+{
+	USqliteDatabase* This = CastChecked<USqliteDatabase>( InThis );
+	{
+		FScopeLock Lock( &This->StatementsCriticalSection );
+		Collector.AddReferencedObjects( This->ActiveStatements );
+	}
+
+	Super::AddReferencedObjects( InThis, Collector );
+}
+
 FString USqliteDatabase::GetDatabaseFileName() const
 {
 	return DatabaseInfoAsset->DatabaseFileName;
@@ -1111,6 +2050,10 @@ FString USqliteDatabase::GetDatabaseFilePath()
 
 bool USqliteDatabase::CreateTable( FName TableName, FString Sql ) const
 {
+	SQLITE_DATABASE_ON_WORKER( this, CreateTable( TableName, Sql ) );
+
+	SQLITE_DATABASE_SCOPE( this );
+
 	char* ErrorMessage = nullptr;
 
 	const int ErrorCode = sqlite3_exec( DatabaseConnectionHandler, TCHAR_TO_ANSI( *Sql ), nullptr, nullptr, &ErrorMessage );
@@ -1132,6 +2075,7 @@ bool USqliteDatabase::CreateTable( FName TableName, FString Sql ) const
 // ============================================================================
 
 const FString USqliteDatabase::Sql_BeginTransaction = TEXT( "BEGIN TRANSACTION;" );
+const FString USqliteDatabase::Sql_BeginImmediateTransaction = TEXT( "BEGIN IMMEDIATE TRANSACTION;" );
 const FString USqliteDatabase::Sql_Commit = TEXT( "COMMIT;" );
 const FString USqliteDatabase::Sql_Rollback = TEXT( "ROLLBACK;" );
 
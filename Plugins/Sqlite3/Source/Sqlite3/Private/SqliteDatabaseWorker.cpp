@@ -0,0 +1,148 @@
+// (c)2024+ Laurent Menten
+
+#include "SqliteDatabaseWorker.h"
+
+#include "HAL/Event.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTLS.h"
+#include "HAL/RunnableThread.h"
+
+FSqliteDatabaseWorker::FSqliteDatabaseWorker( const FString& InThreadName, FSqlitePriorityCounters* InCounters, double InAgingSeconds )
+	: Counters( InCounters )
+	, AgingSeconds( InAgingSeconds )
+	, bStopping( false )
+	, WakeEvent( FPlatformProcess::GetSynchEventFromPool() )
+	, ThreadId( 0 )
+{
+	Thread = FRunnableThread::Create( this, *InThreadName, 0, TPri_Normal );
+	if( Thread )
+	{
+		ThreadId = Thread->GetThreadID();
+	}
+}
+
+FSqliteDatabaseWorker::~FSqliteDatabaseWorker()
+{
+	if( Thread )
+	{
+		Thread->Kill( true );
+		delete Thread;
+	}
+
+	FPlatformProcess::ReturnSynchEventToPool( WakeEvent );
+}
+
+uint32 FSqliteDatabaseWorker::Run()
+{
+	while( !bStopping )
+	{
+		WakeEvent->Wait();
+		ExecuteCommands();
+	}
+
+	ExecuteCommands();
+
+	return 0;
+}
+
+void FSqliteDatabaseWorker::Stop()
+{
+	bStopping = true;
+	WakeEvent->Trigger();
+}
+
+void FSqliteDatabaseWorker::Enqueue( TUniqueFunction<void()>&& InCommand, ESqliteWorkPriority InPriority )
+{
+	// The thread could not be created, the caller is the only one using the connection
+	if( Thread == nullptr )
+	{
+		InCommand();
+		return;
+	}
+
+	// Counted first, the worker may dequeue it right away
+	Counters[(int32)InPriority].Queued++;
+	Commands[(int32)InPriority].Enqueue( { MoveTemp( InCommand ), FPlatformTime::Seconds() } );
+	WakeEvent->Trigger();
+}
+
+void FSqliteDatabaseWorker::ExecuteAndWait( TFunctionRef<void()> InCommand, ESqliteWorkPriority InPriority )
+{
+	if( Thread == nullptr || IsWorkerThread() )
+	{
+		InCommand();
+		return;
+	}
+
+	FEvent* DoneEvent = FPlatformProcess::GetSynchEventFromPool();
+
+	Enqueue( [&InCommand, DoneEvent]()
+	{
+		InCommand();
+		DoneEvent->Trigger();
+	}, InPriority );
+
+	DoneEvent->Wait();
+
+	FPlatformProcess::ReturnSynchEventToPool( DoneEvent );
+}
+
+bool FSqliteDatabaseWorker::IsWorkerThread() const
+{
+	return FPlatformTLS::GetCurrentThreadId() == ThreadId;
+}
+
+int32 FSqliteDatabaseWorker::PickPriorityClass( const double* InHeadWaitSeconds, const double InAgingSeconds )
+{
+	int32 PickedClass = INDEX_NONE;
+	double PickedRank = 0.0;
+
+	for( int32 Class = 0; Class < (int32)ESqliteWorkPriority::Count; Class++ )
+	{
+		if( InHeadWaitSeconds[Class] < 0.0 )
+		{
+			continue;
+		}
+
+		const double Rank = InAgingSeconds > 0.0
+			? Class - FMath::FloorToDouble( InHeadWaitSeconds[Class] / InAgingSeconds )
+			: Class;
+
+		// Ties go to the more urgent class
+		if( PickedClass == INDEX_NONE || Rank < PickedRank )
+		{
+			PickedClass = Class;
+			PickedRank = Rank;
+		}
+	}
+
+	return PickedClass;
+}
+
+void FSqliteDatabaseWorker::ExecuteCommands()
+{
+	for( ;; )
+	{
+		const double Now = FPlatformTime::Seconds();
+
+		double HeadWaitSeconds[(int32)ESqliteWorkPriority::Count];
+		for( int32 Class = 0; Class < (int32)ESqliteWorkPriority::Count; Class++ )
+		{
+			const FCommand* Head = Commands[Class].Peek();
+			HeadWaitSeconds[Class] = Head ? Now - Head->EnqueueTime : -1.0;
+		}
+
+		const int32 Class = PickPriorityClass( HeadWaitSeconds, AgingSeconds );
+		if( Class == INDEX_NONE )
+		{
+			break;
+		}
+
+		FCommand Command;
+		Commands[Class].Dequeue( Command );
+
+		Counters[Class].Dequeued( Now - Command.EnqueueTime );
+
+		Command.Function();
+	}
+}
@@ -0,0 +1,88 @@
+// (c)2024+ Laurent Menten
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "Containers/Queue.h"
+
+#include <atomic>
+
+#include "SqliteWriteQueue.h"
+
+class FEvent;
+class FRunnableThread;
+
+/**
+ * Thread of a database opened with bUseWorkerThread (see USqliteDatabaseInfo),
+ * the only one using its connection. Commands are queued from any thread and
+ * executed by priority class, in order within a class.
+ */
+class FSqliteDatabaseWorker : public FRunnable
+{
+public:
+	/**
+	 * InCounters are those of the database, one per priority class.
+	 */
+	FSqliteDatabaseWorker( const FString& InThreadName, FSqlitePriorityCounters* InCounters, double InAgingSeconds );
+
+	/**
+	 * The commands still queued are executed before the thread exits.
+	 */
+	virtual ~FSqliteDatabaseWorker();
+
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+	/**
+	 * Queue a command, it is executed on the worker thread.
+	 */
+	void Enqueue( TUniqueFunction<void()>&& InCommand, ESqliteWorkPriority InPriority );
+
+	/**
+	 * Execute a command on the worker thread and wait for it, right away when
+	 * called from the worker thread.
+	 */
+	void ExecuteAndWait( TFunctionRef<void()> InCommand, ESqliteWorkPriority InPriority );
+
+	bool IsWorkerThread() const;
+
+	/**
+	 * Class of the work to take next, strict priority with aging: a class is
+	 * one step more urgent per InAgingSeconds its oldest work waited. Negative
+	 * waits stand for empty classes, INDEX_NONE when all are.
+	 */
+	static int32 PickPriorityClass( const double* InHeadWaitSeconds, double InAgingSeconds );
+
+private:
+	/**
+	 * Execute the queued commands.
+	 */
+	void ExecuteCommands();
+
+	struct FCommand
+	{
+		TUniqueFunction<void()> Function;
+		double EnqueueTime;
+	};
+
+	TQueue<FCommand, EQueueMode::Mpsc> Commands[(int32)ESqliteWorkPriority::Count];
+
+	FSqlitePriorityCounters* Counters;
+	double AgingSeconds;
+
+	std::atomic<bool> bStopping;
+	FEvent* WakeEvent;
+	FRunnableThread* Thread;
+	uint32 ThreadId;
+};
+
+/**
+ * Make the calling method of a database (or statement) execute on the worker
+ * thread of the database, when it has one and this is another thread.
+ */
+#define SQLITE_DATABASE_ON_WORKER( Database, Call ) \
+	if( (Database)->IsWorkerDispatchNeeded() ) \
+	{ \
+		return (Database)->RunOnWorker( [&]() { return Call; } ); \
+	}
@@ -8,6 +8,8 @@
 #include "SqliteBlob.h"
 #include "SqliteNull.h"
 #include "Sqlite3Log.h"
+#include "SqliteDatabaseWorker.h"
+#include "platform/SQLite3Platform.h"
 
 // ---------------------------------------------------------------------------
 // - 
@@ -25,6 +27,10 @@ USqliteDatabase* USqliteStatement::GetDatabase() const
 
 int USqliteStatement::Step() const
 {
+	SQLITE_DATABASE_ON_WORKER( Database, Step() );
+
+	SQLITE_DATABASE_SCOPE( Database );
+
 	const int rc = sqlite3_step( StatementHandler );
 	if( (rc != SQLITE_ROW) && (rc != SQLITE_DONE) )
 	{
@@ -36,9 +42,16 @@ int USqliteStatement::Step() const
 
 int USqliteStatement::Finalize()
 {
-	UE_LOG( LogSqlite, Log, TEXT( "Finalize" ) );
+	// Only the statement is finalized on the worker thread, the database forgets it on the calling thread
+	const int rc = Database->RunOnWorker( [this]()
+	{
+		SQLITE_DATABASE_SCOPE( Database );
+
+		UE_LOG( LogSqlite, Log, TEXT( "Finalize" ) );
+
+		return sqlite3_finalize( StatementHandler );
+	} );
 
-	const int rc = sqlite3_finalize( StatementHandler );
 	if( rc == SQLITE_OK )
 	{
 		Database->StatementFinalized( this );
@@ -57,16 +70,24 @@ int USqliteStatement::Finalize()
 
 int USqliteStatement::ClearBindings()
 {
+	SQLITE_DATABASE_ON_WORKER( Database, ClearBindings() );
+
 	return sqlite3_clear_bindings( StatementHandler );
 }
 
 int USqliteStatement::Reset() const
 {
+	SQLITE_DATABASE_ON_WORKER( Database, Reset() );
+
+	SQLITE_DATABASE_SCOPE( Database );
+
 	return sqlite3_reset( StatementHandler );
 }
 
 int USqliteStatement::GetBindParameterCount() const
 {
+	SQLITE_DATABASE_ON_WORKER( Database, GetBindParameterCount() );
+
 	return sqlite3_bind_parameter_count( StatementHandler );
 }
 
@@ -74,6 +95,8 @@ int USqliteStatement::GetBindParameterCount() const
 
 int USqliteStatement::GetBindParameterIndex( ESqliteDatabaseSimpleExecutionPins& Branch, const FString ColumnName )
 {
+	SQLITE_DATABASE_ON_WORKER( Database, GetBindParameterIndex( Branch, ColumnName ) );
+
 	const int ColumnIndex = sqlite3_bind_parameter_index( StatementHandler, StringCast<ANSICHAR>( *ColumnName ).Get() );
 	if( ColumnIndex == 0 )
 	{
@@ -87,6 +110,8 @@ int USqliteStatement::GetBindParameterIndex( ESqliteDatabaseSimpleExecutionPins&
 
 FString USqliteStatement::GetBindParameterName( ESqliteDatabaseSimpleExecutionPins& Branch, const int ColumnIndex )
 {
+	SQLITE_DATABASE_ON_WORKER( Database, GetBindParameterName( Branch, ColumnIndex ) );
+
 	const char* ColumnName = sqlite3_bind_parameter_name( StatementHandler, ColumnIndex );
 	if( ColumnName == nullptr )
 	{
@@ -102,6 +127,8 @@ FString USqliteStatement::GetBindParameterName( ESqliteDatabaseSimpleExecutionPi
 
 int USqliteStatement::BindDouble( ESqliteDatabaseSimpleExecutionPins& Branch, const int ColumnIndex, const double Value, USqliteStatement*& Statement )
 {
+	SQLITE_DATABASE_ON_WORKER( Database, BindDouble( Branch, ColumnIndex, Value, Statement ) );
+
 	UE_LOG( LogSqlite, Log, TEXT("Binding float value %f to columne %d"), Value, ColumnIndex );
 
 	const int rc = sqlite3_bind_double( StatementHandler, ColumnIndex, Value );
@@ -120,6 +147,8 @@ int USqliteStatement::BindDouble( ESqliteDatabaseSimpleExecutionPins& Branch, co
 
 int USqliteStatement::BindInteger( ESqliteDatabaseSimpleExecutionPins& Branch, const int ColumnIndex, const int Value, USqliteStatement*& Statement )
 {
+	SQLITE_DATABASE_ON_WORKER( Database, BindInteger( Branch, ColumnIndex, Value, Statement ) );
+
 	UE_LOG( LogSqlite, Log, TEXT("Binding int value %d to columne %d"), Value, ColumnIndex );
 
 	const int rc = sqlite3_bind_int( StatementHandler, ColumnIndex, Value );
@@ -138,6 +167,8 @@ int USqliteStatement::BindInteger( ESqliteDatabaseSimpleExecutionPins& Branch, c
 
 int USqliteStatement::BindInteger64(ESqliteDatabaseSimpleExecutionPins& Branch, const int ColumnIndex, const int64 Value, USqliteStatement*& Statement )
 {
+	SQLITE_DATABASE_ON_WORKER( Database, BindInteger64( Branch, ColumnIndex, Value, Statement ) );
+
 	UE_LOG( LogSqlite, Log, TEXT("Binding int64 value %lld to columne %d"), Value, ColumnIndex );
 
 	const int rc = sqlite3_bind_int64( StatementHandler, ColumnIndex, Value );
@@ -156,6 +187,8 @@ int USqliteStatement::BindInteger64(ESqliteDatabaseSimpleExecutionPins& Branch,
 
 int USqliteStatement::BindText( ESqliteDatabaseSimpleExecutionPins& Branch, const int ColumnIndex, const FString Value, USqliteStatement*& Statement )
 {
+	SQLITE_DATABASE_ON_WORKER( Database, BindText( Branch, ColumnIndex, Value, Statement ) );
+
 	UE_LOG( LogSqlite, Log, TEXT("Binding text value \"%s\" to columne %d"), *Value, ColumnIndex );
 
 	const int rc = sqlite3_bind_text( StatementHandler, ColumnIndex, StringCast<ANSICHAR>(*Value).Get(), -1, SQLITE_TRANSIENT );
@@ -174,6 +207,8 @@ int USqliteStatement::BindText( ESqliteDatabaseSimpleExecutionPins& Branch, cons
 
 int USqliteStatement::BindNull( ESqliteDatabaseSimpleExecutionPins& Branch, const int ColumnIndex, USqliteStatement*& Statement )
 {
+	SQLITE_DATABASE_ON_WORKER( Database, BindNull( Branch, ColumnIndex, Statement ) );
+
 	UE_LOG( LogSqlite, Log, TEXT("Binding NULL value to columne %d"), ColumnIndex );
 
 	const int rc = sqlite3_bind_null( StatementHandler, ColumnIndex );
@@ -192,6 +227,8 @@ int USqliteStatement::BindNull( ESqliteDatabaseSimpleExecutionPins& Branch, cons
 
 int USqliteStatement::BindZeroBlob( ESqliteDatabaseSimpleExecutionPins& Branch, const int ColumnIndex, const int DataSize, USqliteStatement*& Statement )
 {
+	SQLITE_DATABASE_ON_WORKER( Database, BindZeroBlob( Branch, ColumnIndex, DataSize, Statement ) );
+
 	UE_LOG( LogSqlite, Log, TEXT("Binding zero blob of size %d to columne %d"), DataSize, ColumnIndex );
 
 	const int rc = sqlite3_bind_zeroblob( StatementHandler, ColumnIndex, DataSize );
@@ -210,6 +247,8 @@ int USqliteStatement::BindZeroBlob( ESqliteDatabaseSimpleExecutionPins& Branch,
 
 int USqliteStatement::BindZeroBlob64( ESqliteDatabaseSimpleExecutionPins& Branch, const int ColumnIndex, const int64 DataSize, USqliteStatement*& Statement )
 {
+	SQLITE_DATABASE_ON_WORKER( Database, BindZeroBlob64( Branch, ColumnIndex, DataSize, Statement ) );
+
 	UE_LOG( LogSqlite, Log, TEXT("Binding zero blob (64) of size %lld to columne %d"), DataSize, ColumnIndex );
 
 	const int rc = sqlite3_bind_zeroblob64( StatementHandler, ColumnIndex, DataSize );
@@ -232,11 +271,15 @@ int USqliteStatement::BindZeroBlob64( ESqliteDatabaseSimpleExecutionPins& Branch
 
 int USqliteStatement::GetColumnCount() const
 {
+	SQLITE_DATABASE_ON_WORKER( Database, GetColumnCount() );
+
 	return sqlite3_column_count( StatementHandler );
 }
 
 int USqliteStatement::GetDataCount() const
 {
+	SQLITE_DATABASE_ON_WORKER( Database, GetDataCount() );
+
 	return sqlite3_data_count( StatementHandler );
 }
 
@@ -244,6 +287,8 @@ int USqliteStatement::GetDataCount() const
 
 FString USqliteStatement::GetColumnName( ESqliteDatabaseSimpleExecutionPins& Branch, const int ColumnIndex ) const
 {
+	SQLITE_DATABASE_ON_WORKER( Database, GetColumnName( Branch, ColumnIndex ) );
+
 	const char* ColumnName = sqlite3_column_name( StatementHandler, ColumnIndex );
 	if( ColumnName == nullptr )
 	{
@@ -257,6 +302,8 @@ FString USqliteStatement::GetColumnName( ESqliteDatabaseSimpleExecutionPins& Bra
 
 FString USqliteStatement::GetColumnDatabaseName( ESqliteDatabaseSimpleExecutionPins& Branch, const int ColumnIndex ) const
 {
+	SQLITE_DATABASE_ON_WORKER( Database, GetColumnDatabaseName( Branch, ColumnIndex ) );
+
 	const char* ColumnName = sqlite3_column_database_name( StatementHandler, ColumnIndex );
 	if( ColumnName == nullptr )
 	{
@@ -270,6 +317,8 @@ FString USqliteStatement::GetColumnDatabaseName( ESqliteDatabaseSimpleExecutionP
 
 FString USqliteStatement::GetColumnTableName( ESqliteDatabaseSimpleExecutionPins& Branch, const int ColumnIndex ) const
 {
+	SQLITE_DATABASE_ON_WORKER( Database, GetColumnTableName( Branch, ColumnIndex ) );
+
 	const char* ColumnName = sqlite3_column_table_name( StatementHandler, ColumnIndex );
 	if( ColumnName == nullptr )
 	{
@@ -283,6 +332,8 @@ FString USqliteStatement::GetColumnTableName( ESqliteDatabaseSimpleExecutionPins
 
 FString USqliteStatement::GetColumnOriginName( ESqliteDatabaseSimpleExecutionPins& Branch, const int ColumnIndex ) const
 {
+	SQLITE_DATABASE_ON_WORKER( Database, GetColumnOriginName( Branch, ColumnIndex ) );
+
 	const char* ColumnName = sqlite3_column_origin_name( StatementHandler, ColumnIndex );
 	if( ColumnName == nullptr )
 	{
@@ -296,6 +347,8 @@ FString USqliteStatement::GetColumnOriginName( ESqliteDatabaseSimpleExecutionPin
 
 ESqliteType USqliteStatement::GetColumnType( ESqliteDatabaseSimpleExecutionPins& Branch, const int ColumnIndex ) const
 {
+	SQLITE_DATABASE_ON_WORKER( Database, GetColumnType( Branch, ColumnIndex ) );
+
 	switch( sqlite3_column_type( StatementHandler, ColumnIndex ) )
 	{
 		case SQLITE_INTEGER:
@@ -326,6 +379,8 @@ ESqliteType USqliteStatement::GetColumnType( ESqliteDatabaseSimpleExecutionPins&
 
 FString USqliteStatement::GetColumnDeclaredType( ESqliteDatabaseSimpleExecutionPins& Branch, const int ColumnIndex ) const
 {
+	SQLITE_DATABASE_ON_WORKER( Database, GetColumnDeclaredType( Branch, ColumnIndex ) );
+
 	const char* ColumnDeclaredType = sqlite3_column_decltype( StatementHandler, ColumnIndex );
 	if( ColumnDeclaredType == nullptr )
 	{
@@ -341,21 +396,29 @@ FString USqliteStatement::GetColumnDeclaredType( ESqliteDatabaseSimpleExecutionP
 
 int USqliteStatement::GetColumnAsInteger( const int ColumnIndex ) const
 {
+	SQLITE_DATABASE_ON_WORKER( Database, GetColumnAsInteger( ColumnIndex ) );
+
 	return sqlite3_column_int( StatementHandler, ColumnIndex );
 }
 
 int64 USqliteStatement::GetColumnAsInteger64( const int ColumnIndex ) const
 {
+	SQLITE_DATABASE_ON_WORKER( Database, GetColumnAsInteger64( ColumnIndex ) );
+
 	return sqlite3_column_int64( StatementHandler, ColumnIndex );
 }
 
 double USqliteStatement::GetColumnAsDouble( const int ColumnIndex ) const
 {
+	SQLITE_DATABASE_ON_WORKER( Database, GetColumnAsDouble( ColumnIndex ) );
+
 	return sqlite3_column_double( StatementHandler, ColumnIndex );
 }
 
 FString USqliteStatement::GetColumnAsString( const int ColumnIndex ) const
 {
+	SQLITE_DATABASE_ON_WORKER( Database, GetColumnAsString( ColumnIndex ) );
+
 	return FString( (char*) sqlite3_column_text( StatementHandler, ColumnIndex ) );
 }
 
@@ -363,16 +426,22 @@ FString USqliteStatement::GetColumnAsString( const int ColumnIndex ) const
 
 const void* USqliteStatement::GetColumnAsBlob( const int ColumnIndex ) const
 {
+	SQLITE_DATABASE_ON_WORKER( Database, GetColumnAsBlob( ColumnIndex ) );
+
 	return sqlite3_column_blob( StatementHandler, ColumnIndex );
 }
 
 const unsigned char* USqliteStatement::GetColumnAsText( const int ColumnIndex ) const
 {
+	SQLITE_DATABASE_ON_WORKER( Database, GetColumnAsText( ColumnIndex ) );
+
 	return sqlite3_column_text( StatementHandler, ColumnIndex );
 }
 
 int USqliteStatement::GetColumnBytes( const int ColumnIndex ) const
 {
+	SQLITE_DATABASE_ON_WORKER( Database, GetColumnBytes( ColumnIndex ) );
+
 	return sqlite3_column_bytes( StatementHandler, ColumnIndex );
 }
 
@@ -382,18 +451,61 @@ int USqliteStatement::GetColumnBytes( const int ColumnIndex ) const
 
 TArray<USqliteData*> USqliteStatement::GetResultSet() const
 {
+	// The columns are read on the worker thread, the UObjects are created on the calling thread
+	struct FColumnValue
+	{
+		int DataType = SQLITE_NULL;
+		int64 IntegerValue = 0;
+		double FloatValue = 0.0;
+		const void* Value = nullptr;
+		int Size = 0;
+	};
+
+	const TArray<FColumnValue> ColumnValues = Database->RunOnWorker( [this]()
+	{
+		TArray<FColumnValue> Values;
+
+		const int ColumnCount = sqlite3_column_count( StatementHandler );
+		for( int ColumnIndex = 0; ColumnIndex < ColumnCount; ColumnIndex++ )
+		{
+			FColumnValue& ColumnValue = Values.AddDefaulted_GetRef();
+			ColumnValue.DataType = sqlite3_column_type( StatementHandler, ColumnIndex );
+
+			switch( ColumnValue.DataType )
+			{
+				case SQLITE_INTEGER:
+					ColumnValue.IntegerValue = sqlite3_column_int64( StatementHandler, ColumnIndex );
+					break;
+
+				case SQLITE_FLOAT:
+					ColumnValue.FloatValue = sqlite3_column_double( StatementHandler, ColumnIndex );
+					break;
+
+				case SQLITE_TEXT:
+				case SQLITE_BLOB:
+					ColumnValue.Value = sqlite3_column_text( StatementHandler, ColumnIndex );
+					ColumnValue.Size = sqlite3_column_bytes( StatementHandler, ColumnIndex );
+					break;
+
+				default:
+					break;
+			}
+		}
+
+		return Values;
+	} );
+
 	TArray<USqliteData*> ResultSet;
 
-	const int ColumnCount = sqlite3_column_count( StatementHandler );
-	for( int ColumnIndex = 0; ColumnIndex < ColumnCount; ColumnIndex++ )
+	for( const FColumnValue& ColumnValue : ColumnValues )
 	{
-		switch( const int DataType = sqlite3_column_type( StatementHandler, ColumnIndex ) )
+		switch( ColumnValue.DataType )
 		{
 			case SQLITE_INTEGER:
 			{
 				USqliteInteger* IntegerData = NewObject<USqliteInteger>();
 
-				IntegerData->Value = sqlite3_column_int64( StatementHandler, ColumnIndex );
+				IntegerData->Value = ColumnValue.IntegerValue;
 				ResultSet.Add( IntegerData );
 				break;
 			}
@@ -402,7 +514,7 @@ TArray<USqliteData*> USqliteStatement::GetResultSet() const
 			{
 				USqliteFloat* FloatData = NewObject<USqliteFloat>();
 
-				FloatData->Value = sqlite3_column_double( StatementHandler, ColumnIndex );
+				FloatData->Value = ColumnValue.FloatValue;
 
 				ResultSet.Add( FloatData );
 				break;
@@ -412,8 +524,8 @@ TArray<USqliteData*> USqliteStatement::GetResultSet() const
 			{
 				USqliteText* TextData = NewObject<USqliteText>();
 
-				TextData->Value = sqlite3_column_text( StatementHandler, ColumnIndex );
-				TextData->Size = sqlite3_column_bytes( StatementHandler, ColumnIndex );
+				TextData->Value = (const unsigned char*)ColumnValue.Value;
+				TextData->Size = ColumnValue.Size;
 
 				ResultSet.Add( TextData );
 				break;
@@ -423,8 +535,8 @@ TArray<USqliteData*> USqliteStatement::GetResultSet() const
 			{
 				USqliteBlob* BlobData = NewObject<USqliteBlob>();
 
-				BlobData->Value = sqlite3_column_text( StatementHandler, ColumnIndex );
-				BlobData->Size = sqlite3_column_bytes( StatementHandler, ColumnIndex );
+				BlobData->Value = ColumnValue.Value;
+				BlobData->Size = ColumnValue.Size;
 
 				ResultSet.Add( BlobData );
 				break;
@@ -440,7 +552,7 @@ TArray<USqliteData*> USqliteStatement::GetResultSet() const
 
 			default:
 			{
-				UE_LOG( LogSqlite, Error, TEXT( "Unknown Sqlite data type [%d]" ), DataType );
+				UE_LOG( LogSqlite, Error, TEXT( "Unknown Sqlite data type [%d]" ), ColumnValue.DataType );
 				break;
 			}
 		}
@@ -455,20 +567,28 @@ TArray<USqliteData*> USqliteStatement::GetResultSet() const
 
 bool USqliteStatement::IsBusy() const
 {
+	SQLITE_DATABASE_ON_WORKER( Database, IsBusy() );
+
 	return sqlite3_stmt_busy( StatementHandler ) != 0;
 }
 
 bool USqliteStatement::IsExplain() const
 {
+	SQLITE_DATABASE_ON_WORKER( Database, IsExplain() );
+
 	return sqlite3_stmt_isexplain( StatementHandler ) == 1;
 }
 
 bool USqliteStatement::IsReadOnly() const
 {
+	SQLITE_DATABASE_ON_WORKER( Database, IsReadOnly() );
+
 	return sqlite3_stmt_readonly( StatementHandler ) != 0;
 }
 
 int USqliteStatement::GetStatementStatus( ESqliteStatementStatus Counter, const bool ResetFlag ) const
 {
+	SQLITE_DATABASE_ON_WORKER( Database, GetStatementStatus( Counter, ResetFlag ) );
+
 	return sqlite3_stmt_status( StatementHandler, StaticCast<int>(Counter), ResetFlag );
 }
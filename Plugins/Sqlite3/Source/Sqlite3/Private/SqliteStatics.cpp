@@ -3,8 +3,12 @@
 #include "SqliteStatics.h"
 #include "Sqlite3Log.h"
 #include "Sqlite3Subsystem.h"
+#include "platform/pakfile.h"
 
 #include "CoreMinimal.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "HAL/FileManager.h"
 
 // ============================================================================
 // === 
@@ -607,3 +611,67 @@ FString USqliteStatics::ExtendedErrorString( ESqliteExtendedErrorCode ErrorCode
 {
 	return FString( sqlite3_errstr( USqliteStatics::UnmapNativeExtendedErrorCode( ErrorCode ) ) );
 }
+
+// ============================================================================
+// === 
+// ============================================================================
+
+bool USqliteStatics::CompressDatabaseFile( const FString& SourceFilePath, const FString& TargetFilePath, FName CompressionFormat )
+{
+#if SQLITE_OS_OTHER
+	sqlite3* Db = nullptr;
+
+	int rc = sqlite3_open_v2( TCHAR_TO_UTF8( *FPaths::ConvertRelativePathToFull( SourceFilePath ) ), &Db, SQLITE_OPEN_READONLY, nullptr );
+	if( rc != SQLITE_OK )
+	{
+		LOG_SQLITE_ERROR( rc, "Failed to open the source database" );
+		sqlite3_close_v2( Db );
+		return false;
+	}
+
+	// VACUUM INTO gives a compact copy without free pages and without the WAL content left aside
+	const FString TempFilePath = FPaths::CreateTempFilename( *FPaths::ProjectIntermediateDir(), TEXT( "SqliteCompress" ), TEXT( ".db" ) );
+	const FString Sql = FString::Printf( TEXT( "VACUUM INTO '%s';" ), *FPaths::ConvertRelativePathToFull( TempFilePath ).Replace( TEXT( "'" ), TEXT( "''" ) ) );
+
+	rc = sqlite3_exec( Db, TCHAR_TO_UTF8( *Sql ), nullptr, nullptr, nullptr );
+	if( rc != SQLITE_OK )
+	{
+		LOG_SQLITE_ERROR( rc, sqlite3_errmsg( Db ) );
+		sqlite3_close_v2( Db );
+		IFileManager::Get().Delete( *TempFilePath );
+		return false;
+	}
+
+	sqlite3_close_v2( Db );
+
+	TArray64<uint8> Database;
+	const bool bLoaded = FFileHelper::LoadFileToArray( Database, *TempFilePath );
+	IFileManager::Get().Delete( *TempFilePath );
+
+	if( !bLoaded )
+	{
+		UE_LOG( LogSqlite, Error, TEXT( "Failed to read the vacuumed copy of '%s'." ), *SourceFilePath );
+		return false;
+	}
+
+	TArray64<uint8> Compressed;
+	if( !FSQLitePakFileFuncs::CompressDatabase( Database, CompressionFormat, Compressed ) )
+	{
+		return false;
+	}
+
+	if( !FFileHelper::SaveArrayToFile( Compressed, *TargetFilePath ) )
+	{
+		UE_LOG( LogSqlite, Error, TEXT( "Failed to write '%s'." ), *TargetFilePath );
+		return false;
+	}
+
+	UE_LOG( LogSqlite, Log, TEXT( "Compressed '%s' (%lld bytes) into '%s' (%lld bytes, %s)." ),
+		*SourceFilePath, Database.Num(), *TargetFilePath, Compressed.Num(), *CompressionFormat.ToString() );
+
+	return true;
+#else
+	UE_LOG( LogSqlite, Error, TEXT( "Compressed databases need the Unreal file system (SQLITE_OS_OTHER)." ) );
+	return false;
+#endif
+}
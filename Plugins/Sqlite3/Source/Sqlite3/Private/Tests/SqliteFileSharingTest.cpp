@@ -0,0 +1,94 @@
+// (c)2024+ Laurent Menten
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/Paths.h"
+#include "HAL/FileManager.h"
+#include "sqlite/Sqlite3Include.h"
+
+#if WITH_DEV_AUTOMATION_TESTS && SQLITE_OS_OTHER
+
+// Two connections of the process writing the same database through the Unreal
+// file system, in rollback journal then WAL mode.
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST( FSqliteTwoWritableConnectionsTest, "Sqlite3.File.TwoWritableConnections", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter )
+
+bool FSqliteTwoWritableConnectionsTest::RunTest( const FString& Parameters )
+{
+	const FString Filename = FPaths::ConvertRelativePathToFull( FPaths::ProjectSavedDir() / TEXT( "Sqlite/Tests/TwoWritableConnections.db" ) );
+	const TCHAR* Suffixes[] = { TEXT( "" ), TEXT( "-journal" ), TEXT( "-wal" ), TEXT( "-shm" ) };
+
+	IFileManager::Get().MakeDirectory( *FPaths::GetPath( Filename ), true );
+	for( const TCHAR* Suffix : Suffixes )
+	{
+		IFileManager::Get().Delete( *( Filename + Suffix ) );
+	}
+
+	auto Exec = [this]( sqlite3* Db, const char* Sql )
+	{
+		char* ErrorMessage = nullptr;
+		const int rc = sqlite3_exec( Db, Sql, nullptr, nullptr, &ErrorMessage );
+		if( rc != SQLITE_OK )
+		{
+			AddError( FString::Printf( TEXT( "%hs failed: %hs" ), Sql, ErrorMessage ? ErrorMessage : sqlite3_errstr( rc ) ) );
+		}
+		sqlite3_free( ErrorMessage );
+		return rc == SQLITE_OK;
+	};
+
+	auto CountRows = []( sqlite3* Db )
+	{
+		int Count = -1;
+		sqlite3_stmt* Statement = nullptr;
+		if( sqlite3_prepare_v2( Db, "SELECT COUNT(*) FROM Shared;", -1, &Statement, nullptr ) == SQLITE_OK && sqlite3_step( Statement ) == SQLITE_ROW )
+		{
+			Count = sqlite3_column_int( Statement, 0 );
+		}
+		sqlite3_finalize( Statement );
+		return Count;
+	};
+
+	const int OpenFlags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+
+	sqlite3* First = nullptr;
+	sqlite3* Second = nullptr;
+	const bool bFirstOpen = TestEqual( TEXT( "Open the first writable connection" ), sqlite3_open_v2( TCHAR_TO_UTF8( *Filename ), &First, OpenFlags, "unreal-fs" ), SQLITE_OK );
+	const bool bSecondOpen = TestEqual( TEXT( "Open the second writable connection" ), sqlite3_open_v2( TCHAR_TO_UTF8( *Filename ), &Second, OpenFlags, "unreal-fs" ), SQLITE_OK );
+
+	if( bFirstOpen && bSecondOpen )
+	{
+		sqlite3_busy_timeout( First, 5000 );
+		sqlite3_busy_timeout( Second, 5000 );
+
+		// Rollback journal
+		if( Exec( First, "CREATE TABLE Shared( Id INTEGER PRIMARY KEY, Writer TEXT );" )
+			&& Exec( First, "INSERT INTO Shared( Writer ) VALUES( 'First' );" )
+			&& Exec( Second, "INSERT INTO Shared( Writer ) VALUES( 'Second' );" ) )
+		{
+			TestEqual( TEXT( "Rows seen by the first connection" ), CountRows( First ), 2 );
+			TestEqual( TEXT( "Rows seen by the second connection" ), CountRows( Second ), 2 );
+		}
+
+		// WAL, both connections keep the WAL file open
+		if( Exec( First, "PRAGMA journal_mode=WAL;" )
+			&& Exec( First, "INSERT INTO Shared( Writer ) VALUES( 'First' );" )
+			&& Exec( Second, "INSERT INTO Shared( Writer ) VALUES( 'Second' );" )
+			&& Exec( First, "INSERT INTO Shared( Writer ) VALUES( 'First' );" ) )
+		{
+			TestEqual( TEXT( "Rows seen by the first connection in WAL mode" ), CountRows( First ), 5 );
+			TestEqual( TEXT( "Rows seen by the second connection in WAL mode" ), CountRows( Second ), 5 );
+		}
+	}
+
+	sqlite3_close_v2( Second );
+	sqlite3_close_v2( First );
+
+	for( const TCHAR* Suffix : Suffixes )
+	{
+		IFileManager::Get().Delete( *( Filename + Suffix ) );
+	}
+
+	return true;
+}
+
+#endif
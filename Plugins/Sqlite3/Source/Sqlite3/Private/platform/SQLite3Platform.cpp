@@ -20,6 +20,16 @@ THIRD_PARTY_INCLUDES_END
 #include "platform/file.h"
 #include "platform/malloc.h"
 #include "platform/mutex.h"
+#include "platform/pcache.h"
+#include "platform/pakfile.h"
+
+static void RegisterUnrealVfs()
+{
+	FSQLiteFileFuncs::Register();
+	FSQLitePakFileFuncs::Register();
+}
+
+#if !SQLITE_UE_NATIVE_VFS
 
 // ============================================================================
 // = Perform additional initialization during sqlite3_initialize
@@ -27,7 +37,7 @@ THIRD_PARTY_INCLUDES_END
 
 /*extern "C"*/ SQLITE_API int sqlite3_os_init()
 {
-	FSQLiteFileFuncs::Register();
+	RegisterUnrealVfs();
 
 	return SQLITE_OK;
 }
@@ -38,20 +48,110 @@ THIRD_PARTY_INCLUDES_END
 
 /*extern "C"*/ SQLITE_API int sqlite3_os_end()
 {
+	FSQLiteFileFuncs::Shutdown();
+
 	return SQLITE_OK;
 }
 
+#endif
+
+// ============================================================================
+// = Initialize and shut down SQLite.
+// = Called from USqlite3Subsystem::InitializeSqlite and DeinitializeSqlite
+// ============================================================================
+
+int sqlite3_ue_initialize()
+{
+	const int Result = sqlite3_initialize();
+
+#if SQLITE_UE_NATIVE_VFS
+	// sqlite3_os_init is the one of the unix VFS, which makes "unix" the default: "unreal-fs" takes it back
+	if( Result == SQLITE_OK )
+	{
+		RegisterUnrealVfs();
+	}
+#endif
+
+	return Result;
+}
+
+int sqlite3_ue_shutdown()
+{
+#if SQLITE_UE_NATIVE_VFS
+	FSQLiteFileFuncs::Shutdown();
+#endif
+
+	return sqlite3_shutdown();
+}
+
 // ============================================================================
 // = Perform additional configuration before calling sqlite3_initialize.
 // = Called from USqlite3Subsystem::InitializeSqlite
 // ============================================================================
 
-int sqlite3_ue_config()
+int sqlite3_ue_config( const FSQLitePlatformConfig& InConfig )
 {
-	FSQLiteMallocFuncs::Register();
-	FSQLiteMutexFuncs::Register();
+	sqlite3_config( SQLITE_CONFIG_MEMSTATUS, InConfig.bMemStatus ? 1 : 0 );
+
+	FSQLiteMallocFuncs::Register( InConfig.bUseSlabAllocator, InConfig.SlabAllocatorRegionSize, !InConfig.bMemStatus );
+	FSQLiteMutexFuncs::Register( InConfig.bUseAdaptiveMutex );
+	FSQLiteFileFuncs::Configure( InConfig );
+	FSQLitePakFileFuncs::Configure( InConfig );
+
+	if( InConfig.bUseCustomPageCache )
+	{
+		FSQLitePageCacheFuncs::Register( InConfig.PageCacheBudget, InConfig.PageCacheReserve, InConfig.PageCacheSlabSize );
+	}
 	
 	return SQLITE_OK;
 }
 
+// ============================================================================
+// = Per-database file options.
+// = Called from USqliteDatabase::DoOpenSqliteDatabase
+// ============================================================================
+
+void sqlite3_ue_set_file_options( const FString& InDatabaseFilename, const FSQLiteFileOptions& InOptions )
+{
+	FSQLiteFileFuncs::SetFileOptions( InDatabaseFilename, InOptions );
+}
+
+// ============================================================================
+// = Durability barrier and window of the postponed WAL syncs.
+// = Called from USqliteDatabase::FlushDurable and GetDurabilityStats
+// ============================================================================
+
+int sqlite3_ue_flush_durable( const FString& InDatabaseFilename )
+{
+	return FSQLiteFileFuncs::FlushDurable( InDatabaseFilename ) ? SQLITE_OK : SQLITE_IOERR_FSYNC;
+}
+
+void sqlite3_ue_get_durability_window( const FString& InDatabaseFilename, FSQLiteDurabilityWindow& OutWindow )
+{
+	FSQLiteFileFuncs::GetDurabilityWindow( InDatabaseFilename, OutWindow );
+}
+
+// ============================================================================
+// = Per-thread context
+// ============================================================================
+
+FSQLiteThreadContext& FSQLiteThreadContext::Get()
+{
+	static thread_local FSQLiteThreadContext ThreadContext;
+	return ThreadContext;
+}
+
+FSQLiteThreadContextScope::FSQLiteThreadContextScope( FName InLLMTag, int32 InPageCachePriority )
+	: SavedContext( FSQLiteThreadContext::Get() )
+{
+	FSQLiteThreadContext& ThreadContext = FSQLiteThreadContext::Get();
+	ThreadContext.LLMTag = InLLMTag;
+	ThreadContext.PageCachePriority = InPageCachePriority;
+}
+
+FSQLiteThreadContextScope::~FSQLiteThreadContextScope()
+{
+	FSQLiteThreadContext::Get() = SavedContext;
+}
+
 #endif
@@ -1,5 +1,7 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
+#pragma once
+
 #if SQLITE_OS_OTHER
 
 #include "CoreTypes.h"
@@ -10,6 +12,7 @@
 #include "HAL/PlatformFileManager.h"
 #include "HAL/PlatformFile.h"
 #include "Templates/Atomic.h"
+#include "UObject/NameTypes.h"
 
 THIRD_PARTY_INCLUDES_START
 #include "sqlite/sqlite3.h-inline"
@@ -25,8 +28,156 @@ extern "C"
 
 }	// extern "C"
 
+// ============================================================================
+// = Platform configuration ===================================================
+// ============================================================================
+
+/** Settings for the Unreal platform layer, filled from USqlite3Subsystem config */
+struct FSQLitePlatformConfig
+{
+	/** Serve small SQLite allocations from the thread-caching slab allocator (see FSQLiteMallocFuncs) */
+	bool bUseSlabAllocator = false;
+
+	/** Bytes of address space reserved for the slab allocator */
+	int64 SlabAllocatorRegionSize = 256 * 1024 * 1024;
+
+	/**
+	 * Let SQLite keep its own memory statistics (SQLITE_CONFIG_MEMSTATUS). They are
+	 * updated under a global mutex; when off the malloc shim keeps them instead.
+	 */
+	bool bMemStatus = true;
+
+	/** Back SQLite mutexes with the adaptive spin-then-park lock instead of FCriticalSection */
+	bool bUseAdaptiveMutex = false;
+
+	/** Replace the SQLite default page cache with FSQLitePageCacheFuncs */
+	bool bUseCustomPageCache = false;
+
+	/** Bytes of page memory shared by all page caches (0 = unlimited) */
+	int64 PageCacheBudget = 0;
+
+	/** Bytes of page cache slabs to allocate up-front */
+	int64 PageCacheReserve = 0;
+
+	/** Size of a page cache slab in bytes */
+	int32 PageCacheSlabSize = 256 * 1024;
+
+	/** Back the WAL index with named shared memory so that other processes can use the same databases (see FSQLiteFileFuncs) */
+	bool bUseNamedSharedMemory = false;
+
+	/** Largest sequential read-ahead of a main database file in bytes (0 disables read-ahead) */
+	int32 ReadAheadMaxSize = 1024 * 1024;
+
+	/** Gather adjacent writes of database, journal and WAL files into larger writes */
+	bool bUseWriteCoalescing = false;
+
+	/** Largest coalesced write in bytes */
+	int32 WriteCoalescingMaxSize = 1024 * 1024;
+
+	/** Postpone WAL syncs to a flush window shared by all the databases (a power loss can lose the last window of commits) */
+	bool bRelaxedDurability = false;
+
+	/** Flush window of the postponed WAL syncs in milliseconds */
+	int32 SyncFlushWindowMs = 100;
+
+	/** Keep temporary files (temp databases, sorts, statement journals) in memory instead of on disk */
+	bool bUseMemoryTempFiles = false;
+
+	/** Size in bytes past which an in-memory temporary file moves to disk */
+	int64 MemoryTempFileSpillSize = 16 * 1024 * 1024;
+
+	/** Block size of the reads of packaged databases that can not be memory mapped (see FSQLitePakFileFuncs) */
+	int32 PakBlockSize = 64 * 1024;
+
+	/** Bytes of blocks cached for each packaged database */
+	int64 PakBlockCacheSize = 4 * 1024 * 1024;
+
+	/** Submission queue entries of the io_uring ring of each file of the "unreal-uring" VFS */
+	int32 IoUringQueueDepth = 64;
+};
+
 /** Perform additional configuration before calling sqlite3_initialize - called from FSQLiteCore::StartupModule (not a real SQLite API function) */
 
-int sqlite3_ue_config();
+int sqlite3_ue_config( const FSQLitePlatformConfig& InConfig );
+
+/** sqlite3_initialize and sqlite3_shutdown, plus the registration of the Unreal VFSes when the native unix VFS is compiled in (not real SQLite API functions) */
+
+int sqlite3_ue_initialize();
+int sqlite3_ue_shutdown();
+
+/** Per-database overrides of what the file system reports to SQLite */
+struct FSQLiteFileOptions
+{
+	/** Sector size in bytes, a power of two (0 = detected) */
+	int32 SectorSize = 0;
+
+	/** SQLITE_IOCAP_* flags (-1 = detected) */
+	int32 DeviceCharacteristics = -1;
+
+	/** Group durability: WAL syncs are postponed and done in the background every that many milliseconds (0 = every commit is synced) */
+	int32 GroupSyncIntervalMs = 0;
+
+	/** Group durability: sync before the interval once that many bytes were written to the WAL (0 = interval only) */
+	int64 GroupSyncBytes = 0;
+};
+
+/** Set the file options of a database before opening it - called from USqliteDatabase (not a real SQLite API function) */
+void sqlite3_ue_set_file_options( const FString& InDatabaseFilename, const FSQLiteFileOptions& InOptions );
+
+/** Commits of a database that are not on disk yet (relaxed or group durability) */
+struct FSQLiteDurabilityWindow
+{
+	int64 Commits = 0;
+
+	/** Bytes written to the WAL since the last sync */
+	int64 Bytes = 0;
+
+	/** Age of the oldest of those commits in milliseconds */
+	double AgeMs = 0.0;
+};
+
+/** Sync the postponed WAL syncs of a database now - called from USqliteDatabase (not a real SQLite API function) */
+int sqlite3_ue_flush_durable( const FString& InDatabaseFilename );
+
+/** Get the commits of a database that are not on disk yet - called from USqliteDatabase (not a real SQLite API function) */
+void sqlite3_ue_get_durability_window( const FString& InDatabaseFilename, FSQLiteDurabilityWindow& OutWindow );
+
+// ============================================================================
+// = Per-thread context used to attribute SQLite work to a database ===========
+// ============================================================================
+
+/**
+ * Describes the database the calling thread is currently working on.
+ * SQLite itself has no notion of "who" an allocation is for, so USqliteDatabase
+ * publishes this information around its calls into the library.
+ */
+struct FSQLiteThreadContext
+{
+	/** LLM tag to use for allocations (NAME_None means the shared Sqlite tag) */
+	FName LLMTag;
+
+	/** Eviction priority given to page caches created on this thread (higher is kept longer) */
+	int32 PageCachePriority = 0;
+
+	/** Get the context of the calling thread */
+	static FSQLiteThreadContext& Get();
+};
+
+/** Scoped override of the calling thread context */
+struct FSQLiteThreadContextScope
+{
+	FSQLiteThreadContextScope( FName InLLMTag, int32 InPageCachePriority );
+	~FSQLiteThreadContextScope();
+
+private:
+	FSQLiteThreadContext SavedContext;
+};
+
+#define SQLITE_DATABASE_SCOPE( Database ) \
+	FSQLiteThreadContextScope SqliteThreadContextScope( (Database)->LLMTag, (int32)(Database)->DatabaseInfoAsset->PageCachePriority )
+
+#else
+
+#define SQLITE_DATABASE_SCOPE( Database )
 
 #endif
@@ -3,6 +3,7 @@
 #if SQLITE_OS_OTHER
 
 #include "../../Sqlite3/Private/platform/file.h"
+#include "../../Sqlite3/Private/platform/uring.h"
 #include "Sqlite3Log.h"
 
 #include "CoreTypes.h"
@@ -13,53 +14,151 @@
 #include "HAL/PlatformFileManager.h"
 #include "HAL/PlatformFile.h"
 #include "Templates/Atomic.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformMemory.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "Misc/Crc.h"
+#include "HAL/PlatformTime.h"
 
 THIRD_PARTY_INCLUDES_START
 #include "sqlite/sqlite3.h-inline"
 THIRD_PARTY_INCLUDES_END
 
-/* ========================================================================= */
-/** Unreal implementation of an SQLite file (zeroed on init)                 */
-/* ========================================================================= */
+#if PLATFORM_LINUX
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/vfs.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#endif
+
+/* ========================================================================= *
+ * File functions used by SQLite (see sqlite3_io_methods and sqlite3_vfs)
+ * @note We have to make some concessions for things not exposed in the Unreal HAL that will affect multi-process concurrency (single-process access is not affected):
+ *   - Shared memory is heap-backed unless named shared memory is enabled (see Configure) and implemented by the platform (see MapNamedSharedMemoryRegion);
+ *     its lock slots are fcntl locks on Linux, elsewhere atomic words in that memory which a process that dies while holding one leaves held for the other processes
+ *   - File locks are arbitrated between the connections of the process by a lock table; other processes only see them where the platform has byte-range locks (fcntl on Linux)
+ * ========================================================================= */
+
+bool FSQLiteFileFuncs::bUseNamedSharedMemory = false;
+int32 FSQLiteFileFuncs::ReadAheadMaxSize = 1024 * 1024;
+bool FSQLiteFileFuncs::bUseWriteCoalescing = false;
+int32 FSQLiteFileFuncs::WriteCoalescingMaxSize = 1024 * 1024;
+bool FSQLiteFileFuncs::bRelaxedDurability = false;
+int32 FSQLiteFileFuncs::SyncFlushWindowMs = 100;
+bool FSQLiteFileFuncs::bUseMemoryTempFiles = false;
+int64 FSQLiteFileFuncs::MemoryTempFileSpillSize = 16 * 1024 * 1024;
+int32 FSQLiteFileFuncs::IoUringQueueDepth = 64;
+
+FCriticalSection FSQLiteFileFuncs::DeferredSyncSection;
+TSet<FSQLiteFile*> FSQLiteFileFuncs::DeferredSyncFiles;
+TSet<FSQLiteFile*> FSQLiteFileFuncs::SyncingFiles;
+TMultiMap<FSQLiteFile*, FEvent*> FSQLiteFileFuncs::SyncWaiters;
+FSQLiteSyncFlusher* FSQLiteFileFuncs::SyncFlusher = nullptr;
+
+FCriticalSection FSQLiteFileFuncs::ShmNodesSection;
+TMap<FString, FSQLiteShmNode*> FSQLiteFileFuncs::ShmNodes;
+
+FCriticalSection FSQLiteFileFuncs::LockNodesSection;
+TMap<FString, FSQLiteLockNode*> FSQLiteFileFuncs::LockNodes;
+
+#if !PLATFORM_LINUX
+FCriticalSection FSQLiteFileFuncs::SharedHandleNodesSection;
+TMap<FString, FSQLiteSharedHandleNode*> FSQLiteFileFuncs::SharedHandleNodes;
+#endif
 
-FCriticalSection FSQLiteFile::CurrentlyOpenAsReadOnlySection;
-TSet<FString> FSQLiteFile::CurrentlyOpenAsReadOnly;
+FSQLiteIoStats FSQLiteFileFuncs::FileTypeIoStats[(int32)ESQLiteFileType::Count];
 
-bool FSQLiteFile::AllowOpenAsReadOnly(const TCHAR* InFilename)
+FCriticalSection FSQLiteFileFuncs::OpenFilesSection;
+TArray<FSQLiteFile*> FSQLiteFileFuncs::OpenFiles;
+
+FCriticalSection FSQLiteFileFuncs::FileOptionsSection;
+TMap<FString, FSQLiteFileOptions> FSQLiteFileFuncs::FileOptions;
+
+/** Exclusive bit of a shared memory lock word, the other bits count the shared locks */
+static constexpr uint32 ShmExclusiveLock = 0x80000000u;
+
+/** Lock bytes, the same as the SQLite OS layers so that the native VFS of other processes sees our locks */
+static constexpr int64 LockPendingByte = 0x40000000;
+static constexpr int64 LockReservedByte = LockPendingByte + 1;
+static constexpr int64 LockSharedFirst = LockPendingByte + 2;
+static constexpr int64 LockSharedSize = 510;
+
+/** Read-ahead starts once that many reads followed each other, with a window of at least ReadAheadMinSize bytes */
+static constexpr int32 ReadAheadMinSequentialReads = 2;
+static constexpr int32 ReadAheadMinSize = 64 * 1024;
+
+/** Holds the write-behind critical section of a file, if it has one */
+struct FSQLiteWriteBehindScope
 {
-	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
-	FString CanonFilename = PlatformFile.GetFilenameOnDisk(InFilename);
+	explicit FSQLiteWriteBehindScope( FSQLiteFile* InFile )
+		: CriticalSection( InFile->WriteBehind ? &InFile->WriteBehind->CriticalSection : nullptr )
+	{
+		if (CriticalSection)
+		{
+			CriticalSection->Lock();
+		}
+	}
 
-	// for consistency's sake we try our best to enforce only opening each file _once_
-	//  if we open for write we obtain a lock to the file, but not for read-only
-	//  instead implement a tracking list of files that have been opened
+	~FSQLiteWriteBehindScope()
+	{
+		if (CriticalSection)
+		{
+			CriticalSection->Unlock();
+		}
+	}
 
-	bool bIsAlreadyInSet = false;
-	FScopeLock Lock(&CurrentlyOpenAsReadOnlySection);
-	bool bAdded = CurrentlyOpenAsReadOnly.Add(CanonFilename, &bIsAlreadyInSet).IsValidId();
-	check(bAdded);
+private:
+	FCriticalSection* CriticalSection;
+};
 
-	// only succeed if we were the call to add it to the set
-	return !bIsAlreadyInSet;
-}
+struct FSQLiteFileFuncs::FIoScope
+{
+	FIoScope( FSQLiteFile* InFile, ESQLiteIoOp InOp, int64 InBytes )
+		: File( InFile )
+		, Op( InOp )
+		, Bytes( InBytes )
+		, StartCycles( FPlatformTime::Cycles64() )
+	{
+	}
+
+	~FIoScope()
+	{
+		RecordIo(File, Op, Bytes, StartCycles);
+	}
+
+private:
+	FSQLiteFile* File;
+	ESQLiteIoOp Op;
+	int64 Bytes;
+	uint64 StartCycles;
+};
 
-void FSQLiteFile::CloseAsReadOnly(const TCHAR* InFilename)
+/** Kind of a file from the flags given to Open */
+static ESQLiteFileType GetFileType( int InFlags )
 {
-	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
-	FString CanonFilename = PlatformFile.GetFilenameOnDisk(InFilename);
-	FScopeLock Lock(&CurrentlyOpenAsReadOnlySection);
-	int32 NumRemoved = CurrentlyOpenAsReadOnly.Remove(CanonFilename);
-	check(NumRemoved > 0);
+	if (InFlags & SQLITE_OPEN_MAIN_DB)
+	{
+		return ESQLiteFileType::MainDatabase;
+	}
+	if (InFlags & (SQLITE_OPEN_MAIN_JOURNAL | SQLITE_OPEN_SUPER_JOURNAL))
+	{
+		return ESQLiteFileType::Journal;
+	}
+	if (InFlags & SQLITE_OPEN_WAL)
+	{
+		return ESQLiteFileType::Wal;
+	}
+	if (InFlags & (SQLITE_OPEN_TEMP_DB | SQLITE_OPEN_TRANSIENT_DB | SQLITE_OPEN_TEMP_JOURNAL | SQLITE_OPEN_SUBJOURNAL))
+	{
+		return ESQLiteFileType::Temp;
+	}
+	return ESQLiteFileType::Other;
 }
 
-/* ========================================================================= *
- * File functions used by SQLite (see sqlite3_io_methods and sqlite3_vfs)
- * @note We have to make some concessions for things not exposed in the Unreal HAL that will affect multi-process concurrency (single-process access is not affected):
- *   - We do not provide an implementation for shared memory (mmap) as not all platforms implement it (see MapNamedSharedMemoryRegion and UnmapNamedSharedMemoryRegion)
- *   - We do not provide an implementation for granular file locks as our HAL doesn't expose the concept; instead we always take a writable handle for all file opens to prevent concurrent writes
- * ========================================================================= */
-
-/** Register the file system */
+/** Register the file system, and its io_uring variant where the platform has it */
 void FSQLiteFileFuncs::Register()
 {
 	static sqlite3_vfs VFSFuncs = {
@@ -88,13 +187,259 @@ void FSQLiteFileFuncs::Register()
 	};
 
 	sqlite3_vfs_register( &VFSFuncs, 1 );
+
+#if SQLITE_UE_IO_URING
+	// Same files, Open tells them apart by the application data
+	static sqlite3_vfs UringVFSFuncs = VFSFuncs;
+	UringVFSFuncs.zName = "unreal-uring";
+	UringVFSFuncs.pAppData = &UringVFSFuncs;
+	sqlite3_vfs_register( &UringVFSFuncs, 0 );
+#endif
+
+	if (bRelaxedDurability)
+	{
+		StartSyncFlusher();
+	}
+}
+
+/** Configure the file system (named shared memory, read-ahead, write coalescing, durability, temporary files, io_uring) */
+void FSQLiteFileFuncs::Configure( const FSQLitePlatformConfig& InConfig )
+{
+	bUseNamedSharedMemory = InConfig.bUseNamedSharedMemory;
+	ReadAheadMaxSize = FMath::Max(InConfig.ReadAheadMaxSize, 0);
+	bUseWriteCoalescing = InConfig.bUseWriteCoalescing && InConfig.WriteCoalescingMaxSize > 0;
+	WriteCoalescingMaxSize = FMath::Max(InConfig.WriteCoalescingMaxSize, 0);
+	bRelaxedDurability = InConfig.bRelaxedDurability;
+	SyncFlushWindowMs = FMath::Max(InConfig.SyncFlushWindowMs, 1);
+	bUseMemoryTempFiles = InConfig.bUseMemoryTempFiles;
+	MemoryTempFileSpillSize = FMath::Max<int64>(InConfig.MemoryTempFileSpillSize, 0);
+	IoUringQueueDepth = FMath::Clamp(InConfig.IoUringQueueDepth, 2, 4096);
+}
+
+/** Stop the sync flusher, syncing whatever it still had to - called from sqlite3_os_end */
+void FSQLiteFileFuncs::Shutdown()
+{
+	StopSyncFlusher();
+
+	FlushDeferredSyncs();
+}
+
+/** Start the sync flusher unless it is running */
+void FSQLiteFileFuncs::StartSyncFlusher()
+{
+	FScopeLock Lock(&DeferredSyncSection);
+
+	if (!SyncFlusher)
+	{
+		SyncFlusher = new FSQLiteSyncFlusher(SyncFlushWindowMs);
+	}
+}
+
+/** Stop the sync flusher if it is running */
+void FSQLiteFileFuncs::StopSyncFlusher()
+{
+	FSQLiteSyncFlusher* StoppedFlusher;
+	{
+		FScopeLock Lock(&DeferredSyncSection);
+
+		StoppedFlusher = SyncFlusher;
+		SyncFlusher = nullptr;
+	}
+
+	// Deleted outside of the lock, the flusher takes it until its thread is joined
+	delete StoppedFlusher;
+}
+
+/** Sync every WAL file whose sync was postponed (relaxed or group durability) */
+void FSQLiteFileFuncs::FlushDeferredSyncs()
+{
+	TArray<FSQLiteFile*> Files;
+	{
+		FScopeLock Lock(&DeferredSyncSection);
+
+		Files = DeferredSyncFiles.Array();
+		SyncingFiles.Append(Files);
+		DeferredSyncFiles.Reset();
+	}
+
+	SyncTakenFiles(Files);
+}
+
+/** Sync the postponed WAL syncs that are due, returns the milliseconds until the next one is - called from the sync flusher */
+int32 FSQLiteFileFuncs::FlushDueSyncs()
+{
+	const double Now = FPlatformTime::Seconds();
+	int32 NextDueMs = SyncFlushWindowMs;
+
+	// The due files are taken under the lock and synced without it, so that the syncs of other databases do not wait for them
+	TArray<FSQLiteFile*> DueFiles;
+	{
+		FScopeLock Lock(&DeferredSyncSection);
+
+		for (auto It = DeferredSyncFiles.CreateIterator(); It; ++It)
+		{
+			FSQLiteFile* File = *It;
+
+			// Group durability databases have their own interval and byte threshold, the others use the flush window
+			const int32 IntervalMs = File->GroupSyncIntervalMs > 0 ? File->GroupSyncIntervalMs : SyncFlushWindowMs;
+			{
+				FSQLiteWriteBehindScope WriteBehindScope(File);
+
+				const int32 PendingMs = (int32)((Now - File->WriteBehind->UnsyncedSince) * 1000.0);
+				const bool bBytesDue = File->GroupSyncBytes > 0 && File->WriteBehind->UnsyncedBytes >= File->GroupSyncBytes;
+				if (PendingMs < IntervalMs && !bBytesDue)
+				{
+					NextDueMs = FMath::Min(NextDueMs, IntervalMs - PendingMs);
+					continue;
+				}
+			}
+
+			DueFiles.Add(File);
+			SyncingFiles.Add(File);
+			It.RemoveCurrent();
+		}
+	}
+
+	SyncTakenFiles(DueFiles);
+
+	return NextDueMs;
+}
+
+/** Sync the postponed WAL syncs of a database (durability barrier) */
+bool FSQLiteFileFuncs::FlushDurable( const FString& InDatabaseFilename )
+{
+	FSQLiteLockNode* Node = FindLockNode(FPaths::ConvertRelativePathToFull(InDatabaseFilename));
+	if (!Node)
+	{
+		return true;
+	}
+
+	const bool bSynced = SyncCompanionFiles(Node);
+	ReleaseLockNode(Node);
+
+	return bSynced;
+}
+
+/** Get the commits of a database whose WAL sync was postponed */
+void FSQLiteFileFuncs::GetDurabilityWindow( const FString& InDatabaseFilename, FSQLiteDurabilityWindow& OutWindow )
+{
+	OutWindow = FSQLiteDurabilityWindow();
+
+	FSQLiteLockNode* Node = FindLockNode(FPaths::ConvertRelativePathToFull(InDatabaseFilename));
+	if (!Node)
+	{
+		return;
+	}
+
+	{
+		FScopeLock Lock(&Node->CriticalSection);
+
+		const double Now = FPlatformTime::Seconds();
+		for (FSQLiteFile* Companion : Node->CompanionFiles)
+		{
+			FSQLiteWriteBehindScope WriteBehindScope(Companion);
+
+			const FSQLiteWriteBehind* WriteBehind = Companion->WriteBehind;
+			if (WriteBehind->UnsyncedCommits > 0)
+			{
+				OutWindow.Commits += WriteBehind->UnsyncedCommits;
+				OutWindow.Bytes += WriteBehind->UnsyncedBytes;
+				OutWindow.AgeMs = FMath::Max(OutWindow.AgeMs, (Now - WriteBehind->UnsyncedSince) * 1000.0);
+			}
+		}
+	}
+
+	ReleaseLockNode(Node);
+}
+
+/** Get the I/O statistics of each kind of file since startup, closed files included */
+void FSQLiteFileFuncs::GetFileTypeIoStats( TArray<FSQLiteIoStatsSnapshot>& OutStats )
+{
+	OutStats.SetNum((int32)ESQLiteFileType::Count);
+
+	for (int32 FileType = 0; FileType < (int32)ESQLiteFileType::Count; FileType++)
+	{
+		OutStats[FileType].FileType = (ESQLiteFileType)FileType;
+		SnapshotIoStats(FileTypeIoStats[FileType], OutStats[FileType]);
+	}
+}
+
+/** Get the I/O statistics of each open file */
+void FSQLiteFileFuncs::GetOpenFileIoStats( TArray<FSQLiteIoStatsSnapshot>& OutStats )
+{
+	FScopeLock Lock(&OpenFilesSection);
+
+	OutStats.SetNum(OpenFiles.Num());
+
+	for (int32 Index = 0; Index < OpenFiles.Num(); Index++)
+	{
+		OutStats[Index].Filename = OpenFiles[Index]->Filename;
+		OutStats[Index].FileType = OpenFiles[Index]->FileType;
+		SnapshotIoStats(OpenFiles[Index]->IoStats, OutStats[Index]);
+	}
+}
+
+/** Add an operation to the I/O statistics of a file and of its kind */
+void FSQLiteFileFuncs::RecordIo(FSQLiteFile* InFile, ESQLiteIoOp InOp, int64 InBytes, uint64 InStartCycles)
+{
+	const int64 Microseconds = (int64)(FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - InStartCycles) * 1000000.0);
+	const int32 Bucket = Microseconds > 0 ? FMath::Min<int32>(FMath::FloorLog2_64((uint64)Microseconds) + 1, SQLiteIoLatencyBucketCount - 1) : 0;
+
+	for (FSQLiteIoOpStats* OpStats : { &InFile->IoStats.Ops[(int32)InOp], &FileTypeIoStats[(int32)InFile->FileType].Ops[(int32)InOp] })
+	{
+		OpStats->Count.fetch_add(1, std::memory_order_relaxed);
+		OpStats->Bytes.fetch_add(InBytes, std::memory_order_relaxed);
+		OpStats->TotalMicroseconds.fetch_add(Microseconds, std::memory_order_relaxed);
+		OpStats->LatencyHistogram[Bucket].fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void FSQLiteFileFuncs::SnapshotIoStats(const FSQLiteIoStats& InStats, FSQLiteIoStatsSnapshot& OutSnapshot)
+{
+	for (int32 Op = 0; Op < (int32)ESQLiteIoOp::Count; Op++)
+	{
+		const FSQLiteIoOpStats& OpStats = InStats.Ops[Op];
+		FSQLiteIoStatsSnapshot::FOp& OpSnapshot = OutSnapshot.Ops[Op];
+
+		OpSnapshot.Count = OpStats.Count.load(std::memory_order_relaxed);
+		OpSnapshot.Bytes = OpStats.Bytes.load(std::memory_order_relaxed);
+		OpSnapshot.TotalMicroseconds = OpStats.TotalMicroseconds.load(std::memory_order_relaxed);
+
+		for (int32 Bucket = 0; Bucket < SQLiteIoLatencyBucketCount; Bucket++)
+		{
+			OpSnapshot.LatencyHistogram[Bucket] = OpStats.LatencyHistogram[Bucket].load(std::memory_order_relaxed);
+		}
+	}
+}
+
+/** Set the sector size and device characteristics overrides of a database, its journal and its WAL */
+void FSQLiteFileFuncs::SetFileOptions( const FString& InDatabaseFilename, const FSQLiteFileOptions& InOptions )
+{
+	const FString AbsoluteFilename = FPaths::ConvertRelativePathToFull(InDatabaseFilename);
+
+	// The flusher is only started by Register for relaxed durability
+	if (InOptions.GroupSyncIntervalMs > 0)
+	{
+		StartSyncFlusher();
+	}
+
+	FScopeLock Lock(&FileOptionsSection);
+
+	if (InOptions.SectorSize > 0 || InOptions.DeviceCharacteristics >= 0 || InOptions.GroupSyncIntervalMs > 0)
+	{
+		FileOptions.Add(AbsoluteFilename, InOptions);
+	}
+	else
+	{
+		FileOptions.Remove(AbsoluteFilename);
+	}
 }
 
 /** Attempt to open a file */
 int FSQLiteFileFuncs::Open( sqlite3_vfs* InVFS, const char* InFilename, sqlite3_file* InFile, int InFlags, int* OutFlagsPtr )
 {
 	static const sqlite3_io_methods FileFuncs = {
-		1,	/** Version 1, no shared memory support */
+		3,	/** Version 3, shared memory and memory mapped reads */
 		&Close,
 		&Read,
 		&Write,
@@ -107,6 +452,12 @@ int FSQLiteFileFuncs::Open( sqlite3_vfs* InVFS, const char* InFilename, sqlite3_
 		&FileControl,
 		&SectorSize,
 		&DeviceCharacteristics,
+		&ShmMap,
+		&ShmLock,
+		&ShmBarrier,
+		&ShmUnmap,
+		&Fetch,
+		&Unfetch,
 	};
 
 	FSQLiteFile* File = (FSQLiteFile*)InFile;
@@ -114,6 +465,9 @@ int FSQLiteFileFuncs::Open( sqlite3_vfs* InVFS, const char* InFilename, sqlite3_
 
 	// Zero the file descriptor so it has valid data for the early return cases
 	FMemory::Memzero(*File);
+#if PLATFORM_LINUX
+	File->NativeFd = -1;
+#endif
 
 	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
 
@@ -124,8 +478,12 @@ int FSQLiteFileFuncs::Open( sqlite3_vfs* InVFS, const char* InFilename, sqlite3_
 	}
 	else
 	{
+		// The directory is created by the first file that needs it when temporary files are kept in memory (see FSQLiteMemoryFileHandle::Spill)
 		static const FString TmpPath = FPaths::ProjectIntermediateDir() / TEXT("SQLite");
-		PlatformFile.CreateDirectory(*TmpPath);
+		if (!bUseMemoryTempFiles)
+		{
+			PlatformFile.CreateDirectory(*TmpPath);
+		}
 		File->Filename = FPaths::CreateTempFilename(*TmpPath);
 	}
 
@@ -145,29 +503,22 @@ int FSQLiteFileFuncs::Open( sqlite3_vfs* InVFS, const char* InFilename, sqlite3_
 		return SQLITE_IOERR;
 	}
 
-	// Stat the file to fetch its write-ability.
-	File->bIsReadOnly = PlatformFile.IsReadOnly(*File->Filename);
-	if (!File->bIsReadOnly)
+	// Read-only connections only take a read handle so that other connections can write, the locks arbitrate the access
+	File->bIsReadOnly = (InFlags & SQLITE_OPEN_READONLY) || PlatformFile.IsReadOnly(*File->Filename);
+	const bool bMemoryFile = !InFilename && bUseMemoryTempFiles && !File->bIsReadOnly;
+	if (bMemoryFile)
 	{
-		// The Unreal HAL doesn't support granular file locking so we always obtain a write handle to any file regardless of what SQLite asked for
-		// This prevents concurrent access to the files and makes the locking operations a no-op (though we still track the requested lock mode)
-		File->FileHandle = PlatformFile.OpenWrite(*File->Filename, /*bAppend*/true, /*bAllowRead*/true);
+		// Temporary files live in memory until they grow past the spill size, the temporary filename is only used from then on
+		File->FileHandle = new FSQLiteMemoryFileHandle(File->Filename, MemoryTempFileSpillSize);
 	}
-	else if (InFlags & SQLITE_OPEN_READONLY)
+	else if (!File->bIsReadOnly)
 	{
-		if (FSQLiteFile::AllowOpenAsReadOnly(*File->Filename))
-		{
-			// If we are unable to open for write, the file could be stored in a read-only way (Pak)
-			// If we only require read access, attempt to open the in read-only mode
-			// This assumes there won't be any contention (it's impossible to open for write)
-			File->FileHandle = PlatformFile.OpenRead(*File->Filename);
-
-			// Our open operation failed for a reason, make sure to keep bookkeeping up to date
-			if (!File->FileHandle)
-			{
-				FSQLiteFile::CloseAsReadOnly(*File->Filename);
-			}
-		}
+		File->FileHandle = OpenWriteHandle(File, InFlags);
+	}
+	else
+	{
+		// The file could also be stored in a read-only way (Pak), SQLite is told through the output flags
+		File->FileHandle = PlatformFile.OpenRead(*File->Filename, /*bAllowWrite*/true);
 	}
 
 	if (File->FileHandle)
@@ -176,12 +527,111 @@ int FSQLiteFileFuncs::Open( sqlite3_vfs* InVFS, const char* InFilename, sqlite3_
 	}
 	else
 	{
+		if (File->LockNode)
+		{
+			ReleaseLockNode(File->LockNode);
+			File->LockNode = nullptr;
+		}
 		return SQLITE_IOERR;
 	}
 
 	// Opened the file - fill in the rest of the data
 	File->IOMethods = &FileFuncs;
+	File->OpenFlags = InFlags;
 	File->bDeleteOnClose = !!(InFlags & SQLITE_OPEN_DELETEONCLOSE);
+	File->FileType = GetFileType(InFlags);
+
+	// Only the main database is ever locked or memory mapped by SQLite, and table scans only read it
+	if (InFlags & SQLITE_OPEN_MAIN_DB)
+	{
+		// Writers attach to the lock table when they open their handle (see OpenWriteHandle)
+		if (!File->LockNode)
+		{
+			AcquireLockNode(File);
+		}
+		File->Mapping = new FSQLiteFileMapping();
+
+		if (ReadAheadMaxSize > 0)
+		{
+			File->ReadAhead = new FSQLiteReadAhead();
+		}
+	}
+
+	// Overrides of the database apply to its journal and WAL as well
+	FSQLiteFileOptions Options;
+	if (InFilename && (InFlags & (SQLITE_OPEN_MAIN_DB | SQLITE_OPEN_MAIN_JOURNAL | SQLITE_OPEN_WAL)))
+	{
+		FScopeLock Lock(&FileOptionsSection);
+
+		if (const FSQLiteFileOptions* DatabaseOptions = FileOptions.Find(FPaths::ConvertRelativePathToFull(UTF8_TO_TCHAR(sqlite3_filename_database(InFilename)))))
+		{
+			Options = *DatabaseOptions;
+		}
+	}
+
+	File->GroupSyncIntervalMs = FMath::Max(Options.GroupSyncIntervalMs, 0);
+	File->GroupSyncBytes = FMath::Max<int64>(Options.GroupSyncBytes, 0);
+
+	// Journal and WAL writes can be coalesced, and WAL syncs postponed, as long as the database flushes them before it changes hands
+	// The writes queued on the io_uring ring of a file are flushed at the same points as the write-behind buffer
+	const bool bCoalescedFile = bUseWriteCoalescing && (InFlags & (SQLITE_OPEN_MAIN_DB | SQLITE_OPEN_MAIN_JOURNAL | SQLITE_OPEN_WAL));
+	const bool bDeferredSyncFile = HasDeferredSyncs(File) && (InFlags & SQLITE_OPEN_WAL);
+	const bool bUringFile = SQLITE_UE_IO_URING && InVFS->pAppData != nullptr && !bMemoryFile;
+	if (!File->bIsReadOnly && (bCoalescedFile || bDeferredSyncFile || bUringFile))
+	{
+		File->WriteBehind = new FSQLiteWriteBehind();
+
+		if (InFilename && (InFlags & (SQLITE_OPEN_MAIN_JOURNAL | SQLITE_OPEN_WAL)))
+		{
+			File->DatabaseNode = FindLockNode(FPaths::ConvertRelativePathToFull(UTF8_TO_TCHAR(sqlite3_filename_database(InFilename))));
+			if (File->DatabaseNode)
+			{
+				FScopeLock Lock(&File->DatabaseNode->CriticalSection);
+				File->DatabaseNode->CompanionFiles.Add(File);
+			}
+		}
+	}
+
+#if PLATFORM_LINUX
+	// Positional I/O, writers opened their descriptor with their handle (see OpenWriteHandle)
+	// Readers of the main database share the descriptor its locks are taken on (see CloseFileHandle)
+	if (File->NativeFd < 0 && File->bIsReadOnly)
+	{
+		if (File->LockNode)
+		{
+			File->NativeFd = File->LockNode->LockFd;
+		}
+		else
+		{
+			File->NativeFd = open(TCHAR_TO_UTF8(*FPaths::ConvertRelativePathToFull(File->Filename)), O_RDONLY | O_CLOEXEC);
+			File->bOwnsNativeFd = File->NativeFd >= 0;
+		}
+	}
+
+#if SQLITE_UE_IO_URING
+	// Without a ring (old kernel, io_uring disabled) the file uses positional I/O like any other
+	if (bUringFile && File->NativeFd >= 0)
+	{
+		File->Uring = FSQLiteIoUring::Create(File->NativeFd, IoUringQueueDepth);
+	}
+#endif
+#endif
+
+	DetectDeviceProperties(File);
+
+	if (Options.SectorSize > 0)
+	{
+		File->SectorSize = Options.SectorSize;
+	}
+	if (Options.DeviceCharacteristics >= 0)
+	{
+		File->DeviceCharacteristics = SQLITE_IOCAP_UNDELETABLE_WHEN_OPEN | Options.DeviceCharacteristics;
+	}
+
+	{
+		FScopeLock Lock(&OpenFilesSection);
+		OpenFiles.Add(File);
+	}
 
 	// Set-up the output flags
 	if (OutFlagsPtr)
@@ -202,15 +652,86 @@ int FSQLiteFileFuncs::Close(sqlite3_file* InFile)
 	check(File && File->FileHandle);
 
 	UE_LOG( LogSqlite, Log, TEXT(" ---> FSQLiteFileFuncs::Close [%s]"), *File->Filename);
-	
-	// Make sure to bookeep our special read-only file list
-	if (File->bIsReadOnly)
+
+	{
+		FScopeLock Lock(&OpenFilesSection);
+		OpenFiles.RemoveSingleSwap(File);
+	}
+
+	Unlock(InFile, SQLITE_LOCK_NONE);
+
+	if (File->WriteBehind)
+	{
+		SyncIfDeferred(File);
+
+		if (File->DatabaseNode)
+		{
+			{
+				FScopeLock Lock(&File->DatabaseNode->CriticalSection);
+				File->DatabaseNode->CompanionFiles.Remove(File);
+			}
+			ReleaseLockNode(File->DatabaseNode);
+			File->DatabaseNode = nullptr;
+		}
+
+		{
+			FSQLiteWriteBehindScope WriteBehindScope(File);
+			FlushWriteBehind(File);
+		}
+
+		FMemory::Free(File->WriteBehind->Buffer);
+		delete File->WriteBehind;
+		File->WriteBehind = nullptr;
+	}
+
+	if (File->Mapping)
+	{
+		UnmapFile(File);
+		delete File->Mapping;
+		File->Mapping = nullptr;
+	}
+
+	// SQLite unmaps before closing, this only catches connections that failed half-way
+	if (File->Shm)
+	{
+		ShmUnmap(InFile, 0);
+	}
+
+	UE_LOG( LogSqlite, Verbose, TEXT("I/O [%s]: %lld reads (%lld bytes, %lld short), %lld read-ahead hits, %lld read-ahead fills (%lld bytes), %lld writes (%lld bytes, %lld issued), %lld syncs (%lld deferred)"),
+		*File->Filename,
+		File->IoStats.Ops[(int32)ESQLiteIoOp::Read].Count.load(), File->IoStats.Ops[(int32)ESQLiteIoOp::Read].Bytes.load(), File->Counters.ShortReads,
+		File->Counters.ReadAheadHits, File->Counters.ReadAheadFills, File->Counters.BytesReadAhead,
+		File->IoStats.Ops[(int32)ESQLiteIoOp::Write].Count.load(), File->IoStats.Ops[(int32)ESQLiteIoOp::Write].Bytes.load(), File->Counters.IssuedWrites,
+		File->IoStats.Ops[(int32)ESQLiteIoOp::Sync].Count.load(), File->Counters.DeferredSyncs );
+
+	if (File->ReadAhead)
+	{
+		FMemory::Free(File->ReadAhead->Buffer);
+		delete File->ReadAhead;
+		File->ReadAhead = nullptr;
+	}
+
+#if PLATFORM_LINUX
+#if SQLITE_UE_IO_URING
+	delete File->Uring;
+	File->Uring = nullptr;
+#endif
+
+	if (File->bOwnsNativeFd)
 	{
-		FSQLiteFile::CloseAsReadOnly(*File->Filename);
+		close(File->NativeFd);
 	}
+	File->NativeFd = -1;
+#endif
 
 	// Deleting the handle instance closes the file
-	delete File->FileHandle;
+	CloseFileHandle(File);
+
+	if (File->LockNode)
+	{
+		ReleaseLockNode(File->LockNode);
+		File->LockNode = nullptr;
+	}
 
 	// Should we also delete it?
 	if (File->bDeleteOnClose)
@@ -228,22 +749,34 @@ int FSQLiteFileFuncs::Read(sqlite3_file* InFile, void* OutBuffer, int InReadAmou
 	FSQLiteFile* File = (FSQLiteFile*)InFile;
 	check(File && File->FileHandle);
 
-	// Zero the buffer first in-case of a short read
-	FMemory::Memzero(OutBuffer, InReadAmountBytes);
+	FIoScope IoScope(File, ESQLiteIoOp::Read, InReadAmountBytes);
+
+	if (File->WriteBehind)
+	{
+		FSQLiteWriteBehindScope WriteBehindScope(File);
+		if (!FlushWriteBehind(File))
+		{
+			return SQLITE_IOERR_WRITE;
+		}
+	}
+
+	if (File->ReadAhead && ReadFromReadAhead(File, (uint8*)OutBuffer, InReadAmountBytes, InReadOffsetBytes))
+	{
+		return SQLITE_OK;
+	}
 
-	if (!File->FileHandle->Seek(InReadOffsetBytes))
+	int64 BytesRead = 0;
+	if (!ReadAt(File, (uint8*)OutBuffer, InReadAmountBytes, InReadOffsetBytes, BytesRead))
 	{
-		return SQLITE_IOERR_SEEK;
+		return SQLITE_IOERR_READ;
 	}
 
-	if (!File->FileHandle->Read((uint8*)OutBuffer, InReadAmountBytes))
+	// SQLite expects the missing part of a short read to be zeroed
+	if (BytesRead < InReadAmountBytes)
 	{
-		// Did this read fail because it ran out of data?
-		const int64 CurrentReadPosition = File->FileHandle->Tell();
-		const int64 CurrentFileSize = File->FileHandle->Size();
-		return CurrentReadPosition >= CurrentFileSize
-			? SQLITE_IOERR_SHORT_READ
-			: SQLITE_IOERR_READ;
+		FMemory::Memzero((uint8*)OutBuffer + BytesRead, InReadAmountBytes - BytesRead);
+		File->Counters.ShortReads++;
+		return SQLITE_IOERR_SHORT_READ;
 	}
 
 	return SQLITE_OK;
@@ -255,25 +788,505 @@ int FSQLiteFileFuncs::Write(sqlite3_file* InFile, const void* InBuffer, int InWr
 	FSQLiteFile* File = (FSQLiteFile*)InFile;
 	check(File && File->FileHandle);
 
-	if (!File->FileHandle->Seek(InWriteOffsetBytes))
-	{
-		return SQLITE_IOERR_SEEK;
+	FIoScope IoScope(File, ESQLiteIoOp::Write, InWriteAmountBytes);
+
+	InvalidateReadAhead(File);
+
+	// A checkpoint must not overwrite database pages before the WAL frames they come from are on disk
+	if (HasDeferredSyncs(File) && File->LockNode && !SyncCompanionFiles(File->LockNode))
+	{
+		return SQLITE_IOERR_FSYNC;
+	}
+
+	FSQLiteWriteBehindScope WriteBehindScope(File);
+
+	// Size of the window a power loss can lose
+	if (File->WriteBehind && HasDeferredSyncs(File) && (File->OpenFlags & SQLITE_OPEN_WAL))
+	{
+		File->WriteBehind->UnsyncedBytes += InWriteAmountBytes;
+	}
+
+#if SQLITE_UE_IO_URING
+	// Queued until the next sync submits them with it, main database writes are submitted right away unless we own the database
+	if (File->Uring)
+	{
+		if (!File->Uring->QueueWrite((const uint8*)InBuffer, InWriteAmountBytes, InWriteOffsetBytes))
+		{
+			return SQLITE_IOERR_WRITE;
+		}
+
+		if (File->LockNode && File->LockMode < SQLITE_LOCK_RESERVED && !FlushWriteBehind(File))
+		{
+			return SQLITE_IOERR_WRITE;
+		}
+
+		return SQLITE_OK;
+	}
+#endif
+
+	// Main database writes are only held back while we own the database (not during WAL checkpoints)
+	FSQLiteWriteBehind* WriteBehind = File->WriteBehind;
+	const bool bCoalesce = WriteBehind && bUseWriteCoalescing && InWriteAmountBytes < WriteCoalescingMaxSize
+		&& (!File->LockNode || File->LockMode >= SQLITE_LOCK_RESERVED);
+
+	if (WriteBehind && WriteBehind->BufferSize > 0)
+	{
+		const bool bAdjacent = InWriteOffsetBytes == WriteBehind->BufferOffset + WriteBehind->BufferSize;
+		if (!bCoalesce || !bAdjacent || WriteBehind->BufferSize + InWriteAmountBytes > WriteCoalescingMaxSize)
+		{
+			if (!FlushWriteBehind(File))
+			{
+				return SQLITE_IOERR_WRITE;
+			}
+		}
+	}
+
+	if (!bCoalesce)
+	{
+		return WriteAt(File, (const uint8*)InBuffer, InWriteAmountBytes, InWriteOffsetBytes) ? SQLITE_OK : SQLITE_IOERR_WRITE;
+	}
+
+	if (WriteBehind->BufferCapacity < WriteCoalescingMaxSize)
+	{
+		LLM_SCOPE_BYNAME( TEXT( "Sqlite/WriteBehind" ) );
+		WriteBehind->Buffer = (uint8*)FMemory::Realloc(WriteBehind->Buffer, WriteCoalescingMaxSize);
+		WriteBehind->BufferCapacity = WriteCoalescingMaxSize;
 	}
 
-	if (!File->FileHandle->Write((const uint8*)InBuffer, InWriteAmountBytes))
+	if (WriteBehind->BufferSize == 0)
 	{
-		return SQLITE_IOERR_WRITE;
+		WriteBehind->BufferOffset = InWriteOffsetBytes;
 	}
 
+	FMemory::Memcpy(WriteBehind->Buffer + WriteBehind->BufferSize, InBuffer, InWriteAmountBytes);
+	WriteBehind->BufferSize += InWriteAmountBytes;
+
 	return SQLITE_OK;
 }
 
+/** Write the write-behind buffer of a file, the caller holds its critical section */
+bool FSQLiteFileFuncs::FlushWriteBehind(FSQLiteFile* InFile)
+{
+#if SQLITE_UE_IO_URING
+	if (InFile->Uring)
+	{
+		InFile->Counters.IssuedWrites += InFile->Uring->GetQueuedWriteCount();
+		return InFile->Uring->Submit(false);
+	}
+#endif
+
+	FSQLiteWriteBehind* WriteBehind = InFile->WriteBehind;
+	if (!WriteBehind || WriteBehind->BufferSize == 0)
+	{
+		return true;
+	}
+
+	const bool bWritten = WriteAt(InFile, WriteBehind->Buffer, WriteBehind->BufferSize, WriteBehind->BufferOffset);
+
+#if PLATFORM_LINUX
+	// Start the write-back now so that the sync that usually follows has less left to wait for
+	if (bWritten && InFile->NativeFd >= 0)
+	{
+		sync_file_range(InFile->NativeFd, WriteBehind->BufferOffset, WriteBehind->BufferSize, SYNC_FILE_RANGE_WRITE);
+	}
+#endif
+
+	WriteBehind->BufferSize = 0;
+	return bWritten;
+}
+
+/** Flush the write-behind buffers of the journal and WAL files of a database */
+void FSQLiteFileFuncs::FlushCompanionWrites(FSQLiteLockNode* InDatabaseNode)
+{
+	FScopeLock Lock(&InDatabaseNode->CriticalSection);
+
+	for (FSQLiteFile* Companion : InDatabaseNode->CompanionFiles)
+	{
+		FSQLiteWriteBehindScope WriteBehindScope(Companion);
+		if (!FlushWriteBehind(Companion))
+		{
+			UE_LOG( LogSqlite, Warning, TEXT("Write-behind flush of [%s] failed."), *Companion->Filename );
+		}
+	}
+}
+
+/** Sync the postponed syncs of the WAL files of a database, they have to reach the disk before the database does */
+bool FSQLiteFileFuncs::SyncCompanionFiles(FSQLiteLockNode* InDatabaseNode)
+{
+	// Synced without the node lock, which the other connections of the database must not wait on for an fsync;
+	// SyncIfDeferred only touches a companion once it is taken, and a companion being closed waits for that sync
+	TArray<FSQLiteFile*> Companions;
+	{
+		FScopeLock Lock(&InDatabaseNode->CriticalSection);
+		Companions = InDatabaseNode->CompanionFiles;
+	}
+
+	bool bSynced = true;
+	for (FSQLiteFile* Companion : Companions)
+	{
+		bSynced &= SyncIfDeferred(Companion);
+	}
+
+	return bSynced;
+}
+
+/** Flush the write-behind buffer and sync a file with the platform primitive (fdatasync on Linux) */
+bool FSQLiteFileFuncs::SyncFile(FSQLiteFile* InFile, int InFlags)
+{
+	// Postponed syncs are counted here, when they really happen
+	FIoScope IoScope(InFile, ESQLiteIoOp::Sync, 0);
+
+	FSQLiteWriteBehindScope WriteBehindScope(InFile);
+
+#if SQLITE_UE_IO_URING
+	// The queued writes and the fdatasync go in one submission
+	if (InFile->Uring)
+	{
+		InFile->Counters.IssuedWrites += InFile->Uring->GetQueuedWriteCount();
+		return InFile->Uring->Submit(true);
+	}
+#endif
+
+	if (!FlushWriteBehind(InFile))
+	{
+		return false;
+	}
+
+#if PLATFORM_LINUX
+	// fdatasync also writes the file size, the rest of the metadata is of no use to SQLite
+	if (InFile->NativeFd >= 0)
+	{
+		int Result;
+		do
+		{
+			Result = fdatasync(InFile->NativeFd);
+		} while (Result != 0 && errno == EINTR);
+
+		return Result == 0;
+	}
+#endif
+
+	const bool bFullFlush = (InFlags & 0x0F) == SQLITE_SYNC_FULL;
+	return InFile->FileHandle->Flush(bFullFlush);
+}
+
+/** Sync a file now if its sync was postponed */
+bool FSQLiteFileFuncs::SyncIfDeferred(FSQLiteFile* InFile)
+{
+	for (;;)
+	{
+		FEvent* SyncedEvent;
+		{
+			FScopeLock Lock(&DeferredSyncSection);
+
+			if (!SyncingFiles.Contains(InFile))
+			{
+				if (DeferredSyncFiles.Remove(InFile) == 0)
+				{
+					return true;
+				}
+
+				SyncingFiles.Add(InFile);
+				break;
+			}
+
+			// Another thread is syncing the file, which must not be closed before it is done: SyncTakenFiles signals the end of that sync
+			SyncedEvent = FPlatformProcess::GetSynchEventFromPool();
+			SyncWaiters.Add(InFile, SyncedEvent);
+		}
+
+		// A commit made during that sync deferred the file again, hence the loop
+		SyncedEvent->Wait();
+		FPlatformProcess::ReturnSynchEventToPool(SyncedEvent);
+	}
+
+	return SyncTakenFiles({ InFile });
+}
+
+/** Sync files added to SyncingFiles by the caller, without holding the deferred sync critical section, then remove them */
+bool FSQLiteFileFuncs::SyncTakenFiles(const TArray<FSQLiteFile*>& InFiles)
+{
+	bool bSynced = true;
+
+	for (FSQLiteFile* File : InFiles)
+	{
+		if (!SyncDeferred(File))
+		{
+			UE_LOG( LogSqlite, Warning, TEXT("Deferred sync of [%s] failed."), *File->Filename );
+			bSynced = false;
+		}
+	}
+
+	FScopeLock Lock(&DeferredSyncSection);
+
+	for (FSQLiteFile* File : InFiles)
+	{
+		SyncingFiles.Remove(File);
+
+		for (auto It = SyncWaiters.CreateKeyIterator(File); It; ++It)
+		{
+			It.Value()->Trigger();
+			It.RemoveCurrent();
+		}
+	}
+
+	return bSynced;
+}
+
+/** Sync a file whose sync was postponed and forget its unsynced commits, the caller took it out of DeferredSyncFiles */
+bool FSQLiteFileFuncs::SyncDeferred(FSQLiteFile* InFile)
+{
+	// Held across the sync so that no commit slips between the sync and the reset
+	FSQLiteWriteBehindScope WriteBehindScope(InFile);
+
+	if (!SyncFile(InFile, SQLITE_SYNC_NORMAL))
+	{
+		return false;
+	}
+
+	InFile->WriteBehind->UnsyncedCommits = 0;
+	InFile->WriteBehind->UnsyncedBytes = 0;
+	return true;
+}
+
+/** Whether the WAL syncs of a file or of its database are postponed (relaxed or group durability) */
+bool FSQLiteFileFuncs::HasDeferredSyncs(const FSQLiteFile* InFile)
+{
+	return bRelaxedDurability || InFile->GroupSyncIntervalMs > 0;
+}
+
+/** Read at an offset without moving a shared file position where the platform allows it, OutBytesRead is short at the end of the file */
+bool FSQLiteFileFuncs::ReadAt(FSQLiteFile* InFile, uint8* OutBuffer, int64 InAmountBytes, int64 InOffsetBytes, int64& OutBytesRead)
+{
+	OutBytesRead = 0;
+
+#if PLATFORM_LINUX
+	if (InFile->NativeFd >= 0)
+	{
+#if SQLITE_UE_IO_URING
+		if (InFile->Uring && InFile->Uring->Read(OutBuffer, InAmountBytes, InOffsetBytes, OutBytesRead))
+		{
+			return true;
+		}
+		OutBytesRead = 0;
+#endif
+
+		while (OutBytesRead < InAmountBytes)
+		{
+			const ssize_t Result = pread(InFile->NativeFd, OutBuffer + OutBytesRead, InAmountBytes - OutBytesRead, InOffsetBytes + OutBytesRead);
+			if (Result < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				return false;
+			}
+
+			// End of the file
+			if (Result == 0)
+			{
+				break;
+			}
+
+			OutBytesRead += Result;
+		}
+
+		return true;
+	}
+#endif
+
+	IFileHandle* FileHandle = InFile->FileHandle;
+	if (!FileHandle->Seek(InOffsetBytes))
+	{
+		return false;
+	}
+
+	if (FileHandle->Read(OutBuffer, InAmountBytes))
+	{
+		OutBytesRead = InAmountBytes;
+		return true;
+	}
+
+	// Did this read fail because it ran out of data? Then read what is there
+	const int64 AvailableBytes = FMath::Clamp<int64>(FileHandle->Size() - InOffsetBytes, 0, InAmountBytes);
+	if (AvailableBytes == InAmountBytes)
+	{
+		return false;
+	}
+
+	if (AvailableBytes > 0 && !(FileHandle->Seek(InOffsetBytes) && FileHandle->Read(OutBuffer, AvailableBytes)))
+	{
+		return false;
+	}
+
+	OutBytesRead = AvailableBytes;
+	return true;
+}
+
+/** Write at an offset without moving a shared file position where the platform allows it */
+bool FSQLiteFileFuncs::WriteAt(FSQLiteFile* InFile, const uint8* InBuffer, int64 InAmountBytes, int64 InOffsetBytes)
+{
+	InFile->Counters.IssuedWrites++;
+
+#if PLATFORM_LINUX
+	if (InFile->NativeFd >= 0)
+	{
+		int64 BytesWritten = 0;
+		while (BytesWritten < InAmountBytes)
+		{
+			const ssize_t Result = pwrite(InFile->NativeFd, InBuffer + BytesWritten, InAmountBytes - BytesWritten, InOffsetBytes + BytesWritten);
+			if (Result <= 0)
+			{
+				if (Result < 0 && errno == EINTR)
+				{
+					continue;
+				}
+				return false;
+			}
+
+			BytesWritten += Result;
+		}
+
+		return true;
+	}
+#endif
+
+	return InFile->FileHandle->Seek(InOffsetBytes) && InFile->FileHandle->Write(InBuffer, InAmountBytes);
+}
+
+/** Serve a read from the read-ahead buffer, refilling it when the read continues a sequential run; false to read directly */
+bool FSQLiteFileFuncs::ReadFromReadAhead(FSQLiteFile* InFile, uint8* OutBuffer, int32 InAmountBytes, int64 InOffsetBytes)
+{
+	FSQLiteReadAhead* ReadAhead = InFile->ReadAhead;
+
+	const bool bSequential = InOffsetBytes == ReadAhead->LastReadEnd;
+	ReadAhead->LastReadEnd = InOffsetBytes + InAmountBytes;
+
+	if (InOffsetBytes >= ReadAhead->BufferOffset && InOffsetBytes + InAmountBytes <= ReadAhead->BufferOffset + ReadAhead->BufferSize)
+	{
+		FMemory::Memcpy(OutBuffer, ReadAhead->Buffer + (InOffsetBytes - ReadAhead->BufferOffset), InAmountBytes);
+		InFile->Counters.ReadAheadHits++;
+		return true;
+	}
+
+	// Random access, start over
+	if (!bSequential)
+	{
+		ReadAhead->SequentialReads = 0;
+		ReadAhead->WindowSize = 0;
+		return false;
+	}
+
+	if (++ReadAhead->SequentialReads < ReadAheadMinSequentialReads)
+	{
+		return false;
+	}
+
+	// Grow the window while the run goes on
+	ReadAhead->WindowSize = FMath::Clamp(ReadAhead->WindowSize * 2, FMath::Min(ReadAheadMinSize, ReadAheadMaxSize), ReadAheadMaxSize);
+	const int32 WindowSize = FMath::Max(ReadAhead->WindowSize, InAmountBytes);
+
+	if (ReadAhead->BufferCapacity < WindowSize)
+	{
+		LLM_SCOPE_BYNAME( TEXT( "Sqlite/ReadAhead" ) );
+		FMemory::Free(ReadAhead->Buffer);
+		ReadAhead->Buffer = (uint8*)FMemory::Malloc(WindowSize);
+		ReadAhead->BufferCapacity = WindowSize;
+	}
+
+	int64 BytesRead = 0;
+	bool bPrefetched = false;
+#if SQLITE_UE_IO_URING
+	// The window was usually read in the background while the previous one was consumed
+	bPrefetched = InFile->Uring && InFile->Uring->TakePrefetch(ReadAhead->Buffer, WindowSize, InOffsetBytes, BytesRead);
+#endif
+
+	if (!bPrefetched && !ReadAt(InFile, ReadAhead->Buffer, WindowSize, InOffsetBytes, BytesRead))
+	{
+		ReadAhead->BufferSize = 0;
+		return false;
+	}
+
+	ReadAhead->BufferOffset = InOffsetBytes;
+	ReadAhead->BufferSize = (int32)BytesRead;
+
+	InFile->Counters.ReadAheadFills++;
+	InFile->Counters.BytesReadAhead += BytesRead;
+
+#if SQLITE_UE_IO_URING
+	// Start reading the next window if the run goes on
+	if (InFile->Uring && BytesRead == WindowSize)
+	{
+		const int32 NextWindowSize = FMath::Clamp(ReadAhead->WindowSize * 2, FMath::Min(ReadAheadMinSize, ReadAheadMaxSize), ReadAheadMaxSize);
+		InFile->Uring->Prefetch(FMath::Max(NextWindowSize, InAmountBytes), InOffsetBytes + BytesRead);
+	}
+#endif
+
+	// Short read at the end of the file, let the direct read deal with it
+	if (BytesRead < InAmountBytes)
+	{
+		return false;
+	}
+
+	FMemory::Memcpy(OutBuffer, ReadAhead->Buffer, InAmountBytes);
+	return true;
+}
+
+/** Drop the read-ahead buffer, other connections may change the file whenever the locks change */
+void FSQLiteFileFuncs::InvalidateReadAhead(FSQLiteFile* InFile)
+{
+	if (InFile->ReadAhead)
+	{
+		InFile->ReadAhead->BufferSize = 0;
+	}
+
+#if SQLITE_UE_IO_URING
+	if (InFile->Uring)
+	{
+		InFile->Uring->DropPrefetch();
+	}
+#endif
+}
+
 /** Truncate a file previously opened by Open */
 int FSQLiteFileFuncs::Truncate(sqlite3_file* InFile, sqlite3_int64 InSizeBytes)
 {
 	FSQLiteFile* File = (FSQLiteFile*)InFile;
 	check(File && File->FileHandle);
 
+	FIoScope IoScope(File, ESQLiteIoOp::Truncate, 0);
+
+	InvalidateReadAhead(File);
+
+	if (File->WriteBehind)
+	{
+		FSQLiteWriteBehindScope WriteBehindScope(File);
+		if (!FlushWriteBehind(File))
+		{
+			return SQLITE_IOERR_WRITE;
+		}
+	}
+
+	// A file using chunks always covers whole chunks
+	if (File->ChunkSize > 0)
+	{
+		InSizeBytes = AlignArbitrary(InSizeBytes, (int64)File->ChunkSize);
+	}
+
+	// Some platforms refuse to truncate a mapped file, the mapping is rebuilt on the next Fetch
+	if (File->Mapping && File->Mapping->MappedSize > InSizeBytes)
+	{
+		if (File->Mapping->FetchRefCount == 0)
+		{
+			UnmapFile(File);
+		}
+		else
+		{
+			File->Mapping->MappedSize = InSizeBytes;
+		}
+	}
+
 	if (!File->FileHandle->Truncate(InSizeBytes))
 	{
 		return SQLITE_IOERR_TRUNCATE;
@@ -288,8 +1301,45 @@ int FSQLiteFileFuncs::Sync(sqlite3_file* InFile, int InFlags)
 	FSQLiteFile* File = (FSQLiteFile*)InFile;
 	check(File && File->FileHandle);
 
-	const bool bFullFlush = (InFlags & 0x0F) == SQLITE_SYNC_FULL;
-	if (!File->FileHandle->Flush(bFullFlush))
+	// Relaxed or group durability: a WAL sync only hands the frames to the OS, the flusher syncs them within the flush window
+	// A crash of the application loses nothing, a power loss can lose the commits of the last window
+	if (HasDeferredSyncs(File) && (File->OpenFlags & SQLITE_OPEN_WAL) && File->WriteBehind)
+	{
+		bool bWakeFlusher;
+		{
+			FSQLiteWriteBehindScope WriteBehindScope(File);
+			if (!FlushWriteBehind(File))
+			{
+				return SQLITE_IOERR_WRITE;
+			}
+
+			// The flusher sleeps until a window is due, a new window or a reached byte threshold changes that
+			FSQLiteWriteBehind* WriteBehind = File->WriteBehind;
+			bWakeFlusher = WriteBehind->UnsyncedCommits == 0 || (File->GroupSyncBytes > 0 && WriteBehind->UnsyncedBytes >= File->GroupSyncBytes);
+			if (WriteBehind->UnsyncedCommits++ == 0)
+			{
+				WriteBehind->UnsyncedSince = FPlatformTime::Seconds();
+			}
+		}
+
+		FScopeLock Lock(&DeferredSyncSection);
+		DeferredSyncFiles.Add(File);
+		File->Counters.DeferredSyncs++;
+
+		if (bWakeFlusher && SyncFlusher)
+		{
+			SyncFlusher->Wake();
+		}
+		return SQLITE_OK;
+	}
+
+	// The WAL frames a checkpoint copied must be on disk before the database is
+	if (HasDeferredSyncs(File) && File->LockNode && !SyncCompanionFiles(File->LockNode))
+	{
+		return SQLITE_IOERR_FSYNC;
+	}
+
+	if (!SyncFile(File, InFlags))
 	{
 		return SQLITE_IOERR_FSYNC;
 	}
@@ -303,92 +1353,1166 @@ int FSQLiteFileFuncs::FileSize(sqlite3_file* InFile, sqlite3_int64* OutSizePtr)
 	FSQLiteFile* File = (FSQLiteFile*)InFile;
 	check(File && File->FileHandle);
 
+	if (File->WriteBehind)
+	{
+		FSQLiteWriteBehindScope WriteBehindScope(File);
+		if (!FlushWriteBehind(File))
+		{
+			return SQLITE_IOERR_WRITE;
+		}
+	}
+
 	check(OutSizePtr);
 	*OutSizePtr = File->FileHandle->Size();
 
 	return SQLITE_OK;
 }
 
-/** Lock a file previously opened by Open */
-int FSQLiteFileFuncs::Lock(sqlite3_file* InFile, int InLockMode)
-{
-	FSQLiteFile* File = (FSQLiteFile*)InFile;
-	check(File && File->FileHandle);
+/** Lock a file previously opened by Open */
+int FSQLiteFileFuncs::Lock(sqlite3_file* InFile, int InLockMode)
+{
+	FSQLiteFile* File = (FSQLiteFile*)InFile;
+	check(File && File->FileHandle);
+
+	InvalidateReadAhead(File);
+
+	// Already at that level or stronger
+	if (File->LockMode >= InLockMode)
+	{
+		return SQLITE_OK;
+	}
+
+	// Files SQLite never shares (journals, temporary files) only track the requested lock mode
+	FSQLiteLockNode* Node = File->LockNode;
+	if (!Node)
+	{
+		File->LockMode = InLockMode;
+		return SQLITE_OK;
+	}
+
+	// SQLite never asks for PENDING, and only asks for RESERVED while holding SHARED
+	check(InLockMode != SQLITE_LOCK_PENDING);
+	check(InLockMode != SQLITE_LOCK_RESERVED || File->LockMode == SQLITE_LOCK_SHARED);
+
+	FScopeLock Lock(&Node->CriticalSection);
+
+	// Another connection of the process holds a lock that keeps us from getting this one
+	if (File->LockMode != Node->LockLevel && (Node->LockLevel >= SQLITE_LOCK_PENDING || InLockMode > SQLITE_LOCK_SHARED))
+	{
+		return SQLITE_BUSY;
+	}
+
+	// The process already holds SHARED or RESERVED, just join it
+	if (InLockMode == SQLITE_LOCK_SHARED && (Node->LockLevel == SQLITE_LOCK_SHARED || Node->LockLevel == SQLITE_LOCK_RESERVED))
+	{
+		File->LockMode = SQLITE_LOCK_SHARED;
+		Node->SharedCount++;
+		return SQLITE_OK;
+	}
+
+	// The PENDING byte keeps new readers out while a writer waits for EXCLUSIVE
+	if (InLockMode == SQLITE_LOCK_SHARED || (InLockMode == SQLITE_LOCK_EXCLUSIVE && File->LockMode < SQLITE_LOCK_PENDING))
+	{
+		if (!LockRange(Node, InLockMode == SQLITE_LOCK_SHARED ? ERangeLock::Read : ERangeLock::Write, LockPendingByte, 1))
+		{
+			return SQLITE_BUSY;
+		}
+	}
+
+	if (InLockMode == SQLITE_LOCK_SHARED)
+	{
+		// First SHARED lock of the process, the PENDING byte was only needed to get it
+		const bool bLocked = LockRange(Node, ERangeLock::Read, LockSharedFirst, LockSharedSize);
+		LockRange(Node, ERangeLock::Unlock, LockPendingByte, 1);
+		if (!bLocked)
+		{
+			return SQLITE_BUSY;
+		}
+
+		File->LockMode = SQLITE_LOCK_SHARED;
+		Node->LockLevel = SQLITE_LOCK_SHARED;
+		Node->SharedCount = 1;
+		return SQLITE_OK;
+	}
+
+	// EXCLUSIVE has to wait for the other readers of the process to leave
+	bool bLocked = false;
+	if (InLockMode == SQLITE_LOCK_RESERVED)
+	{
+		bLocked = LockRange(Node, ERangeLock::Write, LockReservedByte, 1);
+	}
+	else if (Node->SharedCount == 1)
+	{
+		bLocked = LockRange(Node, ERangeLock::Write, LockSharedFirst, LockSharedSize);
+	}
+
+	if (bLocked)
+	{
+		File->LockMode = InLockMode;
+		Node->LockLevel = InLockMode;
+		return SQLITE_OK;
+	}
+
+	// A writer that could not get EXCLUSIVE stays PENDING so that no new reader gets in
+	if (InLockMode == SQLITE_LOCK_EXCLUSIVE)
+	{
+		File->LockMode = SQLITE_LOCK_PENDING;
+		Node->LockLevel = SQLITE_LOCK_PENDING;
+	}
+
+	return SQLITE_BUSY;
+}
+
+/** Unlock a file previously opened by Open */
+int FSQLiteFileFuncs::Unlock(sqlite3_file* InFile, int InLockMode)
+{
+	FSQLiteFile* File = (FSQLiteFile*)InFile;
+	check(File && File->FileHandle);
+
+	InvalidateReadAhead(File);
+
+	if (File->LockMode <= InLockMode)
+	{
+		return SQLITE_OK;
+	}
+
+	FSQLiteLockNode* Node = File->LockNode;
+	if (!Node)
+	{
+		File->LockMode = InLockMode;
+		return SQLITE_OK;
+	}
+
+	// Other connections can see the database as soon as the lock drops
+	if (File->WriteBehind)
+	{
+		FSQLiteWriteBehindScope WriteBehindScope(File);
+		if (!FlushWriteBehind(File))
+		{
+			UE_LOG( LogSqlite, Warning, TEXT("Write-behind flush of [%s] failed."), *File->Filename );
+		}
+	}
+	FlushCompanionWrites(Node);
+
+	// SQLite only ever goes back to SHARED or NONE
+	check(InLockMode <= SQLITE_LOCK_SHARED);
+
+	FScopeLock Lock(&Node->CriticalSection);
+
+	int Result = SQLITE_OK;
+
+	if (File->LockMode > SQLITE_LOCK_SHARED)
+	{
+		check(Node->LockLevel == File->LockMode);
+
+		// Turn the write lock on the shared range back into a read lock
+		if (InLockMode == SQLITE_LOCK_SHARED && !LockRange(Node, ERangeLock::Read, LockSharedFirst, LockSharedSize))
+		{
+			Result = SQLITE_IOERR_RDLOCK;
+		}
+
+		// PENDING and RESERVED bytes
+		LockRange(Node, ERangeLock::Unlock, LockPendingByte, 2);
+		Node->LockLevel = SQLITE_LOCK_SHARED;
+	}
+
+	if (InLockMode == SQLITE_LOCK_NONE && --Node->SharedCount == 0)
+	{
+		// Last lock of the process, the handles closed meanwhile can go now
+		LockRange(Node, ERangeLock::Unlock, LockPendingByte, 2 + LockSharedSize);
+		Node->LockLevel = SQLITE_LOCK_NONE;
+
+#if PLATFORM_LINUX
+		for (IFileHandle* FileHandle : Node->DeferredCloseHandles)
+		{
+			delete FileHandle;
+		}
+		for (IMappedFileHandle* MappedHandle : Node->DeferredCloseMappedHandles)
+		{
+			delete MappedHandle;
+		}
+		Node->DeferredCloseHandles.Reset();
+		Node->DeferredCloseMappedHandles.Reset();
+#endif
+	}
+
+	File->LockMode = InLockMode;
+	return Result;
+}
+
+/** Check for a lock on a file previously opened by Open */
+int FSQLiteFileFuncs::CheckReservedLock(sqlite3_file* InFile, int* OutIsLocked)
+{
+	FSQLiteFile* File = (FSQLiteFile*)InFile;
+	check(File && File->FileHandle);
+	check(OutIsLocked);
+
+	FSQLiteLockNode* Node = File->LockNode;
+	if (!Node)
+	{
+		*OutIsLocked = File->LockMode > SQLITE_LOCK_SHARED;
+		return SQLITE_OK;
+	}
+
+	FScopeLock Lock(&Node->CriticalSection);
+	*OutIsLocked = Node->LockLevel > SQLITE_LOCK_SHARED || IsRangeLockedByOtherProcess(Node, LockReservedByte, 1);
+
+	return SQLITE_OK;
+}
+
+/** Attach a file to the lock table of its database */
+void FSQLiteFileFuncs::AcquireLockNode(FSQLiteFile* InFile)
+{
+	FScopeLock Lock(&LockNodesSection);
+
+	FSQLiteLockNode*& Node = LockNodes.FindOrAdd(InFile->Filename);
+	if (!Node)
+	{
+		Node = new FSQLiteLockNode();
+		Node->Filename = InFile->Filename;
+
+#if PLATFORM_LINUX
+		// fcntl locks belong to the process, a single descriptor serves all the connections, and writes those of the main database
+		const FTCHARToUTF8 NativeFilename(*FPaths::ConvertRelativePathToFull(InFile->Filename));
+		Node->LockFd = open(NativeFilename.Get(), O_RDWR | O_CLOEXEC | (InFile->bIsReadOnly ? 0 : O_CREAT), S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+		if (Node->LockFd < 0)
+		{
+			Node->LockFd = open(NativeFilename.Get(), O_RDONLY | O_CLOEXEC);
+		}
+		if (Node->LockFd < 0)
+		{
+			UE_LOG( LogSqlite, Warning, TEXT("Byte-range locks not available for [%s], other processes will not see the locks."), *InFile->Filename );
+		}
+#endif
+	}
+
+	Node->RefCount++;
+	InFile->LockNode = Node;
+}
+
+/** Find the lock table of a database and keep it alive, null if the database is not open */
+FSQLiteLockNode* FSQLiteFileFuncs::FindLockNode(const FString& InFilename)
+{
+	FScopeLock Lock(&LockNodesSection);
+
+	FSQLiteLockNode* Node = LockNodes.FindRef(InFilename);
+	if (Node)
+	{
+		Node->RefCount++;
+	}
+
+	return Node;
+}
+
+/** Drop a reference to a lock table, freeing it with the last connection */
+void FSQLiteFileFuncs::ReleaseLockNode(FSQLiteLockNode* InLockNode)
+{
+	FSQLiteLockNode* Node = InLockNode;
+
+	FScopeLock Lock(&LockNodesSection);
+
+	if (--Node->RefCount > 0)
+	{
+		return;
+	}
+
+	check(Node->SharedCount == 0 && Node->CompanionFiles.IsEmpty());
+	LockNodes.Remove(Node->Filename);
+
+#if PLATFORM_LINUX
+	check(Node->DeferredCloseHandles.IsEmpty() && Node->DeferredCloseMappedHandles.IsEmpty());
+	if (Node->LockFd >= 0)
+	{
+		close(Node->LockFd);
+	}
+#endif
+
+	delete Node;
+}
+
+/** Close the handle of a file, or keep it open while the process holds a lock on the file */
+void FSQLiteFileFuncs::CloseFileHandle(FSQLiteFile* InFile)
+{
+#if PLATFORM_LINUX
+	if (FSQLiteLockNode* Node = InFile->LockNode)
+	{
+		FScopeLock Lock(&Node->CriticalSection);
+		if (Node->SharedCount > 0)
+		{
+			Node->DeferredCloseHandles.Add(InFile->FileHandle);
+			InFile->FileHandle = nullptr;
+			return;
+		}
+	}
+#endif
+
+	delete InFile->FileHandle;
+	InFile->FileHandle = nullptr;
+
+#if !PLATFORM_LINUX
+	if (InFile->SharedHandleNode)
+	{
+		ReleaseSharedHandleNode(InFile->SharedHandleNode);
+		InFile->SharedHandleNode = nullptr;
+	}
+#endif
+}
+
+/** Open a file for writing so that the other connections of the process can write it as well */
+IFileHandle* FSQLiteFileFuncs::OpenWriteHandle(FSQLiteFile* InFile, int InFlags)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+#if PLATFORM_LINUX
+	// OpenWrite takes an exclusive flock, writers go through a descriptor of their own, or the one of the lock table for the main database
+	if (InFlags & SQLITE_OPEN_MAIN_DB)
+	{
+		AcquireLockNode(InFile);
+
+		const int LockFd = InFile->LockNode->LockFd;
+		if (LockFd >= 0 && (fcntl(LockFd, F_GETFL) & O_ACCMODE) == O_RDWR)
+		{
+			InFile->NativeFd = LockFd;
+		}
+	}
+	else
+	{
+		InFile->NativeFd = open(TCHAR_TO_UTF8(*FPaths::ConvertRelativePathToFull(InFile->Filename)), O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+		InFile->bOwnsNativeFd = InFile->NativeFd >= 0;
+	}
+
+	if (InFile->NativeFd >= 0)
+	{
+		return new FSQLiteDescriptorFileHandle(InFile->NativeFd);
+	}
+
+	// Without a descriptor only this connection can write the file
+	return PlatformFile.OpenWrite(*InFile->Filename, /*bAppend*/true, /*bAllowRead*/true);
+#else
+	// Temporary files have a name of their own
+	if (InFlags & SQLITE_OPEN_DELETEONCLOSE)
+	{
+		return PlatformFile.OpenWrite(*InFile->Filename, /*bAppend*/true, /*bAllowRead*/true);
+	}
+
+	// OpenWrite is exclusive, the connections writing the same file share a handle
+	const FString FullFilename = FPaths::ConvertRelativePathToFull(InFile->Filename);
+
+	FScopeLock Lock(&SharedHandleNodesSection);
+
+	FSQLiteSharedHandleNode* Node = SharedHandleNodes.FindRef(FullFilename);
+	if (!Node)
+	{
+		IFileHandle* FileHandle = PlatformFile.OpenWrite(*InFile->Filename, /*bAppend*/true, /*bAllowRead*/true);
+		if (!FileHandle)
+		{
+			return nullptr;
+		}
+
+		Node = new FSQLiteSharedHandleNode();
+		Node->Filename = FullFilename;
+		Node->FileHandle = FileHandle;
+		SharedHandleNodes.Add(FullFilename, Node);
+	}
+
+	Node->RefCount++;
+	InFile->SharedHandleNode = Node;
+
+	return new FSQLiteSharedFileHandle(Node);
+#endif
+}
+
+#if !PLATFORM_LINUX
+/** Drop a reference to a shared write handle, closing it with the last connection */
+void FSQLiteFileFuncs::ReleaseSharedHandleNode(FSQLiteSharedHandleNode* InNode)
+{
+	FScopeLock Lock(&SharedHandleNodesSection);
+
+	if (--InNode->RefCount > 0)
+	{
+		return;
+	}
+
+	SharedHandleNodes.Remove(InNode->Filename);
+
+	delete InNode->FileHandle;
+	delete InNode;
+}
+#endif
+
+/** Take or release an OS byte-range lock for the process, always succeeds where the platform has none */
+bool FSQLiteFileFuncs::LockRange(FSQLiteLockNode* InLockNode, ERangeLock InLockType, int64 InStart, int64 InLength)
+{
+#if PLATFORM_LINUX
+	if (InLockNode->LockFd < 0)
+	{
+		return true;
+	}
+
+	struct flock RangeLock = {};
+	RangeLock.l_type = InLockType == ERangeLock::Unlock ? F_UNLCK : InLockType == ERangeLock::Read ? F_RDLCK : F_WRLCK;
+	RangeLock.l_whence = SEEK_SET;
+	RangeLock.l_start = InStart;
+	RangeLock.l_len = InLength;
+
+	return fcntl(InLockNode->LockFd, F_SETLK, &RangeLock) == 0;
+#else
+	return true;
+#endif
+}
+
+/** Check whether another process holds a lock on a byte range */
+bool FSQLiteFileFuncs::IsRangeLockedByOtherProcess(FSQLiteLockNode* InLockNode, int64 InStart, int64 InLength)
+{
+#if PLATFORM_LINUX
+	if (InLockNode->LockFd < 0)
+	{
+		return false;
+	}
+
+	struct flock RangeLock = {};
+	RangeLock.l_type = F_WRLCK;
+	RangeLock.l_whence = SEEK_SET;
+	RangeLock.l_start = InStart;
+	RangeLock.l_len = InLength;
+
+	return fcntl(InLockNode->LockFd, F_GETLK, &RangeLock) == 0 && RangeLock.l_type != F_UNLCK;
+#else
+	return false;
+#endif
+}
+
+/** Perform additional control operations on a file previously opened by Open */
+int FSQLiteFileFuncs::FileControl(sqlite3_file* InFile, int InOp, void* InOutOpData)
+{
+	FSQLiteFile* File = (FSQLiteFile*)InFile;
+	check(File && File->FileHandle);
+
+	switch (InOp)
+	{
+	case SQLITE_FCNTL_LOCKSTATE:
+		*(int*)InOutOpData = File->LockMode;
+		return SQLITE_OK;
+
+	case SQLITE_FCNTL_CHUNK_SIZE:
+		File->ChunkSize = FMath::Max(*(int*)InOutOpData, 0);
+		return SQLITE_OK;
+
+	case SQLITE_FCNTL_SIZE_HINT:
+		return SizeHint(File, *(sqlite3_int64*)InOutOpData) ? SQLITE_OK : SQLITE_IOERR_WRITE;
+
+	case SQLITE_FCNTL_PERSIST_WAL:
+		{
+			// Negative means query only
+			int* PersistWalPtr = (int*)InOutOpData;
+			if (*PersistWalPtr < 0)
+			{
+				*PersistWalPtr = File->bPersistWal;
+			}
+			else
+			{
+				File->bPersistWal = *PersistWalPtr != 0;
+			}
+		}
+		return SQLITE_OK;
+
+	case SQLITE_FCNTL_POWERSAFE_OVERWRITE:
+		{
+			// Negative means query only
+			int* PowersafeOverwritePtr = (int*)InOutOpData;
+			if (*PowersafeOverwritePtr < 0)
+			{
+				*PowersafeOverwritePtr = (File->DeviceCharacteristics & SQLITE_IOCAP_POWERSAFE_OVERWRITE) != 0;
+			}
+			else if (*PowersafeOverwritePtr)
+			{
+				File->DeviceCharacteristics |= SQLITE_IOCAP_POWERSAFE_OVERWRITE;
+			}
+			else
+			{
+				File->DeviceCharacteristics &= ~SQLITE_IOCAP_POWERSAFE_OVERWRITE;
+			}
+		}
+		return SQLITE_OK;
+
+	case SQLITE_FCNTL_SYNC_OMITTED:
+		// PRAGMA synchronous=OFF skipped a sync, nothing to catch up on here
+		return SQLITE_OK;
+
+	case SQLITE_FCNTL_MMAP_SIZE:
+		if (File->Mapping)
+		{
+			// Negative means query only, the new limit applies from the next Fetch
+			sqlite3_int64* MmapSizePtr = (sqlite3_int64*)InOutOpData;
+			const int64 NewLimit = *MmapSizePtr;
+			*MmapSizePtr = File->Mapping->MmapSizeLimit;
+
+			if (NewLimit >= 0 && NewLimit != File->Mapping->MmapSizeLimit)
+			{
+				File->Mapping->MmapSizeLimit = NewLimit;
+				if (File->Mapping->FetchRefCount == 0)
+				{
+					UnmapFile(File);
+				}
+			}
+			return SQLITE_OK;
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	return SQLITE_NOTFOUND;
+}
+
+/** Get the file ready to grow to InSizeBytes (SQLITE_FCNTL_SIZE_HINT), extending it to whole chunks when a chunk size is set */
+bool FSQLiteFileFuncs::SizeHint(FSQLiteFile* InFile, int64 InSizeBytes)
+{
+	if (InFile->bIsReadOnly)
+	{
+		return true;
+	}
+
+	if (InFile->WriteBehind)
+	{
+		FSQLiteWriteBehindScope WriteBehindScope(InFile);
+		if (!FlushWriteBehind(InFile))
+		{
+			return false;
+		}
+	}
+
+	const int64 CurrentSize = InFile->FileHandle->Size();
+
+	// Without chunks only reserve the blocks, the size SQLite sees does not change
+	if (InFile->ChunkSize <= 0)
+	{
+#if PLATFORM_LINUX
+		if (InFile->NativeFd >= 0 && InSizeBytes > CurrentSize)
+		{
+			fallocate(InFile->NativeFd, FALLOC_FL_KEEP_SIZE, CurrentSize, InSizeBytes - CurrentSize);
+		}
+#endif
+		return true;
+	}
+
+	// Grow a whole chunk at a time so that the file is extended (and its metadata synced) once per chunk
+	const int64 NewSize = AlignArbitrary(InSizeBytes, (int64)InFile->ChunkSize);
+	if (NewSize <= CurrentSize)
+	{
+		return true;
+	}
+
+#if PLATFORM_LINUX
+	if (InFile->NativeFd >= 0)
+	{
+		int Result;
+		do
+		{
+			Result = fallocate(InFile->NativeFd, 0, CurrentSize, NewSize - CurrentSize);
+		} while (Result != 0 && errno == EINTR);
+
+		// File systems without fallocate get a plain (sparse) extension below
+		if (Result == 0)
+		{
+			return true;
+		}
+	}
+#endif
+
+	return InFile->FileHandle->Truncate(NewSize);
+}
+
+/** Get the underlying sector size of a file previously opened by Open */
+int FSQLiteFileFuncs::SectorSize(sqlite3_file* InFile)
+{
+	FSQLiteFile* File = (FSQLiteFile*)InFile;
+	check(File && File->FileHandle);
+
+	return File->SectorSize;
+}
+
+/** Get the device characteristics of a file previously opened by Open */
+int FSQLiteFileFuncs::DeviceCharacteristics(sqlite3_file* InFile)
+{
+	FSQLiteFile* File = (FSQLiteFile*)InFile;
+	check(File && File->FileHandle);
+
+	return File->DeviceCharacteristics;
+}
+
+#if PLATFORM_LINUX
+/** Sector size of a block device from sysfs (the physical block size, else the logical one), 0 when the device has none (tmpfs, btrfs and other anonymous devices) */
+static int32 GetDeviceSectorSize(dev_t InDevice)
+{
+	// A partition has no queue of its own, it uses the one of its disk
+	for (const char* QueueDirectory : { "queue", "../queue" })
+	{
+		for (const char* Attribute : { "physical_block_size", "logical_block_size" })
+		{
+			FString Path = FString::Printf(TEXT("/sys/dev/block/%u:%u/%hs/%hs"), major(InDevice), minor(InDevice), QueueDirectory, Attribute);
+
+			const int Fd = open(TCHAR_TO_UTF8(*Path), O_RDONLY | O_CLOEXEC);
+			if (Fd < 0)
+			{
+				continue;
+			}
+
+			ANSICHAR Buffer[32];
+			const ssize_t Length = read(Fd, Buffer, sizeof(Buffer) - 1);
+			close(Fd);
+
+			if (Length > 0)
+			{
+				Buffer[Length] = 0;
+				const int32 BlockSize = FCStringAnsi::Atoi(Buffer);
+				if (BlockSize > 0)
+				{
+					return BlockSize;
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+#endif
+
+/** Detect the sector size and device characteristics of the file system a file lives on */
+void FSQLiteFileFuncs::DetectDeviceProperties(FSQLiteFile* InFile)
+{
+	// Same defaults as the native OS layers of SQLite: 4KiB sectors, and writing a sector never damages its neighbours on power loss
+	InFile->SectorSize = 4096;
+	InFile->DeviceCharacteristics = SQLITE_IOCAP_UNDELETABLE_WHEN_OPEN | SQLITE_IOCAP_POWERSAFE_OVERWRITE;
+
+#if PLATFORM_LINUX
+	struct statfs FileSystemInfo;
+	if (InFile->NativeFd < 0 || fstatfs(InFile->NativeFd, &FileSystemInfo) != 0)
+	{
+		return;
+	}
+
+	// The sector size of the backing device, the block size of the file system says nothing about what the device writes at once
+	struct stat FileInfo;
+	if (fstat(InFile->NativeFd, &FileInfo) == 0)
+	{
+		const int32 DeviceSectorSize = GetDeviceSectorSize(FileInfo.st_dev);
+		if (DeviceSectorSize > 0)
+		{
+			InFile->SectorSize = FMath::Clamp((int32)FMath::RoundUpToPowerOfTwo((uint32)DeviceSectorSize), 512, 65536);
+		}
+	}
+
+	// Only claim what the file system guarantees whatever its mount options
+	switch ((uint32)FileSystemInfo.f_type)
+	{
+	case 0x01021994:	// tmpfs: nothing survives a crash, so there is no write ordering to protect
+		InFile->DeviceCharacteristics |= SQLITE_IOCAP_SAFE_APPEND | SQLITE_IOCAP_SEQUENTIAL;
+		if (InFile->SectorSize >= 4096)
+		{
+			InFile->DeviceCharacteristics |= SQLITE_IOCAP_ATOMIC4K;
+		}
+		break;
+
+	case 0x00006969:	// NFS
+	case 0xFF534D42:	// CIFS
+	case 0xFE534D42:	// SMB2
+	case 0x65735546:	// FUSE
+		// Remote and user space file systems do not tell how they write, assume the worst
+		InFile->SectorSize = FMath::Max(InFile->SectorSize, 4096);
+		InFile->DeviceCharacteristics &= ~SQLITE_IOCAP_POWERSAFE_OVERWRITE;
+		break;
+
+	default:
+		break;
+	}
+#endif
+}
+
+/** Map a region of the shared memory of a file previously opened by Open */
+int FSQLiteFileFuncs::ShmMap(sqlite3_file* InFile, int InRegionIndex, int InRegionSizeBytes, int bInExtend, void volatile** OutPtr)
+{
+	FSQLiteFile* File = (FSQLiteFile*)InFile;
+	check(File && File->FileHandle && OutPtr);
+
+	*OutPtr = nullptr;
+
+	if (!File->Shm && !ShmAttach(File))
+	{
+		return SQLITE_IOERR_SHMOPEN;
+	}
+
+	FSQLiteShmNode* Node = File->Shm->Node;
+	FScopeLock Lock(&Node->CriticalSection);
+
+	// SQLite always uses the same region size for a given database
+	check(Node->RegionSize == 0 || Node->RegionSize == InRegionSizeBytes);
+	Node->RegionSize = InRegionSizeBytes;
+
+	while (Node->Regions.Num() <= InRegionIndex)
+	{
+		void* Region = nullptr;
+
+		if (Node->bNamed)
+		{
+			// Another process may already have created the region, even when we are not asked to extend
+			const FString RegionName = FString::Printf(TEXT("%s-%d"), *Node->SharedMemoryName, Node->Regions.Num());
+			FPlatformMemory::FSharedMemoryRegion* NamedRegion = MapNamedRegion(RegionName, InRegionSizeBytes, !!bInExtend);
+			if (NamedRegion)
+			{
+				Node->NamedRegions.Add(NamedRegion);
+				Region = NamedRegion->GetAddress();
+			}
+			else if (bInExtend)
+			{
+				return SQLITE_IOERR_SHMMAP;
+			}
+		}
+		else if (bInExtend)
+		{
+			LLM_SCOPE_BYNAME( TEXT( "Sqlite/SharedMemory" ) );
+			Region = FMemory::MallocZeroed(InRegionSizeBytes);
+			if (!Region)
+			{
+				return SQLITE_NOMEM;
+			}
+		}
+
+		// Not there yet and not asked to create it
+		if (!Region)
+		{
+			return SQLITE_OK;
+		}
+
+		Node->Regions.Add(Region);
+	}
+
+	*OutPtr = Node->Regions[InRegionIndex];
+	return SQLITE_OK;
+}
+
+/** Acquire or release shared memory lock slots */
+int FSQLiteFileFuncs::ShmLock(sqlite3_file* InFile, int InOffset, int InCount, int InFlags)
+{
+	FSQLiteFile* File = (FSQLiteFile*)InFile;
+	check(File && File->FileHandle && File->Shm);
+	check(InOffset >= 0 && InCount >= 1 && InOffset + InCount <= SQLITE_SHM_NLOCK);
+
+	// Every WAL transaction starts with a shared memory lock, and checkpoints may have changed the file since the last one
+	InvalidateReadAhead(File);
+
+#if PLATFORM_LINUX
+	FSQLiteShmNode* Node = File->Shm->Node;
+	if (Node->LockFd >= 0)
+	{
+		FScopeLock Lock(&Node->LockSection);
+		return ShmLockSlots(File, InOffset, InCount, InFlags);
+	}
+#endif
+
+	return ShmLockSlots(File, InOffset, InCount, InFlags);
+}
+
+/** Acquire or release shared memory lock slots, serialized by the caller when the process holds fcntl locks for them */
+int FSQLiteFileFuncs::ShmLockSlots(FSQLiteFile* InFile, int InOffset, int InCount, int InFlags)
+{
+	FSQLiteShm* Shm = InFile->Shm;
+	FSQLiteShmNode* Node = Shm->Node;
+	std::atomic<uint32>* LockWords = Node->LockWords;
+	const uint16 Mask = (uint16)(((1u << (InOffset + InCount)) - 1) & ~((1u << InOffset) - 1));
+
+	if (InFlags & SQLITE_SHM_UNLOCK)
+	{
+		// Releasing the WAL write lock publishes the frames of the connection
+		if (InFile->LockNode)
+		{
+			FlushCompanionWrites(InFile->LockNode);
+		}
+
+		for (int32 Slot = InOffset; Slot < InOffset + InCount; ++Slot)
+		{
+			const uint16 SlotBit = (uint16)(1u << Slot);
+			if (Shm->ExclusiveMask & SlotBit)
+			{
+				LockWords[Slot].fetch_and(~ShmExclusiveLock, std::memory_order_release);
+				ShmSystemLock(Node, ERangeLock::Unlock, Slot);
+			}
+			else if (Shm->SharedMask & SlotBit)
+			{
+				// The last shared holder of the process releases the slot for the other processes
+				if (LockWords[Slot].fetch_sub(1, std::memory_order_release) == 1)
+				{
+					ShmSystemLock(Node, ERangeLock::Unlock, Slot);
+				}
+			}
+		}
+
+		Shm->ExclusiveMask &= ~Mask;
+		Shm->SharedMask &= ~Mask;
+		return SQLITE_OK;
+	}
+
+	if (InFlags & SQLITE_SHM_SHARED)
+	{
+		// SQLite only ever takes shared locks one slot at a time
+		check(InCount == 1);
+
+		if ((Shm->SharedMask | Shm->ExclusiveMask) & Mask)
+		{
+			return SQLITE_OK;
+		}
+
+		uint32 LockWord = LockWords[InOffset].load(std::memory_order_relaxed);
+		do
+		{
+			if (LockWord & ShmExclusiveLock)
+			{
+				return SQLITE_BUSY;
+			}
+		} while (!LockWords[InOffset].compare_exchange_weak(LockWord, LockWord + 1, std::memory_order_acquire, std::memory_order_relaxed));
+
+		// The first shared holder of the process takes the slot from the other processes
+		if (LockWord == 0 && !ShmSystemLock(Node, ERangeLock::Read, InOffset))
+		{
+			LockWords[InOffset].fetch_sub(1, std::memory_order_release);
+			return SQLITE_BUSY;
+		}
+
+		Shm->SharedMask |= Mask;
+		return SQLITE_OK;
+	}
+
+	// Exclusive: every slot of the range must be free of other holders, our own shared lock is upgraded
+	for (int32 Slot = InOffset; Slot < InOffset + InCount; ++Slot)
+	{
+		const uint16 SlotBit = (uint16)(1u << Slot);
+		if (Shm->ExclusiveMask & SlotBit)
+		{
+			continue;
+		}
+
+		const uint32 Unlocked = (Shm->SharedMask & SlotBit) ? 1 : 0;
+		uint32 Expected = Unlocked;
+		bool bLocked = LockWords[Slot].compare_exchange_strong(Expected, ShmExclusiveLock, std::memory_order_acquire, std::memory_order_relaxed);
+		if (bLocked && !ShmSystemLock(Node, ERangeLock::Write, Slot))
+		{
+			// A failed fcntl upgrade keeps our shared lock, if any
+			LockWords[Slot].store(Unlocked, std::memory_order_release);
+			bLocked = false;
+		}
+
+		if (!bLocked)
+		{
+			// Roll back the slots taken so far
+			for (int32 TakenSlot = InOffset; TakenSlot < Slot; ++TakenSlot)
+			{
+				const uint16 TakenBit = (uint16)(1u << TakenSlot);
+				if (!(Shm->ExclusiveMask & TakenBit))
+				{
+					const bool bWasShared = (Shm->SharedMask & TakenBit) != 0;
+					LockWords[TakenSlot].store(bWasShared ? 1 : 0, std::memory_order_release);
+					ShmSystemLock(Node, bWasShared ? ERangeLock::Read : ERangeLock::Unlock, TakenSlot);
+				}
+			}
+			return SQLITE_BUSY;
+		}
+	}
+
+	Shm->ExclusiveMask |= Mask;
+	Shm->SharedMask &= ~Mask;
+	return SQLITE_OK;
+}
+
+/** Take or release the fcntl lock of a slot for the process, always succeeds when other processes do not share the memory */
+bool FSQLiteFileFuncs::ShmSystemLock(FSQLiteShmNode* InNode, ERangeLock InLockType, int32 InSlot)
+{
+#if PLATFORM_LINUX
+	if (InNode->LockFd < 0)
+	{
+		return true;
+	}
+
+	struct flock SlotLock = {};
+	SlotLock.l_type = InLockType == ERangeLock::Unlock ? F_UNLCK : InLockType == ERangeLock::Read ? F_RDLCK : F_WRLCK;
+	SlotLock.l_whence = SEEK_SET;
+	SlotLock.l_start = InSlot;
+	SlotLock.l_len = 1;
+
+	return fcntl(InNode->LockFd, F_SETLK, &SlotLock) == 0;
+#else
+	return true;
+#endif
+}
+
+/** Full memory barrier on the shared memory */
+void FSQLiteFileFuncs::ShmBarrier(sqlite3_file* InFile)
+{
+	FSQLiteFile* File = (FSQLiteFile*)InFile;
+	check(File);
+
+	// SQLite publishes a new WAL index header around the barrier, the frames it points to must be written first
+	if (File->LockNode)
+	{
+		FlushCompanionWrites(File->LockNode);
+	}
+
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+/** Detach from the shared memory, freeing it with the last connection */
+int FSQLiteFileFuncs::ShmUnmap(sqlite3_file* InFile, int bInDelete)
+{
+	FSQLiteFile* File = (FSQLiteFile*)InFile;
+	check(File);
+
+	FSQLiteShm* Shm = File->Shm;
+	if (!Shm)
+	{
+		return SQLITE_OK;
+	}
+
+	// Drop whatever locks the connection still holds
+	if (Shm->SharedMask | Shm->ExclusiveMask)
+	{
+		ShmLock(InFile, 0, SQLITE_SHM_NLOCK, SQLITE_SHM_UNLOCK);
+	}
+
+	FSQLiteShmNode* Node = Shm->Node;
+	delete Shm;
+	File->Shm = nullptr;
+
+	FScopeLock Lock(&ShmNodesSection);
+
+	if (--Node->RefCount > 0)
+	{
+		return SQLITE_OK;
+	}
+
+	// Last connection of the process, named regions stay alive as long as another process maps them
+	ShmNodes.Remove(Node->Filename);
+
+	if (Node->bNamed)
+	{
+		for (FPlatformMemory::FSharedMemoryRegion* NamedRegion : Node->NamedRegions)
+		{
+			FPlatformMemory::UnmapNamedSharedMemoryRegion(NamedRegion);
+		}
+
+		if (Node->NamedLockRegion)
+		{
+			FPlatformMemory::UnmapNamedSharedMemoryRegion(Node->NamedLockRegion);
+		}
+
+#if PLATFORM_LINUX
+		// The lock file stays for the other processes, as the regions do
+		if (Node->LockFd >= 0)
+		{
+			close(Node->LockFd);
+		}
+#endif
+	}
+	else
+	{
+		for (void* Region : Node->Regions)
+		{
+			FMemory::Free(Region);
+		}
+	}
+
+	delete Node;
+	return SQLITE_OK;
+}
+
+/** Attach a file to the shared memory node of its database */
+bool FSQLiteFileFuncs::ShmAttach(FSQLiteFile* InFile)
+{
+	FScopeLock Lock(&ShmNodesSection);
+
+	FSQLiteShmNode*& Node = ShmNodes.FindOrAdd(InFile->Filename);
+	if (!Node)
+	{
+		Node = new FSQLiteShmNode();
+		Node->Filename = InFile->Filename;
+
+		if (bUseNamedSharedMemory)
+		{
+			// Region names are derived from the database path so that every process finds the same ones
+			Node->SharedMemoryName = FString::Printf(TEXT("SqliteShm-%08x"), FCrc::StrCrc32(*InFile->Filename.ToLower()));
+
+#if PLATFORM_LINUX
+			// Lock slots are fcntl locks on a shared memory object, as the unix VFS takes them on the -shm file
+			const FString LockFileName = FString::Printf(TEXT("/%s-locks"), *Node->SharedMemoryName);
+			Node->LockFd = shm_open(TCHAR_TO_UTF8(*LockFileName), O_RDWR | O_CREAT | O_CLOEXEC, 0660);
+			if (Node->LockFd >= 0)
+			{
+				Node->bNamed = true;
+			}
+			else
+			{
+				UE_LOG( LogSqlite, Warning, TEXT("Cannot open the shared memory lock file of [%s] (errno %d)."), *InFile->Filename, errno );
+			}
+#else
+			Node->NamedLockRegion = MapNamedRegion(Node->SharedMemoryName + TEXT("-locks"), sizeof(uint32) * SQLITE_SHM_NLOCK, true);
+			if (Node->NamedLockRegion)
+			{
+				Node->bNamed = true;
+				Node->LockWords = (std::atomic<uint32>*)Node->NamedLockRegion->GetAddress();
+			}
+#endif
+			else
+			{
+				UE_LOG( LogSqlite, Warning, TEXT("Named shared memory not available for [%s], other processes will not see the WAL index."), *InFile->Filename );
+			}
+		}
+	}
+
+	Node->RefCount++;
+
+	InFile->Shm = new FSQLiteShm();
+	InFile->Shm->Node = Node;
+	return true;
+}
+
+/** Map a named shared memory region, opening an existing one before creating it if allowed */
+FPlatformMemory::FSharedMemoryRegion* FSQLiteFileFuncs::MapNamedRegion(const FString& InName, SIZE_T InSizeBytes, bool bInCreate)
+{
+	const uint32 AccessMode = FPlatformMemory::ESharedMemoryAccess::Read | FPlatformMemory::ESharedMemoryAccess::Write;
+
+	FPlatformMemory::FSharedMemoryRegion* Region = FPlatformMemory::MapNamedSharedMemoryRegion(InName, /*bCreate*/false, AccessMode, InSizeBytes);
+	if (!Region && bInCreate)
+	{
+		Region = FPlatformMemory::MapNamedSharedMemoryRegion(InName, /*bCreate*/true, AccessMode, InSizeBytes);
+	}
+
+	return Region;
+}
+
+/** Get a pointer to a memory mapped page of a file previously opened by Open */
+int FSQLiteFileFuncs::Fetch(sqlite3_file* InFile, sqlite3_int64 InOffsetBytes, int InAmountBytes, void** OutPtr)
+{
+	FSQLiteFile* File = (FSQLiteFile*)InFile;
+	check(File && File->FileHandle && OutPtr);
+
+	// A null pointer tells SQLite to use Read for this page
+	*OutPtr = nullptr;
+
+	FSQLiteFileMapping* Mapping = File->Mapping;
+	if (!Mapping || Mapping->MmapSizeLimit <= 0 || Mapping->bMappingUnavailable)
+	{
+		return SQLITE_OK;
+	}
+
+	const int64 RequiredSize = InOffsetBytes + InAmountBytes;
+	if (RequiredSize > Mapping->MmapSizeLimit)
+	{
+		return SQLITE_OK;
+	}
 
-	// See Open for the notes on locking
-	if (InLockMode < File->LockMode)
+	// Grow the mapping if the file grew, only possible while no page is out
+	if (RequiredSize > Mapping->MappedSize && Mapping->FetchRefCount == 0)
 	{
-		return SQLITE_IOERR_LOCK;
+		MapFile(File, RequiredSize);
+	}
+
+	if (RequiredSize <= Mapping->MappedSize)
+	{
+		*OutPtr = (void*)(Mapping->MappedRegion->GetMappedPtr() + InOffsetBytes);
+		Mapping->FetchRefCount++;
 	}
-	File->LockMode = InLockMode;
 
 	return SQLITE_OK;
 }
 
-/** Unlock a file previously opened by Open */
-int FSQLiteFileFuncs::Unlock(sqlite3_file* InFile, int InLockMode)
+/** Release a page returned by Fetch, or drop the mapping when InPtr is null */
+int FSQLiteFileFuncs::Unfetch(sqlite3_file* InFile, sqlite3_int64 InOffsetBytes, void* InPtr)
 {
 	FSQLiteFile* File = (FSQLiteFile*)InFile;
 	check(File && File->FileHandle);
 
-	// See Open for the notes on locking
-	if (InLockMode > File->LockMode)
+	FSQLiteFileMapping* Mapping = File->Mapping;
+	if (!Mapping)
 	{
-		return SQLITE_IOERR_UNLOCK;
+		return SQLITE_OK;
+	}
+
+	if (InPtr)
+	{
+		check(Mapping->FetchRefCount > 0);
+		Mapping->FetchRefCount--;
+	}
+	else
+	{
+		UnmapFile(File);
 	}
-	File->LockMode = InLockMode;
 
 	return SQLITE_OK;
 }
 
-/** Check for a lock on a file previously opened by Open */
-int FSQLiteFileFuncs::CheckReservedLock(sqlite3_file* InFile, int* OutIsLocked)
+/** Map (or remap) the file so that at least InRequiredSizeBytes bytes can be fetched */
+bool FSQLiteFileFuncs::MapFile(FSQLiteFile* InFile, int64 InRequiredSizeBytes)
 {
-	FSQLiteFile* File = (FSQLiteFile*)InFile;
-	check(File && File->FileHandle);
+	FSQLiteFileMapping* Mapping = InFile->Mapping;
+	check(Mapping && Mapping->FetchRefCount == 0);
 
-	// See Open for the notes on locking
-	check(OutIsLocked);
-	*OutIsLocked = File->LockMode > 0;
+	const int64 FileSize = InFile->FileHandle->Size();
+	const int64 MapSize = FMath::Min(FileSize, Mapping->MmapSizeLimit);
+	if (MapSize < InRequiredSizeBytes)
+	{
+		return false;
+	}
 
-	return SQLITE_OK;
-}
+	UnmapFile(InFile);
 
-/** Perform additional control operations on a file previously opened by Open */
-int FSQLiteFileFuncs::FileControl(sqlite3_file* InFile, int InOp, void* InOutOpData)
-{
-	FSQLiteFile* File = (FSQLiteFile*)InFile;
-	check(File && File->FileHandle);
+	// The mapped handle size is fixed when it is opened, so it has to be reopened when the file grows
 
-	switch (InOp)
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	Mapping->MappedHandle = PlatformFile.OpenMapped(*InFile->Filename);
+	if (Mapping->MappedHandle)
 	{
-	case SQLITE_FCNTL_LOCKSTATE:
-		*(int*)InOutOpData = File->LockMode;
-		return SQLITE_OK;
+		const int64 RegionSize = FMath::Min(MapSize, Mapping->MappedHandle->GetFileSize());
+		Mapping->MappedRegion = RegionSize > 0 ? Mapping->MappedHandle->MapRegion(0, RegionSize) : nullptr;
+	}
 
-	default:
-		break;
+	if (!Mapping->MappedRegion)
+	{
+		UE_LOG( LogSqlite, Log, TEXT("Memory mapping not available for [%s], using reads."), *InFile->Filename );
+
+		UnmapFile(InFile);
+		Mapping->bMappingUnavailable = true;
+		return false;
 	}
 
-		return SQLITE_NOTFOUND;
+	Mapping->MappedSize = Mapping->MappedRegion->GetMappedSize();
+	return Mapping->MappedSize >= InRequiredSizeBytes;
 }
 
-/** Get the underlying sector size of a file previously opened by Open */
-int FSQLiteFileFuncs::SectorSize(sqlite3_file* InFile)
+/** Drop the mapping of a file */
+void FSQLiteFileFuncs::UnmapFile(FSQLiteFile* InFile)
 {
-	FSQLiteFile* File = (FSQLiteFile*)InFile;
-	check(File && File->FileHandle);
+	FSQLiteFileMapping* Mapping = InFile->Mapping;
+	check(Mapping);
 
-	return 4096;
-}
+	delete Mapping->MappedRegion;
 
-/** Get the device characteristics of a file previously opened by Open */
-int FSQLiteFileFuncs::DeviceCharacteristics(sqlite3_file* InFile)
-{
-	FSQLiteFile* File = (FSQLiteFile*)InFile;
-	check(File && File->FileHandle);
+#if PLATFORM_LINUX
+	// Closing the mapped handle would drop the locks of the process (see CloseFileHandle)
+	if (Mapping->MappedHandle && InFile->LockNode)
+	{
+		FScopeLock Lock(&InFile->LockNode->CriticalSection);
+		if (InFile->LockNode->SharedCount > 0)
+		{
+			InFile->LockNode->DeferredCloseMappedHandles.Add(Mapping->MappedHandle);
+			Mapping->MappedHandle = nullptr;
+		}
+	}
+#endif
+
+	delete Mapping->MappedHandle;
 
-	return SQLITE_IOCAP_UNDELETABLE_WHEN_OPEN;
+	Mapping->MappedRegion = nullptr;
+	Mapping->MappedHandle = nullptr;
+	Mapping->MappedSize = 0;
 }
 
 /** Attempt to delete the named file */
@@ -532,4 +2656,394 @@ int FSQLiteFileFuncs::GetLastError(sqlite3_vfs* InVFS, int InOutputBufferSizeByt
 	return SQLITE_OK;
 }
 
+// ============================================================================
+// = In-memory handle of a temporary file
+// ============================================================================
+
+FSQLiteMemoryFileHandle::FSQLiteMemoryFileHandle( const FString& InSpillFilename, int64 InSpillSize )
+	: SpillFilename(InSpillFilename)
+	, SpillSize(InSpillSize)
+	, Position(0)
+	, SpillHandle(nullptr)
+{
+}
+
+FSQLiteMemoryFileHandle::~FSQLiteMemoryFileHandle()
+{
+	delete SpillHandle;
+}
+
+int64 FSQLiteMemoryFileHandle::Tell()
+{
+	return SpillHandle ? SpillHandle->Tell() : Position;
+}
+
+bool FSQLiteMemoryFileHandle::Seek(int64 InNewPosition)
+{
+	if (SpillHandle)
+	{
+		return SpillHandle->Seek(InNewPosition);
+	}
+
+	// Seeking past the end is allowed, a write there fills the gap with zeros
+	if (InNewPosition < 0)
+	{
+		return false;
+	}
+
+	Position = InNewPosition;
+	return true;
+}
+
+bool FSQLiteMemoryFileHandle::SeekFromEnd(int64 InNewPositionRelativeToEnd)
+{
+	if (SpillHandle)
+	{
+		return SpillHandle->SeekFromEnd(InNewPositionRelativeToEnd);
+	}
+
+	return Seek(Data.Num() + InNewPositionRelativeToEnd);
+}
+
+bool FSQLiteMemoryFileHandle::Read(uint8* OutDestination, int64 InBytesToRead)
+{
+	if (SpillHandle)
+	{
+		return SpillHandle->Read(OutDestination, InBytesToRead);
+	}
+
+	// Like a disk file, a read running past the end fails (see FSQLiteFileFuncs::ReadAt)
+	if (Position + InBytesToRead > Data.Num())
+	{
+		return false;
+	}
+
+	FMemory::Memcpy(OutDestination, Data.GetData() + Position, InBytesToRead);
+	Position += InBytesToRead;
+	return true;
+}
+
+bool FSQLiteMemoryFileHandle::Write(const uint8* InSource, int64 InBytesToWrite)
+{
+	if (!SpillHandle && Position + InBytesToWrite > SpillSize && !Spill())
+	{
+		return false;
+	}
+
+	if (SpillHandle)
+	{
+		return SpillHandle->Write(InSource, InBytesToWrite);
+	}
+
+	const int64 WriteEnd = Position + InBytesToWrite;
+	if (WriteEnd > Data.Num())
+	{
+		const int64 OldSize = Data.Num();
+		Data.AddUninitialized(WriteEnd - OldSize);
+
+		if (Position > OldSize)
+		{
+			FMemory::Memzero(Data.GetData() + OldSize, Position - OldSize);
+		}
+	}
+
+	FMemory::Memcpy(Data.GetData() + Position, InSource, InBytesToWrite);
+	Position = WriteEnd;
+	return true;
+}
+
+bool FSQLiteMemoryFileHandle::Flush(const bool bInFullFlush)
+{
+	return SpillHandle ? SpillHandle->Flush(bInFullFlush) : true;
+}
+
+bool FSQLiteMemoryFileHandle::Truncate(int64 InNewSize)
+{
+	if (!SpillHandle && InNewSize > SpillSize && !Spill())
+	{
+		return false;
+	}
+
+	if (SpillHandle)
+	{
+		return SpillHandle->Truncate(InNewSize);
+	}
+
+	if (InNewSize < 0)
+	{
+		return false;
+	}
+
+	// Keep the memory when shrinking, temporary files are usually refilled right away
+	const int64 OldSize = Data.Num();
+	Data.SetNumUninitialized(InNewSize, /*bAllowShrinking*/false);
+
+	if (InNewSize > OldSize)
+	{
+		FMemory::Memzero(Data.GetData() + OldSize, InNewSize - OldSize);
+	}
+
+	return true;
+}
+
+int64 FSQLiteMemoryFileHandle::Size()
+{
+	return SpillHandle ? SpillHandle->Size() : Data.Num();
+}
+
+bool FSQLiteMemoryFileHandle::Spill()
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(SpillFilename));
+
+	IFileHandle* FileHandle = PlatformFile.OpenWrite(*SpillFilename, /*bAppend*/false, /*bAllowRead*/true);
+	if (!FileHandle)
+	{
+		return false;
+	}
+
+	if (!FileHandle->Write(Data.GetData(), Data.Num()) || !FileHandle->Seek(Position))
+	{
+		delete FileHandle;
+		PlatformFile.DeleteFile(*SpillFilename);
+		return false;
+	}
+
+	UE_LOG( LogSqlite, Verbose, TEXT("Temporary file [%s] moved to disk at %lld bytes."), *SpillFilename, Data.Num() );
+
+	SpillHandle = FileHandle;
+	Data.Empty();
+	return true;
+}
+
+#if PLATFORM_LINUX
+// ============================================================================
+// = Handle over a descriptor
+// ============================================================================
+
+FSQLiteDescriptorFileHandle::FSQLiteDescriptorFileHandle( int InFd )
+	: Fd(InFd)
+	, Position(0)
+{
+}
+
+int64 FSQLiteDescriptorFileHandle::Tell()
+{
+	return Position;
+}
+
+bool FSQLiteDescriptorFileHandle::Seek(int64 InNewPosition)
+{
+	if (InNewPosition < 0)
+	{
+		return false;
+	}
+
+	Position = InNewPosition;
+	return true;
+}
+
+bool FSQLiteDescriptorFileHandle::SeekFromEnd(int64 InNewPositionRelativeToEnd)
+{
+	const int64 FileSize = Size();
+	return FileSize >= 0 && Seek(FileSize + InNewPositionRelativeToEnd);
+}
+
+bool FSQLiteDescriptorFileHandle::Read(uint8* OutDestination, int64 InBytesToRead)
+{
+	// Positional, the descriptor is shared by the connections of the process
+	while (InBytesToRead > 0)
+	{
+		const ssize_t BytesRead = pread(Fd, OutDestination, InBytesToRead, Position);
+		if (BytesRead < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (BytesRead <= 0)
+		{
+			return false;
+		}
+
+		OutDestination += BytesRead;
+		InBytesToRead -= BytesRead;
+		Position += BytesRead;
+	}
+
+	return true;
+}
+
+bool FSQLiteDescriptorFileHandle::Write(const uint8* InSource, int64 InBytesToWrite)
+{
+	while (InBytesToWrite > 0)
+	{
+		const ssize_t BytesWritten = pwrite(Fd, InSource, InBytesToWrite, Position);
+		if (BytesWritten < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (BytesWritten <= 0)
+		{
+			return false;
+		}
+
+		InSource += BytesWritten;
+		InBytesToWrite -= BytesWritten;
+		Position += BytesWritten;
+	}
+
+	return true;
+}
+
+bool FSQLiteDescriptorFileHandle::Flush(const bool bInFullFlush)
+{
+	int Result;
+	do
+	{
+		Result = bInFullFlush ? fsync(Fd) : fdatasync(Fd);
+	} while (Result != 0 && errno == EINTR);
+
+	return Result == 0;
+}
+
+bool FSQLiteDescriptorFileHandle::Truncate(int64 InNewSize)
+{
+	int Result;
+	do
+	{
+		Result = ftruncate(Fd, InNewSize);
+	} while (Result != 0 && errno == EINTR);
+
+	return Result == 0;
+}
+
+int64 FSQLiteDescriptorFileHandle::Size()
+{
+	struct stat FileInfo;
+	return fstat(Fd, &FileInfo) == 0 ? FileInfo.st_size : -1;
+}
+#else
+// ============================================================================
+// = View of a connection on a shared write handle
+// ============================================================================
+
+FSQLiteSharedFileHandle::FSQLiteSharedFileHandle( FSQLiteSharedHandleNode* InNode )
+	: Node(InNode)
+	, Position(0)
+{
+}
+
+int64 FSQLiteSharedFileHandle::Tell()
+{
+	return Position;
+}
+
+bool FSQLiteSharedFileHandle::Seek(int64 InNewPosition)
+{
+	if (InNewPosition < 0)
+	{
+		return false;
+	}
+
+	Position = InNewPosition;
+	return true;
+}
+
+bool FSQLiteSharedFileHandle::SeekFromEnd(int64 InNewPositionRelativeToEnd)
+{
+	const int64 FileSize = Size();
+	return FileSize >= 0 && Seek(FileSize + InNewPositionRelativeToEnd);
+}
+
+bool FSQLiteSharedFileHandle::Read(uint8* OutDestination, int64 InBytesToRead)
+{
+	// The position of the shared handle is only meaningful under its lock
+	FScopeLock Lock(&Node->CriticalSection);
+
+	if (!Node->FileHandle->Seek(Position) || !Node->FileHandle->Read(OutDestination, InBytesToRead))
+	{
+		return false;
+	}
+
+	Position += InBytesToRead;
+	return true;
+}
+
+bool FSQLiteSharedFileHandle::Write(const uint8* InSource, int64 InBytesToWrite)
+{
+	FScopeLock Lock(&Node->CriticalSection);
+
+	if (!Node->FileHandle->Seek(Position) || !Node->FileHandle->Write(InSource, InBytesToWrite))
+	{
+		return false;
+	}
+
+	Position += InBytesToWrite;
+	return true;
+}
+
+bool FSQLiteSharedFileHandle::Flush(const bool bInFullFlush)
+{
+	FScopeLock Lock(&Node->CriticalSection);
+	return Node->FileHandle->Flush(bInFullFlush);
+}
+
+bool FSQLiteSharedFileHandle::Truncate(int64 InNewSize)
+{
+	FScopeLock Lock(&Node->CriticalSection);
+	return Node->FileHandle->Truncate(InNewSize);
+}
+
+int64 FSQLiteSharedFileHandle::Size()
+{
+	FScopeLock Lock(&Node->CriticalSection);
+	return Node->FileHandle->Size();
+}
+#endif
+
+// ============================================================================
+// = Thread syncing the postponed WAL syncs when they are due
+// ============================================================================
+
+FSQLiteSyncFlusher::FSQLiteSyncFlusher( int32 InFlushWindowMs )
+	: FlushWindowMs( InFlushWindowMs )
+	, bStopping( false )
+	, WakeEvent( FPlatformProcess::GetSynchEventFromPool() )
+{
+	Thread = FRunnableThread::Create( this, TEXT( "SqliteSyncFlusher" ), 0, TPri_BelowNormal );
+}
+
+FSQLiteSyncFlusher::~FSQLiteSyncFlusher()
+{
+	if( Thread )
+	{
+		Thread->Kill( true );
+		delete Thread;
+	}
+
+	FPlatformProcess::ReturnSynchEventToPool( WakeEvent );
+}
+
+uint32 FSQLiteSyncFlusher::Run()
+{
+	int32 WaitMs = FlushWindowMs;
+	while( !bStopping )
+	{
+		WakeEvent->Wait( WaitMs );
+		WaitMs = FMath::Max( FSQLiteFileFuncs::FlushDueSyncs(), 1 );
+	}
+
+	return 0;
+}
+
+void FSQLiteSyncFlusher::Stop()
+{
+	bStopping = true;
+	WakeEvent->Trigger();
+}
+
+void FSQLiteSyncFlusher::Wake()
+{
+	WakeEvent->Trigger();
+}
+
 #endif
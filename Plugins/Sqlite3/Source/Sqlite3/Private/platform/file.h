@@ -10,11 +10,309 @@
 #include "HAL/PlatformFileManager.h"
 #include "HAL/PlatformFile.h"
 #include "Templates/Atomic.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformMemory.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/Event.h"
+
+#include <atomic>
 
 THIRD_PARTY_INCLUDES_START
 #include "sqlite/sqlite3.h-inline"
 THIRD_PARTY_INCLUDES_END
 
+#include "../../Sqlite3/Private/platform/SQLite3Platform.h"
+
+struct FSQLiteFile;
+class FSQLiteIoUring;
+
+/* ========================================================================= */
+/** Memory mapping of a file (see xFetch/xUnfetch)                           */
+/* ========================================================================= */
+
+struct FSQLiteFileMapping
+{
+	/** Largest mapping allowed (SQLITE_FCNTL_MMAP_SIZE), 0 disables mapping */
+	int64 MmapSizeLimit = 0;
+
+	IMappedFileHandle* MappedHandle = nullptr;
+	IMappedFileRegion* MappedRegion = nullptr;
+
+	/** Bytes of the file that can be served from the mapping */
+	int64 MappedSize = 0;
+
+	/** Pages currently handed to SQLite by Fetch */
+	int32 FetchRefCount = 0;
+
+	/** The platform could not map the file, do not try again */
+	bool bMappingUnavailable = false;
+};
+
+/* ========================================================================= */
+/** Sequential read-ahead of a file (see Read)                               */
+/* ========================================================================= */
+
+struct FSQLiteReadAhead
+{
+	/** Bytes of the file starting at BufferOffset */
+	uint8* Buffer = nullptr;
+	int32 BufferCapacity = 0;
+	int32 BufferSize = 0;
+	int64 BufferOffset = 0;
+
+	/** End of the last read, a read starting there continues a sequential run */
+	int64 LastReadEnd = -1;
+	int32 SequentialReads = 0;
+
+	/** Bytes read ahead on the next miss, doubled while the run goes on */
+	int32 WindowSize = 0;
+};
+
+/* ========================================================================= */
+/** Write-behind buffer of a file (see Write)                                */
+/* ========================================================================= */
+
+/**
+ * Adjacent writes are gathered into one buffer and written in one go before
+ * anything could observe the file: reads, size queries, truncates, syncs, and
+ * the lock changes that make the writes visible to other connections.
+ */
+struct FSQLiteWriteBehind
+{
+	/** Serializes the I/O of the file with the sync flusher thread */
+	FCriticalSection CriticalSection;
+
+	/** Bytes to write at BufferOffset */
+	uint8* Buffer = nullptr;
+	int32 BufferCapacity = 0;
+	int32 BufferSize = 0;
+	int64 BufferOffset = 0;
+
+	/** Commits whose sync was postponed and bytes written since the last sync, and when the first of those commits was (FPlatformTime::Seconds) */
+	int64 UnsyncedCommits = 0;
+	int64 UnsyncedBytes = 0;
+	double UnsyncedSince = 0.0;
+};
+
+/* ========================================================================= */
+/** I/O counters of a file                                                   */
+/* ========================================================================= */
+
+struct FSQLiteFileCounters
+{
+	/** Reads that hit the end of the file */
+	int64 ShortReads = 0;
+
+	/** Reads served from the read-ahead buffer */
+	int64 ReadAheadHits = 0;
+
+	/** Reads that refilled the read-ahead buffer, and the bytes they read */
+	int64 ReadAheadFills = 0;
+	int64 BytesReadAhead = 0;
+
+	/** Writes issued to the file system, fewer than the writes of SQLite when adjacent writes are coalesced */
+	int64 IssuedWrites = 0;
+
+	/** Syncs postponed to the next flush window (relaxed durability) */
+	int64 DeferredSyncs = 0;
+};
+
+/* ========================================================================= */
+/** I/O statistics, per open file and per kind of file                       */
+/* ========================================================================= */
+
+/** Kind of file, from the flags given to Open */
+enum class ESQLiteFileType : uint8
+{
+	MainDatabase,
+	Journal,		// Rollback and super journals
+	Wal,
+	Temp,			// Temp and transient databases, temp and statement journals
+	Other,
+	Count
+};
+
+enum class ESQLiteIoOp : uint8
+{
+	Read,
+	Write,
+	Sync,
+	Truncate,
+	Count
+};
+
+/** Bucket N counts the operations that took less than 2^N microseconds, the last bucket also counts the slower ones */
+static constexpr int32 SQLiteIoLatencyBucketCount = 20;
+
+/** Figures of one kind of operation, updated without locks so that they can be read while the file is in use */
+struct FSQLiteIoOpStats
+{
+	std::atomic<int64> Count;
+	std::atomic<int64> Bytes;
+	std::atomic<int64> TotalMicroseconds;
+	std::atomic<int64> LatencyHistogram[SQLiteIoLatencyBucketCount];
+};
+
+struct FSQLiteIoStats
+{
+	FSQLiteIoOpStats Ops[(int32)ESQLiteIoOp::Count];
+};
+
+/** Copy of the I/O statistics of an open file or of a kind of file (see FSQLiteFileFuncs::GetOpenFileIoStats) */
+struct FSQLiteIoStatsSnapshot
+{
+	/** Empty for the totals of a kind of file */
+	FString Filename;
+
+	ESQLiteFileType FileType = ESQLiteFileType::Other;
+
+	struct FOp
+	{
+		int64 Count = 0;
+		int64 Bytes = 0;
+		int64 TotalMicroseconds = 0;
+		int64 LatencyHistogram[SQLiteIoLatencyBucketCount] = {};
+	};
+
+	FOp Ops[(int32)ESQLiteIoOp::Count];
+};
+
+/* ========================================================================= */
+/** WAL index shared memory of a database (see xShmMap)                      */
+/* ========================================================================= */
+
+/**
+ * One node per database file, shared by all the connections of the process.
+ * Regions live on the heap, or in named shared memory regions when the file
+ * system is configured for multi-process access and the platform has them.
+ */
+struct FSQLiteShmNode
+{
+	/** Registry key (full database filename) */
+	FString Filename;
+
+	/** Connections attached to the node */
+	int32 RefCount = 0;
+
+	/** Size of every region in bytes */
+	int32 RegionSize = 0;
+
+	/** Address of each region */
+	TArray<void*> Regions;
+
+	/** Named shared memory backing Regions, and LockWords where the platform has no fcntl locks (multi-process only) */
+	bool bNamed = false;
+	FString SharedMemoryName;
+	TArray<FPlatformMemory::FSharedMemoryRegion*> NamedRegions;
+	FPlatformMemory::FSharedMemoryRegion* NamedLockRegion = nullptr;
+
+	/** One word per lock slot, the high bit is the exclusive lock and the low bits count shared locks */
+	std::atomic<uint32>* LockWords = nullptr;
+	std::atomic<uint32> LocalLockWords[SQLITE_SHM_NLOCK];
+
+#if PLATFORM_LINUX
+	/**
+	 * Descriptor of the lock file of named shared memory. LockWords stay local
+	 * to the process, which holds one fcntl lock per slot for all its
+	 * connections, so the kernel releases them if the process dies.
+	 */
+	int LockFd = -1;
+
+	/** Serializes the changes of the slots held by the process and of their fcntl locks */
+	FCriticalSection LockSection;
+#endif
+
+	/** Protects Regions */
+	FCriticalSection CriticalSection;
+
+	FSQLiteShmNode()
+	{
+		for (std::atomic<uint32>& LockWord : LocalLockWords)
+		{
+			LockWord.store(0, std::memory_order_relaxed);
+		}
+		LockWords = LocalLockWords;
+	}
+};
+
+/** Attachment of one connection to a shared memory node */
+struct FSQLiteShm
+{
+	FSQLiteShmNode* Node = nullptr;
+
+	/** Lock slots held by this connection */
+	uint16 SharedMask = 0;
+	uint16 ExclusiveMask = 0;
+};
+
+/* ========================================================================= */
+/** Lock table of a database file (see xLock)                                */
+/* ========================================================================= */
+
+/**
+ * One node per main database file, shared by all the connections of the
+ * process. It holds the strongest lock taken in the process so that the
+ * connections arbitrate among themselves, and forwards the process lock to
+ * the OS byte-range locks where available (fcntl on Linux) for other processes.
+ */
+struct FSQLiteLockNode
+{
+	/** Registry key (full database filename) */
+	FString Filename;
+
+	/** Connections attached to the node */
+	int32 RefCount = 0;
+
+	/** Strongest lock held by a connection of the process (SQLITE_LOCK_*) */
+	int32 LockLevel = SQLITE_LOCK_NONE;
+
+	/** Connections holding at least a SHARED lock */
+	int32 SharedCount = 0;
+
+	/** Journal and WAL files of the database with a write-behind buffer, flushed before the database changes hands */
+	TArray<FSQLiteFile*> CompanionFiles;
+
+#if PLATFORM_LINUX
+	/** Descriptor the byte-range locks are taken on */
+	int LockFd = -1;
+
+	/**
+	 * Closing any descriptor of a file drops the fcntl locks the process holds
+	 * on it, so handles closed while a lock is held are kept until it is released.
+	 */
+	TArray<IFileHandle*> DeferredCloseHandles;
+	TArray<IMappedFileHandle*> DeferredCloseMappedHandles;
+#endif
+
+	FCriticalSection CriticalSection;
+};
+
+#if !PLATFORM_LINUX
+/* ========================================================================= */
+/** Write handle of a file, shared by the connections of the process         */
+/* ========================================================================= */
+
+/**
+ * Opening a file for writing is exclusive (the share mode on Windows), so
+ * the connections of the process writing the same file go through a single
+ * handle, each with its own position (see FSQLiteSharedFileHandle).
+ */
+struct FSQLiteSharedHandleNode
+{
+	/** Registry key (full filename) */
+	FString Filename;
+
+	/** Connections attached to the node */
+	int32 RefCount = 0;
+
+	IFileHandle* FileHandle = nullptr;
+
+	/** Serializes the seek and access of the connections */
+	FCriticalSection CriticalSection;
+};
+#endif
+
 /* ========================================================================= */
 /** Unreal implementation of an SQLite file (zeroed on init)                 */
 /* ========================================================================= */
@@ -25,28 +323,156 @@ struct FSQLiteFile
 	IFileHandle* FileHandle;
 	FString Filename;
 	int LockMode;
+
+	/** Flags given to Open (SQLITE_OPEN_MAIN_DB, SQLITE_OPEN_WAL, ...) */
+	int OpenFlags;
+
 	bool bDeleteOnClose;
 	bool bIsReadOnly;
 
-	static FCriticalSection CurrentlyOpenAsReadOnlySection;
-	static TSet<FString> CurrentlyOpenAsReadOnly;
-	static bool AllowOpenAsReadOnly(const TCHAR* InFilename);
-	static void CloseAsReadOnly(const TCHAR* InFilename);
+	/** Grow and truncate the file in multiples of this many bytes (SQLITE_FCNTL_CHUNK_SIZE), 0 to disable */
+	int32 ChunkSize;
+
+	/** Keep the WAL file when the last connection closes (SQLITE_FCNTL_PERSIST_WAL) */
+	bool bPersistWal;
+
+	/** Group durability of the database (see FSQLiteFileOptions), 0 when it does not postpone the WAL syncs */
+	int32 GroupSyncIntervalMs;
+	int64 GroupSyncBytes;
+
+	/** Sector size and SQLITE_IOCAP_* flags reported to SQLite, detected at Open (see DetectDeviceProperties) */
+	int32 SectorSize;
+	int32 DeviceCharacteristics;
+
+	/** Memory mapping state, only allocated for main database files */
+	FSQLiteFileMapping* Mapping;
+
+	/** Shared memory attachment, created by the first ShmMap */
+	FSQLiteShm* Shm;
+
+	/** Lock table of the file, only allocated for main database files */
+	FSQLiteLockNode* LockNode;
+
+	/** Lock table of the database a journal or WAL file belongs to */
+	FSQLiteLockNode* DatabaseNode;
+
+#if !PLATFORM_LINUX
+	/** Write handle shared with the other connections of the process, null for read-only and temporary files */
+	FSQLiteSharedHandleNode* SharedHandleNode;
+#endif
+
+	/** Write coalescing and deferred sync state (see FSQLitePlatformConfig::bUseWriteCoalescing and bRelaxedDurability) */
+	FSQLiteWriteBehind* WriteBehind;
+
+	/** Sequential read-ahead state, only allocated for main database files */
+	FSQLiteReadAhead* ReadAhead;
+
+	FSQLiteFileCounters Counters;
+
+	/** Kind of file, the I/O statistics are also added to the totals of that kind */
+	ESQLiteFileType FileType;
+	FSQLiteIoStats IoStats;
+
+#if PLATFORM_LINUX
+	/** Descriptor used for positional I/O (-1 to go through FileHandle), borrowed from the lock node for main database files */
+	int NativeFd;
+	bool bOwnsNativeFd;
+
+	/** io_uring ring of the files of the "unreal-uring" VFS, null when io_uring is not available (positional I/O) */
+	FSQLiteIoUring* Uring;
+#endif
 };
 
 /* ========================================================================= *
  * File functions used by SQLite (see sqlite3_io_methods and sqlite3_vfs)
  * @note We have to make some concessions for things not exposed in the Unreal HAL that will affect multi-process concurrency (single-process access is not affected):
- *   - We do not provide an implementation for shared memory (mmap) as not all platforms implement it (see MapNamedSharedMemoryRegion and UnmapNamedSharedMemoryRegion)
- *   - We do not provide an implementation for granular file locks as our HAL doesn't expose the concept; instead we always take a writable handle for all file opens to prevent concurrent writes
+ *   - Shared memory is heap-backed unless named shared memory is enabled (see Configure) and implemented by the platform (see MapNamedSharedMemoryRegion);
+ *     its lock slots are fcntl locks on Linux, elsewhere atomic words in that memory which a process that dies while holding one leaves held for the other processes
+ *   - File locks are arbitrated between the connections of the process by a lock table; other processes only see them where the platform has byte-range locks (fcntl on Linux)
  * ========================================================================= */
 struct FSQLiteFileFuncs
 {
 public:
-	/** Register the file system */
+	/** Register the file system, and its io_uring variant where the platform has it */
 	static void Register();
 
+	/** Configure the file system (named shared memory, read-ahead, write coalescing, durability, io_uring) */
+	static void Configure( const FSQLitePlatformConfig& InConfig );
+
+	/** Stop the sync flusher, syncing whatever it still had to - called from sqlite3_os_end */
+	static void Shutdown();
+
+	/** Sync every WAL file whose sync was postponed (relaxed or group durability) */
+	static void FlushDeferredSyncs();
+
+	/** Sync the postponed WAL syncs that are due, returns the milliseconds until the next one is - called from the sync flusher */
+	static int32 FlushDueSyncs();
+
+	/** Sync the postponed WAL syncs of a database (durability barrier) */
+	static bool FlushDurable( const FString& InDatabaseFilename );
+
+	/** Get the commits of a database whose WAL sync was postponed */
+	static void GetDurabilityWindow( const FString& InDatabaseFilename, FSQLiteDurabilityWindow& OutWindow );
+
+	/** Set the sector size and device characteristics overrides of a database, its journal and its WAL (applied when they are opened) */
+	static void SetFileOptions( const FString& InDatabaseFilename, const FSQLiteFileOptions& InOptions );
+
+	/** Get the I/O statistics of each kind of file since startup, closed files included */
+	static void GetFileTypeIoStats( TArray<FSQLiteIoStatsSnapshot>& OutStats );
+
+	/** Get the I/O statistics of each open file */
+	static void GetOpenFileIoStats( TArray<FSQLiteIoStatsSnapshot>& OutStats );
+
 private:
+	static bool bUseNamedSharedMemory;
+	static int32 ReadAheadMaxSize;
+	static bool bUseWriteCoalescing;
+	static int32 WriteCoalescingMaxSize;
+	static bool bRelaxedDurability;
+	static int32 SyncFlushWindowMs;
+	static bool bUseMemoryTempFiles;
+	static int64 MemoryTempFileSpillSize;
+	static int32 IoUringQueueDepth;
+
+	/** WAL files with a postponed sync, and the thread syncing them once per flush window */
+	static FCriticalSection DeferredSyncSection;
+	static TSet<FSQLiteFile*> DeferredSyncFiles;
+	/** Files taken out of DeferredSyncFiles and being synced outside of the critical section, closing one waits for its sync */
+	static TSet<FSQLiteFile*> SyncingFiles;
+	/** Events of the threads waiting for the sync of a file in SyncingFiles, triggered when it is done */
+	static TMultiMap<FSQLiteFile*, FEvent*> SyncWaiters;
+	static class FSQLiteSyncFlusher* SyncFlusher;
+
+	static FCriticalSection ShmNodesSection;
+	static TMap<FString, FSQLiteShmNode*> ShmNodes;
+
+	static FCriticalSection LockNodesSection;
+	static TMap<FString, FSQLiteLockNode*> LockNodes;
+
+#if !PLATFORM_LINUX
+	static FCriticalSection SharedHandleNodesSection;
+	static TMap<FString, FSQLiteSharedHandleNode*> SharedHandleNodes;
+#endif
+
+	/** I/O statistics totals of each kind of file */
+	static FSQLiteIoStats FileTypeIoStats[(int32)ESQLiteFileType::Count];
+
+	/** Files currently open, for GetOpenFileIoStats */
+	static FCriticalSection OpenFilesSection;
+	static TArray<FSQLiteFile*> OpenFiles;
+
+	/** Overrides set with SetFileOptions, by absolute database filename */
+	static FCriticalSection FileOptionsSection;
+	static TMap<FString, FSQLiteFileOptions> FileOptions;
+
+	/** Byte-range lock operations (see LockRange) */
+	enum class ERangeLock : uint8
+	{
+		Unlock,
+		Read,
+		Write
+	};
+
 	/** Attempt to open a file */
 	static int Open( sqlite3_vfs* InVFS, const char* InFilename, sqlite3_file* InFile, int InFlags, int* OutFlagsPtr );
 
@@ -86,6 +512,124 @@ private:
 	/** Get the device characteristics of a file previously opened by Open */
 	static int DeviceCharacteristics( sqlite3_file* InFile );
 
+	/** Read at an offset without moving a shared file position where the platform allows it, OutBytesRead is short at the end of the file */
+	static bool ReadAt( FSQLiteFile* InFile, uint8* OutBuffer, int64 InAmountBytes, int64 InOffsetBytes, int64& OutBytesRead );
+
+	/** Write at an offset without moving a shared file position where the platform allows it */
+	static bool WriteAt( FSQLiteFile* InFile, const uint8* InBuffer, int64 InAmountBytes, int64 InOffsetBytes );
+
+	/** Serve a read from the read-ahead buffer, refilling it when the read continues a sequential run; false to read directly */
+	static bool ReadFromReadAhead( FSQLiteFile* InFile, uint8* OutBuffer, int32 InAmountBytes, int64 InOffsetBytes );
+
+	/** Write the write-behind buffer of a file, the caller holds its critical section */
+	static bool FlushWriteBehind( FSQLiteFile* InFile );
+
+	/** Flush the write-behind buffers of the journal and WAL files of a database */
+	static void FlushCompanionWrites( FSQLiteLockNode* InDatabaseNode );
+
+	/** Sync the postponed syncs of the WAL files of a database, they have to reach the disk before the database does */
+	static bool SyncCompanionFiles( FSQLiteLockNode* InDatabaseNode );
+
+	/** Flush the write-behind buffer and sync a file with the platform primitive (fdatasync on Linux) */
+	static bool SyncFile( FSQLiteFile* InFile, int InFlags );
+
+	/** Sync a file now if its sync was postponed */
+	static bool SyncIfDeferred( FSQLiteFile* InFile );
+
+	/** Sync a file whose sync was postponed and forget its unsynced commits, the caller took it out of DeferredSyncFiles */
+	static bool SyncDeferred( FSQLiteFile* InFile );
+
+	/** Sync files added to SyncingFiles by the caller, without holding the deferred sync critical section, then remove them and wake their waiters */
+	static bool SyncTakenFiles( const TArray<FSQLiteFile*>& InFiles );
+
+	/** Start the sync flusher unless it is running, under the deferred sync critical section */
+	static void StartSyncFlusher();
+
+	/** Stop the sync flusher if it is running, taken out under the deferred sync critical section and joined outside of it */
+	static void StopSyncFlusher();
+
+	/** Whether the WAL syncs of a file or of its database are postponed (relaxed or group durability) */
+	static bool HasDeferredSyncs( const FSQLiteFile* InFile );
+
+	/** Find the lock table of a database and keep it alive, null if the database is not open */
+	static FSQLiteLockNode* FindLockNode( const FString& InFilename );
+
+	/** Times an operation and adds it to the I/O statistics of the file and of its kind when leaving the scope */
+	struct FIoScope;
+
+	/** Add an operation to the I/O statistics of a file and of its kind */
+	static void RecordIo( FSQLiteFile* InFile, ESQLiteIoOp InOp, int64 InBytes, uint64 InStartCycles );
+
+	static void SnapshotIoStats( const FSQLiteIoStats& InStats, FSQLiteIoStatsSnapshot& OutSnapshot );
+
+	/** Detect the sector size and device characteristics of the file system a file lives on */
+	static void DetectDeviceProperties( FSQLiteFile* InFile );
+
+	/** Get the file ready to grow to InSizeBytes (SQLITE_FCNTL_SIZE_HINT), extending it to whole chunks when a chunk size is set */
+	static bool SizeHint( FSQLiteFile* InFile, int64 InSizeBytes );
+
+	/** Drop the read-ahead buffer, other connections may change the file whenever the locks change */
+	static void InvalidateReadAhead( FSQLiteFile* InFile );
+
+	/** Attach a file to the lock table of its database */
+	static void AcquireLockNode( FSQLiteFile* InFile );
+
+	/** Drop a reference to a lock table, freeing it with the last connection */
+	static void ReleaseLockNode( FSQLiteLockNode* InLockNode );
+
+	/** Close the handle of a file, or keep it open while the process holds a lock on the file */
+	static void CloseFileHandle( FSQLiteFile* InFile );
+
+	/** Open a file for writing so that the other connections of the process can write it as well */
+	static IFileHandle* OpenWriteHandle( FSQLiteFile* InFile, int InFlags );
+
+#if !PLATFORM_LINUX
+	/** Drop a reference to a shared write handle, closing it with the last connection */
+	static void ReleaseSharedHandleNode( FSQLiteSharedHandleNode* InNode );
+#endif
+
+	/** Take or release an OS byte-range lock for the process, always succeeds where the platform has none */
+	static bool LockRange( FSQLiteLockNode* InLockNode, ERangeLock InLockType, int64 InStart, int64 InLength );
+
+	/** Check whether another process holds a lock on a byte range */
+	static bool IsRangeLockedByOtherProcess( FSQLiteLockNode* InLockNode, int64 InStart, int64 InLength );
+
+	/** Map a region of the shared memory of a file previously opened by Open */
+	static int ShmMap( sqlite3_file* InFile, int InRegionIndex, int InRegionSizeBytes, int bInExtend, void volatile** OutPtr );
+
+	/** Acquire or release shared memory lock slots */
+	static int ShmLock( sqlite3_file* InFile, int InOffset, int InCount, int InFlags );
+
+	/** Acquire or release shared memory lock slots, serialized by the caller when the process holds fcntl locks for them */
+	static int ShmLockSlots( FSQLiteFile* InFile, int InOffset, int InCount, int InFlags );
+
+	/** Take or release the fcntl lock of a slot for the process, always succeeds when other processes do not share the memory */
+	static bool ShmSystemLock( FSQLiteShmNode* InNode, ERangeLock InLockType, int32 InSlot );
+
+	/** Full memory barrier on the shared memory */
+	static void ShmBarrier( sqlite3_file* InFile );
+
+	/** Detach from the shared memory, freeing it with the last connection */
+	static int ShmUnmap( sqlite3_file* InFile, int bInDelete );
+
+	/** Attach a file to the shared memory node of its database */
+	static bool ShmAttach( FSQLiteFile* InFile );
+
+	/** Map a named shared memory region, opening an existing one before creating it if allowed */
+	static FPlatformMemory::FSharedMemoryRegion* MapNamedRegion( const FString& InName, SIZE_T InSizeBytes, bool bInCreate );
+
+	/** Get a pointer to a memory mapped page of a file previously opened by Open (nullptr to use Read instead) */
+	static int Fetch( sqlite3_file* InFile, sqlite3_int64 InOffsetBytes, int InAmountBytes, void** OutPtr );
+
+	/** Release a page returned by Fetch, or drop the mapping when InPtr is null */
+	static int Unfetch( sqlite3_file* InFile, sqlite3_int64 InOffsetBytes, void* InPtr );
+
+	/** Map (or remap) the file so that at least InRequiredSizeBytes bytes can be fetched */
+	static bool MapFile( FSQLiteFile* InFile, int64 InRequiredSizeBytes );
+
+	/** Drop the mapping of a file */
+	static void UnmapFile( FSQLiteFile* InFile );
+
 	/** Attempt to delete the named file */
 	static int Delete( sqlite3_vfs* InVFS, const char* InFilename, int InSyncDir );
 
@@ -111,4 +655,113 @@ private:
 	static int GetLastError( sqlite3_vfs* InVFS, int InOutputBufferSizeBytes, char* InOutputBuffer );
 };
 
+/* ========================================================================= */
+/** Growable in-memory handle of a temporary file, moving to disk past a size */
+/* ========================================================================= */
+
+class FSQLiteMemoryFileHandle : public IFileHandle
+{
+public:
+	FSQLiteMemoryFileHandle( const FString& InSpillFilename, int64 InSpillSize );
+	virtual ~FSQLiteMemoryFileHandle();
+
+	virtual int64 Tell() override;
+	virtual bool Seek( int64 InNewPosition ) override;
+	virtual bool SeekFromEnd( int64 InNewPositionRelativeToEnd = 0 ) override;
+	virtual bool Read( uint8* OutDestination, int64 InBytesToRead ) override;
+	virtual bool Write( const uint8* InSource, int64 InBytesToWrite ) override;
+	virtual bool Flush( const bool bInFullFlush = false ) override;
+	virtual bool Truncate( int64 InNewSize ) override;
+	virtual int64 Size() override;
+
+private:
+	/** Move the contents to the spill file, every call is forwarded to it from then on */
+	bool Spill();
+
+	FString SpillFilename;
+	int64 SpillSize;
+
+	TArray64<uint8> Data;
+	int64 Position;
+
+	IFileHandle* SpillHandle;
+};
+
+#if PLATFORM_LINUX
+/* ========================================================================= */
+/** Handle over a descriptor, unlike OpenWrite it does not lock the file     */
+/* ========================================================================= */
+
+/**
+ * PlatformFile.OpenWrite takes an exclusive flock, so a second connection
+ * could not write the file. The descriptor belongs to the caller, the main
+ * database is written through the one its byte-range locks are taken on.
+ */
+class FSQLiteDescriptorFileHandle : public IFileHandle
+{
+public:
+	FSQLiteDescriptorFileHandle( int InFd );
+
+	virtual int64 Tell() override;
+	virtual bool Seek( int64 InNewPosition ) override;
+	virtual bool SeekFromEnd( int64 InNewPositionRelativeToEnd = 0 ) override;
+	virtual bool Read( uint8* OutDestination, int64 InBytesToRead ) override;
+	virtual bool Write( const uint8* InSource, int64 InBytesToWrite ) override;
+	virtual bool Flush( const bool bInFullFlush = false ) override;
+	virtual bool Truncate( int64 InNewSize ) override;
+	virtual int64 Size() override;
+
+private:
+	int Fd;
+	int64 Position;
+};
+#else
+/* ========================================================================= */
+/** View of a connection on a shared write handle, with its own position     */
+/* ========================================================================= */
+
+class FSQLiteSharedFileHandle : public IFileHandle
+{
+public:
+	FSQLiteSharedFileHandle( FSQLiteSharedHandleNode* InNode );
+
+	virtual int64 Tell() override;
+	virtual bool Seek( int64 InNewPosition ) override;
+	virtual bool SeekFromEnd( int64 InNewPositionRelativeToEnd = 0 ) override;
+	virtual bool Read( uint8* OutDestination, int64 InBytesToRead ) override;
+	virtual bool Write( const uint8* InSource, int64 InBytesToWrite ) override;
+	virtual bool Flush( const bool bInFullFlush = false ) override;
+	virtual bool Truncate( int64 InNewSize ) override;
+	virtual int64 Size() override;
+
+private:
+	FSQLiteSharedHandleNode* Node;
+	int64 Position;
+};
+#endif
+
+/* ========================================================================= */
+/** Thread syncing the postponed WAL syncs when they are due                 */
+/* ========================================================================= */
+
+class FSQLiteSyncFlusher : public FRunnable
+{
+public:
+	FSQLiteSyncFlusher( int32 InFlushWindowMs );
+	virtual ~FSQLiteSyncFlusher();
+
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+	/** Look at the postponed syncs again, a file started a window or went past its byte threshold */
+	void Wake();
+
+private:
+	/** Wait when nothing is pending */
+	int32 FlushWindowMs;
+	std::atomic<bool> bStopping;
+	FEvent* WakeEvent;
+	FRunnableThread* Thread;
+};
+
 #endif
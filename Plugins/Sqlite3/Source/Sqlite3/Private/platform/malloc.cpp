@@ -3,6 +3,7 @@
 #if SQLITE_OS_OTHER
 
 #include "../../Sqlite3/Private/platform/malloc.h"
+#include "../../Sqlite3/Private/platform/SQLite3Platform.h"
 #include "Sqlite3Log.h"
 
 #include "CoreTypes.h"
@@ -13,37 +14,91 @@
 #include "HAL/PlatformFileManager.h"
 #include "HAL/PlatformFile.h"
 #include "Templates/Atomic.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "HAL/PlatformMemory.h"
+
+#include <atomic>
 
 THIRD_PARTY_INCLUDES_START
 #include "sqlite/sqlite3.h-inline"
 THIRD_PARTY_INCLUDES_END
 
+// ============================================================================
+// = LLM tagging
+// = All SQLite allocations go to the "Sqlite" tag, or to the per-database
+// = "Sqlite/<Database>" tag published by USqliteDatabase (see
+// = FSQLiteThreadContext).
+// ============================================================================
+
+LLM_DEFINE_TAG( Sqlite );
+
+#define SQLITE_LLM_SCOPE() LLM_SCOPE( GetLLMTag() )
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+
+FName FSQLiteMallocFuncs::GetLLMTag()
+{
+	static const FName SqliteLLMTag( TEXT( "Sqlite" ) );
+
+	const FName& DatabaseLLMTag = FSQLiteThreadContext::Get().LLMTag;
+	return DatabaseLLMTag.IsNone() ? SqliteLLMTag : DatabaseLLMTag;
+}
+
+#endif
+
+// ============================================================================
+// = 
+// ============================================================================
+
 bool FSQLiteMallocFuncs::bRegistered = false;
+bool FSQLiteMallocFuncs::bUseWorkaround = false;
+
+const sqlite3_mem_methods FSQLiteMallocFuncs::MallocFuncs = {
+	&Malloc,
+	&Free,
+	&Realloc,
+	&Size,
+	&Roundup,
+	&Init,
+	&Shutdown,
+	nullptr,
+};
+
+const sqlite3_mem_methods FSQLiteMallocFuncs::WorkaroundMallocFuncs = {
+	&WorkaroundMalloc,
+	&WorkaroundFree,
+	&WorkaroundRealloc,
+	&WorkaroundSize,
+	&WorkaroundRoundup,
+	&Init,
+	&Shutdown,
+	nullptr,
+};
 
-void FSQLiteMallocFuncs::Register()
-{
-	static const sqlite3_mem_methods MallocFuncs = {
-		&Malloc,
-		&Free,
-		&Realloc,
-		&Size,
-		&Roundup,
-		&Init,
-		&Shutdown,
-		nullptr,
-	};
-
-	static const sqlite3_mem_methods WorkaroundMallocFuncs = {
-		&WorkaroundMalloc,
-		&WorkaroundFree,
-		&WorkaroundRealloc,
-		&WorkaroundSize,
-		&WorkaroundRoundup,
-		&Init,
-		&Shutdown,
-		nullptr,
-	};
+const sqlite3_mem_methods FSQLiteMallocFuncs::SlabMallocFuncs = {
+	&SlabMalloc,
+	&SlabFree,
+	&SlabRealloc,
+	&SlabSize,
+	&SlabRoundup,
+	&Init,
+	&Shutdown,
+	nullptr,
+};
 
+const sqlite3_mem_methods FSQLiteMallocFuncs::CountedMallocFuncs = {
+	&CountedMalloc,
+	&CountedFree,
+	&CountedRealloc,
+	&CountedSize,
+	&CountedRoundup,
+	&CountedInit,
+	&CountedShutdown,
+	nullptr,
+};
+
+void FSQLiteMallocFuncs::Register( const bool bInUseSlabAllocator, const int64 InSlabRegionSize, const bool bInCountAllocations )
+{
 	if( ! bRegistered )
 	{
 		// SQLite needs a working FMemory::GetAllocSize, so check if the
@@ -55,12 +110,57 @@ void FSQLiteMallocFuncs::Register()
 
 		// Use the workaround functions if GetAllocSize is not supported.
 
-		sqlite3_config( SQLITE_CONFIG_MALLOC, bSupportsGetAllocSize ? &MallocFuncs : &WorkaroundMallocFuncs );
+		bUseWorkaround = !bSupportsGetAllocSize;
+
+		// The slab allocator uses them for the blocks too large for a slab.
+
+		if( bInUseSlabAllocator && InSlabRegionSize >= SlabChunkSize )
+		{
+			for( int Granule = 0; Granule <= SlabMaxSmallSize / 16; ++Granule )
+			{
+				int SizeClass = 0;
+				while( SlabSizeClasses[SizeClass] < Granule * 16 )
+				{
+					++SizeClass;
+				}
+				SlabSizeClassIndex[Granule] = (uint8)SizeClass;
+			}
+
+			SlabRegion = FPlatformMemory::FPlatformVirtualMemoryBlock::AllocateVirtual( Align( InSlabRegionSize, SlabChunkSize ), SlabChunkSize );
+			SlabRegionBase = (uint8*)SlabRegion.GetVirtualPointer();
+			SlabRegionSize = SlabRegionBase ? Align( InSlabRegionSize, SlabChunkSize ) : 0;
+			SlabChunkSizeClass = (uint8*)FMemory::MallocZeroed( FMath::Max<int64>( SlabRegionSize >> SlabChunkShift, 1 ) );
+		}
+
+		const sqlite3_mem_methods* Funcs = SlabRegionBase ? &SlabMallocFuncs
+			: bUseWorkaround ? &WorkaroundMallocFuncs
+			: &MallocFuncs;
+
+		if( bInCountAllocations )
+		{
+			BaseFuncs = Funcs;
+			Funcs = &CountedMallocFuncs;
+		}
+
+		sqlite3_config( SQLITE_CONFIG_MALLOC, Funcs );
 
 		bRegistered = true;
 	}
 }
 
+/** Get the allocation functions Register chooses from */
+void FSQLiteMallocFuncs::GetAllocators( TArray<FSQLiteAllocator>& OutAllocators )
+{
+	OutAllocators.Reset();
+	OutAllocators.Add( { TEXT( "FMemory" ), &MallocFuncs } );
+	OutAllocators.Add( { TEXT( "FMemory with size header" ), &WorkaroundMallocFuncs } );
+
+	if( SlabRegionBase )
+	{
+		OutAllocators.Add( { TEXT( "Slabs" ), &SlabMallocFuncs } );
+	}
+}
+
 // ============================================================================
 // = 
 // ============================================================================
@@ -83,6 +183,7 @@ void FSQLiteMallocFuncs::Shutdown(void*)
 /** Allocate memory */
 void* FSQLiteMallocFuncs::Malloc(int InSizeBytes)
 {
+	SQLITE_LLM_SCOPE();
 	return FMemory::Malloc(InSizeBytes, DEFAULT_ALIGNMENT);
 }
 
@@ -95,6 +196,7 @@ void FSQLiteMallocFuncs::Free(void* InPtr)
 /** Reallocate memory returned by Alloc or Realloc */
 void* FSQLiteMallocFuncs::Realloc(void* InPtr, int InSizeBytes)
 {
+	SQLITE_LLM_SCOPE();
 	return FMemory::Realloc(InPtr, InSizeBytes, DEFAULT_ALIGNMENT);
 }
 
@@ -117,6 +219,7 @@ int FSQLiteMallocFuncs::Roundup(int InSizeBytes)
 /** Allocate memory */
 void* FSQLiteMallocFuncs::WorkaroundMalloc(int InSizeBytes)
 {
+	SQLITE_LLM_SCOPE();
 	void* Result = FMemory::Malloc(InSizeBytes + WorkaroundHeaderSize, DEFAULT_ALIGNMENT);
 	if (Result)
 	{
@@ -138,6 +241,7 @@ void FSQLiteMallocFuncs::WorkaroundFree(void* InPtr)
 /** Reallocate memory returned by Alloc or Realloc */
 void* FSQLiteMallocFuncs::WorkaroundRealloc(void* InPtr, int InSizeBytes)
 {
+	SQLITE_LLM_SCOPE();
 	if (InPtr)
 	{
 		InPtr = (char*)InPtr - WorkaroundHeaderSize;
@@ -163,4 +267,463 @@ int FSQLiteMallocFuncs::WorkaroundRoundup(int InSizeBytes)
 	return (int)FMemory::QuantizeSize(InSizeBytes + WorkaroundHeaderSize, DEFAULT_ALIGNMENT) - WorkaroundHeaderSize;
 }
 
+// ============================================================================
+// = Slab allocator
+// ============================================================================
+
+const int FSQLiteMallocFuncs::SlabSizeClasses[FSQLiteMallocFuncs::SlabSizeClassCount] = {
+	16, 32, 48, 64, 80, 96, 112, 128,
+	160, 192, 224, 256, 320, 384, 448, 512,
+	640, 768, 896, 1024, 1280, 1536, 1792, 2048
+};
+
+uint8 FSQLiteMallocFuncs::SlabSizeClassIndex[FSQLiteMallocFuncs::SlabMaxSmallSize / 16 + 1] = { 0 };
+
+FPlatformMemory::FPlatformVirtualMemoryBlock FSQLiteMallocFuncs::SlabRegion;
+uint8* FSQLiteMallocFuncs::SlabRegionBase = nullptr;
+int64 FSQLiteMallocFuncs::SlabRegionSize = 0;
+uint8* FSQLiteMallocFuncs::SlabChunkSizeClass = nullptr;
+
+/** A free block, linked through its first bytes */
+struct FSQLiteSlabFreeBlock
+{
+	FSQLiteSlabFreeBlock* Next;
+};
+
+/** Shared list of free blocks of a size class */
+struct FSQLiteSlabSharedList
+{
+	FCriticalSection CriticalSection;
+	FSQLiteSlabFreeBlock* Head = nullptr;
+	int32 Count = 0;
+};
+
+static FSQLiteSlabSharedList SlabSharedLists[FSQLiteMallocFuncs::SlabSizeClassCount];
+
+/** Next chunk of the region to commit */
+static FCriticalSection SlabChunkCriticalSection;
+static int64 SlabNextChunk = 0;
+
+/** Blocks moved between a thread cache and the shared lists at once */
+static constexpr int SlabBatchBytes = 16 * 1024;
+
+static int GetSlabBatchCount( const int InBlockSize )
+{
+	return FMath::Clamp( SlabBatchBytes / InBlockSize, 4, 64 );
+}
+
+/** Free blocks owned by a thread, given back to the shared lists when the thread exits */
+struct FSQLiteSlabThreadCache
+{
+	FSQLiteSlabFreeBlock* Heads[FSQLiteMallocFuncs::SlabSizeClassCount] = { nullptr };
+	int32 Counts[FSQLiteMallocFuncs::SlabSizeClassCount] = { 0 };
+
+	~FSQLiteSlabThreadCache()
+	{
+		for( int SizeClass = 0; SizeClass < FSQLiteMallocFuncs::SlabSizeClassCount; ++SizeClass )
+		{
+			if( Counts[SizeClass] > 0 )
+			{
+				FSQLiteMallocFuncs::SlabRelease( *this, SizeClass, Counts[SizeClass] );
+			}
+		}
+	}
+
+	static FSQLiteSlabThreadCache& Get()
+	{
+		static thread_local FSQLiteSlabThreadCache ThreadCache;
+		return ThreadCache;
+	}
+};
+
+/** Allocate memory */
+void* FSQLiteMallocFuncs::SlabMalloc( int InSizeBytes )
+{
+	if( InSizeBytes > 0 && InSizeBytes <= SlabMaxSmallSize )
+	{
+		const int SizeClass = SlabSizeClassIndex[( InSizeBytes + 15 ) / 16];
+
+		FSQLiteSlabThreadCache& ThreadCache = FSQLiteSlabThreadCache::Get();
+		if( FSQLiteSlabFreeBlock* Block = ThreadCache.Heads[SizeClass] )
+		{
+			ThreadCache.Heads[SizeClass] = Block->Next;
+			ThreadCache.Counts[SizeClass]--;
+			return Block;
+		}
+
+		if( void* Block = SlabRefill( SizeClass ) )
+		{
+			return Block;
+		}
+
+		// Region exhausted, fall through to FMemory
+	}
+
+	return bUseWorkaround ? WorkaroundMalloc( InSizeBytes ) : Malloc( InSizeBytes );
+}
+
+/** Free memory returned by Alloc or Realloc */
+void FSQLiteMallocFuncs::SlabFree( void* InPtr )
+{
+	if( !IsSlabBlock( InPtr ) )
+	{
+		bUseWorkaround ? WorkaroundFree( InPtr ) : Free( InPtr );
+		return;
+	}
+
+	const int SizeClass = SlabChunkSizeClass[( (uint8*)InPtr - SlabRegionBase ) >> SlabChunkShift];
+
+	FSQLiteSlabThreadCache& ThreadCache = FSQLiteSlabThreadCache::Get();
+
+	FSQLiteSlabFreeBlock* Block = (FSQLiteSlabFreeBlock*)InPtr;
+	Block->Next = ThreadCache.Heads[SizeClass];
+	ThreadCache.Heads[SizeClass] = Block;
+
+	// Keep at most two batches per thread, give one back when over
+
+	const int BatchCount = GetSlabBatchCount( SlabSizeClasses[SizeClass] );
+	if( ++ThreadCache.Counts[SizeClass] > 2 * BatchCount )
+	{
+		SlabRelease( ThreadCache, SizeClass, BatchCount );
+	}
+}
+
+/** Reallocate memory returned by Alloc or Realloc */
+void* FSQLiteMallocFuncs::SlabRealloc( void* InPtr, int InSizeBytes )
+{
+	if( !InPtr )
+	{
+		return SlabMalloc( InSizeBytes );
+	}
+
+	const int OldSize = SlabSize( InPtr );
+
+	if( IsSlabBlock( InPtr ) )
+	{
+		if( InSizeBytes <= OldSize )
+		{
+			return InPtr;
+		}
+	}
+	else if( InSizeBytes > SlabMaxSmallSize )
+	{
+		return bUseWorkaround ? WorkaroundRealloc( InPtr, InSizeBytes ) : Realloc( InPtr, InSizeBytes );
+	}
+
+	void* Result = SlabMalloc( InSizeBytes );
+	if( Result )
+	{
+		FMemory::Memcpy( Result, InPtr, FMath::Min( OldSize, InSizeBytes ) );
+		SlabFree( InPtr );
+	}
+	return Result;
+}
+
+/** Get the actual size of an allocation returned by Alloc or Realloc */
+int FSQLiteMallocFuncs::SlabSize( void* InPtr )
+{
+	if( !IsSlabBlock( InPtr ) )
+	{
+		return bUseWorkaround ? WorkaroundSize( InPtr ) : Size( InPtr );
+	}
+
+	return SlabSizeClasses[SlabChunkSizeClass[( (uint8*)InPtr - SlabRegionBase ) >> SlabChunkShift]];
+}
+
+/** Roundup to the expected allocation size */
+int FSQLiteMallocFuncs::SlabRoundup( int InSizeBytes )
+{
+	if( InSizeBytes > 0 && InSizeBytes <= SlabMaxSmallSize )
+	{
+		return SlabSizeClasses[SlabSizeClassIndex[( InSizeBytes + 15 ) / 16]];
+	}
+
+	return bUseWorkaround ? WorkaroundRoundup( InSizeBytes ) : Roundup( InSizeBytes );
+}
+
+/** Refill the calling thread cache of a size class */
+void* FSQLiteMallocFuncs::SlabRefill( const int InSizeClass )
+{
+	const int BlockSize = SlabSizeClasses[InSizeClass];
+	const int BatchCount = GetSlabBatchCount( BlockSize );
+
+	FSQLiteSlabSharedList& SharedList = SlabSharedLists[InSizeClass];
+
+	FSQLiteSlabFreeBlock* Head = nullptr;
+	int32 Count = 0;
+
+	{
+		FScopeLock Lock( &SharedList.CriticalSection );
+
+		while( SharedList.Head && Count < BatchCount )
+		{
+			FSQLiteSlabFreeBlock* Block = SharedList.Head;
+			SharedList.Head = Block->Next;
+			Block->Next = Head;
+			Head = Block;
+			++Count;
+		}
+
+		SharedList.Count -= Count;
+	}
+
+	if( !Head )
+	{
+		// Commit a new chunk and carve it into blocks of the size class
+
+		uint8* Chunk = nullptr;
+		{
+			FScopeLock Lock( &SlabChunkCriticalSection );
+
+			if( ( SlabNextChunk + 1 ) * SlabChunkSize > SlabRegionSize )
+			{
+				return nullptr;
+			}
+
+			SlabRegion.Commit( SlabNextChunk * SlabChunkSize, SlabChunkSize );
+			SlabChunkSizeClass[SlabNextChunk] = (uint8)InSizeClass;
+			Chunk = SlabRegionBase + SlabNextChunk * SlabChunkSize;
+			++SlabNextChunk;
+		}
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+		{
+			LLM_SCOPE_BYNAME( TEXT( "Sqlite/Slabs" ) );
+			LLM_IF_ENABLED( FLowLevelMemTracker::Get().OnLowLevelAlloc( ELLMTracker::Default, Chunk, SlabChunkSize ) );
+		}
+#endif
+
+		for( int Offset = SlabChunkSize - ( SlabChunkSize % BlockSize ) - BlockSize; Offset >= 0; Offset -= BlockSize )
+		{
+			FSQLiteSlabFreeBlock* Block = (FSQLiteSlabFreeBlock*)( Chunk + Offset );
+			Block->Next = Head;
+			Head = Block;
+			++Count;
+		}
+	}
+
+	// First block goes to the caller, the rest to the thread cache
+
+	FSQLiteSlabThreadCache& ThreadCache = FSQLiteSlabThreadCache::Get();
+
+	FSQLiteSlabFreeBlock* Result = Head;
+	Head = Head->Next;
+
+	while( Head )
+	{
+		FSQLiteSlabFreeBlock* Block = Head;
+		Head = Block->Next;
+		Block->Next = ThreadCache.Heads[InSizeClass];
+		ThreadCache.Heads[InSizeClass] = Block;
+		ThreadCache.Counts[InSizeClass]++;
+	}
+
+	return Result;
+}
+
+/** Give a batch of blocks from a thread cache back to the shared list */
+void FSQLiteMallocFuncs::SlabRelease( FSQLiteSlabThreadCache& InThreadCache, const int InSizeClass, const int InCount )
+{
+	// Detach the batch before taking the lock
+
+	FSQLiteSlabFreeBlock* Head = InThreadCache.Heads[InSizeClass];
+	FSQLiteSlabFreeBlock* Tail = Head;
+	for( int Index = 1; Index < InCount; ++Index )
+	{
+		Tail = Tail->Next;
+	}
+
+	InThreadCache.Heads[InSizeClass] = Tail->Next;
+	InThreadCache.Counts[InSizeClass] -= InCount;
+
+	FSQLiteSlabSharedList& SharedList = SlabSharedLists[InSizeClass];
+
+	FScopeLock Lock( &SharedList.CriticalSection );
+
+	Tail->Next = SharedList.Head;
+	SharedList.Head = Head;
+	SharedList.Count += InCount;
+}
+
+// ============================================================================
+// = Memory statistics
+// = Each thread updates its own shard with relaxed atomics, figures are summed
+// = on read. This replaces SQLite memstatus and its SQLITE_MUTEX_STATIC_MEM
+// = global mutex.
+// ============================================================================
+
+const sqlite3_mem_methods* FSQLiteMallocFuncs::BaseFuncs = nullptr;
+
+static constexpr int MemoryStatsShardCount = 16;
+
+/** Allocations between two samples of the high-water marks */
+static constexpr uint32 MemoryStatsSampleInterval = 64;
+
+struct alignas( PLATFORM_CACHE_LINE_SIZE ) FSQLiteMemoryStatsShard
+{
+	std::atomic<int64> MemoryUsed{ 0 };
+	std::atomic<int64> AllocationCount{ 0 };
+};
+
+static FSQLiteMemoryStatsShard MemoryStatsShards[MemoryStatsShardCount];
+
+static std::atomic<int64> MemoryUsedHighWater{ 0 };
+static std::atomic<int64> AllocationCountHighWater{ 0 };
+static std::atomic<int64> LargestAllocation{ 0 };
+
+static std::atomic<uint32> NextMemoryStatsShard{ 0 };
+
+struct FSQLiteMemoryStatsThreadState
+{
+	FSQLiteMemoryStatsShard* Shard;
+	uint32 SampleCountdown;
+
+	static FSQLiteMemoryStatsThreadState& Get()
+	{
+		static thread_local FSQLiteMemoryStatsThreadState ThreadState = {
+			&MemoryStatsShards[NextMemoryStatsShard.fetch_add( 1, std::memory_order_relaxed ) % MemoryStatsShardCount],
+			MemoryStatsSampleInterval
+		};
+		return ThreadState;
+	}
+};
+
+static void AtomicMax( std::atomic<int64>& InOutValue, const int64 InCandidate )
+{
+	int64 Current = InOutValue.load( std::memory_order_relaxed );
+	while( InCandidate > Current && !InOutValue.compare_exchange_weak( Current, InCandidate, std::memory_order_relaxed ) )
+	{
+	}
+}
+
+static void SumMemoryStats( int64& OutMemoryUsed, int64& OutAllocationCount )
+{
+	OutMemoryUsed = 0;
+	OutAllocationCount = 0;
+
+	for( const FSQLiteMemoryStatsShard& Shard : MemoryStatsShards )
+	{
+		OutMemoryUsed += Shard.MemoryUsed.load( std::memory_order_relaxed );
+		OutAllocationCount += Shard.AllocationCount.load( std::memory_order_relaxed );
+	}
+}
+
+static void SampleMemoryHighWater()
+{
+	int64 MemoryUsed, AllocationCount;
+	SumMemoryStats( MemoryUsed, AllocationCount );
+
+	AtomicMax( MemoryUsedHighWater, MemoryUsed );
+	AtomicMax( AllocationCountHighWater, AllocationCount );
+}
+
+static void CountAllocation( const int64 InBlockSize, const int InRequestedSize )
+{
+	FSQLiteMemoryStatsThreadState& ThreadState = FSQLiteMemoryStatsThreadState::Get();
+
+	ThreadState.Shard->MemoryUsed.fetch_add( InBlockSize, std::memory_order_relaxed );
+	ThreadState.Shard->AllocationCount.fetch_add( 1, std::memory_order_relaxed );
+
+	if( InRequestedSize > LargestAllocation.load( std::memory_order_relaxed ) )
+	{
+		AtomicMax( LargestAllocation, InRequestedSize );
+	}
+
+	// Large blocks move the totals enough to be sampled right away
+
+	if( --ThreadState.SampleCountdown == 0 || InBlockSize >= 64 * 1024 )
+	{
+		ThreadState.SampleCountdown = MemoryStatsSampleInterval;
+		SampleMemoryHighWater();
+	}
+}
+
+static void CountFree( const int64 InBlockSize )
+{
+	FSQLiteMemoryStatsThreadState& ThreadState = FSQLiteMemoryStatsThreadState::Get();
+
+	ThreadState.Shard->MemoryUsed.fetch_sub( InBlockSize, std::memory_order_relaxed );
+	ThreadState.Shard->AllocationCount.fetch_sub( 1, std::memory_order_relaxed );
+}
+
+/** Get the memory statistics kept by the shim */
+void FSQLiteMallocFuncs::GetMemoryStats( FSQLiteMemoryStats& OutStats, const bool bResetHighWater )
+{
+	SampleMemoryHighWater();
+
+	SumMemoryStats( OutStats.MemoryUsed, OutStats.AllocationCount );
+	OutStats.MemoryUsedHighWater = MemoryUsedHighWater.load( std::memory_order_relaxed );
+	OutStats.AllocationCountHighWater = AllocationCountHighWater.load( std::memory_order_relaxed );
+	OutStats.LargestAllocation = LargestAllocation.load( std::memory_order_relaxed );
+
+	if( bResetHighWater )
+	{
+		MemoryUsedHighWater.store( OutStats.MemoryUsed, std::memory_order_relaxed );
+		AllocationCountHighWater.store( OutStats.AllocationCount, std::memory_order_relaxed );
+		LargestAllocation.store( 0, std::memory_order_relaxed );
+	}
+}
+
+/** Initialize the malloc system */
+int FSQLiteMallocFuncs::CountedInit( void* InAppData )
+{
+	return BaseFuncs->xInit( InAppData );
+}
+
+/** Shutdown the malloc system */
+void FSQLiteMallocFuncs::CountedShutdown( void* InAppData )
+{
+	BaseFuncs->xShutdown( InAppData );
+}
+
+/** Allocate memory */
+void* FSQLiteMallocFuncs::CountedMalloc( int InSizeBytes )
+{
+	void* Result = BaseFuncs->xMalloc( InSizeBytes );
+	if( Result )
+	{
+		CountAllocation( BaseFuncs->xSize( Result ), InSizeBytes );
+	}
+	return Result;
+}
+
+/** Free memory returned by Alloc or Realloc */
+void FSQLiteMallocFuncs::CountedFree( void* InPtr )
+{
+	if( InPtr )
+	{
+		CountFree( BaseFuncs->xSize( InPtr ) );
+		BaseFuncs->xFree( InPtr );
+	}
+}
+
+/** Reallocate memory returned by Alloc or Realloc */
+void* FSQLiteMallocFuncs::CountedRealloc( void* InPtr, int InSizeBytes )
+{
+	const int64 OldSize = InPtr ? BaseFuncs->xSize( InPtr ) : 0;
+
+	void* Result = BaseFuncs->xRealloc( InPtr, InSizeBytes );
+	if( Result )
+	{
+		if( InPtr )
+		{
+			CountFree( OldSize );
+		}
+		CountAllocation( BaseFuncs->xSize( Result ), InSizeBytes );
+	}
+	return Result;
+}
+
+/** Get the actual size of an allocation returned by Alloc or Realloc */
+int FSQLiteMallocFuncs::CountedSize( void* InPtr )
+{
+	return BaseFuncs->xSize( InPtr );
+}
+
+/** Roundup to the expected allocation size */
+int FSQLiteMallocFuncs::CountedRoundup( int InSizeBytes )
+{
+	return BaseFuncs->xRoundup( InSizeBytes );
+}
+
 #endif
@@ -10,11 +10,32 @@
 #include "HAL/PlatformFileManager.h"
 #include "HAL/PlatformFile.h"
 #include "Templates/Atomic.h"
+#include "HAL/PlatformMemory.h"
+#include "UObject/NameTypes.h"
 
 THIRD_PARTY_INCLUDES_START
 #include "sqlite/sqlite3.h-inline"
 THIRD_PARTY_INCLUDES_END
 
+struct FSQLiteSlabThreadCache;
+
+/** Allocation functions of the malloc shim, for comparisons (see sqlite.Bench Alloc) */
+struct FSQLiteAllocator
+{
+	const TCHAR* Name;
+	const sqlite3_mem_methods* Funcs;
+};
+
+/** Memory figures kept by the malloc shim when SQLite memory statistics are off */
+struct FSQLiteMemoryStats
+{
+	int64 MemoryUsed = 0;
+	int64 MemoryUsedHighWater = 0;
+	int64 AllocationCount = 0;
+	int64 AllocationCountHighWater = 0;
+	int64 LargestAllocation = 0;
+};
+
 // ============================================================================
 // = Malloc functions used by SQLite (see sqlite3_mem_methods) ================
 // ============================================================================
@@ -22,12 +43,53 @@ THIRD_PARTY_INCLUDES_END
 struct FSQLiteMallocFuncs
 {
 public:
-	/** Register the malloc system */
-	static void Register();
+	/**
+	 * Register the malloc system
+	 *
+	 * @param bInUseSlabAllocator - Serve small blocks from size-class slabs with per-thread free caches
+	 * @param InSlabRegionSize - Bytes of address space reserved for the slabs
+	 * @param bInCountAllocations - Keep memory statistics in the shim (when SQLite memstatus is off)
+	 */
+	static void Register( bool bInUseSlabAllocator, int64 InSlabRegionSize, bool bInCountAllocations );
+
+	/** Are memory statistics kept by the shim */
+	static bool IsCountingAllocations() { return BaseFuncs != nullptr; }
+
+	/**
+	 * Get the memory statistics kept by the shim, summed over all the shards.
+	 * High-water marks are sampled, short spikes between two samples may be missed.
+	 */
+	static void GetMemoryStats( FSQLiteMemoryStats& OutStats, bool bResetHighWater );
+
+	/**
+	 * Get the allocation functions Register chooses from, whichever it chose:
+	 * FMemory, FMemory with size headers, and the slabs once their region is
+	 * reserved. Only their xMalloc/xRealloc/xFree are meant to be called.
+	 */
+	static void GetAllocators( TArray<FSQLiteAllocator>& OutAllocators );
+
+	static constexpr int SlabChunkShift = 16;
+	static constexpr int SlabChunkSize = 1 << SlabChunkShift;
+	static constexpr int SlabMaxSmallSize = 2048;
+	static constexpr int SlabSizeClassCount = 24;
 
 private:
 
 	static bool bRegistered;
+
+	/** Allocation functions Register chooses from */
+	static const sqlite3_mem_methods MallocFuncs;
+	static const sqlite3_mem_methods WorkaroundMallocFuncs;
+	static const sqlite3_mem_methods SlabMallocFuncs;
+	static const sqlite3_mem_methods CountedMallocFuncs;
+
+	/** FMemory::GetAllocSize is not supported, blocks carry their size in a header */
+	static bool bUseWorkaround;
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+	/** Get the LLM tag allocations made on the calling thread should be charged to */
+	static FName GetLLMTag();
+#endif
 	
 	// ------------------------------------------------------------------------
 	// 
@@ -81,6 +143,88 @@ private:
 
 	/** Roundup to the expected allocation size */
 	static int WorkaroundRoundup( int InSizeBytes );
+
+	// ------------------------------------------------------------------------
+	// Slab allocator functions.
+	// Blocks up to SlabMaxSmallSize come from 64 KiB chunks carved in a
+	// reserved address range, each chunk holding a single size class, so the
+	// size of a block is found from its address and no header is needed.
+	// Freed blocks go to a per-thread cache and move to/from the shared
+	// per-class lists in batches. Larger blocks go to FMemory.
+	// ------------------------------------------------------------------------
+
+	/** Block size of each size class */
+	static const int SlabSizeClasses[SlabSizeClassCount];
+
+	/** Size class of each 16 bytes granule up to SlabMaxSmallSize */
+	static uint8 SlabSizeClassIndex[SlabMaxSmallSize / 16 + 1];
+
+	/** Address range the chunks are carved from */
+	static FPlatformMemory::FPlatformVirtualMemoryBlock SlabRegion;
+	static uint8* SlabRegionBase;
+	static int64 SlabRegionSize;
+
+	/** Size class of each chunk of the region */
+	static uint8* SlabChunkSizeClass;
+
+	/** Allocate memory */
+	static void* SlabMalloc( int InSizeBytes );
+
+	/** Free memory returned by Alloc or Realloc */
+	static void SlabFree( void* InPtr );
+
+	/** Reallocate memory returned by Alloc or Realloc */
+	static void* SlabRealloc( void* InPtr, int InSizeBytes );
+
+	/** Get the actual size of an allocation returned by Alloc or Realloc */
+	static int SlabSize( void* InPtr );
+
+	/** Roundup to the expected allocation size */
+	static int SlabRoundup( int InSizeBytes );
+
+	/** Is the block part of the slab region */
+	static bool IsSlabBlock( const void* InPtr )
+	{
+		return (const uint8*)InPtr >= SlabRegionBase && (const uint8*)InPtr < SlabRegionBase + SlabRegionSize;
+	}
+
+	/** Refill the calling thread cache of a size class, returns a block or nullptr if the region is full */
+	static void* SlabRefill( int InSizeClass );
+
+	/** Give a batch of blocks from a thread cache back to the shared list */
+	static void SlabRelease( FSQLiteSlabThreadCache& InThreadCache, int InSizeClass, int InCount );
+
+	friend struct FSQLiteSlabThreadCache;
+
+	// ------------------------------------------------------------------------
+	// Counting functions.
+	// Wrap the registered functions and account for every block in counters
+	// sharded per thread, so that no global lock is needed.
+	// ------------------------------------------------------------------------
+
+	/** Functions wrapped by the counting functions */
+	static const sqlite3_mem_methods* BaseFuncs;
+
+	/** Initialize the malloc system */
+	static int CountedInit( void* InAppData );
+
+	/** Shutdown the malloc system */
+	static void CountedShutdown( void* InAppData );
+
+	/** Allocate memory */
+	static void* CountedMalloc( int InSizeBytes );
+
+	/** Free memory returned by Alloc or Realloc */
+	static void CountedFree( void* InPtr );
+
+	/** Reallocate memory returned by Alloc or Realloc */
+	static void* CountedRealloc( void* InPtr, int InSizeBytes );
+
+	/** Get the actual size of an allocation returned by Alloc or Realloc */
+	static int CountedSize( void* InPtr );
+
+	/** Roundup to the expected allocation size */
+	static int CountedRoundup( int InSizeBytes );
 };
 
 #endif
@@ -3,6 +3,7 @@
 #if SQLITE_OS_OTHER
 
 #include "../../Sqlite3/Private/platform/mutex.h"
+#include "../../Sqlite3/Private/platform/SQLite3Platform.h"
 #include "Sqlite3Log.h"
 
 #include "CoreTypes.h"
@@ -13,11 +14,90 @@
 #include "HAL/PlatformFileManager.h"
 #include "HAL/PlatformFile.h"
 #include "Templates/Atomic.h"
+#include "Async/ParkingLot.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "ProfilingDebugging/CountersTrace.h"
 
 THIRD_PARTY_INCLUDES_START
 #include "sqlite/sqlite3.h-inline"
 THIRD_PARTY_INCLUDES_END
 
+/* ========================================================================= */
+/** Adaptive lock: spin for a while, then park the thread                    */
+/* ========================================================================= */
+
+bool FSQLiteAdaptiveLock::Lock()
+{
+	uint32 Expected = 0;
+	if( State.compare_exchange_strong( Expected, 1, std::memory_order_acquire ) )
+	{
+		return false;
+	}
+
+	return LockSlow();
+}
+
+bool FSQLiteAdaptiveLock::TryLock()
+{
+	uint32 Expected = 0;
+	return State.compare_exchange_strong( Expected, 1, std::memory_order_acquire );
+}
+
+void FSQLiteAdaptiveLock::Unlock()
+{
+	if( State.exchange( 0, std::memory_order_release ) == 2 )
+	{
+		UE::ParkingLot::WakeOne( &State );
+	}
+}
+
+bool FSQLiteAdaptiveLock::LockSlow()
+{
+	// Spin, up to twice the recent average
+
+	const int32 Estimate = SpinEstimate.load( std::memory_order_relaxed );
+	const int32 SpinLimit = FMath::Min( Estimate * 2 + 10, MaxSpinCount );
+
+	int32 SpinCount = 0;
+	while( SpinCount < SpinLimit )
+	{
+		++SpinCount;
+		FPlatformProcess::YieldCycles( 1 );
+
+		uint32 Expected = 0;
+		if( State.load( std::memory_order_relaxed ) == 0
+			&& State.compare_exchange_weak( Expected, 1, std::memory_order_acquire ) )
+		{
+			UpdateSpinEstimate( Estimate, SpinCount );
+			return true;
+		}
+	}
+
+	UpdateSpinEstimate( Estimate, SpinCount );
+
+	// Park, flagging the lock so that Unlock wakes us up
+
+	while( State.exchange( 2, std::memory_order_acquire ) != 0 )
+	{
+		UE::ParkingLot::Wait( &State,
+			[this]() { return State.load( std::memory_order_relaxed ) == 2; },
+			[]() {} );
+	}
+
+	return true;
+}
+
+void FSQLiteAdaptiveLock::UpdateSpinEstimate( const int32 InEstimate, const int32 InSpinCount )
+{
+	// Every store takes the cache line away from the other contending threads, so small moves are dropped
+	const int32 NewEstimate = InEstimate + ( InSpinCount - InEstimate ) / 8;
+	if( FMath::Abs( NewEstimate - InEstimate ) > SpinEstimateThreshold )
+	{
+		SpinEstimate.store( NewEstimate, std::memory_order_relaxed );
+	}
+}
+
 /* ========================================================================= */
 /** Unreal implementation of an SQLite mutex                                 */
 /* ========================================================================= */
@@ -33,9 +113,13 @@ FSQLiteMutex::FSQLiteMutex( int InSQLiteMutexId )
 
 FSQLiteMutex* FSQLiteMutexFuncs::SQLiteStaticMutexArray[FSQLiteMutexFuncs::SQLiteStaticMutexArrayCount] = { 0 };
 
+bool FSQLiteMutexFuncs::bUseAdaptiveMutex = false;
+
 /** Register the mutex system */
-void FSQLiteMutexFuncs::Register()
+void FSQLiteMutexFuncs::Register( const bool bInUseAdaptiveMutex )
 {
+	bUseAdaptiveMutex = bInUseAdaptiveMutex;
+
 	static const sqlite3_mutex_methods MutexFuncs = {
 		&Init,
 		&End,
@@ -58,6 +142,9 @@ int FSQLiteMutexFuncs::Init()
 	{
 		check(!SQLiteStaticMutexArray[SQLiteStaticMutexIndex]);
 		SQLiteStaticMutexArray[SQLiteStaticMutexIndex] = new FSQLiteMutex(SQLiteStaticMutexIndex + 2);
+#if SQLITE_UE_MUTEX_PROFILING
+		SQLiteStaticMutexArray[SQLiteStaticMutexIndex]->Profile = FindOrAddProfile(GetProfileName(SQLiteStaticMutexIndex + 2), SQLiteStaticMutexIndex + 2);
+#endif
 	}
 		return SQLITE_OK;
 }
@@ -80,7 +167,11 @@ sqlite3_mutex* FSQLiteMutexFuncs::Alloc( int InSQLiteMutexId )
 {
 	if (InSQLiteMutexId == SQLITE_MUTEX_FAST || InSQLiteMutexId == SQLITE_MUTEX_RECURSIVE)
 	{
-		return (sqlite3_mutex*)new FSQLiteMutex(InSQLiteMutexId);
+		FSQLiteMutex* Mutex = new FSQLiteMutex(InSQLiteMutexId);
+#if SQLITE_UE_MUTEX_PROFILING
+		Mutex->Profile = FindDynamicProfile(InSQLiteMutexId);
+#endif
+		return (sqlite3_mutex*)Mutex;
 	}
 	else
 	{
@@ -112,10 +203,28 @@ void FSQLiteMutexFuncs::Enter(sqlite3_mutex* InMutex)
 	FSQLiteMutex* Mutex = (FSQLiteMutex*)InMutex;
 	check(Mutex);
 
-	Mutex->CriticalSection.Lock();
-#ifdef SQLITE_DEBUG
-	Mutex->OwnerThreadId = FPlatformTLS::GetCurrentThreadId();
+	const uint32 ThreadId = FPlatformTLS::GetCurrentThreadId();
+
+	if (Mutex->SQLiteMutexId == SQLITE_MUTEX_RECURSIVE && Mutex->OwnerThreadId.load(std::memory_order_relaxed) == ThreadId)
+	{
+		++Mutex->RecursionCount;
+		return;
+	}
+
+#if SQLITE_UE_MUTEX_PROFILING
+	if (!TryLockMutex(Mutex))
+	{
+		const uint64 WaitStartCycles = FPlatformTime::Cycles64();
+		LockMutex(Mutex);
+		Mutex->Profile->RecordWait(FPlatformTime::Cycles64() - WaitStartCycles);
+	}
+	Mutex->Profile->Acquisitions.fetch_add(1, std::memory_order_relaxed);
+#else
+	LockMutex(Mutex);
 #endif
+
+	Mutex->OwnerThreadId.store(ThreadId, std::memory_order_relaxed);
+	Mutex->RecursionCount = 1;
 }
 
 /** TryLock a mutex returned by Alloc */
@@ -124,13 +233,27 @@ int FSQLiteMutexFuncs::Try(sqlite3_mutex* InMutex)
 	FSQLiteMutex* Mutex = (FSQLiteMutex*)InMutex;
 	check(Mutex);
 
-	if (Mutex->CriticalSection.TryLock())
+	const uint32 ThreadId = FPlatformTLS::GetCurrentThreadId();
+
+	if (Mutex->SQLiteMutexId == SQLITE_MUTEX_RECURSIVE && Mutex->OwnerThreadId.load(std::memory_order_relaxed) == ThreadId)
 	{
-#ifdef SQLITE_DEBUG
-		Mutex->OwnerThreadId = FPlatformTLS::GetCurrentThreadId();
+		++Mutex->RecursionCount;
+		return SQLITE_OK;
+	}
+
+	if (TryLockMutex(Mutex))
+	{
+#if SQLITE_UE_MUTEX_PROFILING
+		Mutex->Profile->Acquisitions.fetch_add(1, std::memory_order_relaxed);
 #endif
+		Mutex->OwnerThreadId.store(ThreadId, std::memory_order_relaxed);
+		Mutex->RecursionCount = 1;
 		return SQLITE_OK;
 	}
+
+#if SQLITE_UE_MUTEX_PROFILING
+	Mutex->Profile->TryFailures.fetch_add(1, std::memory_order_relaxed);
+#endif
 	return SQLITE_BUSY;
 }
 
@@ -139,37 +262,252 @@ void FSQLiteMutexFuncs::Leave( sqlite3_mutex* InMutex )
 {
 	FSQLiteMutex* Mutex = (FSQLiteMutex*)InMutex;
 	check(Mutex);
+	checkSlow(Mutex->OwnerThreadId.load(std::memory_order_relaxed) == FPlatformTLS::GetCurrentThreadId());
 
-	Mutex->CriticalSection.Unlock();
-#ifdef SQLITE_DEBUG
-	Mutex->OwnerThreadId = (uint32)INDEX_NONE;
-#endif
+	if (--Mutex->RecursionCount > 0)
+	{
+		return;
+	}
+
+	Mutex->OwnerThreadId.store((uint32)INDEX_NONE, std::memory_order_relaxed);
+
+	UnlockMutex(Mutex);
 }
 
-/** Test whether a mutex returned by Alloc is held by the current thread (debug only) */
+/** Test whether a mutex returned by Alloc is held by the current thread */
 int FSQLiteMutexFuncs::Held(sqlite3_mutex* InMutex)
 {
 	FSQLiteMutex* Mutex = (FSQLiteMutex*)InMutex;
 	check(Mutex);
 
-#ifdef SQLITE_DEBUG
-	return Mutex->OwnerThreadId == FPlatformTLS::GetCurrentThreadId();
-#else
-	return true;
-#endif
+	return Mutex->OwnerThreadId.load(std::memory_order_relaxed) == FPlatformTLS::GetCurrentThreadId();
 }
 
-/** Test whether a mutex returned by Alloc is not held by the current thread (debug only) */
+/** Test whether a mutex returned by Alloc is not held by the current thread */
 int FSQLiteMutexFuncs::Notheld(sqlite3_mutex* InMutex)
 {
 	FSQLiteMutex* Mutex = (FSQLiteMutex*)InMutex;
 	check(Mutex);
 
-#ifdef SQLITE_DEBUG
-	return Mutex->OwnerThreadId != FPlatformTLS::GetCurrentThreadId();
-#else
-	return true;
-#endif
+	return Mutex->OwnerThreadId.load(std::memory_order_relaxed) != FPlatformTLS::GetCurrentThreadId();
+}
+
+// ----------------------------------------------------------------------------
+
+void FSQLiteMutexFuncs::LockMutex(FSQLiteMutex* InMutex)
+{
+	if (bUseAdaptiveMutex)
+	{
+		InMutex->AdaptiveLock.Lock();
+	}
+	else
+	{
+		InMutex->CriticalSection.Lock();
+	}
+}
+
+bool FSQLiteMutexFuncs::TryLockMutex(FSQLiteMutex* InMutex)
+{
+	return bUseAdaptiveMutex ? InMutex->AdaptiveLock.TryLock() : InMutex->CriticalSection.TryLock();
+}
+
+void FSQLiteMutexFuncs::UnlockMutex(FSQLiteMutex* InMutex)
+{
+	if (bUseAdaptiveMutex)
+	{
+		InMutex->AdaptiveLock.Unlock();
+	}
+	else
+	{
+		InMutex->CriticalSection.Unlock();
+	}
+}
+
+#if SQLITE_UE_MUTEX_PROFILING
+
+/* ========================================================================= */
+/** Contention profiling                                                     */
+/* ========================================================================= */
+
+TRACE_DECLARE_INT_COUNTER(SqliteMutexContended, TEXT("Sqlite/Mutex/Contended"));
+TRACE_DECLARE_INT_COUNTER(SqliteMutexWaitMicroseconds, TEXT("Sqlite/Mutex/WaitMicroseconds"));
+TRACE_DECLARE_INT_COUNTER(SqliteMutexStaticMemContended, TEXT("Sqlite/Mutex/StaticMemContended"));
+TRACE_DECLARE_INT_COUNTER(SqliteMutexStaticLruContended, TEXT("Sqlite/Mutex/StaticLruContended"));
+TRACE_DECLARE_INT_COUNTER(SqliteMutexConnectionContended, TEXT("Sqlite/Mutex/ConnectionContended"));
+
+/** Profiles by name, kept for the lifetime of the process */
+static FCriticalSection SQLiteMutexProfilesCriticalSection;
+static TMap<FString, TUniquePtr<FSQLiteMutexProfile>> SQLiteMutexProfiles;
+
+void FSQLiteMutexProfile::RecordWait(uint64 InWaitCycles)
+{
+	ContendedAcquisitions.fetch_add(1, std::memory_order_relaxed);
+	WaitCycles.fetch_add(InWaitCycles, std::memory_order_relaxed);
+
+	const uint64 WaitMicroseconds = (uint64)(FPlatformTime::ToSeconds64(InWaitCycles) * 1000000.0);
+	const int32 Bucket = WaitMicroseconds == 0 ? 0 : FMath::Min<int32>((int32)FMath::FloorLog2_64(WaitMicroseconds) + 1, WaitHistogramBucketCount - 1);
+	WaitHistogram[Bucket].fetch_add(1, std::memory_order_relaxed);
+
+	TRACE_COUNTER_ADD(SqliteMutexContended, 1);
+	TRACE_COUNTER_ADD(SqliteMutexWaitMicroseconds, (int64)WaitMicroseconds);
+
+	switch (SQLiteMutexId)
+	{
+	case SQLITE_MUTEX_STATIC_MEM:
+		TRACE_COUNTER_ADD(SqliteMutexStaticMemContended, 1);
+		break;
+	case SQLITE_MUTEX_STATIC_LRU:
+		TRACE_COUNTER_ADD(SqliteMutexStaticLruContended, 1);
+		break;
+	case SQLITE_MUTEX_RECURSIVE:
+		TRACE_COUNTER_ADD(SqliteMutexConnectionContended, 1);
+		break;
+	default:
+		break;
+	}
+}
+
+void FSQLiteMutexProfile::Reset()
+{
+	Acquisitions = 0;
+	ContendedAcquisitions = 0;
+	TryFailures = 0;
+	WaitCycles = 0;
+
+	for (std::atomic<uint64>& Bucket : WaitHistogram)
+	{
+		Bucket = 0;
+	}
+}
+
+/** Get the profile shared by all the mutexes with a given name */
+FSQLiteMutexProfile* FSQLiteMutexFuncs::FindOrAddProfile(const FString& InName, int InSQLiteMutexId)
+{
+	FScopeLock Lock(&SQLiteMutexProfilesCriticalSection);
+
+	TUniquePtr<FSQLiteMutexProfile>& Profile = SQLiteMutexProfiles.FindOrAdd(InName);
+	if (!Profile)
+	{
+		Profile = MakeUnique<FSQLiteMutexProfile>();
+		Profile->Name = InName;
+		Profile->SQLiteMutexId = InSQLiteMutexId;
+	}
+	return Profile.Get();
 }
 
+/** Name a mutex from its id and the calling thread context */
+FString FSQLiteMutexFuncs::GetProfileName(int InSQLiteMutexId)
+{
+	static const TCHAR* StaticMutexNames[] = {
+		TEXT("STATIC_MAIN"),
+		TEXT("STATIC_MEM"),
+		TEXT("STATIC_OPEN"),
+		TEXT("STATIC_PRNG"),
+		TEXT("STATIC_LRU (page cache)"),
+		TEXT("STATIC_PMEM"),
+		TEXT("STATIC_APP1"),
+		TEXT("STATIC_APP2"),
+		TEXT("STATIC_APP3"),
+		TEXT("STATIC_VFS1"),
+		TEXT("STATIC_VFS2"),
+		TEXT("STATIC_VFS3"),
+	};
+	static_assert(UE_ARRAY_COUNT(StaticMutexNames) == SQLiteStaticMutexArrayCount, "One name per static mutex");
+
+	if (InSQLiteMutexId != SQLITE_MUTEX_FAST && InSQLiteMutexId != SQLITE_MUTEX_RECURSIVE)
+	{
+		return StaticMutexNames[InSQLiteMutexId - 2];
+	}
+
+	const FName& Owner = FSQLiteThreadContext::Get().LLMTag;
+	return FString::Printf(TEXT("%s %s"),
+		Owner.IsNone() ? TEXT("Sqlite") : *Owner.ToString(),
+		InSQLiteMutexId == SQLITE_MUTEX_RECURSIVE ? TEXT("RECURSIVE") : TEXT("FAST"));
+}
+
+/** Get the profile of a FAST or RECURSIVE mutex allocated by the calling thread */
+FSQLiteMutexProfile* FSQLiteMutexFuncs::FindDynamicProfile(int InSQLiteMutexId)
+{
+	// The profiles of the last database context of the thread, the names are only built and looked up when it changes
+	struct FProfileCache
+	{
+		FName Owner;
+		FSQLiteMutexProfile* FastProfile = nullptr;
+		FSQLiteMutexProfile* RecursiveProfile = nullptr;
+	};
+	static thread_local FProfileCache ProfileCache;
+
+	const FName& Owner = FSQLiteThreadContext::Get().LLMTag;
+	if (ProfileCache.Owner != Owner)
+	{
+		ProfileCache.Owner = Owner;
+		ProfileCache.FastProfile = nullptr;
+		ProfileCache.RecursiveProfile = nullptr;
+	}
+
+	FSQLiteMutexProfile*& Profile = InSQLiteMutexId == SQLITE_MUTEX_RECURSIVE ? ProfileCache.RecursiveProfile : ProfileCache.FastProfile;
+	if (!Profile)
+	{
+		Profile = FindOrAddProfile(GetProfileName(InSQLiteMutexId), InSQLiteMutexId);
+	}
+	return Profile;
+}
+
+/** Log the contention figures of all the mutexes, most waited on first */
+void FSQLiteMutexFuncs::DumpProfiles(bool bInReset)
+{
+	TArray<FSQLiteMutexProfile*> Profiles;
+	{
+		FScopeLock Lock(&SQLiteMutexProfilesCriticalSection);
+		for (const TPair<FString, TUniquePtr<FSQLiteMutexProfile>>& Entry : SQLiteMutexProfiles)
+		{
+			Profiles.Add(Entry.Value.Get());
+		}
+	}
+
+	Profiles.Sort([](const FSQLiteMutexProfile& A, const FSQLiteMutexProfile& B)
+	{
+		return A.WaitCycles.load(std::memory_order_relaxed) > B.WaitCycles.load(std::memory_order_relaxed);
+	});
+
+	UE_LOG(LogSqlite, Display, TEXT("%-40s %12s %12s %8s %12s %10s  Wait histogram (<1us, <2us, <4us, ...)"),
+		TEXT("Mutex"), TEXT("Acquired"), TEXT("Contended"), TEXT("%"), TEXT("Wait (ms)"), TEXT("Try fail"));
+
+	for (FSQLiteMutexProfile* Profile : Profiles)
+	{
+		const uint64 Acquisitions = Profile->Acquisitions.load(std::memory_order_relaxed);
+		const uint64 Contended = Profile->ContendedAcquisitions.load(std::memory_order_relaxed);
+
+		FString Histogram;
+		for (const std::atomic<uint64>& Bucket : Profile->WaitHistogram)
+		{
+			Histogram += FString::Printf(TEXT(" %llu"), Bucket.load(std::memory_order_relaxed));
+		}
+
+		UE_LOG(LogSqlite, Display, TEXT("%-40s %12llu %12llu %7.2f%% %12.3f %10llu %s"),
+			*Profile->Name,
+			Acquisitions,
+			Contended,
+			Acquisitions > 0 ? 100.0 * (double)Contended / (double)Acquisitions : 0.0,
+			FPlatformTime::ToMilliseconds64(Profile->WaitCycles.load(std::memory_order_relaxed)),
+			Profile->TryFailures.load(std::memory_order_relaxed),
+			*Histogram);
+
+		if (bInReset)
+		{
+			Profile->Reset();
+		}
+	}
+}
+
+static FAutoConsoleCommand SqliteMutexStatsCommand(
+	TEXT("sqlite.MutexStats"),
+	TEXT("Log the acquisition counts and wait times of the SQLite mutexes. Pass 'reset' to clear them afterwards."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		FSQLiteMutexFuncs::DumpProfiles(Args.Contains(TEXT("reset")));
+	}));
+
+#endif
+
 #endif
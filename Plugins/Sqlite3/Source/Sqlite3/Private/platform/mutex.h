@@ -11,10 +11,93 @@
 #include "HAL/PlatformFile.h"
 #include "Templates/Atomic.h"
 
+#include <atomic>
+
 THIRD_PARTY_INCLUDES_START
 #include "sqlite/sqlite3.h-inline"
 THIRD_PARTY_INCLUDES_END
 
+/** Record acquisition counts and wait times of every SQLite mutex (see sqlite.MutexStats) */
+#ifndef SQLITE_UE_MUTEX_PROFILING
+#define SQLITE_UE_MUTEX_PROFILING !UE_BUILD_SHIPPING
+#endif
+
+/* ========================================================================= */
+/** Adaptive lock: spin for a while, then park the thread                    */
+/* ========================================================================= */
+
+/**
+ * Most SQLite mutexes are held for a few dozen nanoseconds, so a contended
+ * thread is better off spinning than going to sleep. The number of spins
+ * adapts to how long the lock was recently held (as glibc adaptive mutexes
+ * do), then the thread parks on UE::ParkingLot until the owner releases it.
+ */
+struct FSQLiteAdaptiveLock
+{
+	/** Take the lock, returns true if the lock was not free at first try */
+	bool Lock();
+
+	bool TryLock();
+
+	void Unlock();
+
+private:
+	/** 0 = free, 1 = locked, 2 = locked with parked threads */
+	std::atomic<uint32> State{ 0 };
+
+	/** Running average of the spins needed to take the lock */
+	std::atomic<int32> SpinEstimate{ 0 };
+
+	static constexpr int32 MaxSpinCount = 100;
+
+	/** Smallest move of SpinEstimate that is stored */
+	static constexpr int32 SpinEstimateThreshold = 1;
+
+	bool LockSlow();
+
+	/** Move SpinEstimate towards the spins of the last acquisition, if it moves by more than SpinEstimateThreshold */
+	void UpdateSpinEstimate( int32 InEstimate, int32 InSpinCount );
+};
+
+#if SQLITE_UE_MUTEX_PROFILING
+
+/* ========================================================================= */
+/** Contention figures shared by the mutexes with the same name              */
+/* ========================================================================= */
+
+/**
+ * Static mutexes are named after their id (STATIC_MEM, STATIC_LRU, ...),
+ * the others after the database that was being opened when SQLite allocated
+ * them (see FSQLiteThreadContext) and their kind.
+ */
+struct FSQLiteMutexProfile
+{
+	/** Wait time buckets: < 1 us, then one bucket per power of two microseconds */
+	static constexpr int32 WaitHistogramBucketCount = 16;
+
+	FString Name;
+
+	/** Id of the mutexes sharing this profile (SQLITE_MUTEX_xxx) */
+	int SQLiteMutexId = 0;
+
+	std::atomic<uint64> Acquisitions{ 0 };
+
+	/** Acquisitions that found the mutex already held */
+	std::atomic<uint64> ContendedAcquisitions{ 0 };
+
+	std::atomic<uint64> TryFailures{ 0 };
+
+	std::atomic<uint64> WaitCycles{ 0 };
+
+	std::atomic<uint64> WaitHistogram[WaitHistogramBucketCount] = {};
+
+	/** Record a contended acquisition */
+	void RecordWait( uint64 InWaitCycles );
+
+	void Reset();
+};
+
+#endif
 
 /* ========================================================================= */
 /** Unreal implementation of an SQLite mutex                                 */
@@ -25,9 +108,17 @@ struct FSQLiteMutex
 	FSQLiteMutex( int InSQLiteMutexId );
 
 	FCriticalSection CriticalSection;
+	FSQLiteAdaptiveLock AdaptiveLock;
 	int SQLiteMutexId;
-#ifdef SQLITE_DEBUG
-	TAtomic<uint32> OwnerThreadId{ (uint32)INDEX_NONE };
+
+	/** Thread holding the mutex, tracked in all builds for Held/Notheld */
+	std::atomic<uint32> OwnerThreadId{ (uint32)INDEX_NONE };
+
+	/** Number of times the owner entered the mutex (SQLITE_MUTEX_RECURSIVE) */
+	int32 RecursionCount = 0;
+
+#if SQLITE_UE_MUTEX_PROFILING
+	FSQLiteMutexProfile* Profile = nullptr;
 #endif
 };
 
@@ -38,10 +129,19 @@ struct FSQLiteMutex
 struct FSQLiteMutexFuncs
 {
 public:
-	/** Register the mutex system */
-	static void Register();
+	/**
+	 * Register the mutex system
+	 *
+	 * @param bInUseAdaptiveMutex - Use FSQLiteAdaptiveLock rather than FCriticalSection
+	 */
+	static void Register( bool bInUseAdaptiveMutex );
+
+	/** Are mutexes backed by FSQLiteAdaptiveLock */
+	static bool IsUsingAdaptiveMutex() { return bUseAdaptiveMutex; }
 
 private:
+	static bool bUseAdaptiveMutex;
+
 	/** Array of static mutexes used by SQLite */
 	static const int32 SQLiteStaticMutexArrayCount = 12;
 	static FSQLiteMutex* SQLiteStaticMutexArray[SQLiteStaticMutexArrayCount];
@@ -67,11 +167,32 @@ private:
 	/** Unlock a mutex returned by Alloc */
 	static void Leave( sqlite3_mutex* InMutex );
 
-	/** Test whether a mutex returned by Alloc is held by the current thread (debug only) */
+	/** Test whether a mutex returned by Alloc is held by the current thread */
 	static int Held( sqlite3_mutex* InMutex );
 
-	/** Test whether a mutex returned by Alloc is not held by the current thread (debug only) */
+	/** Test whether a mutex returned by Alloc is not held by the current thread */
 	static int Notheld( sqlite3_mutex* InMutex );
+
+	// ------------------------------------------------------------------------
+
+	static void LockMutex( FSQLiteMutex* InMutex );
+	static bool TryLockMutex( FSQLiteMutex* InMutex );
+	static void UnlockMutex( FSQLiteMutex* InMutex );
+
+#if SQLITE_UE_MUTEX_PROFILING
+	/** Get the profile shared by all the mutexes with a given name (never freed) */
+	static FSQLiteMutexProfile* FindOrAddProfile( const FString& InName, int InSQLiteMutexId );
+
+	/** Name a mutex from its id and the calling thread context */
+	static FString GetProfileName( int InSQLiteMutexId );
+
+	/** Get the profile of a FAST or RECURSIVE mutex allocated by the calling thread, cached per thread for its current context */
+	static FSQLiteMutexProfile* FindDynamicProfile( int InSQLiteMutexId );
+
+public:
+	/** Log the contention figures of all the mutexes, most waited on first */
+	static void DumpProfiles( bool bInReset );
+#endif
 };
 
 #endif
@@ -0,0 +1,643 @@
+﻿// Copyright Epic Games, Inc. All Rights Reserved.
+
+#if SQLITE_OS_OTHER
+
+#include "../../Sqlite3/Private/platform/pakfile.h"
+#include "Sqlite3Log.h"
+
+#include "CoreTypes.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+#include "HAL/PlatformFileManager.h"
+#include "HAL/PlatformFile.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "Misc/Compression.h"
+
+THIRD_PARTY_INCLUDES_START
+#include "sqlite/sqlite3.h-inline"
+THIRD_PARTY_INCLUDES_END
+
+// ============================================================================
+// = Read-only file system for packaged databases (see sqlite3_io_methods and sqlite3_vfs)
+// ============================================================================
+
+int32 FSQLitePakFileFuncs::BlockSize = 64 * 1024;
+int64 FSQLitePakFileFuncs::BlockCacheSize = 4 * 1024 * 1024;
+
+FCriticalSection FSQLitePakFileFuncs::NodesSection;
+TMap<FString, FSQLitePakFileNode*> FSQLitePakFileFuncs::Nodes;
+
+/** Register the file system, it borrows everything but the file functions from "unreal-fs" */
+void FSQLitePakFileFuncs::Register()
+{
+	static sqlite3_vfs VFSFuncs;
+
+	sqlite3_vfs* BaseVFS = sqlite3_vfs_find( "unreal-fs" );
+	check(BaseVFS);
+
+	VFSFuncs = *BaseVFS;
+	VFSFuncs.szOsFile = sizeof(FSQLitePakFile);
+	VFSFuncs.pNext = nullptr;
+	VFSFuncs.zName = "unreal-pak";
+	VFSFuncs.xOpen = &Open;
+	VFSFuncs.xDelete = &Delete;
+	VFSFuncs.xAccess = &Access;
+
+	sqlite3_vfs_register( &VFSFuncs, 0 );
+}
+
+/** Configure the block cache (block size and cache size of each file) */
+void FSQLitePakFileFuncs::Configure( const FSQLitePlatformConfig& InConfig )
+{
+	BlockSize = FMath::Max<int32>(FMath::RoundUpToPowerOfTwo(FMath::Max(InConfig.PakBlockSize, 4096)), 4096);
+	BlockCacheSize = FMath::Max<int64>(InConfig.PakBlockCacheSize, 0);
+}
+
+/** Convert a database image into a page-compressed file, the database must not need its journal or WAL */
+bool FSQLitePakFileFuncs::CompressDatabase( const TArray64<uint8>& InDatabase, FName InFormat, TArray64<uint8>& OutFile )
+{
+	static const ANSICHAR DatabaseMagic[] = "SQLite format 3";
+
+	if (InDatabase.Num() < 100 || FMemory::Memcmp(InDatabase.GetData(), DatabaseMagic, sizeof(DatabaseMagic)) != 0)
+	{
+		UE_LOG( LogSqlite, Error, TEXT("Not a SQLite database.") );
+		return false;
+	}
+
+	// Big endian page size at offset 16, 1 stands for 65536
+	const uint32 RawPageSize = (InDatabase[16] << 8) | InDatabase[17];
+	const int32 PageSize = RawPageSize == 1 ? 65536 : (int32)RawPageSize;
+	if (PageSize < 512 || !FMath::IsPowerOfTwo(PageSize) || InDatabase.Num() % PageSize != 0)
+	{
+		UE_LOG( LogSqlite, Error, TEXT("Invalid page size %d."), PageSize );
+		return false;
+	}
+
+	const FString FormatName = InFormat.ToString();
+	if (FormatName.Len() >= UE_ARRAY_COUNT(FSQLiteCompressedHeader::Format) || !FCompression::IsFormatValid(InFormat))
+	{
+		UE_LOG( LogSqlite, Error, TEXT("Unknown compression format %s."), *FormatName );
+		return false;
+	}
+
+	const int32 PageCount = (int32)(InDatabase.Num() / PageSize);
+
+	FSQLiteCompressedHeader Header;
+	FMemory::Memzero(Header);
+	Header.Magic = FSQLiteCompressedHeader::FileMagic;
+	Header.Version = FSQLiteCompressedHeader::FileVersion;
+	Header.PageSize = PageSize;
+	Header.PageCount = PageCount;
+	Header.DatabaseSize = InDatabase.Num();
+	FCStringAnsi::Strncpy(Header.Format, TCHAR_TO_ANSI(*FormatName), UE_ARRAY_COUNT(Header.Format));
+
+	TArray<FSQLiteCompressedPage> Pages;
+	Pages.SetNumZeroed(PageCount);
+
+	const int64 PagesOffset = sizeof(FSQLiteCompressedHeader) + (int64)PageCount * sizeof(FSQLiteCompressedPage);
+	OutFile.Reset(PagesOffset + InDatabase.Num() / 2);
+	OutFile.SetNumZeroed(PagesOffset);
+
+	TArray<uint8> PageBuffer;
+	PageBuffer.SetNumUninitialized(PageSize);
+
+	TArray<uint8> CompressedBuffer;
+	CompressedBuffer.SetNumUninitialized(FCompression::CompressMemoryBound(InFormat, PageSize));
+
+	for (int32 PageIndex = 0; PageIndex < PageCount; PageIndex++)
+	{
+		FMemory::Memcpy(PageBuffer.GetData(), InDatabase.GetData() + (int64)PageIndex * PageSize, PageSize);
+
+		// The file is opened immutable without shared memory, it must say rollback journal rather than WAL (write and read versions)
+		if (PageIndex == 0)
+		{
+			PageBuffer[18] = 1;
+			PageBuffer[19] = 1;
+		}
+
+		int32 CompressedSize = CompressedBuffer.Num();
+		const bool bCompressed = FCompression::CompressMemory(InFormat, CompressedBuffer.GetData(), CompressedSize, PageBuffer.GetData(), PageSize)
+			&& CompressedSize < PageSize;
+
+		Pages[PageIndex].Offset = OutFile.Num();
+		Pages[PageIndex].Size = bCompressed ? CompressedSize : PageSize;
+		OutFile.Append(bCompressed ? CompressedBuffer.GetData() : PageBuffer.GetData(), Pages[PageIndex].Size);
+	}
+
+	FMemory::Memcpy(OutFile.GetData(), &Header, sizeof(Header));
+	FMemory::Memcpy(OutFile.GetData() + sizeof(Header), Pages.GetData(), (int64)PageCount * sizeof(FSQLiteCompressedPage));
+
+	return true;
+}
+
+/** Attempt to open a file, only main databases can be opened */
+int FSQLitePakFileFuncs::Open( sqlite3_vfs* InVFS, const char* InFilename, sqlite3_file* InFile, int InFlags, int* OutFlagsPtr )
+{
+	static const sqlite3_io_methods FileFuncs = {
+		3,	/** Version 3, memory mapped reads (no shared memory, WAL databases can not be opened) */
+		&Close,
+		&Read,
+		&Write,
+		&Truncate,
+		&Sync,
+		&FileSize,
+		&Lock,
+		&Unlock,
+		&CheckReservedLock,
+		&FileControl,
+		&SectorSize,
+		&DeviceCharacteristics,
+		nullptr,
+		nullptr,
+		nullptr,
+		nullptr,
+		&Fetch,
+		&Unfetch,
+	};
+
+	FSQLitePakFile* File = (FSQLitePakFile*)InFile;
+	check(File);
+
+	// Zero the file descriptor so it has valid data for the early return cases
+	FMemory::Memzero(*File);
+
+	if (!InFilename || !(InFlags & SQLITE_OPEN_MAIN_DB))
+	{
+		return SQLITE_CANTOPEN;
+	}
+
+	File->Node = AcquireNode(FPaths::ConvertRelativePathToFull(UTF8_TO_TCHAR(InFilename)));
+	if (!File->Node)
+	{
+		return SQLITE_CANTOPEN;
+	}
+
+	File->IOMethods = &FileFuncs;
+
+	if (OutFlagsPtr)
+	{
+		*OutFlagsPtr = SQLITE_OPEN_READONLY;
+	}
+
+	return SQLITE_OK;
+}
+
+/** Packaged files can not be deleted */
+int FSQLitePakFileFuncs::Delete( sqlite3_vfs* InVFS, const char* InFilename, int InSyncDir )
+{
+	return SQLITE_IOERR_DELETE;
+}
+
+/** Check whether a file exists, nothing is ever writable */
+int FSQLitePakFileFuncs::Access( sqlite3_vfs* InVFS, const char* InFilename, int InAccessMode, int* OutResultPtr )
+{
+	check(InFilename && OutResultPtr);
+
+	*OutResultPtr = 0;
+
+	if (InAccessMode == SQLITE_ACCESS_EXISTS || InAccessMode == SQLITE_ACCESS_READ)
+	{
+		const FString Filename = FPaths::ConvertRelativePathToFull(UTF8_TO_TCHAR(InFilename));
+
+		FScopeLock Lock(&NodesSection);
+		*OutResultPtr = Nodes.Contains(Filename) || FPlatformFileManager::Get().GetPlatformFile().FileExists(*Filename);
+	}
+
+	return SQLITE_OK;
+}
+
+/** Close a file previously opened by Open */
+int FSQLitePakFileFuncs::Close( sqlite3_file* InFile )
+{
+	FSQLitePakFile* File = (FSQLitePakFile*)InFile;
+	check(File && File->Node);
+
+	ReleaseNode(File->Node);
+	File->Node = nullptr;
+
+	return SQLITE_OK;
+}
+
+/** Read from a file previously opened by Open, through the mapping or the block cache */
+int FSQLitePakFileFuncs::Read( sqlite3_file* InFile, void* OutBuffer, int InReadAmountBytes, sqlite3_int64 InReadOffsetBytes )
+{
+	FSQLitePakFile* File = (FSQLitePakFile*)InFile;
+	check(File && File->Node);
+
+	FSQLitePakFileNode* Node = File->Node;
+	uint8* OutPtr = (uint8*)OutBuffer;
+
+	const int64 AvailableBytes = FMath::Clamp<int64>(Node->FileSize - InReadOffsetBytes, 0, InReadAmountBytes);
+
+	if (Node->MappedRegion && Node->CompressionFormat.IsNone())
+	{
+		FMemory::Memcpy(OutPtr, Node->MappedRegion->GetMappedPtr() + InReadOffsetBytes, AvailableBytes);
+	}
+	else
+	{
+		int64 BytesRead = 0;
+		while (BytesRead < AvailableBytes)
+		{
+			const int64 Offset = InReadOffsetBytes + BytesRead;
+			const int64 BlockBytes = ReadBlock(Node, Offset / Node->BlockSize, Offset % Node->BlockSize, AvailableBytes - BytesRead, OutPtr + BytesRead);
+			if (BlockBytes <= 0)
+			{
+				return SQLITE_IOERR_READ;
+			}
+
+			BytesRead += BlockBytes;
+		}
+	}
+
+	// SQLite expects the missing part of a short read to be zeroed
+	if (AvailableBytes < InReadAmountBytes)
+	{
+		FMemory::Memzero(OutPtr + AvailableBytes, InReadAmountBytes - AvailableBytes);
+		return SQLITE_IOERR_SHORT_READ;
+	}
+
+	return SQLITE_OK;
+}
+
+int FSQLitePakFileFuncs::Write( sqlite3_file* InFile, const void* InBuffer, int InWriteAmountBytes, sqlite3_int64 InWriteOffsetBytes )
+{
+	return SQLITE_READONLY;
+}
+
+int FSQLitePakFileFuncs::Truncate( sqlite3_file* InFile, sqlite3_int64 InSizeBytes )
+{
+	return SQLITE_READONLY;
+}
+
+int FSQLitePakFileFuncs::Sync( sqlite3_file* InFile, int InFlags )
+{
+	return SQLITE_OK;
+}
+
+int FSQLitePakFileFuncs::FileSize( sqlite3_file* InFile, sqlite3_int64* OutSizePtr )
+{
+	FSQLitePakFile* File = (FSQLitePakFile*)InFile;
+	check(File && File->Node && OutSizePtr);
+
+	*OutSizePtr = File->Node->FileSize;
+	return SQLITE_OK;
+}
+
+/** Nothing can write to the file, so there is nothing to lock */
+int FSQLitePakFileFuncs::Lock( sqlite3_file* InFile, int InLockMode )
+{
+	return SQLITE_OK;
+}
+
+int FSQLitePakFileFuncs::Unlock( sqlite3_file* InFile, int InLockMode )
+{
+	return SQLITE_OK;
+}
+
+int FSQLitePakFileFuncs::CheckReservedLock( sqlite3_file* InFile, int* OutIsLocked )
+{
+	*OutIsLocked = 0;
+	return SQLITE_OK;
+}
+
+int FSQLitePakFileFuncs::FileControl( sqlite3_file* InFile, int InOp, void* InOutOpData )
+{
+	return SQLITE_NOTFOUND;
+}
+
+int FSQLitePakFileFuncs::SectorSize( sqlite3_file* InFile )
+{
+	FSQLitePakFile* File = (FSQLitePakFile*)InFile;
+	check(File && File->Node);
+
+	return File->Node->CompressionFormat.IsNone() ? 4096 : File->Node->BlockSize;
+}
+
+/** Immutable: SQLite reads the database without locks and never looks for a journal */
+int FSQLitePakFileFuncs::DeviceCharacteristics( sqlite3_file* InFile )
+{
+	return SQLITE_IOCAP_IMMUTABLE | SQLITE_IOCAP_UNDELETABLE_WHEN_OPEN;
+}
+
+/** Hand out a pointer into the file mapping, SQLite falls back to Read when there is none */
+int FSQLitePakFileFuncs::Fetch( sqlite3_file* InFile, sqlite3_int64 InOffsetBytes, int InAmountBytes, void** OutPtr )
+{
+	FSQLitePakFile* File = (FSQLitePakFile*)InFile;
+	check(File && File->Node && OutPtr);
+
+	*OutPtr = nullptr;
+
+	FSQLitePakFileNode* Node = File->Node;
+	if (Node->MappedRegion && Node->CompressionFormat.IsNone() && InOffsetBytes + InAmountBytes <= Node->FileSize)
+	{
+		*OutPtr = (void*)(Node->MappedRegion->GetMappedPtr() + InOffsetBytes);
+	}
+
+	return SQLITE_OK;
+}
+
+/** The mapping lives as long as the node, there is nothing to release */
+int FSQLitePakFileFuncs::Unfetch( sqlite3_file* InFile, sqlite3_int64 InOffsetBytes, void* InPtr )
+{
+	return SQLITE_OK;
+}
+
+/** Get the node of a file, opening it for the first connection */
+FSQLitePakFileNode* FSQLitePakFileFuncs::AcquireNode( const FString& InFilename )
+{
+	FScopeLock Lock(&NodesSection);
+
+	if (FSQLitePakFileNode** NodePtr = Nodes.Find(InFilename))
+	{
+		(*NodePtr)->RefCount++;
+		return *NodePtr;
+	}
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+	const int64 FileSize = PlatformFile.FileSize(*InFilename);
+	if (FileSize < 0)
+	{
+		return nullptr;
+	}
+
+	FSQLitePakFileNode* Node = new FSQLitePakFileNode();
+	Node->Filename = InFilename;
+	Node->RefCount = 1;
+	Node->FileSize = FileSize;
+	Node->BlockSize = BlockSize;
+
+	// Uncompressed entries (and loose files) can be mapped, everything else goes through the block cache
+	if (FileSize > 0)
+	{
+		Node->MappedHandle = PlatformFile.OpenMapped(*InFilename);
+		if (Node->MappedHandle)
+		{
+			Node->MappedRegion = Node->MappedHandle->MapRegion(0, FileSize);
+			if (!Node->MappedRegion)
+			{
+				delete Node->MappedHandle;
+				Node->MappedHandle = nullptr;
+			}
+		}
+	}
+
+	if (!Node->MappedRegion)
+	{
+		Node->AsyncHandle = PlatformFile.OpenAsyncRead(*InFilename);
+		if (!Node->AsyncHandle)
+		{
+			delete Node;
+			return nullptr;
+		}
+	}
+
+	// Compressed pages are read through the block cache, one page per block
+	if (!ReadCompressedIndex(Node, FileSize) && !Node->CompressionFormat.IsNone())
+	{
+		UE_LOG( LogSqlite, Warning, TEXT("Invalid page index in [%s]."), *InFilename );
+		Node->RefCount = 0;
+		delete Node->MappedRegion;
+		delete Node->MappedHandle;
+		delete Node->AsyncHandle;
+		delete Node;
+		return nullptr;
+	}
+
+	Node->MaxCachedBlocks = FMath::Max<int32>((int32)(BlockCacheSize / Node->BlockSize), 1);
+
+	UE_LOG( LogSqlite, Log, TEXT(" ---> FSQLitePakFileFuncs::Open [%s] (%lld bytes, %s, %s)"), *InFilename, FileSize,
+		Node->MappedRegion ? TEXT("mapped") : TEXT("async reads"),
+		Node->CompressionFormat.IsNone() ? TEXT("uncompressed") : *Node->CompressionFormat.ToString() );
+
+	Nodes.Add(InFilename, Node);
+	return Node;
+}
+
+void FSQLitePakFileFuncs::ReleaseNode( FSQLitePakFileNode* InNode )
+{
+	FScopeLock Lock(&NodesSection);
+
+	if (--InNode->RefCount > 0)
+	{
+		return;
+	}
+
+	Nodes.Remove(InNode->Filename);
+
+	delete InNode->MappedRegion;
+	delete InNode->MappedHandle;
+	delete InNode->AsyncHandle;
+
+	for (const TPair<int64, FSQLitePakBlock*>& Pair : InNode->Blocks)
+	{
+		FMemory::Free(Pair.Value->Data);
+		delete Pair.Value;
+	}
+
+	delete InNode;
+}
+
+/** Read the header and page index of a page-compressed file, false if the file is not one */
+bool FSQLitePakFileFuncs::ReadCompressedIndex( FSQLitePakFileNode* InNode, int64 InRawFileSize )
+{
+	if (InRawFileSize < (int64)sizeof(FSQLiteCompressedHeader))
+	{
+		return false;
+	}
+
+	FSQLiteCompressedHeader Header;
+	if (!ReadRange(InNode, 0, sizeof(Header), (uint8*)&Header) || Header.Magic != FSQLiteCompressedHeader::FileMagic)
+	{
+		return false;
+	}
+
+	// From here on the file is a compressed one, a false return means that it can not be opened
+	Header.Format[UE_ARRAY_COUNT(Header.Format) - 1] = 0;
+	InNode->CompressionFormat = FName(ANSI_TO_TCHAR(Header.Format));
+
+	const int64 IndexBytes = (int64)Header.PageCount * sizeof(FSQLiteCompressedPage);
+	if (Header.Version != FSQLiteCompressedHeader::FileVersion
+		|| Header.PageSize < 512 || Header.PageSize > 65536 || !FMath::IsPowerOfTwo(Header.PageSize)
+		|| Header.DatabaseSize != (uint64)Header.PageCount * Header.PageSize
+		|| sizeof(Header) + IndexBytes > (uint64)InRawFileSize
+		|| !FCompression::IsFormatValid(InNode->CompressionFormat))
+	{
+		return false;
+	}
+
+	InNode->Pages.SetNumUninitialized(Header.PageCount);
+	if (!ReadRange(InNode, sizeof(Header), IndexBytes, (uint8*)InNode->Pages.GetData()))
+	{
+		return false;
+	}
+
+	for (const FSQLiteCompressedPage& Page : InNode->Pages)
+	{
+		if (Page.Size > Header.PageSize || Page.Offset + Page.Size > (uint64)InRawFileSize)
+		{
+			return false;
+		}
+	}
+
+	InNode->FileSize = Header.DatabaseSize;
+	InNode->BlockSize = Header.PageSize;
+
+	return true;
+}
+
+/** Read bytes of the file as stored, through the mapping or an async read */
+bool FSQLitePakFileFuncs::ReadRange( FSQLitePakFileNode* InNode, int64 InOffsetBytes, int64 InAmountBytes, uint8* OutBuffer )
+{
+	if (InNode->MappedRegion)
+	{
+		if (InOffsetBytes + InAmountBytes > InNode->MappedRegion->GetMappedSize())
+		{
+			return false;
+		}
+
+		FMemory::Memcpy(OutBuffer, InNode->MappedRegion->GetMappedPtr() + InOffsetBytes, InAmountBytes);
+		return true;
+	}
+
+	IAsyncReadRequest* Request = InNode->AsyncHandle->ReadRequest(InOffsetBytes, InAmountBytes, AIOP_Normal, nullptr, OutBuffer);
+	const bool bSucceeded = Request && Request->WaitCompletion() && Request->GetReadResults() != nullptr;
+	delete Request;
+
+	return bSucceeded;
+}
+
+/** Copy a block to the output buffer, reading and caching it on a miss, returns the number of bytes copied (-1 on error) */
+int64 FSQLitePakFileFuncs::ReadBlock( FSQLitePakFileNode* InNode, int64 InBlockIndex, int64 InOffsetInBlock, int64 InAmountBytes, uint8* OutBuffer )
+{
+	{
+		FScopeLock Lock(&InNode->CriticalSection);
+
+		if (FSQLitePakBlock** BlockPtr = InNode->Blocks.Find(InBlockIndex))
+		{
+			FSQLitePakBlock* Block = *BlockPtr;
+			LruRemove(InNode, Block);
+			LruAddHead(InNode, Block);
+
+			const int64 CopyBytes = FMath::Min<int64>(Block->Size - InOffsetInBlock, InAmountBytes);
+			FMemory::Memcpy(OutBuffer, Block->Data + InOffsetInBlock, CopyBytes);
+			return CopyBytes;
+		}
+	}
+
+	// Read (and decompress) the whole block outside of the lock so that the other connections keep hitting the cache
+	const int64 BlockOffset = InBlockIndex * InNode->BlockSize;
+	const int32 BlockBytes = (int32)FMath::Min<int64>(InNode->BlockSize, InNode->FileSize - BlockOffset);
+
+	uint8* Data;
+	{
+		LLM_SCOPE_BYNAME( TEXT( "Sqlite/PakBlockCache" ) );
+		Data = (uint8*)FMemory::Malloc(BlockBytes);
+	}
+
+	bool bSucceeded;
+	if (InNode->CompressionFormat.IsNone())
+	{
+		bSucceeded = ReadRange(InNode, BlockOffset, BlockBytes, Data);
+	}
+	else
+	{
+		const FSQLiteCompressedPage& Page = InNode->Pages[InBlockIndex];
+		if (Page.Size == (uint32)BlockBytes)
+		{
+			bSucceeded = ReadRange(InNode, Page.Offset, Page.Size, Data);
+		}
+		else
+		{
+			TArray<uint8> Compressed;
+			Compressed.SetNumUninitialized(Page.Size);
+			bSucceeded = ReadRange(InNode, Page.Offset, Page.Size, Compressed.GetData())
+				&& FCompression::UncompressMemory(InNode->CompressionFormat, Data, BlockBytes, Compressed.GetData(), Page.Size);
+		}
+	}
+
+	if (!bSucceeded)
+	{
+		UE_LOG( LogSqlite, Warning, TEXT("Read of block %lld of [%s] failed."), InBlockIndex, *InNode->Filename );
+		FMemory::Free(Data);
+		return -1;
+	}
+
+	const int64 CopyBytes = FMath::Min<int64>(BlockBytes - InOffsetInBlock, InAmountBytes);
+	FMemory::Memcpy(OutBuffer, Data + InOffsetInBlock, CopyBytes);
+
+	FScopeLock Lock(&InNode->CriticalSection);
+
+	// Another connection may have read the same block meanwhile
+	if (InNode->Blocks.Contains(InBlockIndex))
+	{
+		FMemory::Free(Data);
+		return CopyBytes;
+	}
+
+	FSQLitePakBlock* Block;
+	if (InNode->Blocks.Num() >= InNode->MaxCachedBlocks && InNode->LruTail)
+	{
+		// Recycle the least recently used block
+		Block = InNode->LruTail;
+		LruRemove(InNode, Block);
+		InNode->Blocks.Remove(Block->Index);
+		FMemory::Free(Block->Data);
+	}
+	else
+	{
+		Block = new FSQLitePakBlock();
+	}
+
+	Block->Index = InBlockIndex;
+	Block->Data = Data;
+	Block->Size = BlockBytes;
+
+	InNode->Blocks.Add(InBlockIndex, Block);
+	LruAddHead(InNode, Block);
+
+	return CopyBytes;
+}
+
+void FSQLitePakFileFuncs::LruRemove( FSQLitePakFileNode* InNode, FSQLitePakBlock* InBlock )
+{
+	if (InBlock->LruPrev)
+	{
+		InBlock->LruPrev->LruNext = InBlock->LruNext;
+	}
+	else
+	{
+		InNode->LruHead = InBlock->LruNext;
+	}
+
+	if (InBlock->LruNext)
+	{
+		InBlock->LruNext->LruPrev = InBlock->LruPrev;
+	}
+	else
+	{
+		InNode->LruTail = InBlock->LruPrev;
+	}
+
+	InBlock->LruPrev = nullptr;
+	InBlock->LruNext = nullptr;
+}
+
+void FSQLitePakFileFuncs::LruAddHead( FSQLitePakFileNode* InNode, FSQLitePakBlock* InBlock )
+{
+	InBlock->LruPrev = nullptr;
+	InBlock->LruNext = InNode->LruHead;
+
+	if (InNode->LruHead)
+	{
+		InNode->LruHead->LruPrev = InBlock;
+	}
+	else
+	{
+		InNode->LruTail = InBlock;
+	}
+
+	InNode->LruHead = InBlock;
+}
+
+#endif
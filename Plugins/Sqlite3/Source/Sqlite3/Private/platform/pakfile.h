@@ -0,0 +1,214 @@
+﻿// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#if SQLITE_OS_OTHER
+
+#include "CoreTypes.h"
+#include "Containers/Map.h"
+#include "Misc/ScopeLock.h"
+#include "HAL/PlatformFile.h"
+#include "Async/AsyncFileHandle.h"
+#include "Async/MappedFileHandle.h"
+
+THIRD_PARTY_INCLUDES_START
+#include "sqlite/sqlite3.h-inline"
+THIRD_PARTY_INCLUDES_END
+
+#include "../../Sqlite3/Private/platform/SQLite3Platform.h"
+
+/* ========================================================================= */
+/** Page-compressed database file format                                     */
+/* ========================================================================= */
+
+/**
+ * The header is followed by the page index (FSQLiteCompressedPage[PageCount])
+ * and by the pages, each compressed on its own so that it can be read alone.
+ * All values are little endian.
+ */
+struct FSQLiteCompressedHeader
+{
+	/** "SQLZPAGE" */
+	static constexpr uint64 FileMagic = 0x454741505A4C5153ull;
+	static constexpr uint32 FileVersion = 1;
+
+	uint64 Magic;
+	uint32 Version;
+	uint32 PageSize;
+	uint32 PageCount;
+	uint32 Reserved;
+
+	/** Size of the uncompressed database in bytes */
+	uint64 DatabaseSize;
+
+	/** FCompression format name (LZ4, Zlib, ...) */
+	ANSICHAR Format[16];
+};
+static_assert(sizeof(FSQLiteCompressedHeader) == 48, "The compressed database header is part of the file format");
+
+struct FSQLiteCompressedPage
+{
+	/** Offset of the page data in the file */
+	uint64 Offset;
+
+	/** Bytes of page data, the page is stored uncompressed when this is the page size */
+	uint32 Size;
+	uint32 Reserved;
+};
+static_assert(sizeof(FSQLiteCompressedPage) == 16, "The compressed page index is part of the file format");
+
+/* ========================================================================= */
+/** A cached block of a packaged database file                               */
+/* ========================================================================= */
+
+struct FSQLitePakBlock
+{
+	/** Block number (offset / block size, the page number - 1 of compressed files) */
+	int64 Index;
+
+	uint8* Data;
+
+	/** Bytes of data, less than the block size for the last block of the file */
+	int32 Size;
+
+	/** Blocks are kept in a LRU list (head is the most recently used) */
+	FSQLitePakBlock* LruPrev;
+	FSQLitePakBlock* LruNext;
+};
+
+/* ========================================================================= */
+/** One node per packaged database file, shared by all its connections      */
+/* ========================================================================= */
+
+struct FSQLitePakFileNode
+{
+	/** Registry key (full filename) */
+	FString Filename;
+
+	int32 RefCount = 0;
+
+	/** Size SQLite sees, the uncompressed size of compressed files */
+	int64 FileSize = 0;
+
+	/** Block size of the cache, the page size of compressed files */
+	int32 BlockSize = 0;
+	int32 MaxCachedBlocks = 0;
+
+	/** Compression format of page-compressed files, NAME_None for plain databases */
+	FName CompressionFormat;
+	TArray<FSQLiteCompressedPage> Pages;
+
+	/** Whole file mapping, where the platform and the container allow it (uncompressed pak entries) */
+	IMappedFileHandle* MappedHandle = nullptr;
+	IMappedFileRegion* MappedRegion = nullptr;
+
+	/** Reads of the files that can not be mapped */
+	IAsyncReadFileHandle* AsyncHandle = nullptr;
+
+	TMap<int64, FSQLitePakBlock*> Blocks;
+	FSQLitePakBlock* LruHead = nullptr;
+	FSQLitePakBlock* LruTail = nullptr;
+
+	FCriticalSection CriticalSection;
+};
+
+/* ========================================================================= */
+/** What SQLite sees of a packaged database file                             */
+/* ========================================================================= */
+
+struct FSQLitePakFile
+{
+	const sqlite3_io_methods* IOMethods;
+
+	FSQLitePakFileNode* Node;
+};
+
+/* ========================================================================= */
+/** Read-only file system for databases shipped in pak/IoStore containers    */
+/* ========================================================================= */
+
+/**
+ * Registered as "unreal-pak", next to "unreal-fs" whose path and system functions it shares.
+ * Files report SQLITE_IOCAP_IMMUTABLE, so SQLite opens them with immutable=1 semantics:
+ * no locks, no journal or WAL lookups and no change counter checks. The database must not
+ * be in WAL mode, and nothing may write to it while it is open.
+ * Page-compressed files (see CompressDatabase) are recognized by their header, their pages
+ * are decompressed into the block cache which bounds the decompression work.
+ */
+struct FSQLitePakFileFuncs
+{
+public:
+	/** Register the file system, after FSQLiteFileFuncs::Register */
+	static void Register();
+
+	/** Configure the block cache */
+	static void Configure( const FSQLitePlatformConfig& InConfig );
+
+	/** Convert a database image into a page-compressed file, the database must not need its journal or WAL */
+	static bool CompressDatabase( const TArray64<uint8>& InDatabase, FName InFormat, TArray64<uint8>& OutFile );
+
+private:
+	static int32 BlockSize;
+	static int64 BlockCacheSize;
+
+	/** Nodes by full filename */
+	static FCriticalSection NodesSection;
+	static TMap<FString, FSQLitePakFileNode*> Nodes;
+
+	// ------------------------------------------------------------------------
+	// sqlite3_vfs
+	// ------------------------------------------------------------------------
+
+	/** Attempt to open a file, only main databases can be opened */
+	static int Open( sqlite3_vfs* InVFS, const char* InFilename, sqlite3_file* InFile, int InFlags, int* OutFlagsPtr );
+
+	/** Packaged files can not be deleted */
+	static int Delete( sqlite3_vfs* InVFS, const char* InFilename, int InSyncDir );
+
+	/** Check whether a file exists, nothing is ever writable */
+	static int Access( sqlite3_vfs* InVFS, const char* InFilename, int InAccessMode, int* OutResultPtr );
+
+	// ------------------------------------------------------------------------
+	// sqlite3_io_methods
+	// ------------------------------------------------------------------------
+
+	static int Close( sqlite3_file* InFile );
+	static int Read( sqlite3_file* InFile, void* OutBuffer, int InReadAmountBytes, sqlite3_int64 InReadOffsetBytes );
+	static int Write( sqlite3_file* InFile, const void* InBuffer, int InWriteAmountBytes, sqlite3_int64 InWriteOffsetBytes );
+	static int Truncate( sqlite3_file* InFile, sqlite3_int64 InSizeBytes );
+	static int Sync( sqlite3_file* InFile, int InFlags );
+	static int FileSize( sqlite3_file* InFile, sqlite3_int64* OutSizePtr );
+	static int Lock( sqlite3_file* InFile, int InLockMode );
+	static int Unlock( sqlite3_file* InFile, int InLockMode );
+	static int CheckReservedLock( sqlite3_file* InFile, int* OutIsLocked );
+	static int FileControl( sqlite3_file* InFile, int InOp, void* InOutOpData );
+	static int SectorSize( sqlite3_file* InFile );
+	static int DeviceCharacteristics( sqlite3_file* InFile );
+
+	/** Memory mapped reads straight from the file mapping, when there is one */
+	static int Fetch( sqlite3_file* InFile, sqlite3_int64 InOffsetBytes, int InAmountBytes, void** OutPtr );
+	static int Unfetch( sqlite3_file* InFile, sqlite3_int64 InOffsetBytes, void* InPtr );
+
+	// ------------------------------------------------------------------------
+	// Helpers
+	// ------------------------------------------------------------------------
+
+	/** Get the node of a file, opening it for the first connection */
+	static FSQLitePakFileNode* AcquireNode( const FString& InFilename );
+	static void ReleaseNode( FSQLitePakFileNode* InNode );
+
+	/** Read the header and page index of a page-compressed file, false if the file is not one */
+	static bool ReadCompressedIndex( FSQLitePakFileNode* InNode, int64 InRawFileSize );
+
+	/** Read bytes of the file as stored, through the mapping or an async read */
+	static bool ReadRange( FSQLitePakFileNode* InNode, int64 InOffsetBytes, int64 InAmountBytes, uint8* OutBuffer );
+
+	/** Copy a block to the output buffer, reading and caching it on a miss, returns the number of bytes copied (-1 on error) */
+	static int64 ReadBlock( FSQLitePakFileNode* InNode, int64 InBlockIndex, int64 InOffsetInBlock, int64 InAmountBytes, uint8* OutBuffer );
+
+	/** Called with the node critical section held */
+	static void LruRemove( FSQLitePakFileNode* InNode, FSQLitePakBlock* InBlock );
+	static void LruAddHead( FSQLitePakFileNode* InNode, FSQLitePakBlock* InBlock );
+};
+
+#endif
@@ -0,0 +1,615 @@
+﻿// Copyright Epic Games, Inc. All Rights Reserved.
+
+#if SQLITE_OS_OTHER
+
+#include "../../Sqlite3/Private/platform/pcache.h"
+#include "../../Sqlite3/Private/platform/SQLite3Platform.h"
+#include "Sqlite3Log.h"
+
+#include "CoreTypes.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+#include "Math/RandomStream.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformFileManager.h"
+#include "HAL/PlatformFile.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "Templates/Atomic.h"
+
+THIRD_PARTY_INCLUDES_START
+#include "sqlite/sqlite3.h-inline"
+THIRD_PARTY_INCLUDES_END
+
+// ============================================================================
+// = Page cache functions used by SQLite (see sqlite3_pcache_methods2)
+// ============================================================================
+
+int64 FSQLitePageCacheFuncs::Budget = 0;
+int64 FSQLitePageCacheFuncs::Reserve = 0;
+int32 FSQLitePageCacheFuncs::SlabSize = 256 * 1024;
+
+sqlite3_mutex* FSQLitePageCacheFuncs::Mutex = nullptr;
+
+TArray<FSQLitePageCache*> FSQLitePageCacheFuncs::Caches;
+TArray<FSQLitePageCacheSlab*> FSQLitePageCacheFuncs::Slabs;
+TArray<FSQLitePageCacheSlab*> FSQLitePageCacheFuncs::SpareSlabs;
+TMap<int32, FSQLitePage*> FSQLitePageCacheFuncs::FreeLists;
+
+FSQLitePageCacheStats FSQLitePageCacheFuncs::Stats;
+
+/** Scoped lock on the page cache mutex */
+struct FSQLitePageCacheLock
+{
+	FSQLitePageCacheLock( sqlite3_mutex* InMutex ) : Mutex( InMutex ) { sqlite3_mutex_enter( Mutex ); }
+	~FSQLitePageCacheLock() { sqlite3_mutex_leave( Mutex ); }
+
+private:
+	sqlite3_mutex* Mutex;
+};
+
+/** Register the page cache */
+void FSQLitePageCacheFuncs::Register( int64 InBudget, int64 InReserve, int32 InSlabSize )
+{
+	static const sqlite3_pcache_methods2 PageCacheFuncs = {
+		1,
+		nullptr,
+		&Init,
+		&Shutdown,
+		&Create,
+		&Cachesize,
+		&Pagecount,
+		&Fetch,
+		&Unpin,
+		&Rekey,
+		&Truncate,
+		&Destroy,
+		&Shrink
+	};
+
+	Budget = FMath::Max<int64>( InBudget, 0 );
+	Reserve = FMath::Max<int64>( InReserve, 0 );
+	SlabSize = FMath::Max<int32>( InSlabSize, 64 * 1024 );
+
+	sqlite3_config( SQLITE_CONFIG_PCACHE2, &PageCacheFuncs );
+}
+
+/** Get a snapshot of the page cache statistics */
+void FSQLitePageCacheFuncs::GetStats( FSQLitePageCacheStats& OutStats )
+{
+	FSQLitePageCacheLock Lock( Mutex );
+
+	OutStats = Stats;
+	OutStats.Budget = Budget;
+	OutStats.CacheCount = Caches.Num();
+}
+
+/** Evict every unpinned page and give back the slabs beyond the reserve */
+int64 FSQLitePageCacheFuncs::ReleaseMemory()
+{
+	FSQLitePageCacheLock Lock( Mutex );
+
+	const int64 BytesReserved = Stats.BytesReserved;
+
+	for( FSQLitePageCache* Cache : Caches )
+	{
+		while( Cache->LruTail )
+		{
+			DiscardPage( Cache->LruTail );
+		}
+	}
+
+	ReleaseEmptySlabs();
+
+	return BytesReserved - Stats.BytesReserved;
+}
+
+// ----------------------------------------------------------------------------
+
+/** Initialize the page cache */
+int FSQLitePageCacheFuncs::Init( void* )
+{
+	Mutex = sqlite3_mutex_alloc( SQLITE_MUTEX_STATIC_LRU );
+
+	// Allocate the reserve up-front so that the first pages do not hit the allocator
+
+	LLM_SCOPE_BYNAME( TEXT( "Sqlite/PageCache" ) );
+
+	for( int64 Reserved = 0; Reserved < Reserve; Reserved += SlabSize )
+	{
+		FSQLitePageCacheSlab* Slab = new FSQLitePageCacheSlab();
+		Slab->Size = SlabSize;
+		Slab->Memory = (uint8*)FMemory::Malloc( Slab->Size, 16 );
+		Slab->SlotSize = 0;
+		Slab->SlotCount = 0;
+		Slab->UsedCount = 0;
+
+		if( !Slab->Memory )
+		{
+			delete Slab;
+			return SQLITE_NOMEM;
+		}
+
+		Slabs.Add( Slab );
+		SpareSlabs.Add( Slab );
+		Stats.BytesReserved += Slab->Size;
+	}
+
+	return SQLITE_OK;
+}
+
+/** Shutdown the page cache */
+void FSQLitePageCacheFuncs::Shutdown( void* )
+{
+	check( Caches.Num() == 0 );
+
+	for( FSQLitePageCacheSlab* Slab : Slabs )
+	{
+		FMemory::Free( Slab->Memory );
+		delete Slab;
+	}
+
+	Slabs.Empty();
+	SpareSlabs.Empty();
+	FreeLists.Empty();
+
+	Stats = FSQLitePageCacheStats();
+
+	Mutex = nullptr;
+}
+
+/** Create a cache */
+sqlite3_pcache* FSQLitePageCacheFuncs::Create( int InPageSize, int InExtraSize, int bInPurgeable )
+{
+	FSQLitePageCache* Cache = new FSQLitePageCache();
+	Cache->PageSize = InPageSize;
+	Cache->ExtraSize = InExtraSize;
+	Cache->SlotSize = Align( InPageSize + InExtraSize, 16 ) + Align( (int32)sizeof( FSQLitePage ), 16 );
+	Cache->bPurgeable = bInPurgeable != 0;
+	Cache->Priority = FSQLiteThreadContext::Get().PageCachePriority;
+	Cache->MaxPages = 0;
+	Cache->UnpinnedCount = 0;
+	Cache->LruHead = nullptr;
+	Cache->LruTail = nullptr;
+
+	FSQLitePageCacheLock Lock( Mutex );
+	Caches.Add( Cache );
+
+	return (sqlite3_pcache*)Cache;
+}
+
+/** Set the suggested maximum size of a cache */
+void FSQLitePageCacheFuncs::Cachesize( sqlite3_pcache* InCache, int InMaxPages )
+{
+	FSQLitePageCache* Cache = (FSQLitePageCache*)InCache;
+
+	FSQLitePageCacheLock Lock( Mutex );
+
+	if( Cache->bPurgeable )
+	{
+		Cache->MaxPages = InMaxPages;
+
+		while( Cache->Pages.Num() > Cache->MaxPages && Cache->LruTail )
+		{
+			DiscardPage( Cache->LruTail );
+		}
+	}
+}
+
+/** Get the number of pages in a cache */
+int FSQLitePageCacheFuncs::Pagecount( sqlite3_pcache* InCache )
+{
+	FSQLitePageCache* Cache = (FSQLitePageCache*)InCache;
+
+	FSQLitePageCacheLock Lock( Mutex );
+	return Cache->Pages.Num();
+}
+
+/** Fetch a page from a cache, possibly allocating it */
+sqlite3_pcache_page* FSQLitePageCacheFuncs::Fetch( sqlite3_pcache* InCache, unsigned int InKey, int InCreateFlag )
+{
+	FSQLitePageCache* Cache = (FSQLitePageCache*)InCache;
+
+	FSQLitePageCacheLock Lock( Mutex );
+
+	if( FSQLitePage** Found = Cache->Pages.Find( InKey ) )
+	{
+		FSQLitePage* Page = *Found;
+		if( !Page->bPinned )
+		{
+			LruRemove( Page );
+			Page->bPinned = true;
+		}
+
+		++Stats.Hits;
+		return &Page->Base;
+	}
+
+	++Stats.Misses;
+
+	if( InCreateFlag == 0 )
+	{
+		return nullptr;
+	}
+
+	// Same rule as pcache1: when nearly every page is pinned, let the pager
+	// spill dirty pages (second call with InCreateFlag == 2) before growing.
+
+	const int32 PinnedCount = Cache->Pages.Num() - Cache->UnpinnedCount;
+	if( InCreateFlag == 1 && Cache->bPurgeable && PinnedCount >= ( Cache->MaxPages * 9 ) / 10 )
+	{
+		return nullptr;
+	}
+
+	FSQLitePage* Page = nullptr;
+
+	if( Cache->bPurgeable && Cache->Pages.Num() >= Cache->MaxPages && Cache->LruTail )
+	{
+		// The cache is at its own limit: reuse its least recently used page
+
+		Page = Cache->LruTail;
+		LruRemove( Page );
+		Cache->Pages.Remove( Page->Key );
+		++Stats.Recycles;
+	}
+	else if( Budget > 0 && Stats.BytesInUse + Cache->SlotSize > Budget )
+	{
+		// The global budget is spent: take a page from the lowest priority cache
+
+		if( FSQLitePageCache* Victim = FindEvictionVictim( Cache ) )
+		{
+			FSQLitePage* VictimPage = Victim->LruTail;
+			if( Victim->SlotSize == Cache->SlotSize )
+			{
+				Page = VictimPage;
+				LruRemove( Page );
+				Victim->Pages.Remove( Page->Key );
+			}
+			else
+			{
+				DiscardPage( VictimPage );
+			}
+
+			++Stats.Evictions;
+		}
+		else if( InCreateFlag == 1 )
+		{
+			return nullptr;
+		}
+		else
+		{
+			++Stats.Overflows;
+		}
+	}
+
+	if( !Page )
+	{
+		Page = AllocateSlot( Cache->SlotSize );
+		if( !Page )
+		{
+			return nullptr;
+		}
+
+		++Stats.PageCount;
+		Stats.BytesInUse += Cache->SlotSize;
+	}
+
+	Page->Base.pBuf = (uint8*)Page - Align( Cache->PageSize + Cache->ExtraSize, 16 );
+	Page->Base.pExtra = (uint8*)Page->Base.pBuf + Cache->PageSize;
+	Page->Cache = Cache;
+	Page->Key = InKey;
+	Page->bPinned = true;
+	Page->LruPrev = nullptr;
+	Page->LruNext = nullptr;
+	Page->NextFree = nullptr;
+
+	*(void**)Page->Base.pExtra = nullptr;
+
+	Cache->Pages.Add( InKey, Page );
+
+	return &Page->Base;
+}
+
+/** Release a page previously returned by Fetch */
+void FSQLitePageCacheFuncs::Unpin( sqlite3_pcache* InCache, sqlite3_pcache_page* InPage, int bInDiscard )
+{
+	FSQLitePageCache* Cache = (FSQLitePageCache*)InCache;
+	FSQLitePage* Page = (FSQLitePage*)InPage;
+
+	FSQLitePageCacheLock Lock( Mutex );
+
+	check( Page->Cache == Cache && Page->bPinned );
+
+	if( bInDiscard || ( Cache->bPurgeable && Cache->Pages.Num() > Cache->MaxPages ) )
+	{
+		DiscardPage( Page );
+	}
+	else
+	{
+		Page->bPinned = false;
+		LruAddHead( Page );
+	}
+}
+
+/** Change the page number of a page */
+void FSQLitePageCacheFuncs::Rekey( sqlite3_pcache* InCache, sqlite3_pcache_page* InPage, unsigned int InOldKey, unsigned int InNewKey )
+{
+	FSQLitePageCache* Cache = (FSQLitePageCache*)InCache;
+	FSQLitePage* Page = (FSQLitePage*)InPage;
+
+	FSQLitePageCacheLock Lock( Mutex );
+
+	check( Page->Key == InOldKey );
+
+	Cache->Pages.Remove( InOldKey );
+	Page->Key = InNewKey;
+	Cache->Pages.Add( InNewKey, Page );
+}
+
+/** Discard all pages with a page number greater than or equal to the limit */
+void FSQLitePageCacheFuncs::Truncate( sqlite3_pcache* InCache, unsigned int InLimit )
+{
+	FSQLitePageCache* Cache = (FSQLitePageCache*)InCache;
+
+	FSQLitePageCacheLock Lock( Mutex );
+
+	TArray<FSQLitePage*> Discarded;
+	for( const TPair<uint32, FSQLitePage*>& Entry : Cache->Pages )
+	{
+		if( Entry.Key >= InLimit )
+		{
+			Discarded.Add( Entry.Value );
+		}
+	}
+
+	for( FSQLitePage* Page : Discarded )
+	{
+		DiscardPage( Page );
+	}
+}
+
+/** Destroy a cache returned by Create */
+void FSQLitePageCacheFuncs::Destroy( sqlite3_pcache* InCache )
+{
+	FSQLitePageCache* Cache = (FSQLitePageCache*)InCache;
+
+	{
+		FSQLitePageCacheLock Lock( Mutex );
+
+		TArray<FSQLitePage*> Discarded;
+		Cache->Pages.GenerateValueArray( Discarded );
+
+		for( FSQLitePage* Page : Discarded )
+		{
+			DiscardPage( Page );
+		}
+
+		Caches.Remove( Cache );
+
+		ReleaseEmptySlabs();
+	}
+
+	delete Cache;
+}
+
+/** Release as much memory as possible from a cache */
+void FSQLitePageCacheFuncs::Shrink( sqlite3_pcache* InCache )
+{
+	FSQLitePageCache* Cache = (FSQLitePageCache*)InCache;
+
+	FSQLitePageCacheLock Lock( Mutex );
+
+	while( Cache->LruTail )
+	{
+		DiscardPage( Cache->LruTail );
+	}
+
+	ReleaseEmptySlabs();
+}
+
+// ----------------------------------------------------------------------------
+// Helpers, called with the mutex held
+// ----------------------------------------------------------------------------
+
+FSQLitePage* FSQLitePageCacheFuncs::AllocateSlot( int32 InSlotSize )
+{
+	FSQLitePage*& FreeList = FreeLists.FindOrAdd( InSlotSize );
+
+	if( !FreeList )
+	{
+		// Carve a spare slab (or a new one) into slots of the requested size
+
+		FSQLitePageCacheSlab* Slab = nullptr;
+		for( int32 Index = 0; Index < SpareSlabs.Num(); ++Index )
+		{
+			if( SpareSlabs[Index]->Size >= InSlotSize )
+			{
+				Slab = SpareSlabs[Index];
+				SpareSlabs.RemoveAtSwap( Index );
+				break;
+			}
+		}
+
+		if( !Slab )
+		{
+			LLM_SCOPE_BYNAME( TEXT( "Sqlite/PageCache" ) );
+
+			const int64 Size = FMath::Max<int64>( SlabSize, InSlotSize );
+			uint8* Memory = (uint8*)FMemory::Malloc( Size, 16 );
+			if( !Memory )
+			{
+				return nullptr;
+			}
+
+			Slab = new FSQLitePageCacheSlab();
+			Slab->Memory = Memory;
+			Slab->Size = Size;
+
+			Slabs.Add( Slab );
+			Stats.BytesReserved += Size;
+		}
+
+		Slab->SlotSize = InSlotSize;
+		Slab->SlotCount = (int32)( Slab->Size / InSlotSize );
+		Slab->UsedCount = 0;
+
+		const int32 HeaderOffset = InSlotSize - Align( (int32)sizeof( FSQLitePage ), 16 );
+		for( int32 SlotIndex = Slab->SlotCount - 1; SlotIndex >= 0; --SlotIndex )
+		{
+			FSQLitePage* Slot = (FSQLitePage*)( Slab->Memory + (int64)SlotIndex * InSlotSize + HeaderOffset );
+			Slot->Cache = nullptr;
+			Slot->Slab = Slab;
+			Slot->NextFree = FreeList;
+			FreeList = Slot;
+		}
+	}
+
+	FSQLitePage* Page = FreeList;
+	FreeList = Page->NextFree;
+
+	++Page->Slab->UsedCount;
+
+	return Page;
+}
+
+void FSQLitePageCacheFuncs::FreeSlot( FSQLitePage* InPage )
+{
+	FSQLitePage*& FreeList = FreeLists.FindChecked( InPage->Slab->SlotSize );
+
+	InPage->Cache = nullptr;
+	InPage->NextFree = FreeList;
+	FreeList = InPage;
+
+	--InPage->Slab->UsedCount;
+}
+
+void FSQLitePageCacheFuncs::LruRemove( FSQLitePage* InPage )
+{
+	FSQLitePageCache* Cache = InPage->Cache;
+
+	( InPage->LruPrev ? InPage->LruPrev->LruNext : Cache->LruHead ) = InPage->LruNext;
+	( InPage->LruNext ? InPage->LruNext->LruPrev : Cache->LruTail ) = InPage->LruPrev;
+
+	InPage->LruPrev = nullptr;
+	InPage->LruNext = nullptr;
+
+	--Cache->UnpinnedCount;
+}
+
+void FSQLitePageCacheFuncs::LruAddHead( FSQLitePage* InPage )
+{
+	FSQLitePageCache* Cache = InPage->Cache;
+
+	InPage->LruPrev = nullptr;
+	InPage->LruNext = Cache->LruHead;
+
+	( Cache->LruHead ? Cache->LruHead->LruPrev : Cache->LruTail ) = InPage;
+	Cache->LruHead = InPage;
+
+	++Cache->UnpinnedCount;
+}
+
+/** Remove a page from its cache and give the slot back */
+void FSQLitePageCacheFuncs::DiscardPage( FSQLitePage* InPage )
+{
+	FSQLitePageCache* Cache = InPage->Cache;
+
+	if( !InPage->bPinned )
+	{
+		LruRemove( InPage );
+	}
+
+	Cache->Pages.Remove( InPage->Key );
+
+	--Stats.PageCount;
+	Stats.BytesInUse -= Cache->SlotSize;
+
+	FreeSlot( InPage );
+}
+
+/** Find the cache that should lose a page so that InRequester can get one */
+FSQLitePageCache* FSQLitePageCacheFuncs::FindEvictionVictim( FSQLitePageCache* InRequester )
+{
+	FSQLitePageCache* Victim = nullptr;
+
+	for( FSQLitePageCache* Cache : Caches )
+	{
+		if( !Cache->bPurgeable || !Cache->LruTail || Cache->Priority > InRequester->Priority )
+		{
+			continue;
+		}
+
+		// Lowest priority first, then the cache holding the most pages
+
+		if( !Victim
+			|| Cache->Priority < Victim->Priority
+			|| ( Cache->Priority == Victim->Priority && Cache->Pages.Num() > Victim->Pages.Num() ) )
+		{
+			Victim = Cache;
+		}
+	}
+
+	return Victim;
+}
+
+/** Give back the memory of slabs that are no longer used */
+void FSQLitePageCacheFuncs::ReleaseEmptySlabs()
+{
+	// Unlink the free slots of the empty slabs
+
+	bool bHasEmptySlab = false;
+	for( FSQLitePageCacheSlab* Slab : Slabs )
+	{
+		bHasEmptySlab |= ( Slab->SlotSize != 0 && Slab->UsedCount == 0 );
+	}
+
+	if( !bHasEmptySlab )
+	{
+		return;
+	}
+
+	for( TPair<int32, FSQLitePage*>& FreeList : FreeLists )
+	{
+		FSQLitePage** Link = &FreeList.Value;
+		while( *Link )
+		{
+			if( ( *Link )->Slab->UsedCount == 0 )
+			{
+				*Link = ( *Link )->NextFree;
+			}
+			else
+			{
+				Link = &( *Link )->NextFree;
+			}
+		}
+	}
+
+	for( FSQLitePageCacheSlab* Slab : Slabs )
+	{
+		if( Slab->SlotSize != 0 && Slab->UsedCount == 0 )
+		{
+			Slab->SlotSize = 0;
+			Slab->SlotCount = 0;
+			SpareSlabs.Add( Slab );
+		}
+	}
+
+	// Keep the reserve, free the rest
+
+	for( int32 Index = SpareSlabs.Num() - 1; Index >= 0 && Stats.BytesReserved > Reserve; --Index )
+	{
+		FSQLitePageCacheSlab* Slab = SpareSlabs[Index];
+		if( Stats.BytesReserved - Slab->Size < Reserve )
+		{
+			continue;
+		}
+
+		SpareSlabs.RemoveAtSwap( Index );
+		Slabs.RemoveSwap( Slab );
+		Stats.BytesReserved -= Slab->Size;
+
+		FMemory::Free( Slab->Memory );
+		delete Slab;
+	}
+}
+
+#endif
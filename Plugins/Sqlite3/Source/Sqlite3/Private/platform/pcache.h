@@ -0,0 +1,221 @@
+﻿// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#if SQLITE_OS_OTHER
+
+#include "CoreTypes.h"
+#include "Containers/Array.h"
+#include "Containers/Map.h"
+
+THIRD_PARTY_INCLUDES_START
+#include "sqlite/sqlite3.h-inline"
+THIRD_PARTY_INCLUDES_END
+
+struct FSQLitePageCache;
+struct FSQLitePageCacheSlab;
+
+/* ========================================================================= */
+/** A page slot, stored right after the page and extra data in its slab      */
+/* ========================================================================= */
+
+struct FSQLitePage
+{
+	/** What SQLite sees of the page (must stay first) */
+	sqlite3_pcache_page Base;
+
+	/** Cache owning the page, null while on a free list */
+	FSQLitePageCache* Cache;
+
+	/** Slab the slot was carved from */
+	FSQLitePageCacheSlab* Slab;
+
+	/** Page number */
+	uint32 Key;
+
+	/** Pinned pages are in use by SQLite and can not be evicted */
+	bool bPinned;
+
+	/** Unpinned pages are kept in a LRU list (head is the most recently used) */
+	FSQLitePage* LruPrev;
+	FSQLitePage* LruNext;
+
+	/** Next slot on the free list of the same slot size */
+	FSQLitePage* NextFree;
+};
+
+/* ========================================================================= */
+/** A block of memory carved into slots of a single size                     */
+/* ========================================================================= */
+
+struct FSQLitePageCacheSlab
+{
+	uint8* Memory;
+
+	/** Size of the memory block in bytes */
+	int64 Size;
+
+	/** Slot size in bytes, zero while the slab is spare */
+	int32 SlotSize;
+
+	int32 SlotCount;
+
+	/** Slots currently handed to a cache */
+	int32 UsedCount;
+};
+
+/* ========================================================================= */
+/** One SQLite page cache (one per open pager)                              */
+/* ========================================================================= */
+
+struct FSQLitePageCache
+{
+	int32 PageSize;
+	int32 ExtraSize;
+	int32 SlotSize;
+
+	bool bPurgeable;
+
+	/** Eviction priority, caches with the lowest priority lose their pages first */
+	int32 Priority;
+
+	/** Suggested maximum number of pages (see xCachesize) */
+	int32 MaxPages;
+
+	int32 UnpinnedCount;
+
+	TMap<uint32, FSQLitePage*> Pages;
+
+	FSQLitePage* LruHead;
+	FSQLitePage* LruTail;
+};
+
+/* ========================================================================= */
+/** Page cache statistics                                                    */
+/* ========================================================================= */
+
+struct FSQLitePageCacheStats
+{
+	/** Fetches that found the page in the cache */
+	int64 Hits = 0;
+
+	/** Fetches that did not find the page */
+	int64 Misses = 0;
+
+	/** Pages taken from another cache to stay within the global budget */
+	int64 Evictions = 0;
+
+	/** Pages reused within a cache because it reached its own size limit */
+	int64 Recycles = 0;
+
+	/** Pages allocated past the global budget because nothing could be evicted */
+	int64 Overflows = 0;
+
+	/** Bytes of slots currently holding a page */
+	int64 BytesInUse = 0;
+
+	/** Bytes of slabs owned by the page cache (in use, free or spare) */
+	int64 BytesReserved = 0;
+
+	/** Global budget (0 = unlimited) */
+	int64 Budget = 0;
+
+	int32 PageCount = 0;
+	int32 CacheCount = 0;
+};
+
+/* ========================================================================= */
+/** Page cache functions used by SQLite (see sqlite3_pcache_methods2)        */
+/* ========================================================================= */
+
+/**
+ * Pages are served from large slabs so that SQLite page traffic does not hit
+ * the general purpose allocator, and all caches share a single page budget.
+ * When the budget is reached the unpinned pages of the lowest priority cache
+ * are evicted first (see FSQLiteThreadContext::PageCachePriority).
+ */
+struct FSQLitePageCacheFuncs
+{
+public:
+	/** Register the page cache */
+	static void Register( int64 InBudget, int64 InReserve, int32 InSlabSize );
+
+	/** Get a snapshot of the page cache statistics */
+	static void GetStats( FSQLitePageCacheStats& OutStats );
+
+	/** Evict every unpinned page and give back the slabs beyond the reserve, returns the number of bytes freed */
+	static int64 ReleaseMemory();
+
+private:
+	static int64 Budget;
+	static int64 Reserve;
+	static int32 SlabSize;
+
+	/** Mutex protecting all the page cache state (SQLITE_MUTEX_STATIC_LRU) */
+	static sqlite3_mutex* Mutex;
+
+	static TArray<FSQLitePageCache*> Caches;
+	static TArray<FSQLitePageCacheSlab*> Slabs;
+	static TArray<FSQLitePageCacheSlab*> SpareSlabs;
+	static TMap<int32, FSQLitePage*> FreeLists;
+
+	static FSQLitePageCacheStats Stats;
+
+	// ------------------------------------------------------------------------
+	//
+	// ------------------------------------------------------------------------
+
+	/** Initialize the page cache */
+	static int Init( void* );
+
+	/** Shutdown the page cache */
+	static void Shutdown( void* );
+
+	/** Create a cache */
+	static sqlite3_pcache* Create( int InPageSize, int InExtraSize, int bInPurgeable );
+
+	/** Set the suggested maximum size of a cache */
+	static void Cachesize( sqlite3_pcache* InCache, int InMaxPages );
+
+	/** Get the number of pages in a cache */
+	static int Pagecount( sqlite3_pcache* InCache );
+
+	/** Fetch a page from a cache, possibly allocating it */
+	static sqlite3_pcache_page* Fetch( sqlite3_pcache* InCache, unsigned int InKey, int InCreateFlag );
+
+	/** Release a page previously returned by Fetch */
+	static void Unpin( sqlite3_pcache* InCache, sqlite3_pcache_page* InPage, int bInDiscard );
+
+	/** Change the page number of a page */
+	static void Rekey( sqlite3_pcache* InCache, sqlite3_pcache_page* InPage, unsigned int InOldKey, unsigned int InNewKey );
+
+	/** Discard all pages with a page number greater than or equal to the limit */
+	static void Truncate( sqlite3_pcache* InCache, unsigned int InLimit );
+
+	/** Destroy a cache returned by Create */
+	static void Destroy( sqlite3_pcache* InCache );
+
+	/** Release as much memory as possible from a cache */
+	static void Shrink( sqlite3_pcache* InCache );
+
+	// ------------------------------------------------------------------------
+	// Helpers, called with the mutex held
+	// ------------------------------------------------------------------------
+
+	static FSQLitePage* AllocateSlot( int32 InSlotSize );
+	static void FreeSlot( FSQLitePage* InPage );
+
+	static void LruRemove( FSQLitePage* InPage );
+	static void LruAddHead( FSQLitePage* InPage );
+
+	/** Remove a page from its cache and give the slot back */
+	static void DiscardPage( FSQLitePage* InPage );
+
+	/** Find the cache that should lose a page so that InRequester can get one (never one with a higher priority) */
+	static FSQLitePageCache* FindEvictionVictim( FSQLitePageCache* InRequester );
+
+	/** Give back the memory of slabs that are no longer used */
+	static void ReleaseEmptySlabs();
+};
+
+#endif
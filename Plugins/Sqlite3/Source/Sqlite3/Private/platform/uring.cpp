@@ -0,0 +1,556 @@
+﻿// Copyright Epic Games, Inc. All Rights Reserved.
+
+#if SQLITE_OS_OTHER
+
+#include "../../Sqlite3/Private/platform/uring.h"
+
+#if SQLITE_UE_IO_URING
+
+#include "Sqlite3Log.h"
+
+#include "CoreTypes.h"
+#include "Misc/ScopeLock.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "HAL/PlatformProcess.h"
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+/** Older C libraries do not know the io_uring system calls, their numbers are the same on every architecture */
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+
+// ============================================================================
+// = io_uring submission and completion rings of one file
+// ============================================================================
+
+/** User data of the prefetch read and of its cancellation, the other operations use their index in the submission */
+static constexpr uint64 PrefetchUserData = ~0ull;
+static constexpr uint64 CancelUserData = ~0ull - 1;
+
+/** Queued write bytes that trigger a submission, whatever the sync points */
+static constexpr int64 MaxQueuedWriteBytes = 8 * 1024 * 1024;
+
+/** Positional write used when the ring could not complete a write */
+static bool WriteFully( int InFd, const uint8* InBuffer, int64 InAmountBytes, int64 InOffsetBytes )
+{
+	int64 BytesWritten = 0;
+	while (BytesWritten < InAmountBytes)
+	{
+		const ssize_t Result = pwrite(InFd, InBuffer + BytesWritten, InAmountBytes - BytesWritten, InOffsetBytes + BytesWritten);
+		if (Result <= 0)
+		{
+			if (Result < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			return false;
+		}
+
+		BytesWritten += Result;
+	}
+
+	return true;
+}
+
+static bool DataSync( int InFd )
+{
+	int Result;
+	do
+	{
+		Result = fdatasync(InFd);
+	} while (Result != 0 && errno == EINTR);
+
+	return Result == 0;
+}
+
+/** Set up a ring for a descriptor, nullptr when the kernel has no io_uring or does not allow it */
+FSQLiteIoUring* FSQLiteIoUring::Create( int InFd, int32 InQueueDepth )
+{
+	io_uring_params Params;
+	FMemory::Memzero(Params);
+
+	const int RingFd = (int)syscall(__NR_io_uring_setup, (uint32)FMath::Clamp(InQueueDepth, 2, 4096), &Params);
+	if (RingFd < 0)
+	{
+		static bool bLogged = false;
+		if (!bLogged)
+		{
+			UE_LOG( LogSqlite, Log, TEXT("io_uring is not available (errno %d), using positional I/O."), errno );
+			bLogged = true;
+		}
+		return nullptr;
+	}
+
+	FSQLiteIoUring* Ring = new FSQLiteIoUring();
+	Ring->RingFd = RingFd;
+	Ring->Fd = InFd;
+	Ring->QueueDepth = Params.sq_entries;
+
+	Ring->SqRingSize = Params.sq_off.array + Params.sq_entries * sizeof(uint32);
+	Ring->CqRingSize = Params.cq_off.cqes + Params.cq_entries * sizeof(io_uring_cqe);
+
+	// Recent kernels map both rings at once
+	const bool bSingleMmap = !!(Params.features & IORING_FEAT_SINGLE_MMAP);
+	if (bSingleMmap)
+	{
+		Ring->SqRingSize = Ring->CqRingSize = FMath::Max(Ring->SqRingSize, Ring->CqRingSize);
+	}
+
+	Ring->SqRingPtr = mmap(nullptr, Ring->SqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RingFd, IORING_OFF_SQ_RING);
+	Ring->CqRingPtr = bSingleMmap ? Ring->SqRingPtr : mmap(nullptr, Ring->CqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RingFd, IORING_OFF_CQ_RING);
+
+	Ring->SqesSize = Params.sq_entries * sizeof(io_uring_sqe);
+	void* SqesPtr = mmap(nullptr, Ring->SqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RingFd, IORING_OFF_SQES);
+
+	if (Ring->SqRingPtr == MAP_FAILED || Ring->CqRingPtr == MAP_FAILED || SqesPtr == MAP_FAILED)
+	{
+		UE_LOG( LogSqlite, Warning, TEXT("io_uring rings could not be mapped (errno %d), using positional I/O."), errno );
+
+		Ring->SqRingPtr = Ring->SqRingPtr == MAP_FAILED ? nullptr : Ring->SqRingPtr;
+		Ring->CqRingPtr = Ring->CqRingPtr == MAP_FAILED ? nullptr : Ring->CqRingPtr;
+		Ring->Sqes = SqesPtr == MAP_FAILED ? nullptr : (io_uring_sqe*)SqesPtr;
+		delete Ring;
+		return nullptr;
+	}
+
+	Ring->Sqes = (io_uring_sqe*)SqesPtr;
+
+	uint8* SqRing = (uint8*)Ring->SqRingPtr;
+	Ring->SqHead = (uint32*)(SqRing + Params.sq_off.head);
+	Ring->SqTail = (uint32*)(SqRing + Params.sq_off.tail);
+	Ring->SqMask = *(uint32*)(SqRing + Params.sq_off.ring_mask);
+	Ring->SqArray = (uint32*)(SqRing + Params.sq_off.array);
+
+	uint8* CqRing = (uint8*)Ring->CqRingPtr;
+	Ring->CqHead = (uint32*)(CqRing + Params.cq_off.head);
+	Ring->CqTail = (uint32*)(CqRing + Params.cq_off.tail);
+	Ring->CqMask = *(uint32*)(CqRing + Params.cq_off.ring_mask);
+	Ring->Cqes = (io_uring_cqe*)(CqRing + Params.cq_off.cqes);
+
+	Ring->Results.SetNumZeroed(Ring->QueueDepth);
+
+	return Ring;
+}
+
+FSQLiteIoUring::~FSQLiteIoUring()
+{
+	// The kernel may still be writing into the prefetch buffer, even after a failed io_uring_enter, and would keep on after the ring is closed
+	if (bPrefetchInFlight && !CancelPrefetch())
+	{
+		UE_LOG( LogSqlite, Warning, TEXT("io_uring prefetch could not be reaped, leaking its %d bytes buffer."), PrefetchBuffer.Num() );
+		new TArray<uint8>(MoveTemp(PrefetchBuffer));
+	}
+
+	if (Sqes)
+	{
+		munmap(Sqes, SqesSize);
+	}
+	if (CqRingPtr && CqRingPtr != SqRingPtr)
+	{
+		munmap(CqRingPtr, CqRingSize);
+	}
+	if (SqRingPtr)
+	{
+		munmap(SqRingPtr, SqRingSize);
+	}
+
+	if (RingFd >= 0)
+	{
+		close(RingFd);
+	}
+}
+
+/** Queue a write (adjacent writes are merged), the queued writes are submitted first when the queue is full */
+bool FSQLiteIoUring::QueueWrite( const uint8* InBuffer, int64 InAmountBytes, int64 InOffsetBytes )
+{
+	FScopeLock Lock(&CriticalSection);
+
+	if (bFailed)
+	{
+		return WriteFully(Fd, InBuffer, InAmountBytes, InOffsetBytes);
+	}
+
+	// WAL frames are written as a header followed by the page, they end up in one entry
+	if (QueuedWrites.Num() > 0)
+	{
+		FQueuedWrite& Last = QueuedWrites.Last();
+		if (Last.Offset + Last.Size == InOffsetBytes && Last.DataOffset + Last.Size == WriteData.Num() && Last.Size + InAmountBytes <= MAX_int32)
+		{
+			WriteData.Append(InBuffer, InAmountBytes);
+			Last.Size += InAmountBytes;
+			return true;
+		}
+	}
+
+	// The writes of a submission complete in any order, so an overlapping write has to wait for the next one
+	bool bSubmitFirst = QueuedWrites.Num() >= (int32)QueueDepth - 1 || WriteData.Num() + InAmountBytes > MaxQueuedWriteBytes;
+	for (int32 Index = 0; Index < QueuedWrites.Num() && !bSubmitFirst; Index++)
+	{
+		const FQueuedWrite& Queued = QueuedWrites[Index];
+		bSubmitFirst = InOffsetBytes < Queued.Offset + Queued.Size && Queued.Offset < InOffsetBytes + InAmountBytes;
+	}
+
+	if (bSubmitFirst && !Submit(/*bInSync*/false))
+	{
+		return false;
+	}
+
+	{
+		LLM_SCOPE_BYNAME( TEXT( "Sqlite/IoUring" ) );
+		QueuedWrites.Add({ InOffsetBytes, WriteData.Num(), InAmountBytes });
+		WriteData.Append(InBuffer, InAmountBytes);
+	}
+
+	return true;
+}
+
+/** Submit the queued writes, followed by an fdatasync when bInSync, and wait for them */
+bool FSQLiteIoUring::Submit( bool bInSync )
+{
+	FScopeLock Lock(&CriticalSection);
+
+	if (QueuedWrites.Num() == 0 && !bInSync)
+	{
+		return true;
+	}
+
+	const int32 WriteCount = QueuedWrites.Num();
+
+	bool bSubmitted = false;
+	if (!bFailed)
+	{
+		for (int32 Index = 0; Index < WriteCount; Index++)
+		{
+			const FQueuedWrite& Queued = QueuedWrites[Index];
+
+			io_uring_sqe* Sqe = GetSqe();
+			check(Sqe);
+			Sqe->opcode = IORING_OP_WRITE;
+			Sqe->fd = Fd;
+			Sqe->off = Queued.Offset;
+			Sqe->addr = (uint64)(UPTRINT)(WriteData.GetData() + Queued.DataOffset);
+			Sqe->len = (uint32)Queued.Size;
+			Sqe->user_data = Index;
+		}
+
+		// The sync is drained: it starts once the writes before it completed
+		if (bInSync)
+		{
+			io_uring_sqe* Sqe = GetSqe();
+			check(Sqe);
+			Sqe->opcode = IORING_OP_FSYNC;
+			Sqe->flags = IOSQE_IO_DRAIN;
+			Sqe->fd = Fd;
+			Sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+			Sqe->user_data = WriteCount;
+		}
+
+		bSubmitted = SubmitAndWait(WriteCount + (bInSync ? 1 : 0));
+	}
+
+	// Whatever the ring did not complete is written again, a sync then has to follow it
+	bool bSucceeded = true;
+	bool bRewritten = false;
+	for (int32 Index = 0; Index < WriteCount; Index++)
+	{
+		const FQueuedWrite& Queued = QueuedWrites[Index];
+		if (!bSubmitted || Results[Index] != Queued.Size)
+		{
+			bRewritten = true;
+			bSucceeded &= WriteFully(Fd, WriteData.GetData() + Queued.DataOffset, Queued.Size, Queued.Offset);
+		}
+	}
+
+	if (bInSync && (!bSubmitted || bRewritten || Results[WriteCount] < 0))
+	{
+		bSucceeded &= DataSync(Fd);
+	}
+
+	QueuedWrites.Reset();
+	WriteData.Reset();
+
+	return bSucceeded;
+}
+
+int32 FSQLiteIoUring::GetQueuedWriteCount()
+{
+	FScopeLock Lock(&CriticalSection);
+	return QueuedWrites.Num();
+}
+
+/** Read at an offset, OutBytesRead is short at the end of the file; false if the ring failed, the caller reads by itself */
+bool FSQLiteIoUring::Read( uint8* OutBuffer, int64 InAmountBytes, int64 InOffsetBytes, int64& OutBytesRead )
+{
+	FScopeLock Lock(&CriticalSection);
+
+	OutBytesRead = 0;
+
+	while (OutBytesRead < InAmountBytes && !bFailed)
+	{
+		io_uring_sqe* Sqe = GetSqe();
+		check(Sqe);
+		Sqe->opcode = IORING_OP_READ;
+		Sqe->fd = Fd;
+		Sqe->off = InOffsetBytes + OutBytesRead;
+		Sqe->addr = (uint64)(UPTRINT)(OutBuffer + OutBytesRead);
+		Sqe->len = (uint32)FMath::Min<int64>(InAmountBytes - OutBytesRead, MAX_int32);
+		Sqe->user_data = 0;
+
+		if (!SubmitAndWait(1))
+		{
+			break;
+		}
+
+		const int32 Result = Results[0];
+		if (Result < 0)
+		{
+			if (Result == -EINTR || Result == -EAGAIN)
+			{
+				continue;
+			}
+			return false;
+		}
+
+		// End of the file
+		if (Result == 0)
+		{
+			return true;
+		}
+
+		OutBytesRead += Result;
+	}
+
+	return !bFailed;
+}
+
+/** Start reading a range in the background, there is one prefetch at a time */
+void FSQLiteIoUring::Prefetch( int64 InAmountBytes, int64 InOffsetBytes )
+{
+	FScopeLock Lock(&CriticalSection);
+
+	if (bFailed || InAmountBytes <= 0 || InAmountBytes > MAX_int32 || !WaitPrefetch())
+	{
+		return;
+	}
+
+	if (PrefetchBuffer.Num() < InAmountBytes)
+	{
+		LLM_SCOPE_BYNAME( TEXT( "Sqlite/IoUring" ) );
+		PrefetchBuffer.SetNumUninitialized((int32)InAmountBytes);
+	}
+
+	io_uring_sqe* Sqe = GetSqe();
+	check(Sqe);
+	Sqe->opcode = IORING_OP_READ;
+	Sqe->fd = Fd;
+	Sqe->off = InOffsetBytes;
+	Sqe->addr = (uint64)(UPTRINT)PrefetchBuffer.GetData();
+	Sqe->len = (uint32)InAmountBytes;
+	Sqe->user_data = PrefetchUserData;
+
+	PrefetchOffset = InOffsetBytes;
+	PrefetchSize = InAmountBytes;
+	bPrefetchInFlight = true;
+
+	if (!SubmitAndWait(0))
+	{
+		PrefetchOffset = -1;
+	}
+}
+
+/** Copy the prefetched range if it starts at InOffsetBytes and covers the read, waiting for it if needed */
+bool FSQLiteIoUring::TakePrefetch( uint8* OutBuffer, int64 InAmountBytes, int64 InOffsetBytes, int64& OutBytesRead )
+{
+	FScopeLock Lock(&CriticalSection);
+
+	if (bFailed || PrefetchOffset < 0 || PrefetchOffset != InOffsetBytes || !WaitPrefetch())
+	{
+		return false;
+	}
+
+	PrefetchOffset = -1;
+
+	// A short prefetch stopped at the end of the file, anything else has to cover the read
+	const bool bEndOfFile = PrefetchResult >= 0 && PrefetchResult < PrefetchSize;
+	if (PrefetchResult < 0 || (PrefetchResult < InAmountBytes && !bEndOfFile))
+	{
+		return false;
+	}
+
+	OutBytesRead = FMath::Min<int64>(PrefetchResult, InAmountBytes);
+	FMemory::Memcpy(OutBuffer, PrefetchBuffer.GetData(), OutBytesRead);
+	return true;
+}
+
+/** Forget the prefetched range, the file changed */
+void FSQLiteIoUring::DropPrefetch()
+{
+	FScopeLock Lock(&CriticalSection);
+
+	// A read still in flight completes into the buffer, it is waited for before the buffer is used again
+	PrefetchOffset = -1;
+}
+
+/** Next free submission entry (zeroed), nullptr when the queue is full */
+io_uring_sqe* FSQLiteIoUring::GetSqe()
+{
+	const uint32 Head = __atomic_load_n(SqHead, __ATOMIC_ACQUIRE);
+	const uint32 Tail = *SqTail + PendingSqes;
+	if (Tail - Head >= QueueDepth)
+	{
+		return nullptr;
+	}
+
+	const uint32 Index = Tail & SqMask;
+	io_uring_sqe* Sqe = &Sqes[Index];
+	FMemory::Memzero(*Sqe);
+	SqArray[Index] = Index;
+
+	PendingSqes++;
+	return Sqe;
+}
+
+/** Submit the prepared entries and wait until InWaitCount operations completed, the prefetch excluded */
+bool FSQLiteIoUring::SubmitAndWait( uint32 InWaitCount )
+{
+	uint32 ToSubmit = PendingSqes;
+	if (ToSubmit > 0)
+	{
+		__atomic_store_n(SqTail, *SqTail + ToSubmit, __ATOMIC_RELEASE);
+		PendingSqes = 0;
+	}
+
+	uint32 Completed = ReapCompletions();
+	while (ToSubmit > 0 || Completed < InWaitCount)
+	{
+		const int Submitted = Enter(ToSubmit, Completed < InWaitCount ? 1 : 0);
+		if (Submitted < 0)
+		{
+			return false;
+		}
+
+		ToSubmit -= FMath::Min<uint32>((uint32)Submitted, ToSubmit);
+		Completed += ReapCompletions();
+	}
+
+	return true;
+}
+
+/** Wait for the prefetch in flight, if any */
+bool FSQLiteIoUring::WaitPrefetch()
+{
+	while (bPrefetchInFlight)
+	{
+		ReapCompletions();
+		if (bPrefetchInFlight && Enter(0, 1) < 0)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/** Cancel the prefetch in flight and wait for its completion, false if the ring cannot tell when it completed */
+bool FSQLiteIoUring::CancelPrefetch()
+{
+	ReapCompletions();
+
+	// A full queue leaves nothing but waiting for the read itself
+	if (bPrefetchInFlight)
+	{
+		if (io_uring_sqe* Sqe = GetSqe())
+		{
+			Sqe->opcode = IORING_OP_ASYNC_CANCEL;
+			Sqe->addr = PrefetchUserData;
+			Sqe->user_data = CancelUserData;
+
+			__atomic_store_n(SqTail, *SqTail + PendingSqes, __ATOMIC_RELEASE);
+			PendingSqes = 0;
+		}
+	}
+
+	// The prefetch of a failed submission may still be in the submission queue, everything not consumed yet is submitted
+	while (bPrefetchInFlight)
+	{
+		const uint32 ToSubmit = *SqTail - __atomic_load_n(SqHead, __ATOMIC_ACQUIRE);
+		if (Enter(ToSubmit, 1) < 0)
+		{
+			return false;
+		}
+
+		ReapCompletions();
+	}
+
+	return true;
+}
+
+/** Consume the available completions, returns the number of operations completed (the prefetch excluded) */
+uint32 FSQLiteIoUring::ReapCompletions()
+{
+	uint32 Head = *CqHead;
+	const uint32 Tail = __atomic_load_n(CqTail, __ATOMIC_ACQUIRE);
+
+	uint32 Completed = 0;
+	for (; Head != Tail; Head++)
+	{
+		const io_uring_cqe& Cqe = Cqes[Head & CqMask];
+		if (Cqe.user_data == PrefetchUserData)
+		{
+			PrefetchResult = Cqe.res;
+			bPrefetchInFlight = false;
+		}
+		else if (Cqe.user_data == CancelUserData)
+		{
+			continue;
+		}
+		else
+		{
+			Results[(int32)Cqe.user_data] = Cqe.res;
+			Completed++;
+		}
+	}
+
+	__atomic_store_n(CqHead, Head, __ATOMIC_RELEASE);
+	return Completed;
+}
+
+/** io_uring_enter, retried while interrupted, 0 when the kernel is busy (reap and try again), -1 (and the ring is given up) on error */
+int FSQLiteIoUring::Enter( uint32 InToSubmit, uint32 InMinComplete )
+{
+	const uint32 Flags = InMinComplete > 0 ? IORING_ENTER_GETEVENTS : 0;
+
+	for (;;)
+	{
+		const int Result = (int)syscall(__NR_io_uring_enter, RingFd, InToSubmit, InMinComplete, Flags, nullptr, 0);
+		if (Result >= 0)
+		{
+			return Result;
+		}
+
+		if (errno == EAGAIN || errno == EBUSY)
+		{
+			FPlatformProcess::Yield();
+			return 0;
+		}
+
+		if (errno != EINTR)
+		{
+			UE_LOG( LogSqlite, Warning, TEXT("io_uring_enter failed (errno %d), using positional I/O."), errno );
+			bFailed = true;
+			return -1;
+		}
+	}
+}
+
+#endif
+
+#endif
@@ -0,0 +1,140 @@
+﻿// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#if SQLITE_OS_OTHER
+
+#include "CoreTypes.h"
+#include "Containers/Array.h"
+#include "Misc/ScopeLock.h"
+
+/** Submit the I/O of the "unreal-uring" VFS through io_uring, where the kernel headers have it */
+#ifndef SQLITE_UE_IO_URING
+	#if PLATFORM_LINUX && defined(__has_include)
+		#if __has_include(<linux/io_uring.h>)
+			#define SQLITE_UE_IO_URING 1
+		#endif
+	#endif
+#endif
+
+#ifndef SQLITE_UE_IO_URING
+	#define SQLITE_UE_IO_URING 0
+#endif
+
+#if SQLITE_UE_IO_URING
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/* ========================================================================= */
+/** io_uring submission and completion rings of one file                     */
+/* ========================================================================= */
+
+/**
+ * Writes are queued between sync points and submitted in one go, a sync adds
+ * an fdatasync drained behind them to the same submission. Reads are waited
+ * for, except the prefetch of the next read-ahead window which stays in
+ * flight until it is used or dropped. Anything the ring fails to complete is
+ * done again with positional I/O. The methods can be called from any thread.
+ */
+class FSQLiteIoUring
+{
+public:
+	/** Set up a ring for a descriptor, nullptr when the kernel has no io_uring or does not allow it */
+	static FSQLiteIoUring* Create( int InFd, int32 InQueueDepth );
+
+	~FSQLiteIoUring();
+
+	/** Queue a write (adjacent writes are merged), the queued writes are submitted first when the queue is full */
+	bool QueueWrite( const uint8* InBuffer, int64 InAmountBytes, int64 InOffsetBytes );
+
+	/** Submit the queued writes, followed by an fdatasync when bInSync, and wait for them */
+	bool Submit( bool bInSync );
+
+	int32 GetQueuedWriteCount();
+
+	/** Read at an offset, OutBytesRead is short at the end of the file; false if the ring failed, the caller reads by itself */
+	bool Read( uint8* OutBuffer, int64 InAmountBytes, int64 InOffsetBytes, int64& OutBytesRead );
+
+	/** Start reading a range in the background, there is one prefetch at a time */
+	void Prefetch( int64 InAmountBytes, int64 InOffsetBytes );
+
+	/** Copy the prefetched range if it starts at InOffsetBytes and covers the read, waiting for it if needed */
+	bool TakePrefetch( uint8* OutBuffer, int64 InAmountBytes, int64 InOffsetBytes, int64& OutBytesRead );
+
+	/** Forget the prefetched range, the file changed */
+	void DropPrefetch();
+
+private:
+	FSQLiteIoUring() = default;
+
+	struct FQueuedWrite
+	{
+		int64 Offset;
+		int64 DataOffset;
+		int64 Size;
+	};
+
+	/** Next free submission entry (zeroed), nullptr when the queue is full */
+	io_uring_sqe* GetSqe();
+
+	/** Submit the prepared entries and wait until InWaitCount operations completed, the prefetch excluded */
+	bool SubmitAndWait( uint32 InWaitCount );
+
+	/** Wait for the prefetch in flight, if any */
+	bool WaitPrefetch();
+
+	/** Cancel the prefetch in flight and wait for its completion, false if the ring cannot tell when it completed */
+	bool CancelPrefetch();
+
+	/** Consume the available completions, returns the number of operations completed (the prefetch excluded) */
+	uint32 ReapCompletions();
+
+	/** io_uring_enter, retried while interrupted, 0 when the kernel is busy (reap and try again), -1 (and the ring is given up) on error */
+	int Enter( uint32 InToSubmit, uint32 InMinComplete );
+
+	int RingFd = -1;
+	int Fd = -1;
+	uint32 QueueDepth = 0;
+
+	void* SqRingPtr = nullptr;
+	size_t SqRingSize = 0;
+	void* CqRingPtr = nullptr;
+	size_t CqRingSize = 0;
+	io_uring_sqe* Sqes = nullptr;
+	size_t SqesSize = 0;
+
+	uint32* SqHead = nullptr;
+	uint32* SqTail = nullptr;
+	uint32 SqMask = 0;
+	uint32* SqArray = nullptr;
+	uint32* CqHead = nullptr;
+	uint32* CqTail = nullptr;
+	uint32 CqMask = 0;
+	io_uring_cqe* Cqes = nullptr;
+
+	/** Entries prepared but not submitted yet */
+	uint32 PendingSqes = 0;
+
+	/** Result of each operation of the current submission, by user data */
+	TArray<int32> Results;
+
+	TArray<FQueuedWrite> QueuedWrites;
+	TArray64<uint8> WriteData;
+
+	/** Background read of the next read-ahead window */
+	TArray<uint8> PrefetchBuffer;
+	int64 PrefetchOffset = -1;
+	int64 PrefetchSize = 0;
+	int32 PrefetchResult = 0;
+	bool bPrefetchInFlight = false;
+
+	/** io_uring_enter failed, everything goes through positional I/O from then on */
+	bool bFailed = false;
+
+	FCriticalSection CriticalSection;
+};
+
+#endif
+
+#endif
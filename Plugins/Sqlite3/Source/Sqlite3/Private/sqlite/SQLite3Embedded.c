@@ -22,6 +22,13 @@
 
 	UE_COMPILER_THIRD_PARTY_INCLUDES_START
 
+		/** Compile the native unix VFS in, its sqlite3_os_init runs first and the Unreal VFSes are registered after sqlite3_initialize (see sqlite3_ue_initialize) */
+		#if defined(SQLITE_UE_NATIVE_VFS) && SQLITE_UE_NATIVE_VFS
+			#undef SQLITE_OS_OTHER
+			#define SQLITE_OS_OTHER 0
+			#define SQLITE_OS_UNIX 1
+		#endif
+
 		#include "sqlite/sqlite3.c-inline"
 
 		#if defined(SQLITE_ENABLE_SQLLOG)
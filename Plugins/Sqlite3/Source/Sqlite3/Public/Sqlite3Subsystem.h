@@ -5,6 +5,7 @@
 #include "CoreMinimal.h"
 #include "Subsystems/GameInstanceSubsystem.h"
 
+#include "SqliteStats.h"
 #include "Sqlite3Subsystem.generated.h"
 
 class USqliteStatics;
@@ -13,7 +14,7 @@ class USqliteDatabase;
 /**
  * 
  */
-UCLASS()
+UCLASS( Config=Engine )
 class SQLITE3_API USqlite3Subsystem : public UGameInstanceSubsystem
 {
 	GENERATED_BODY()
@@ -37,6 +38,211 @@ private:
 	 */
 	TArray<USqliteDatabase*> Databases;
 
+	// ---------------------------------------------------------------------------
+	// - Memory budget -----------------------------------------------------------
+	// ---------------------------------------------------------------------------
+
+	/**
+	 * Process-wide advisory limit on SQLite memory in bytes (0 = no limit).
+	 * Once exceeded SQLite starts recycling page cache memory instead of growing.
+	 * (sqlite3_soft_heap_limit64)
+	 */
+	UPROPERTY( Config )
+	int64 SoftHeapLimit = 0;
+
+	/**
+	 * Process-wide hard limit on SQLite memory in bytes (0 = no limit).
+	 * Allocations beyond this limit fail with SQLITE_NOMEM.
+	 * (sqlite3_hard_heap_limit64)
+	 */
+	UPROPERTY( Config )
+	int64 HardHeapLimit = 0;
+
+	/**
+	 * Release SQLite caches when the platform asks the application to trim
+	 * its memory or warns about low memory.
+	 */
+	UPROPERTY( Config )
+	bool bTrimOnMemoryWarning = true;
+
+	/**
+	 * Release SQLite caches once a new map has been loaded.
+	 */
+	UPROPERTY( Config )
+	bool bTrimOnLevelTransition = true;
+
+	// ---------------------------------------------------------------------------
+	// - Allocator ---------------------------------------------------------------
+	// ---------------------------------------------------------------------------
+
+	/**
+	 * Serve SQLite allocations up to 2 KiB from size-class slabs with per-thread
+	 * free caches instead of going through FMemory for each of them.
+	 */
+	UPROPERTY( Config )
+	bool bUseSlabAllocator = false;
+
+	/**
+	 * Bytes of address space reserved for the slab allocator. Once full, small
+	 * allocations fall back to FMemory.
+	 */
+	UPROPERTY( Config )
+	int64 SlabAllocatorRegionSize = 256 * 1024 * 1024;
+
+	/**
+	 * Let SQLite keep its own memory statistics. SQLite updates them under a
+	 * global mutex taken by every allocation of every connection; when off,
+	 * the plugin allocator keeps lock-free per-thread counters instead, but
+	 * the heap limits are no longer enforced (they need SQLite's statistics).
+	 */
+	UPROPERTY( Config )
+	bool bSqliteMemStatus = true;
+
+	// ---------------------------------------------------------------------------
+	// - Mutexes -----------------------------------------------------------------
+	// ---------------------------------------------------------------------------
+
+	/**
+	 * Back SQLite mutexes with an adaptive lock that spins briefly before
+	 * parking the thread, instead of an FCriticalSection. Most SQLite mutexes
+	 * are held for a very short time.
+	 */
+	UPROPERTY( Config )
+	bool bUseAdaptiveMutex = false;
+
+	// ---------------------------------------------------------------------------
+	// - Page cache --------------------------------------------------------------
+	// ---------------------------------------------------------------------------
+
+	/**
+	 * Serve SQLite pages from the plugin page cache (slab allocated, shared
+	 * budget, per-database priority) instead of the SQLite default one.
+	 */
+	UPROPERTY( Config )
+	bool bUseCustomPageCache = false;
+
+	/**
+	 * Bytes of page memory shared by all the connections (0 = no limit).
+	 * Once spent, the pages of the lowest priority databases are evicted first.
+	 */
+	UPROPERTY( Config )
+	int64 PageCacheBudget = 0;
+
+	/**
+	 * Bytes of page cache slabs allocated at startup and kept across trims.
+	 */
+	UPROPERTY( Config )
+	int64 PageCacheReserve = 0;
+
+	/**
+	 * Size in bytes of the blocks the page cache carves its pages from.
+	 */
+	UPROPERTY( Config )
+	int32 PageCacheSlabSize = 256 * 1024;
+
+	// ---------------------------------------------------------------------------
+	// - File system -------------------------------------------------------------
+	// ---------------------------------------------------------------------------
+
+	/**
+	 * Keep the WAL index of the databases in named shared memory instead of
+	 * process memory, so that several processes can use the same database in
+	 * WAL mode. Ignored on platforms without named shared memory.
+	 */
+	UPROPERTY( Config )
+	bool bUseNamedSharedMemory = false;
+
+	/**
+	 * Largest read-ahead in bytes when a database file is read sequentially
+	 * (table scans). The window starts small and doubles while the reads stay
+	 * sequential. 0 disables read-ahead.
+	 */
+	UPROPERTY( Config )
+	int32 ReadAheadMaxSize = 1024 * 1024;
+
+	/**
+	 * Gather adjacent page writes into larger sequential writes, written out
+	 * before anything can observe the file (reads, syncs, lock releases).
+	 */
+	UPROPERTY( Config )
+	bool bUseWriteCoalescing = false;
+
+	/**
+	 * Largest coalesced write in bytes.
+	 */
+	UPROPERTY( Config )
+	int32 WriteCoalescingMaxSize = 1024 * 1024;
+
+	/**
+	 * Return from WAL commits once the frames are handed to the OS, and sync
+	 * the WAL files of all the databases together once per flush window.
+	 * A crash of the game loses nothing, a power loss can lose the commits of
+	 * the last window. Databases in rollback journal mode are not affected.
+	 * See USqliteDatabaseInfo::bGroupDurability to do it for some databases.
+	 */
+	UPROPERTY( Config )
+	bool bRelaxedDurability = false;
+
+	/**
+	 * Flush window of the relaxed durability mode in milliseconds.
+	 */
+	UPROPERTY( Config )
+	int32 SyncFlushWindowMs = 100;
+
+	/**
+	 * Keep the temporary files of SQLite (temp databases, sorts, temp indexes,
+	 * statement journals) in memory instead of the intermediate directory.
+	 */
+	UPROPERTY( Config )
+	bool bUseMemoryTempFiles = false;
+
+	/**
+	 * Size in bytes past which an in-memory temporary file moves to disk.
+	 */
+	UPROPERTY( Config )
+	int64 MemoryTempFileSpillSize = 16 * 1024 * 1024;
+
+	/**
+	 * Block size in bytes of the reads of packaged databases (FileSystem set
+	 * to Packaged) that can not be memory mapped, eg. compressed pak entries.
+	 */
+	UPROPERTY( Config )
+	int32 PakBlockSize = 64 * 1024;
+
+	/**
+	 * Bytes of blocks cached for each packaged database, shared by all its
+	 * connections. Page-compressed databases cache decompressed pages.
+	 */
+	UPROPERTY( Config )
+	int64 PakBlockCacheSize = 4 * 1024 * 1024;
+
+	/**
+	 * Submission queue entries of the io_uring ring each file of the
+	 * databases opened with FileSystem set to io_uring gets (Linux). The
+	 * writes queued between two syncs are submitted early when it fills up.
+	 */
+	UPROPERTY( Config )
+	int32 IoUringQueueDepth = 64;
+
+	// ---------------------------------------------------------------------------
+
+	FSqliteMemoryTrimStats MemoryTrimStats;
+
+	FDelegateHandle MemoryTrimDelegateHandle;
+	FDelegateHandle LowMemoryDelegateHandle;
+	FDelegateHandle PostLoadMapDelegateHandle;
+	FDelegateHandle EndFrameDelegateHandle;
+
+	void OnMemoryTrim();
+
+	void OnPostLoadMap( UWorld* LoadedWorld );
+
+	/** Flush the write queues of the databases that are due, and emit the I/O figures of the frame as CSV profiler stats */
+	void OnEndFrame();
+
+	/** Bytes currently allocated by SQLite, from SQLite or from the plugin allocator */
+	int64 GetMemoryUsed() const;
+
 	// ---------------------------------------------------------------------------
 
 	bool InitializeSqlite();
@@ -70,4 +276,62 @@ public:
 	int getSqliteInitializationStatus();
 
 	FString GetDefaultDatabaseDirectory();
+
+	// ---------------------------------------------------------------------------
+	// - Memory ------------------------------------------------------------------
+	// ---------------------------------------------------------------------------
+
+	/**
+	 * Get the process-wide SQLite memory figures and their high-water marks.
+	 *
+	 * @param bResetHighWater - Reset the high-water marks to the current values after reading them
+	 */
+	UFUNCTION( BlueprintCallable, Category = "Sqlite3|Memory" )
+	FSqliteMemoryStatus GetMemoryStatus( bool bResetHighWater = false );
+
+	/**
+	 * Set the process-wide soft heap limit (0 = no limit).
+	 */
+	UFUNCTION( BlueprintCallable, Category = "Sqlite3|Memory" )
+	void SetSoftHeapLimit( int64 LimitBytes );
+
+	/**
+	 * Set the process-wide hard heap limit (0 = no limit).
+	 */
+	UFUNCTION( BlueprintCallable, Category = "Sqlite3|Memory" )
+	void SetHardHeapLimit( int64 LimitBytes );
+
+	/**
+	 * Flush and release the caches of every open database.
+	 *
+	 * @return The number of bytes given back by SQLite
+	 */
+	UFUNCTION( BlueprintCallable, Category = "Sqlite3|Memory" )
+	int64 TrimMemory();
+
+	UFUNCTION( BlueprintCallable, Category = "Sqlite3|Memory" )
+	FSqliteMemoryTrimStats GetMemoryTrimStats() const;
+
+	/**
+	 * Get the hit/miss and eviction figures of the plugin page cache.
+	 */
+	UFUNCTION( BlueprintCallable, Category = "Sqlite3|Memory" )
+	FSqlitePageCacheStats GetPageCacheStats() const;
+
+	// ---------------------------------------------------------------------------
+	// - Files -------------------------------------------------------------------
+	// ---------------------------------------------------------------------------
+
+	/**
+	 * Get the I/O figures of each kind of file (main database, journal, WAL,
+	 * temporary) since startup, closed files included.
+	 */
+	UFUNCTION( BlueprintCallable, Category = "Sqlite3|Files" )
+	TArray<FSqliteFileIoStats> GetFileTypeIoStats() const;
+
+	/**
+	 * Get the I/O figures of each file currently open by SQLite.
+	 */
+	UFUNCTION( BlueprintCallable, Category = "Sqlite3|Files" )
+	TArray<FSqliteFileIoStats> GetOpenFileIoStats() const;
 };
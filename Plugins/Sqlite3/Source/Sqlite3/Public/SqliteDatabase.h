@@ -4,14 +4,21 @@
 
 #include "CoreMinimal.h"
 #include "UObject/Object.h"
+#include "Containers/Queue.h"
+
+#include <atomic>
 
 #include "sqlite/Sqlite3Include.h"
 
 #include "SqliteDatabaseInfo.h"
 #include "SqliteEnums.h" 
 #include "SqliteStatement.h"
+#include "SqliteStats.h"
+#include "SqliteWriteQueue.h"
 #include "SqliteDatabase.generated.h"
 
+class FSqliteDatabaseWorker;
+
 /**
  * 
  */
@@ -44,6 +51,9 @@ public:
 		UPARAM(DisplayName = "Database") USqliteDatabase* & DatabaseHandle
 	);
 
+	/** Keeps ActiveStatements alive, under StatementsCriticalSection */
+	static void AddReferencedObjects( UObject* InThis, FReferenceCollector& Collector );
+
 protected:
 	/**
 	 * Note: DatabaseInfo asset has been validated by editor.
@@ -77,6 +87,11 @@ private:
 	 */
 	TMap<FString, FString> Attachments;
 
+	/**
+	 * The LLM tag allocations made on behalf of this database are charged to.
+	 */
+	FName LLMTag;
+
 	// ---------------------------------------------------------------------------
 	// - Runtime state -----------------------------------------------------------
 	// ---------------------------------------------------------------------------
@@ -87,15 +102,20 @@ private:
 	sqlite3* DatabaseConnectionHandler = nullptr;
 
 	/**
-	 * List of statements not yet finalized
+	 * List of statements not yet finalized, referenced by AddReferencedObjects.
 	 */
-	UPROPERTY()
 	TArray<USqliteStatement*> ActiveStatements;
 
+	/**
+	 * Guards ActiveStatements and the DatabaseOpenCount of the asset, which
+	 * callers on any thread update when there is a worker thread.
+	 */
+	FCriticalSection StatementsCriticalSection;
+
 	/**
 	 * 
 	 */
-	int LastSqliteReturnCode = SQLITE_OK;
+	std::atomic<int> LastSqliteReturnCode = SQLITE_OK;
 
 	/**
 	 * 
@@ -103,9 +123,56 @@ private:
 	bool bIsInitialized = false;
 
 	/**
-	 * 
+	 * Cleared with DatabaseConnectionHandler by the close job, on the worker
+	 * thread when there is one: commands still queued there see it.
+	 */
+	std::atomic<bool> bIsOpen = false;
+
+	// ---------------------------------------------------------------------------
+
+	/**
+	 * Writes queued from any thread, executed by FlushWriteQueue. One queue per priority class.
+	 */
+	TQueue<FSqliteQueuedWrite, EQueueMode::Mpsc> WriteQueues[(int32)ESqliteWorkPriority::Count];
+
+	std::atomic<int32> QueuedWriteCount = 0;
+
+	double LastWriteQueueFlushTime = 0.0;
+
+	FSqliteWriteQueueStats WriteQueueStats;
+
+	/**
+	 * A flush of the write queue has been handed to the worker thread and is not done yet.
+	 */
+	std::atomic<bool> bWriteQueueFlushPending = false;
+
+	// ---------------------------------------------------------------------------
+
+	/**
+	 * Lock conflicts, see GetBusyStats.
+	 */
+	std::atomic<int64> BusyEvents = 0;
+	std::atomic<int64> BusyRetries = 0;
+	std::atomic<int64> BusyGaveUp = 0;
+	std::atomic<int64> BusyWaitUs = 0;
+
+	/**
+	 * When the current lock conflict began, the busy handler is not called concurrently for a connection.
+	 */
+	double BusyStartTime = 0.0;
+
+	// ---------------------------------------------------------------------------
+
+	/**
+	 * Thread executing the calls made on the connection, when the DatabaseInfo
+	 * asset asks for one (bUseWorkerThread). Created by Open, deleted by Close.
+	 */
+	FSqliteDatabaseWorker* Worker = nullptr;
+
+	/**
+	 * Queue depth and wait time of the worker commands and queued writes, per priority class.
 	 */
-	bool bIsOpen = false;
+	FSqlitePriorityCounters PriorityCounters[(int32)ESqliteWorkPriority::Count];
 
 	// ---------------------------------------------------------------------------
 
@@ -124,6 +191,7 @@ private:
 	// ---------------------------------------------------------------------------
 
 	static const FString Sql_BeginTransaction;
+	static const FString Sql_BeginImmediateTransaction;
 	static const FString Sql_Commit;
 	static const FString Sql_Rollback;
 
@@ -151,6 +219,65 @@ private:
 	 */
 	bool CreateTable( FName TableName, FString Sql ) const;
 
+	/**
+	 * Flush the write queue if the flush interval is over - called by the subsystem at the end of the frame.
+	 */
+	void TickWriteQueue();
+
+	/**
+	 * Execute queued writes in one transaction, up to WriteQueueMaxBatchSize
+	 * and the MaxInFlightStatements of each priority class unless bWithinBudgets
+	 * is false.
+	 */
+	int ExecuteWriteQueueBatch( bool bWithinBudgets );
+
+	/**
+	 * Execute every queued write, batch after batch and without budgets; the
+	 * writes a transaction cannot be started for are completed with its error.
+	 * Called by Close so that no queued write is lost.
+	 */
+	int DrainWriteQueue();
+
+	/**
+	 * Complete every queued write with an error, without executing it.
+	 */
+	void FailQueuedWrites( int ErrorCode );
+
+	/**
+	 * Begin the transaction of a write queue flush. It takes the write lock
+	 * right away, so a lock conflict fails here (SQLITE_BUSY, the writes stay
+	 * queued) rather than on the first write.
+	 */
+	int BeginWriteQueueTransaction();
+
+	/**
+	 * Execute one queued write, reusing the statements of the flush.
+	 */
+	int ExecuteQueuedWrite( const FSqliteQueuedWrite& Write, TMap<FString, sqlite3_stmt*>& Statements );
+
+	bool IsWriteQueueEmpty() const;
+
+	/**
+	 * Take the next queued write by priority class (with aging), skipping the
+	 * classes without budget left in ClassBudgets, whose entry is decremented.
+	 */
+	bool DequeueNextWrite( FSqliteQueuedWrite& OutWrite, int32* ClassBudgets );
+
+	/**
+	 * The database has a worker thread and this is another thread: the call must be handed to the worker.
+	 */
+	bool IsWorkerDispatchNeeded() const;
+
+	/**
+	 * Execute a command on the worker thread and wait for it, on the calling thread if there is no worker.
+	 */
+	void ExecuteOnWorker( TFunctionRef<void()> Command, ESqliteWorkPriority Priority ) const;
+
+	/**
+	 * Delete the worker thread, after executing the commands it still has.
+	 */
+	void StopWorker();
+
 	// ===========================================================================
 	// = 
 	// ===========================================================================
@@ -212,12 +339,44 @@ private:
 	 */
 	void Finalize();
 
+	/**
+	 * Apply the memory budget and memory mapping settings from the DatabaseInfo asset to the connection.
+	 */
+	void ApplyMemoryBudget();
+
+	/**
+	 * Hand the sector size and device characteristics overrides from the DatabaseInfo asset to the VFS, before the files are opened.
+	 */
+	void RegisterFileOptions();
+
+	/**
+	 * Apply the file settings from the DatabaseInfo asset to the main database file.
+	 */
+	void ApplyFileOptions();
+
+	/**
+	 * Install the busy handler if the DatabaseInfo asset has a busy timeout.
+	 */
+	void ApplyBusyPolicy();
+
+	/**
+	 * Decide whether to retry a locked database, and wait before it.
+	 * (sqlite3_busy_handler)
+	 */
+	int BusyHandler( int RetryCount );
+
+	/**
+	 * Name of the VFS selected by the FileSystem setting of the DatabaseInfo asset (nullptr = SQLite default).
+	 */
+	const char* GetVfsName() const;
+
 	// ---------------------------------------------------------------------------
 
 	static unsigned int AutovacuumCallbackGlue( void*, const char*, unsigned int, unsigned int, unsigned int );
 	static void PreupdateHookGlue( void*, sqlite3*, int, const char*, const char*, int64, int64 );
 	static void UpdateHookGlue( void*, int, char const*, char const*, int64 );
 	static int CommitHookGlue( void* );
+	static int BusyHandlerGlue( void*, int );
 	static void RollbackHookGlue( void* );
 
 protected:
@@ -282,6 +441,28 @@ public:
 
 #pragma endregion
 
+#pragma region *** Memory
+	// ===========================================================================
+	// = Memory ==================================================================
+	// ===========================================================================
+
+	/**
+	 * Write dirty pages to disk and release as much of the connection cache
+	 * memory as possible.
+	 * (sqlite3_db_cacheflush, sqlite3_db_release_memory)
+	 */
+	UFUNCTION( BlueprintCallable, Category = "Sqlite3|Memory" )
+	void ReleaseMemory();
+
+	/**
+	 * Get the bytes of heap memory used by the page cache of this connection.
+	 * (SQLITE_DBSTATUS_CACHE_USED)
+	 */
+	UFUNCTION( BlueprintCallable, Category = "Sqlite3|Memory" )
+	int64 GetCacheMemoryUsed() const;
+
+#pragma endregion
+
 #pragma region *** Versioning
 	// ===========================================================================
 	// = application_id & user_version ===========================================
@@ -352,6 +533,107 @@ public:
 
 #pragma endregion
 
+#pragma region *** Durability
+	// ===========================================================================
+	// = Durability ==============================================================
+	// ===========================================================================
+
+	/**
+	 * Durability barrier: returns once every commit of the database is on
+	 * disk. Only needed with group durability (see USqliteDatabaseInfo),
+	 * eg. after a purchase.
+	 *
+	 * @return True if the pending commits could be synced
+	 */
+	UFUNCTION( BlueprintCallable, Category = "Sqlite3|Durability" )
+	bool FlushDurable();
+
+	/**
+	 * Get the commits that are not on disk yet (group durability).
+	 */
+	UFUNCTION( BlueprintCallable, Category = "Sqlite3|Durability" )
+	FSqliteDurabilityStats GetDurabilityStats() const;
+
+#pragma endregion
+
+#pragma region *** Write queue
+	// ===========================================================================
+	// = Write queue =============================================================
+	// ===========================================================================
+
+	/**
+	 * Queue a write (SQL with ?N parameters and their values), from any
+	 * thread. The queued writes are executed in one transaction at the end
+	 * of the frame, or every WriteQueueFlushIntervalMs (see USqliteDatabaseInfo),
+	 * the most urgent priority classes first.
+	 */
+	void EnqueueWrite( const FString& Sql, TArray<FSqliteWriteValue> Bindings = {}, ESqliteWorkPriority Priority = FSqliteWorkPriorityScope::GetCurrent() );
+
+	/**
+	 * Queue a write, the future gets its result code once its transaction
+	 * committed or failed.
+	 */
+	TFuture<int> EnqueueWriteWithResult( const FString& Sql, TArray<FSqliteWriteValue> Bindings = {}, ESqliteWorkPriority Priority = FSqliteWorkPriorityScope::GetCurrent() );
+
+	/**
+	 * Execute the queued writes now, in one transaction. Writes that could not
+	 * start a transaction (eg. SQLITE_BUSY) stay queued for the next flush.
+	 *
+	 * @return The result code of the transaction
+	 */
+	UFUNCTION( BlueprintCallable, Category = "Sqlite3|Write Queue" )
+	int FlushWriteQueue();
+
+	UFUNCTION( BlueprintCallable, Category = "Sqlite3|Write Queue" )
+	FSqliteWriteQueueStats GetWriteQueueStats() const;
+
+#pragma endregion
+
+#pragma region *** Worker thread
+	// ===========================================================================
+	// = Worker thread ===========================================================
+	// ===========================================================================
+
+	/**
+	 * Execute a function on the worker thread of the database and wait for its
+	 * result. Called from the worker thread, or when the database has no worker
+	 * thread (see bUseWorkerThread in USqliteDatabaseInfo), the function is
+	 * executed right away. The calls made by the function are not interleaved
+	 * with those of other threads.
+	 */
+	template<typename FunctionType>
+	auto RunOnWorker( FunctionType&& Function, ESqliteWorkPriority Priority = FSqliteWorkPriorityScope::GetCurrent() ) const -> decltype( Function() );
+
+	/**
+	 * Queue a function for the worker thread of the database, the future gets
+	 * its result. Executed right away when the database has no worker thread.
+	 */
+	TFuture<int> RunOnWorkerAsync( TUniqueFunction<int()> Function, ESqliteWorkPriority Priority = FSqliteWorkPriorityScope::GetCurrent() ) const;
+
+	bool HasWorkerThread() const;
+
+	/**
+	 * Get the queue depth and wait time of a priority class, worker thread
+	 * commands and queued writes together.
+	 */
+	UFUNCTION( BlueprintCallable, Category = "Sqlite3|Priorities" )
+	FSqlitePriorityStats GetPriorityStats( ESqliteWorkPriority Priority ) const;
+
+#pragma endregion
+
+#pragma region *** Busy
+	// ===========================================================================
+	// = Busy ====================================================================
+	// ===========================================================================
+
+	/**
+	 * Get the lock conflicts met by the database since it was created.
+	 */
+	UFUNCTION( BlueprintCallable, Category = "Sqlite3|Busy" )
+	FSqliteBusyStats GetBusyStats() const;
+
+#pragma endregion
+
 #pragma region *** Errors
 	// ===========================================================================
 	// = Errors ==================================================================
@@ -457,3 +739,20 @@ public:
 
 };
 
+template<typename FunctionType>
+auto USqliteDatabase::RunOnWorker( FunctionType&& Function, ESqliteWorkPriority Priority ) const -> decltype( Function() )
+{
+	using ResultType = decltype( Function() );
+
+	if constexpr( std::is_void_v<ResultType> )
+	{
+		ExecuteOnWorker( Function, Priority );
+	}
+	else
+	{
+		TOptional<ResultType> Result;
+		ExecuteOnWorker( [&]() { Result.Emplace( Function() ); }, Priority );
+
+		return MoveTemp( Result.GetValue() );
+	}
+}
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "Engine/DataAsset.h"
+#include "SqliteEnums.h"
 #include "SqliteDatabaseInfo.generated.h"
 
 class USqliteDatabase;
@@ -76,6 +77,89 @@ enum class ESqliteDatabaseCacheMode : uint8
 	UNSET			UMETA( DisplayName = "Default" ),
 };
 
+/**
+ * File system the database is opened with.
+ */
+UENUM( BlueprintType )
+enum class ESqliteDatabaseFileSystem : uint8
+{
+	/**
+	 * Read-write files through the platform file layer ("unreal-fs").
+	 */
+	DEFAULT		UMETA( DisplayName = "Default" ),
+
+	/**
+	 * Read-only database shipped in a pak/IoStore container ("unreal-pak").
+	 * Opened as immutable: no locks and no journal, the database must not be
+	 * in WAL mode. Page-compressed copies (SqliteCompress commandlet) are
+	 * recognized and decompressed page by page.
+	 */
+	PACKAGED	UMETA( DisplayName = "Packaged (read-only)" ),
+
+	/**
+	 * SQLite's own unix VFS ("unix"), Linux only: WAL with shared memory,
+	 * memory mapped I/O and POSIX locks, eg. for dedicated servers. Other
+	 * platforms fall back to Default. A database must not be opened through
+	 * both this and Default at the same time, their locks do not see each
+	 * other.
+	 */
+	NATIVE		UMETA( DisplayName = "Native (Linux)" ),
+
+	/**
+	 * Default with the reads and writes submitted through io_uring
+	 * ("unreal-uring"), Linux only: the writes between two syncs go in one
+	 * submission with the sync, and sequential scans prefetch the next
+	 * read-ahead window. Falls back to Default where io_uring is not
+	 * available, both see each other's locks.
+	 */
+	IO_URING	UMETA( DisplayName = "Unreal with io_uring (Linux)" ),
+};
+
+/**
+ * When the shared page cache budget is spent, pages are taken from the caches
+ * with the lowest priority first. A cache never loses pages to a cache with a
+ * lower priority.
+ */
+UENUM( BlueprintType )
+enum class ESqlitePageCachePriority : uint8
+{
+	LOW			UMETA( DisplayName = "Low" ),
+	NORMAL		UMETA( DisplayName = "Normal" ),	// default
+	HIGH		UMETA( DisplayName = "High" ),
+	CRITICAL	UMETA( DisplayName = "Critical" ),
+};
+
+/**
+ * Guarantees of the storage a database lives on, that let SQLite write less
+ * journal data and sync less often (see SQLITE_IOCAP_*).
+ */
+UENUM( BlueprintType, meta = (Bitflags, UseEnumValuesAsMaskValuesInEditor = "true") )
+enum class ESqliteDeviceCharacteristics : uint8
+{
+	NONE				= 0			UMETA( Hidden ),
+
+	/**
+	 * Writing a sector never damages the neighbouring sectors on power loss.
+	 */
+	POWERSAFE_OVERWRITE	= 1 << 0	UMETA( DisplayName = "Powersafe overwrite" ),
+
+	/**
+	 * Data appended to a file reaches the storage before the new file size.
+	 */
+	SAFE_APPEND			= 1 << 1	UMETA( DisplayName = "Safe append" ),
+
+	/**
+	 * Writes reach the storage in the order they were issued.
+	 */
+	SEQUENTIAL			= 1 << 2	UMETA( DisplayName = "Sequential" ),
+
+	/**
+	 * Aligned 4KiB writes are atomic.
+	 */
+	ATOMIC4K			= 1 << 3	UMETA( DisplayName = "Atomic 4K" ),
+};
+ENUM_CLASS_FLAGS( ESqliteDeviceCharacteristics )
+
 // ============================================================================
 // === Table definition ======================================================= 
 // ============================================================================
@@ -260,6 +344,14 @@ public:
 	 */
 	UPROPERTY( EditAnywhere, Category="Database|Advanced" )
 	ESqliteDatabaseOpenMode OpenMode = ESqliteDatabaseOpenMode::READ_WRITE_CREATE;
+
+	/**
+	 * File system the database is opened with. Packaged databases are always
+	 * opened read-only, whatever the open mode. Sector size, device
+	 * characteristics and chunk size only apply to Default and io_uring.
+	 */
+	UPROPERTY( EditAnywhere, Category = "Database|Advanced" )
+	ESqliteDatabaseFileSystem FileSystem = ESqliteDatabaseFileSystem::DEFAULT;
 	
 	/**
 	 * Override the default %PlatformUserDir%/%ProjectName%/ directory where
@@ -286,7 +378,7 @@ public:
 	 * Set the threading mode for multiple connections to a single database.
 	 * (SQLITE_OPEN_NOMUTEX, SQLITE_OPEN_FULLMUTEX)
 	 */
-	UPROPERTY( EditAnywhere, Category = "Database|Advanced" )
+	UPROPERTY( EditAnywhere, Category = "Database|Advanced", meta = (EditCondition = "!bUseWorkerThread") )
 	ESqliteDatabaseThreadingMode ThreadingMode = ESqliteDatabaseThreadingMode::UNSET;
 
 	/**
@@ -310,6 +402,175 @@ public:
 	UPROPERTY( EditAnywhere, Category = "Database|Advanced" )
 	bool bNoFollow = false;
 
+	/**
+	 * Give the database a thread of its own, the only one using the connection:
+	 * the calls made from other threads are executed there and waited for, the
+	 * write queue is flushed there without stalling the game thread. The hooks
+	 * are called on that thread. The connection is opened without mutex and
+	 * ThreadingMode is ignored.
+	 * (SQLITE_OPEN_NOMUTEX)
+	 */
+	UPROPERTY( EditAnywhere, Category = "Database|Advanced" )
+	bool bUseWorkerThread = false;
+
+	// ---------------------------------------------------------------------------
+
+	/**
+	 * Retry a locked database for up to that many milliseconds before the
+	 * call fails with SQLITE_BUSY. Zero fails at once (SQLite default).
+	 * (sqlite3_busy_handler)
+	 */
+	UPROPERTY( EditAnywhere, Category = "Database|Busy", meta = (ClampMin = "0") )
+	int32 BusyTimeoutMs = 0;
+
+	/**
+	 * Wait before the first retry, doubled at each retry up to BusyMaxBackoffMs.
+	 */
+	UPROPERTY( EditAnywhere, Category = "Database|Busy", meta = (ClampMin = "0", EditCondition = "BusyTimeoutMs > 0") )
+	int32 BusyInitialBackoffMs = 1;
+
+	UPROPERTY( EditAnywhere, Category = "Database|Busy", meta = (ClampMin = "1", EditCondition = "BusyTimeoutMs > 0") )
+	int32 BusyMaxBackoffMs = 50;
+
+	/**
+	 * Part of each wait drawn at random, so that connections waiting for the
+	 * same lock do not retry in step.
+	 */
+	UPROPERTY( EditAnywhere, Category = "Database|Busy", meta = (ClampMin = "0", ClampMax = "1", EditCondition = "BusyTimeoutMs > 0") )
+	float BusyBackoffJitter = 0.5f;
+
+	/**
+	 * Give up after that many retries, even before BusyTimeoutMs. Zero means
+	 * no limit.
+	 */
+	UPROPERTY( EditAnywhere, Category = "Database|Busy", meta = (ClampMin = "0", EditCondition = "BusyTimeoutMs > 0") )
+	int32 BusyMaxRetries = 0;
+
+	/**
+	 * On a task worker thread, run the pending tasks of the task system during
+	 * the backoff instead of sleeping through the Sleep function of the VFS,
+	 * so that a busy database does not hold the worker. Other threads sleep.
+	 */
+	UPROPERTY( EditAnywhere, Category = "Database|Busy", meta = (EditCondition = "BusyTimeoutMs > 0") )
+	bool bBusyYield = false;
+
+	// ---------------------------------------------------------------------------
+
+	/**
+	 * Maximum amount of memory the page cache of this connection may use, in KiB.
+	 * Zero keeps the SQLite default.
+	 * (PRAGMA cache_size = -N)
+	 */
+	UPROPERTY( EditAnywhere, Category = "Database|Memory", meta = (ClampMin = "0") )
+	int32 CacheSizeKiB = 0;
+
+	/**
+	 * Maximum number of bytes of the database file read through a memory mapping
+	 * instead of read calls, in MiB. Zero disables memory mapped reads.
+	 * Falls back to reads where the platform or the file (eg. compressed pak
+	 * entries) can not be mapped.
+	 * (PRAGMA mmap_size = N)
+	 */
+	UPROPERTY( EditAnywhere, Category = "Database|Memory", meta = (ClampMin = "0") )
+	int32 MmapSizeMiB = 0;
+
+	/**
+	 * Eviction priority of the pages of this connection in the shared page cache.
+	 */
+	UPROPERTY( EditAnywhere, Category = "Database|Memory" )
+	ESqlitePageCachePriority PageCachePriority = ESqlitePageCachePriority::NORMAL;
+
+	// ---------------------------------------------------------------------------
+
+	/**
+	 * Grow and shrink the database file in chunks of this size, in KiB, instead
+	 * of one page at a time. Large databases then fragment less and the file
+	 * size metadata is synced once per chunk. Zero disables chunks.
+	 * (SQLITE_FCNTL_CHUNK_SIZE)
+	 */
+	UPROPERTY( EditAnywhere, Category = "Database|Files", meta = (ClampMin = "0") )
+	int32 ChunkSizeKiB = 0;
+
+	/**
+	 * Sector size reported to SQLite for the database, its journal and its WAL,
+	 * in bytes (rounded up to a power of two). Zero uses the physical sector
+	 * size of the storage device where it can be detected, 4096 otherwise.
+	 */
+	UPROPERTY( EditAnywhere, Category = "Database|Files", meta = (ClampMin = "0", ClampMax = "65536") )
+	int32 SectorSize = 0;
+
+	UPROPERTY( EditAnywhere, Category = "Database|Files" )
+	bool bOverrideDeviceCharacteristics = false;
+
+	/**
+	 * Device characteristics reported to SQLite instead of the detected ones.
+	 * Only claim what the storage really guarantees: a wrong claim can corrupt
+	 * the database on power loss.
+	 */
+	UPROPERTY( EditAnywhere, Category = "Database|Files", meta = (Bitmask, BitmaskEnum = "/Script/Sqlite3.ESqliteDeviceCharacteristics", EditCondition = "bOverrideDeviceCharacteristics") )
+	int32 DeviceCharacteristics = 0;
+
+	/**
+	 * Group durability: commits return once their WAL frames are written, a
+	 * background thread syncs the WAL every GroupSyncIntervalMs. A crash of
+	 * the game loses nothing, a power loss can lose the commits of the last
+	 * interval; use FlushDurable after the writes that must not be lost.
+	 * Only databases in WAL mode opened with the Default or io_uring file
+	 * system are affected.
+	 */
+	UPROPERTY( EditAnywhere, Category = "Database|Files" )
+	bool bGroupDurability = false;
+
+	UPROPERTY( EditAnywhere, Category = "Database|Files", meta = (ClampMin = "1", EditCondition = "bGroupDurability") )
+	int32 GroupSyncIntervalMs = 200;
+
+	/**
+	 * Sync before the interval is over once that many KiB were written to the
+	 * WAL since the last sync. Zero only syncs on the interval.
+	 */
+	UPROPERTY( EditAnywhere, Category = "Database|Files", meta = (ClampMin = "0", EditCondition = "bGroupDurability") )
+	int32 GroupSyncKiB = 0;
+
+	// ---------------------------------------------------------------------------
+
+	/**
+	 * Execute the writes of the write queue (USqliteDatabase::EnqueueWrite)
+	 * every that many milliseconds, in one transaction. Zero executes them
+	 * at the end of every frame.
+	 */
+	UPROPERTY( EditAnywhere, Category = "Database|Write Queue", meta = (ClampMin = "0") )
+	int32 WriteQueueFlushIntervalMs = 0;
+
+	/**
+	 * Largest number of writes in one transaction, the others wait for the
+	 * next flush. Zero means no limit.
+	 */
+	UPROPERTY( EditAnywhere, Category = "Database|Write Queue", meta = (ClampMin = "0") )
+	int32 WriteQueueMaxBatchSize = 0;
+
+	// ---------------------------------------------------------------------------
+
+	/**
+	 * Commands of the worker thread and queued writes are taken by priority
+	 * class (see ESqliteWorkPriority). Those which waited that many
+	 * milliseconds are taken as if they were one class more urgent, and so on,
+	 * so that the low classes are not starved. Zero is strict priority.
+	 */
+	UPROPERTY( EditAnywhere, Category = "Database|Priorities", meta = (ClampMin = "0") )
+	int32 PriorityAgingMs = 500;
+
+	/**
+	 * Largest number of writes of a priority class executed in one write queue
+	 * transaction, the others wait for the next flush: a backlog of low
+	 * priority writes does not hold the connection while more urgent work
+	 * waits. The classes not listed have no limit.
+	 */
+	UPROPERTY( EditAnywhere, Category = "Database|Priorities" )
+	TMap<ESqliteWorkPriority, int32> MaxInFlightStatements = {
+		{ ESqliteWorkPriority::Background, 256 },
+		{ ESqliteWorkPriority::Maintenance, 64 }
+	};
+
 	// ---------------------------------------------------------------------------
 
 	/**
@@ -289,3 +289,22 @@ enum class ESqliteExtendedErrorCode : uint8
 
 	WarningAutoIndex			/**/
 };
+
+// ============================================================================
+// === 
+// ============================================================================
+
+/**
+ * Priority class of the work handed to the worker thread or to the write
+ * queue of a database, the most urgent first.
+ */
+UENUM( BlueprintType )
+enum class ESqliteWorkPriority : uint8
+{
+	Critical,					/* A player waits for it */
+	Gameplay,					/* Work of the game thread */
+	Background,					/* Work of the other threads */
+	Maintenance,				/* Exports, analysis, cleanups */
+
+	Count		UMETA(Hidden)
+};
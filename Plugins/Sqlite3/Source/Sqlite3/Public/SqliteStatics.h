@@ -141,4 +141,15 @@ public:
 
 	UFUNCTION( BlueprintCallable, Category = "Sqlite3|Errors", meta = (ExpandEnumAsExecs = "Branch") )
 	static void BranchIfSqliteExtendedErrorCode( int NativeErrorCode, ESqliteExtendedErrorCode ErrorCode, ESqliteDatabaseEqualityExecutionPins& Branch );
+
+	// ---------------------------------------------------------------------------
+	// - Packaging ---------------------------------------------------------------
+	// ---------------------------------------------------------------------------
+
+	/**
+	 * Write a page-compressed copy of a database, to be shipped and opened with
+	 * the PACKAGED file system. The copy is vacuumed and set to rollback journal
+	 * mode. CompressionFormat is an FCompression format name (LZ4, Zlib, ...).
+	 */
+	static bool CompressDatabaseFile( const FString& SourceFilePath, const FString& TargetFilePath, FName CompressionFormat = NAME_LZ4 );
 };
@@ -0,0 +1,358 @@
+// (c)2024+ Laurent Menten
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SqliteStats.generated.h"
+
+// ============================================================================
+// === Memory =================================================================
+// ============================================================================
+
+/**
+ * Process-wide memory figures reported by SQLite (see sqlite3_status64).
+ */
+USTRUCT( BlueprintType )
+struct SQLITE3_API FSqliteMemoryStatus
+{
+	GENERATED_BODY()
+
+	/**
+	 * Bytes currently allocated by SQLite.
+	 * (SQLITE_STATUS_MEMORY_USED)
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Memory" )
+	int64 MemoryUsed = 0;
+
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Memory" )
+	int64 MemoryUsedHighWater = 0;
+
+	/**
+	 * Bytes of page cache that could not be served by the page cache memory pool.
+	 * (SQLITE_STATUS_PAGECACHE_OVERFLOW)
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Memory" )
+	int64 PageCacheOverflow = 0;
+
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Memory" )
+	int64 PageCacheOverflowHighWater = 0;
+
+	/**
+	 * Size of the largest allocation request.
+	 * (SQLITE_STATUS_MALLOC_SIZE)
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Memory" )
+	int64 LargestAllocation = 0;
+
+	/**
+	 * Number of outstanding allocations.
+	 * (SQLITE_STATUS_MALLOC_COUNT)
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Memory" )
+	int64 AllocationCount = 0;
+
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Memory" )
+	int64 AllocationCountHighWater = 0;
+};
+
+/**
+ * Book-keeping of the memory given back by SQLite on trim requests.
+ */
+USTRUCT( BlueprintType )
+struct SQLITE3_API FSqliteMemoryTrimStats
+{
+	GENERATED_BODY()
+
+	/**
+	 * How many times the open databases were asked to release memory.
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Memory" )
+	int32 TrimCount = 0;
+
+	/**
+	 * Bytes reclaimed by the last trim.
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Memory" )
+	int64 LastReclaimedBytes = 0;
+
+	/**
+	 * Bytes reclaimed by all trims since the subsystem was initialized.
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Memory" )
+	int64 TotalReclaimedBytes = 0;
+};
+
+/**
+ * Figures of the plugin page cache, shared by all the connections.
+ */
+USTRUCT( BlueprintType )
+struct SQLITE3_API FSqlitePageCacheStats
+{
+	GENERATED_BODY()
+
+	/**
+	 * Page requests served from the cache.
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Memory" )
+	int64 Hits = 0;
+
+	/**
+	 * Page requests that had to read the page from the database file.
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Memory" )
+	int64 Misses = 0;
+
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Memory" )
+	float HitRatio = 0.0f;
+
+	/**
+	 * Pages taken from a lower priority database to stay within the budget.
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Memory" )
+	int64 Evictions = 0;
+
+	/**
+	 * Pages reused by a database that reached its own cache size.
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Memory" )
+	int64 Recycles = 0;
+
+	/**
+	 * Pages allocated past the budget because nothing could be evicted.
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Memory" )
+	int64 Overflows = 0;
+
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Memory" )
+	int32 PageCount = 0;
+
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Memory" )
+	int32 CacheCount = 0;
+
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Memory" )
+	int64 BytesInUse = 0;
+
+	/**
+	 * Bytes of slabs held by the page cache, used or not.
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Memory" )
+	int64 BytesReserved = 0;
+
+	/**
+	 * Page budget in bytes (0 = no limit).
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Memory" )
+	int64 Budget = 0;
+};
+
+// ============================================================================
+// === Durability =============================================================
+// ============================================================================
+
+/**
+ * Commits of a database that returned before reaching the disk (group
+ * durability), a power loss now would lose them.
+ */
+USTRUCT( BlueprintType )
+struct SQLITE3_API FSqliteDurabilityStats
+{
+	GENERATED_BODY()
+
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Durability" )
+	int64 PendingCommits = 0;
+
+	/**
+	 * Bytes written to the WAL since its last sync.
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Durability" )
+	int64 PendingBytes = 0;
+
+	/**
+	 * Age of the oldest pending commit in milliseconds.
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Durability" )
+	float PendingWindowMs = 0.0f;
+};
+
+// ============================================================================
+// === Write queue ============================================================
+// ============================================================================
+
+/**
+ * Figures of the write queue of a database (see USqliteDatabase::EnqueueWrite).
+ */
+USTRUCT( BlueprintType )
+struct SQLITE3_API FSqliteWriteQueueStats
+{
+	GENERATED_BODY()
+
+	/**
+	 * Writes waiting for the next flush.
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Write Queue" )
+	int32 QueuedWrites = 0;
+
+	/**
+	 * Transactions committed by the flushes, and the writes they carried.
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Write Queue" )
+	int64 Transactions = 0;
+
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Write Queue" )
+	int64 Writes = 0;
+
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Write Queue" )
+	int64 FailedWrites = 0;
+};
+
+// ============================================================================
+// === Busy ===================================================================
+// ============================================================================
+
+/**
+ * Lock conflicts met by a database (see the busy settings of USqliteDatabaseInfo).
+ */
+USTRUCT( BlueprintType )
+struct SQLITE3_API FSqliteBusyStats
+{
+	GENERATED_BODY()
+
+	/**
+	 * Calls that found the database locked.
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Busy" )
+	int64 BusyEvents = 0;
+
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Busy" )
+	int64 Retries = 0;
+
+	/**
+	 * Calls that still found the database locked after the last retry, and failed with SQLITE_BUSY.
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Busy" )
+	int64 GaveUp = 0;
+
+	/**
+	 * Time spent waiting for locks.
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Busy" )
+	float TotalWaitMs = 0.0f;
+};
+
+// ============================================================================
+// === Priorities =============================================================
+// ============================================================================
+
+/**
+ * Figures of one priority class of a database: the commands of its worker
+ * thread and the writes of its write queue.
+ */
+USTRUCT( BlueprintType )
+struct SQLITE3_API FSqlitePriorityStats
+{
+	GENERATED_BODY()
+
+	/**
+	 * Commands and writes waiting.
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Priorities" )
+	int32 QueueDepth = 0;
+
+	/**
+	 * Commands and writes that left the queue since the database was opened.
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Priorities" )
+	int64 Executed = 0;
+
+	/**
+	 * Time spent in the queue.
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Priorities" )
+	float AverageWaitMs = 0.0f;
+
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Priorities" )
+	float MaxWaitMs = 0.0f;
+};
+
+// ============================================================================
+// === Files ==================================================================
+// ============================================================================
+
+UENUM( BlueprintType )
+enum class ESqliteFileType : uint8
+{
+	MAIN_DATABASE	UMETA( DisplayName = "Main database" ),
+	JOURNAL			UMETA( DisplayName = "Journal" ),
+	WAL				UMETA( DisplayName = "WAL" ),
+	TEMP			UMETA( DisplayName = "Temporary" ),		// temp databases, sorts, statement journals
+	OTHER			UMETA( DisplayName = "Other" ),
+};
+
+/**
+ * Figures of one kind of file operation.
+ */
+USTRUCT( BlueprintType )
+struct SQLITE3_API FSqliteIoOpStats
+{
+	GENERATED_BODY()
+
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Files" )
+	int64 Count = 0;
+
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Files" )
+	int64 Bytes = 0;
+
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Files" )
+	int64 TotalLatencyUs = 0;
+
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Files" )
+	float AverageLatencyUs = 0.0f;
+
+	/**
+	 * Latency under which 99% of the operations completed, in microseconds
+	 * (upper bound of the histogram bucket).
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Files" )
+	int64 P99LatencyUs = 0;
+
+	/**
+	 * Bucket N counts the operations that took less than 2^N microseconds,
+	 * the last bucket also counts the slower ones.
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Files" )
+	TArray<int64> LatencyHistogram;
+};
+
+/**
+ * I/O figures of an open file, or of all the files of a kind since startup.
+ */
+USTRUCT( BlueprintType )
+struct SQLITE3_API FSqliteFileIoStats
+{
+	GENERATED_BODY()
+
+	/**
+	 * Empty for the figures of a kind of file.
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Files" )
+	FString Filename;
+
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Files" )
+	ESqliteFileType FileType = ESqliteFileType::OTHER;
+
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Files" )
+	FSqliteIoOpStats Reads;
+
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Files" )
+	FSqliteIoOpStats Writes;
+
+	/**
+	 * Syncs that reached the file system (postponed WAL syncs are counted when
+	 * they happen).
+	 */
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Files" )
+	FSqliteIoOpStats Syncs;
+
+	UPROPERTY( BlueprintReadOnly, Category = "Sqlite3|Files" )
+	FSqliteIoOpStats Truncates;
+};
@@ -0,0 +1,89 @@
+// (c)2024+ Laurent Menten
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/TVariant.h"
+#include "Async/Future.h"
+
+#include <atomic>
+
+#include "SqliteEnums.h"
+
+/**
+ * Value bound to a parameter of a queued write, NULL when empty.
+ */
+using FSqliteWriteValue = TVariant<FEmptyVariantState, int64, double, FString, TArray<uint8>>;
+
+/**
+ * Write operation waiting in the write queue of a database (see USqliteDatabase::EnqueueWrite).
+ */
+struct FSqliteQueuedWrite
+{
+	FString Sql;
+
+	/**
+	 * Bound to ?1, ?2, ... in order.
+	 */
+	TArray<FSqliteWriteValue> Bindings;
+
+	/**
+	 * Set to the result code of the write once its transaction committed or
+	 * failed, null when nobody waits for it.
+	 */
+	TUniquePtr<TPromise<int>> Promise;
+
+	ESqliteWorkPriority Priority = ESqliteWorkPriority::Gameplay;
+
+	/**
+	 * FPlatformTime::Seconds() when queued.
+	 */
+	double EnqueueTime = 0.0;
+};
+
+/**
+ * Priority class of the database calls made by the calling thread while the
+ * scope lives. Without a scope the game thread works as Gameplay and the
+ * other threads as Background.
+ */
+struct SQLITE3_API FSqliteWorkPriorityScope
+{
+	FSqliteWorkPriorityScope( ESqliteWorkPriority InPriority );
+	~FSqliteWorkPriorityScope();
+
+	/**
+	 * Priority class of the calling thread.
+	 */
+	static ESqliteWorkPriority GetCurrent();
+
+private:
+	uint8 SavedPriority;
+};
+
+/**
+ * Counters of the work of one priority class, updated from any thread.
+ */
+struct FSqlitePriorityCounters
+{
+	std::atomic<int32> Queued = 0;
+	std::atomic<int64> Executed = 0;
+	std::atomic<int64> TotalWaitUs = 0;
+	std::atomic<int64> MaxWaitUs = 0;
+
+	/**
+	 * Count one piece of work leaving the queue after waiting InWaitSeconds.
+	 */
+	void Dequeued( double InWaitSeconds )
+	{
+		const int64 WaitUs = (int64)( InWaitSeconds * 1000000.0 );
+
+		Queued--;
+		Executed++;
+		TotalWaitUs += WaitUs;
+
+		int64 MaxUs = MaxWaitUs.load();
+		while( WaitUs > MaxUs && !MaxWaitUs.compare_exchange_weak( MaxUs, WaitUs ) )
+		{
+		}
+	}
+};
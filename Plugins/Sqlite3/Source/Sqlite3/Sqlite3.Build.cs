@@ -154,14 +154,23 @@ public class Sqlite3 : ModuleRules
         // Should we use the Unreal HAL rather than the SQLite platform implementations?
         if (Target.bCompileCustomSQLitePlatform)
         {
-            // Note: The Unreal HAL doesn't provide an implementation of shared memory (as not all platforms implement it),
-            // nor does it provide an implementation of granular file locks. These two things affect the concurrency of an
-            // SQLite database as only one FSqliteDatabase can have the file open at the same time.
+            // Note: The Unreal file system (platform/file.cpp) provides the WAL shared memory on the heap, or in named
+            // shared memory regions for multi-process access (bUseNamedSharedMemory), and arbitrates file locks between the
+            // connections of the process with a lock table. Other processes only see these locks where the platform has
+            // byte-range locks (fcntl on Linux).
 
             PrivateDefinitions.Add("SQLITE_OS_OTHER=1");            // We are a custom OS
             PrivateDefinitions.Add("SQLITE_ZERO_MALLOC");           // We provide our own malloc implementation
             PrivateDefinitions.Add("SQLITE_MUTEX_NOOP");            // We provide our own mutex implementation
             PrivateDefinitions.Add("SQLITE_OMIT_LOAD_EXTENSION");   // We disable extension loading
+            PrivateDefinitions.Add("SQLITE_DEFAULT_MEMSTATUS=1");   // SQLite keeps memory statistics (and enforces the heap limits) unless bSqliteMemStatus is off
+
+            // On Linux the native unix VFS (WAL, shared memory, mmap and POSIX locks) is kept next to the Unreal ones,
+            // databases select it with their FileSystem setting
+            if (Target.Platform == UnrealTargetPlatform.Linux)
+            {
+                PrivateDefinitions.Add("SQLITE_UE_NATIVE_VFS=1");
+            }
         }
 
         // Enable Sqlite debug checks?
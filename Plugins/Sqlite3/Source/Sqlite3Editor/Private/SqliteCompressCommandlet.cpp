@@ -0,0 +1,49 @@
+// (c)2024+ Laurent Menten
+
+#include "SqliteCompressCommandlet.h"
+#include "SqliteStatics.h"
+
+#include "Sqlite3Editor.h"
+#include "Sqlite3EditorLog.h"
+
+#include "Misc/Paths.h"
+
+// ============================================================================
+// = 
+// ============================================================================
+
+USqliteCompressCommandlet::USqliteCompressCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 USqliteCompressCommandlet::Main( const FString& Params )
+{
+	FString SourceFilePath;
+	FString TargetFilePath;
+	FString Format = TEXT( "LZ4" );
+
+	if( !FParse::Value( *Params, TEXT( "Source=" ), SourceFilePath ) || !FParse::Value( *Params, TEXT( "Target=" ), TargetFilePath ) )
+	{
+		UE_LOG( LogSqliteEditor, Error, TEXT( "Usage: -run=SqliteCompress -Source=<database> -Target=<file> [-Format=LZ4|Zlib]" ) );
+		return 1;
+	}
+
+	FParse::Value( *Params, TEXT( "Format=" ), Format );
+
+	// Relative paths are relative to the project
+	if( FPaths::IsRelative( SourceFilePath ) )
+	{
+		SourceFilePath = FPaths::ProjectDir() / SourceFilePath;
+	}
+
+	if( FPaths::IsRelative( TargetFilePath ) )
+	{
+		TargetFilePath = FPaths::ProjectDir() / TargetFilePath;
+	}
+
+	return USqliteStatics::CompressDatabaseFile( SourceFilePath, TargetFilePath, FName( *Format ) ) ? 0 : 1;
+}
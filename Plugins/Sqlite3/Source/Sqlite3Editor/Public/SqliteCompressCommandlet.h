@@ -0,0 +1,23 @@
+// (c)2024+ Laurent Menten
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "SqliteCompressCommandlet.generated.h"
+
+/**
+ * Write a page-compressed copy of a database for the PACKAGED file system.
+ *
+ * UnrealEditor-Cmd <Project> -run=SqliteCompress -Source=<database> -Target=<file> [-Format=LZ4|Zlib]
+ */
+UCLASS()
+class SQLITE3EDITOR_API USqliteCompressCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	USqliteCompressCommandlet();
+
+	virtual int32 Main( const FString& Params ) override;
+};